@@ -1,5 +1,8 @@
 # We have to create a label variable if we want to display it in AboutThisBuild.txt...
 
+# Whatever the target, WITH_TARGET_CLONES also builds the heaviest functions of rtengine for AVX2 and AVX-512,
+# selected at runtime, so a generic build still runs them at near native speed on recent processors
+
 # This first choice should be used for official releases
 set(PROC_TARGET_1_LABEL generic x86 CACHE STRING "Processor-1 label - should be used for official Windows release")
 set(PROC_TARGET_1_FLAGS "-mtune=generic" CACHE STRING "Processor-1 flags")
@@ -31,6 +31,7 @@
 #include "cplx_wavelet_dec.h"
 #include "color.h"
 #include "curves.h"
+#include "fftwplans.h"
 #include "iccmatrices.h"
 #include "iccstore.h"
 #include "imagefloat.h"
@@ -52,6 +53,7 @@
 
 //#define BENCHMARK
 #include "StopWatch.h"
+#include "pipelinetrace.h"
 
 #define TS 64       // Tile size
 #define offset 25   // shift between tiles
@@ -479,9 +481,11 @@ void ImProcFunctions::Tile_calc(int tilesize, int overlap, int kall, int imwidth
 int denoiseNestedLevels = 1;
 enum nrquality {QUALITY_STANDARD, QUALITY_HIGH};
 
+TARGET_CLONES
 void ImProcFunctions::RGB_denoise(int kall, Imagefloat * src, Imagefloat * dst, Imagefloat * calclum, float * ch_M, float *max_r, float *max_b, bool isRAW, const procparams::DirPyrDenoiseParams & dnparams, const double expcomp, const NoiseCurve & noiseLCurve, const NoiseCurve & noiseCCurve, float &nresi, float &highresi)
 {
 BENCHFUN
+    TRACEFUN
     MyTime t1e, t2e;
     t1e.set();
 
@@ -753,27 +757,17 @@ BENCHFUN
             // calculate min size of numblox_W.
             int min_numblox_W = ceil((static_cast<float>((MIN(imwidth, ((numtiles_W - 1) * tileWskip) + tilewidth)) - ((numtiles_W - 1) * tileWskip))) / (offset)) + 2 * blkrad;
 
-            // these are needed only for creation of the plans and will be freed before entering the parallel loop
-            fftwf_plan plan_forward_blox[2];
-            fftwf_plan plan_backward_blox[2];
+            FFTWPlanCache::Plan plan_forward_blox[2];
+            FFTWPlanCache::Plan plan_backward_blox[2];
 
             if (denoiseLuminance) {
-                float *Lbloxtmp  = reinterpret_cast<float*>(fftwf_malloc(max_numblox_W * TS * TS * sizeof(float)));
-                float *fLbloxtmp = reinterpret_cast<float*>(fftwf_malloc(max_numblox_W * TS * TS * sizeof(float)));
-
-                int nfwd[2] = {TS, TS};
-
-                //for DCT:
-                fftw_r2r_kind fwdkind[2] = {FFTW_REDFT10, FFTW_REDFT10};
-                fftw_r2r_kind bwdkind[2] = {FFTW_REDFT01, FFTW_REDFT01};
-
-                // Creating the plans with FFTW_MEASURE instead of FFTW_ESTIMATE speeds up the execute a bit
-                plan_forward_blox[0]  = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-                plan_backward_blox[0] = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-                plan_forward_blox[1]  = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-                plan_backward_blox[1] = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-                fftwf_free(Lbloxtmp);
-                fftwf_free(fLbloxtmp);
+                FFTWPlanCache& plans = FFTWPlanCache::getInstance();
+
+                // Measured plans speed up the execute a bit, the cache and the wisdom make their creation cheap after the first image
+                plan_forward_blox[0]  = plans.getR2R(TS, TS, FFTW_REDFT10, FFTW_REDFT10, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, max_numblox_W);
+                plan_backward_blox[0] = plans.getR2R(TS, TS, FFTW_REDFT01, FFTW_REDFT01, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, max_numblox_W);
+                plan_forward_blox[1]  = plans.getR2R(TS, TS, FFTW_REDFT10, FFTW_REDFT10, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, min_numblox_W);
+                plan_backward_blox[1] = plans.getR2R(TS, TS, FFTW_REDFT01, FFTW_REDFT01, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, min_numblox_W);
             }
 
 #ifndef _OPENMP
@@ -1405,9 +1399,9 @@ BENCHFUN
                                         //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
                                         //fftwf_print_plan (plan_forward_blox);
                                         if (numblox_W == max_numblox_W) {
-                                            fftwf_execute_r2r(plan_forward_blox[0], Lblox, fLblox);    // DCT an entire row of tiles
+                                            fftwf_execute_r2r(plan_forward_blox[0].get(), Lblox, fLblox);    // DCT an entire row of tiles
                                         } else {
-                                            fftwf_execute_r2r(plan_forward_blox[1], Lblox, fLblox);    // DCT an entire row of tiles
+                                            fftwf_execute_r2r(plan_forward_blox[1].get(), Lblox, fLblox);    // DCT an entire row of tiles
                                         }
 
                                         //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -1423,9 +1417,9 @@ BENCHFUN
 
                                         //now perform inverse FT of an entire row of blocks
                                         if (numblox_W == max_numblox_W) {
-                                            fftwf_execute_r2r(plan_backward_blox[0], fLblox, Lblox);    //for DCT
+                                            fftwf_execute_r2r(plan_backward_blox[0].get(), fLblox, Lblox);    //for DCT
                                         } else {
-                                            fftwf_execute_r2r(plan_backward_blox[1], fLblox, Lblox);    //for DCT
+                                            fftwf_execute_r2r(plan_backward_blox[1].get(), fLblox, Lblox);    //for DCT
                                         }
 
                                         int topproc = (vblk - blkrad) * offset;
@@ -1753,13 +1747,6 @@ BENCHFUN
                 }
             }
 
-            if (denoiseLuminance) {
-                // destroy the plans
-                fftwf_destroy_plan(plan_forward_blox[0]);
-                fftwf_destroy_plan(plan_backward_blox[0]);
-                fftwf_destroy_plan(plan_forward_blox[1]);
-                fftwf_destroy_plan(plan_backward_blox[1]);
-            }
         } while (memoryAllocationFailed && numTries < 2 && (options.rgbDenoiseThreadLimit == 0) && !ponder);
 
         if (memoryAllocationFailed) {
@@ -2030,6 +2017,7 @@ BENCHFUN
 
 
 //void ImProcFunctions::RGBtile_denoise(float * fLblox, int hblproc, float noisevar_Ldetail, float * nbrwt, float * blurbuffer)  //for DCT
+TARGET_CLONES
 void ImProcFunctions::RGBtile_denoise(float* fLblox, int hblproc, float noisevar_Ldetail)  //for DCT
 {
     float nbrwt[TS * TS] ALIGNED64;
@@ -2187,6 +2175,7 @@ void ImProcFunctions::Noise_residualAB(const wavelet_decomposition &WaveletCoeff
     chmaxresid = maxresid;
 }
 
+TARGET_CLONES
 bool ImProcFunctions::WaveletDenoiseAll_BiShrinkL(wavelet_decomposition& WaveletCoeffs_L, float *noisevarlum, float madL[8][3], float * vari, int edge, int denoiseNestedLevels)
 {
     int maxlvl = min(WaveletCoeffs_L.maxlevel(), 5);
@@ -2374,6 +2363,7 @@ bool ImProcFunctions::WaveletDenoiseAll_BiShrinkL(wavelet_decomposition& Wavelet
 }
 
 
+TARGET_CLONES
 bool ImProcFunctions::WaveletDenoiseAll_BiShrinkAB(wavelet_decomposition& WaveletCoeffs_L, wavelet_decomposition& WaveletCoeffs_ab, float *noisevarchrom, float madL[8][3], float *variC, int local, float noisevar_ab, const bool useNoiseCCurve,  bool autoch, bool denoiseMethodRgb, int denoiseNestedLevels)
 {
     int maxlvl = WaveletCoeffs_L.maxlevel();
@@ -2672,6 +2662,7 @@ bool ImProcFunctions::WaveletDenoiseAllAB(wavelet_decomposition& WaveletCoeffs_L
 
 
 
+TARGET_CLONES
 void ImProcFunctions::ShrinkAllL(wavelet_decomposition& WaveletCoeffs_L, float **buffer, int level, int dir,
         float *noisevarlum, float * madL, float * vari, int edge)
 
@@ -2763,6 +2754,7 @@ void ImProcFunctions::ShrinkAllL(wavelet_decomposition& WaveletCoeffs_L, float *
 }
 
 
+TARGET_CLONES
 void ImProcFunctions::ShrinkAllAB(wavelet_decomposition& WaveletCoeffs_L, wavelet_decomposition& WaveletCoeffs_ab, float **buffer, int level, int dir,
         float * noisevarchrom, float noisevar_ab,  const bool useNoiseCCurve, bool autoch,
         bool denoiseMethodRgb, float * madL,  float * variC, int local, float * madaab,  bool madCalculated)
@@ -45,6 +45,7 @@ unsigned fc(const unsigned int cfa[2][2], int r, int c) {
 namespace rtengine
 {
 
+TARGET_CLONES
 void RawImageSource::amaze_demosaic_RT(int winx, int winy, int winw, int winh, const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue, size_t chunkSize, bool measure)
 {
 
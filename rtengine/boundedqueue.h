@@ -0,0 +1,104 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+
+#include <glibmm/threads.h>
+
+#include "noncopyable.h"
+
+namespace rtengine
+{
+
+/**
+ * @brief Blocking FIFO of limited capacity, used to chain the stages of the batch processing
+ *
+ * push() blocks while the queue is full and pop() blocks while it is empty, so a fast stage
+ * can't run arbitrarily far ahead of a slow one and the memory held by the pipeline stays
+ * bounded. Once close() has been called, push() refuses new items (the caller keeps their
+ * ownership) and pop() returns the remaining items, then fails.
+ */
+template<typename T>
+class BoundedQueue :
+    public NonCopyable
+{
+public:
+    explicit BoundedQueue(std::size_t capacity) :
+        capacity(std::max<std::size_t>(capacity, 1)),
+        closed(false)
+    {
+    }
+
+    bool push(const T& item)
+    {
+        Glib::Threads::Mutex::Lock lock(mutex);
+
+        while (items.size() >= capacity && !closed) {
+            notFull.wait(mutex);
+        }
+
+        if (closed) {
+            return false;
+        }
+
+        items.push_back(item);
+        notEmpty.signal();
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        Glib::Threads::Mutex::Lock lock(mutex);
+
+        while (items.empty() && !closed) {
+            notEmpty.wait(mutex);
+        }
+
+        if (items.empty()) {
+            return false;
+        }
+
+        item = items.front();
+        items.pop_front();
+        notFull.signal();
+        return true;
+    }
+
+    void close()
+    {
+        Glib::Threads::Mutex::Lock lock(mutex);
+
+        closed = true;
+        notFull.broadcast();
+        notEmpty.broadcast();
+    }
+
+private:
+    const std::size_t capacity;
+    bool closed;
+    std::deque<T> items;
+
+    // Need to be a Glib::Threads::Mutex because used in Glib::Threads::Cond objects
+    Glib::Threads::Mutex mutex;
+    Glib::Threads::Cond notFull;
+    Glib::Threads::Cond notEmpty;
+};
+
+}
@@ -29,6 +29,7 @@
 namespace rtengine
 {
 
+TARGET_CLONES
 void boxblur(float** src, float** dst, int radius, int W, int H, bool multiThread)
 {
     //box blur using rowbuffers and linebuffers instead of a full size buffer
@@ -271,6 +272,7 @@ void boxblur(float** src, float** dst, int radius, int W, int H, bool multiThrea
     }
 }
 
+TARGET_CLONES
 void boxabsblur(float** src, float** dst, int radius, int W, int H, bool multiThread)
 {
     //abs box blur using rowbuffers and linebuffers instead of a full size buffer, W should be a multiple of 16
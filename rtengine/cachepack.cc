@@ -0,0 +1,755 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+
+#ifdef WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/file.h>
+#endif
+
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include "cachepack.h"
+
+namespace
+{
+
+// Both followed by the identifier of the pack, so that an index is never used with another pack
+constexpr char packMagic[8] = {'R', 'T', 'C', 'P', 'A', 'C', 'K', '1'};
+constexpr char indexMagic[8] = {'R', 'T', 'C', 'I', 'N', 'D', 'X', '1'};
+constexpr std::size_t headerSize = sizeof(packMagic) + sizeof(std::uint64_t);
+
+// Each file is a record made of the size of its key, the size of its data, the key and the data. A removed file
+// is a record with this data size and no data.
+constexpr std::uint32_t removedSize = 0xffffffff;
+constexpr std::size_t recordHeaderSize = 2 * sizeof(std::uint32_t);
+
+template<typename T>
+bool readValue(const std::string& data, std::size_t& pos, T& value)
+{
+    if (data.size() - pos < sizeof(T)) {
+        return false;
+    }
+
+    memcpy(&value, data.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+template<typename T>
+void appendValue(std::string& data, const T& value)
+{
+    data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+std::uint64_t getRecordSize(const std::string& key, std::uint32_t size)
+{
+    return recordHeaderSize + key.size() + (size == removedSize ? 0 : size);
+}
+
+// Changed whenever the offsets of the records change, so that an older index is never used with the pack
+std::uint64_t getNewPackId()
+{
+    return static_cast<std::uint64_t>(g_random_int()) << 32 | g_random_int();
+}
+
+// Opens path with an exclusive advisory lock, released when it is closed. -1 if another process holds it.
+int openLocked(const std::string& path)
+{
+    const int fd = g_open(path.c_str(), O_RDWR | O_CREAT, 0666);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+#ifdef WIN32
+    OVERLAPPED overlapped = {};
+    const bool locked = LockFileEx(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &overlapped);
+#else
+    const bool locked = !flock(fd, LOCK_EX | LOCK_NB);
+#endif
+
+    if (!locked) {
+        g_close(fd, nullptr);
+        return -1;
+    }
+
+    return fd;
+}
+
+}
+
+namespace rtengine
+{
+
+CachePack& CachePack::getInstance()
+{
+    static CachePack instance;
+    return instance;
+}
+
+CachePack::CachePack() :
+    lockFd(-1),
+    file(nullptr),
+    mapping(nullptr),
+    packId(0),
+    packSize(0),
+    unusedSize(0)
+{
+}
+
+CachePack::~CachePack()
+{
+    close();
+}
+
+bool CachePack::open(const Glib::ustring& dir)
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (file) {
+        return baseDir == dir;
+    }
+
+    baseDir = dir;
+    packPath = Glib::build_filename(dir, "cache.pack");
+    indexPath = Glib::build_filename(dir, "cache.index");
+    entries.clear();
+    unusedSize = 0;
+
+    // held while the pack is open, another instance using the same cache directory falls back to the files.
+    // It has its own file, as the pack is replaced when it is compacted.
+    lockFd = openLocked(Glib::build_filename(dir, "cache.lock"));
+
+    if (lockFd < 0) {
+        return false;
+    }
+
+    // appended to only, it is read through the mapping
+    file = g_fopen(packPath.c_str(), "a+b");
+
+    if (!file) {
+        unlock();
+        return false;
+    }
+
+    if (!map(0) || g_mapped_file_get_length(mapping) < headerSize || memcmp(g_mapped_file_get_contents(mapping), packMagic, sizeof(packMagic))) {
+        reset();
+    } else {
+        packSize = g_mapped_file_get_length(mapping);
+        memcpy(&packId, g_mapped_file_get_contents(mapping) + sizeof(packMagic), sizeof(packId));
+    }
+
+    if (!file) {
+        unlock();
+        return false;
+    }
+
+    const std::uint64_t indexed = loadIndex();
+
+    if (!indexed) {
+        entries.clear();
+        unusedSize = 0;
+    }
+
+    // the files written after the index was saved, the pack is rewritten if it ends with a partial record
+    if (!scan(indexed ? indexed : headerSize)) {
+        compact();
+    }
+
+    if (!file) {
+        unlock();
+        return false;
+    }
+
+    return true;
+}
+
+void CachePack::close()
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (!file) {
+        return;
+    }
+
+    if (unusedSize <= packSize / 2 || !compact()) {
+        saveIndex();
+    }
+
+    unmap();
+
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+
+    entries.clear();
+    unlock();
+}
+
+bool CachePack::isOpen() const
+{
+    MyMutex::MyLock lock(mutex);
+
+    return file;
+}
+
+bool CachePack::read(const Glib::ustring& fname, std::string& data)
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (!file) {
+        return false;
+    }
+
+    const auto entry = entries.find(getKey(fname));
+
+    if (entry == entries.end() || !map(entry->second.offset + entry->second.size)) {
+        return false;
+    }
+
+    data.assign(g_mapped_file_get_contents(mapping) + entry->second.offset, entry->second.size);
+    entry->second.lastUsed = g_get_real_time();
+
+    return true;
+}
+
+bool CachePack::write(const Glib::ustring& fname, const std::string& data)
+{
+    MyMutex::MyLock lock(mutex);
+
+    const std::string key = getKey(fname);
+
+    if (!file || key.empty() || data.size() >= removedSize) {
+        return false;
+    }
+
+    const std::uint64_t offset = packSize + recordHeaderSize + key.size();
+
+    if (!appendRecord(key, data.data(), data.size())) {
+        return false;
+    }
+
+    const auto entry = entries.find(key);
+
+    if (entry != entries.end()) {
+        unusedSize += getRecordSize(key, entry->second.size);
+    }
+
+    entries[key] = {offset, static_cast<std::uint32_t>(data.size()), g_get_real_time()};
+
+    return true;
+}
+
+void CachePack::erase(const Glib::ustring& fname)
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (!file) {
+        return;
+    }
+
+    const std::string key = getKey(fname);
+    const auto entry = entries.find(key);
+
+    if (entry != entries.end() && appendRecord(key, nullptr, removedSize)) {
+        unusedSize += getRecordSize(key, entry->second.size) + getRecordSize(key, removedSize);
+        entries.erase(entry);
+    }
+}
+
+bool CachePack::move(const Glib::ustring& oldName, const Glib::ustring& newName)
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (!file) {
+        return false;
+    }
+
+    const std::string oldKey = getKey(oldName);
+    const std::string newKey = getKey(newName);
+    const auto entry = entries.find(oldKey);
+
+    if (entry == entries.end() || newKey.empty() || !map(entry->second.offset + entry->second.size)) {
+        return false;
+    }
+
+    // the data is copied, as appending may change the mapping
+    const Entry oldEntry = entry->second;
+    const std::string data(g_mapped_file_get_contents(mapping) + oldEntry.offset, oldEntry.size);
+    const std::uint64_t offset = packSize + recordHeaderSize + newKey.size();
+
+    if (!appendRecord(newKey, data.data(), data.size()) || !appendRecord(oldKey, nullptr, removedSize)) {
+        return false;
+    }
+
+    unusedSize += getRecordSize(oldKey, oldEntry.size) + getRecordSize(oldKey, removedSize);
+    entries.erase(oldKey);
+
+    const auto replaced = entries.find(newKey);
+
+    if (replaced != entries.end()) {
+        unusedSize += getRecordSize(newKey, replaced->second.size);
+    }
+
+    entries[newKey] = {offset, oldEntry.size, oldEntry.lastUsed};
+
+    return true;
+}
+
+void CachePack::removeDir(const Glib::ustring& dirName)
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (!file) {
+        return;
+    }
+
+    const std::string prefix = dirName.raw() + '/';
+    std::vector<std::string> removed;
+
+    for (auto entry = entries.begin(); entry != entries.end();) {
+        if (!entry->first.compare(0, prefix.size(), prefix)) {
+            removed.push_back(entry->first);
+            unusedSize += getRecordSize(entry->first, entry->second.size);
+            entry = entries.erase(entry);
+        } else {
+            ++entry;
+        }
+    }
+
+    // rewriting the pack is cheaper than a record per removed file, which is only needed if it fails
+    if (!removed.empty() && !compact()) {
+        for (const auto& key : removed) {
+            appendRecord(key, nullptr, removedSize);
+            unusedSize += getRecordSize(key, removedSize);
+        }
+    }
+}
+
+std::vector<std::pair<Glib::ustring, gint64>> CachePack::getFiles(const Glib::ustring& dirName) const
+{
+    MyMutex::MyLock lock(mutex);
+
+    const std::string prefix = dirName.raw() + '/';
+    std::vector<std::pair<Glib::ustring, gint64>> files;
+
+    for (const auto& entry : entries) {
+        if (!entry.first.compare(0, prefix.size(), prefix)) {
+            files.emplace_back(entry.first.substr(prefix.size()), entry.second.lastUsed);
+        }
+    }
+
+    return files;
+}
+
+bool CachePack::removePack(const Glib::ustring& baseDir)
+{
+    if (!hasPack(baseDir)) {
+        return true;
+    }
+
+    {
+        CachePack& pack = getInstance();
+        MyMutex::MyLock lock(pack.mutex);
+
+        if (pack.file && pack.baseDir == baseDir) {
+            return false;
+        }
+    }
+
+    const int fd = openLocked(Glib::build_filename(baseDir, "cache.lock"));
+
+    if (fd < 0) {
+        return false;
+    }
+
+    g_remove(Glib::build_filename(baseDir, "cache.index").c_str());
+    const bool removed = !g_remove(Glib::build_filename(baseDir, "cache.pack").c_str());
+    g_close(fd, nullptr);
+
+    return removed;
+}
+
+bool CachePack::hasPack(const Glib::ustring& baseDir)
+{
+    return Glib::file_test(Glib::build_filename(baseDir, "cache.pack"), Glib::FILE_TEST_EXISTS);
+}
+
+bool CachePack::readFile(const Glib::ustring& fname, std::string& data)
+{
+    CachePack& pack = getInstance();
+
+    if (pack.isOpen()) {
+        return pack.read(fname, data);
+    }
+
+    try {
+        data = Glib::file_get_contents(fname);
+    } catch (Glib::FileError&) {
+        return false;
+    }
+
+    return true;
+}
+
+bool CachePack::writeFile(const Glib::ustring& fname, const std::string& data, bool text)
+{
+    CachePack& pack = getInstance();
+
+    if (pack.isOpen()) {
+        return pack.write(fname, data);
+    }
+
+    FILE* const f = g_fopen(fname.c_str(), text ? "wt" : "wb");
+
+    if (!f) {
+        return false;
+    }
+
+    const bool written = fwrite(data.data(), 1, data.size(), f) == data.size();
+
+    return fclose(f) == 0 && written;
+}
+
+std::string CachePack::getKey(const Glib::ustring& fname) const
+{
+    const std::string& path = fname.raw();
+    const std::string& base = baseDir.raw();
+
+    if (path.size() <= base.size() + 1 || path.compare(0, base.size(), base) || !G_IS_DIR_SEPARATOR(path[base.size()])) {
+        return std::string();
+    }
+
+    std::string key = path.substr(base.size() + 1);
+    std::replace(key.begin(), key.end(), G_DIR_SEPARATOR, '/');
+
+    return key;
+}
+
+bool CachePack::appendRecord(const std::string& key, const char* data, std::uint32_t size)
+{
+    if (!file) {
+        return false;
+    }
+
+    const std::uint32_t keySize = key.size();
+
+    const bool written =
+        fwrite(&keySize, sizeof(keySize), 1, file) == 1
+        && fwrite(&size, sizeof(size), 1, file) == 1
+        && fwrite(key.data(), 1, keySize, file) == keySize
+        && (size == removedSize || fwrite(data, 1, size, file) == size)
+        && fflush(file) == 0;
+
+    if (!written) {
+        // the end of the pack is unknown, starts again with an empty one
+        reset();
+        return false;
+    }
+
+    packSize += getRecordSize(key, size);
+
+    return true;
+}
+
+bool CachePack::scan(std::uint64_t start)
+{
+    if (start > packSize || !map(packSize)) {
+        return false;
+    }
+
+    const char* const contents = g_mapped_file_get_contents(mapping);
+    const gint64 now = g_get_real_time();
+    std::uint64_t pos = start;
+
+    while (packSize - pos >= recordHeaderSize) {
+        std::uint32_t keySize;
+        std::uint32_t size;
+        memcpy(&keySize, contents + pos, sizeof(keySize));
+        memcpy(&size, contents + pos + sizeof(keySize), sizeof(size));
+
+        if (packSize - pos - recordHeaderSize < keySize || packSize - pos - recordHeaderSize - keySize < (size == removedSize ? 0 : size)) {
+            break;
+        }
+
+        const std::string key(contents + pos + recordHeaderSize, keySize);
+        const auto entry = entries.find(key);
+
+        if (entry != entries.end()) {
+            unusedSize += getRecordSize(key, entry->second.size);
+            entries.erase(entry);
+        }
+
+        if (size == removedSize) {
+            unusedSize += getRecordSize(key, size);
+        } else {
+            entries[key] = {pos + recordHeaderSize + keySize, size, now};
+        }
+
+        pos += getRecordSize(key, size);
+    }
+
+    return pos == packSize;
+}
+
+std::uint64_t CachePack::loadIndex()
+{
+    std::string data;
+
+    try {
+        data = Glib::file_get_contents(indexPath);
+    } catch (Glib::FileError&) {
+        return 0;
+    }
+
+    std::size_t pos = sizeof(indexMagic);
+    std::uint64_t indexPackId;
+    std::uint64_t indexed;
+    std::uint64_t unused;
+    std::uint32_t count;
+
+    if (
+        data.size() < sizeof(indexMagic)
+        || memcmp(data.data(), indexMagic, sizeof(indexMagic))
+        || !readValue(data, pos, indexPackId)
+        || indexPackId != packId
+        || !readValue(data, pos, indexed)
+        || indexed < headerSize
+        || indexed > packSize
+        || !readValue(data, pos, unused)
+        || !readValue(data, pos, count)
+    ) {
+        return 0;
+    }
+
+    entries.reserve(count);
+
+    for (std::uint32_t i = 0; i < count; ++i) {
+        std::uint32_t keySize;
+
+        if (!readValue(data, pos, keySize) || data.size() - pos < keySize) {
+            return 0;
+        }
+
+        std::string key = data.substr(pos, keySize);
+        pos += keySize;
+        Entry entry;
+
+        if (
+            !readValue(data, pos, entry.offset)
+            || !readValue(data, pos, entry.size)
+            || !readValue(data, pos, entry.lastUsed)
+            || entry.offset > indexed
+            || indexed - entry.offset < entry.size
+        ) {
+            return 0;
+        }
+
+        entries.emplace(std::move(key), entry);
+    }
+
+    unusedSize = unused;
+
+    return indexed;
+}
+
+bool CachePack::saveIndex() const
+{
+    std::string data(indexMagic, sizeof(indexMagic));
+    appendValue(data, packId);
+    appendValue(data, packSize);
+    appendValue(data, unusedSize);
+    appendValue(data, static_cast<std::uint32_t>(entries.size()));
+
+    for (const auto& entry : entries) {
+        appendValue(data, static_cast<std::uint32_t>(entry.first.size()));
+        data += entry.first;
+        appendValue(data, entry.second.offset);
+        appendValue(data, entry.second.size);
+        appendValue(data, entry.second.lastUsed);
+    }
+
+    // written under a temporary name, so that a partial index is never read
+    const std::string tmpPath = indexPath + ".tmp";
+    FILE* const f = g_fopen(tmpPath.c_str(), "wb");
+    bool written = f && fwrite(data.data(), 1, data.size(), f) == data.size();
+
+    if (f) {
+        written = fclose(f) == 0 && written;
+    }
+
+    if (!written || g_rename(tmpPath.c_str(), indexPath.c_str())) {
+        // the pack is scanned at the next start instead
+        g_remove(tmpPath.c_str());
+        g_remove(indexPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool CachePack::map(std::uint64_t size)
+{
+    if (mapping && g_mapped_file_get_length(mapping) >= size) {
+        return true;
+    }
+
+    unmap();
+
+    mapping = g_mapped_file_new(packPath.c_str(), FALSE, nullptr);
+
+    return mapping && g_mapped_file_get_length(mapping) >= size;
+}
+
+void CachePack::unmap()
+{
+    if (mapping) {
+        g_mapped_file_unref(mapping);
+        mapping = nullptr;
+    }
+}
+
+bool CachePack::compact()
+{
+    if (!map(packSize)) {
+        return false;
+    }
+
+    const std::string tmpPath = packPath + ".tmp";
+    FILE* const f = g_fopen(tmpPath.c_str(), "wb");
+
+    if (!f) {
+        return false;
+    }
+
+    const char* const contents = g_mapped_file_get_contents(mapping);
+    std::vector<std::uint64_t> offsets;
+    offsets.reserve(entries.size());
+    std::uint64_t size = headerSize;
+
+    const std::uint64_t newPackId = getNewPackId();
+    bool written =
+        fwrite(packMagic, sizeof(packMagic), 1, f) == 1
+        && fwrite(&newPackId, sizeof(newPackId), 1, f) == 1;
+
+    for (auto entry = entries.begin(); written && entry != entries.end(); ++entry) {
+        const std::uint32_t keySize = entry->first.size();
+
+        written =
+            fwrite(&keySize, sizeof(keySize), 1, f) == 1
+            && fwrite(&entry->second.size, sizeof(entry->second.size), 1, f) == 1
+            && fwrite(entry->first.data(), 1, keySize, f) == keySize
+            && fwrite(contents + entry->second.offset, 1, entry->second.size, f) == entry->second.size;
+
+        offsets.push_back(size + recordHeaderSize + keySize);
+        size += getRecordSize(entry->first, entry->second.size);
+    }
+
+    written = fclose(f) == 0 && written;
+
+    // the pack can't be replaced while it is mapped or open on Windows
+    unmap();
+    fclose(file);
+
+    // the index of the old pack goes first, a crash before the new one is saved then only costs a scan
+    if (written && g_remove(indexPath.c_str()) && errno != ENOENT) {
+        written = false;
+    }
+
+    if (!written || g_rename(tmpPath.c_str(), packPath.c_str())) {
+        g_remove(tmpPath.c_str());
+        file = g_fopen(packPath.c_str(), "a+b");
+        return false;
+    }
+
+    file = g_fopen(packPath.c_str(), "a+b");
+
+    if (!file || !map(size)) {
+        reset();
+        return false;
+    }
+
+    std::size_t i = 0;
+
+    for (auto& entry : entries) {
+        entry.second.offset = offsets[i++];
+    }
+
+    packId = newPackId;
+    packSize = size;
+    unusedSize = 0;
+    saveIndex();
+
+    return true;
+}
+
+void CachePack::reset()
+{
+    unmap();
+
+    if (file) {
+        fclose(file);
+    }
+
+    entries.clear();
+    packSize = 0;
+    unusedSize = 0;
+    g_remove(indexPath.c_str());
+    g_remove(packPath.c_str());
+
+    file = g_fopen(packPath.c_str(), "a+b");
+
+    if (!file) {
+        return;
+    }
+
+    packId = getNewPackId();
+
+    if (
+        fwrite(packMagic, sizeof(packMagic), 1, file) != 1
+        || fwrite(&packId, sizeof(packId), 1, file) != 1
+        || fflush(file)
+        || !map(headerSize)
+    ) {
+        unmap();
+        fclose(file);
+        file = nullptr;
+        return;
+    }
+
+    packSize = headerSize;
+}
+
+void CachePack::unlock()
+{
+    if (lockFd >= 0) {
+        g_close(lockFd, nullptr);
+        lockFd = -1;
+    }
+}
+
+}
@@ -0,0 +1,115 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glib.h>
+#include <glibmm/ustring.h>
+
+#include "noncopyable.h"
+
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+/**
+ * @brief Single file store of the files of the cache directory
+ *
+ * The files are appended to a pack file and found through an index held in memory, saved next to the pack when
+ * it is closed. The time each file was last read or written is kept in the index, to evict the least recently
+ * used entries of the cache without listing the cache directory. The files are read from a mapping of the pack.
+ *
+ * A file replaced or removed leaves its old content in the pack until it is compacted, which happens when it is
+ * closed if more than half of the pack is unused.
+ *
+ * The files are identified by their path, which has to be in the directory given to open(). Only one process
+ * opens the pack of a directory at a time, the others use the files.
+ */
+class CachePack final :
+    public NonCopyable
+{
+public:
+    static CachePack& getInstance();
+
+    // Opens the pack of the cache in baseDir, false on error
+    bool open(const Glib::ustring& baseDir);
+    // Saves the index and compacts the pack if needed
+    void close();
+    bool isOpen() const;
+
+    bool read(const Glib::ustring& fname, std::string& data);
+    bool write(const Glib::ustring& fname, const std::string& data);
+    void erase(const Glib::ustring& fname);
+    bool move(const Glib::ustring& oldName, const Glib::ustring& newName);
+
+    // Removes the files of a sub-directory of the cache
+    void removeDir(const Glib::ustring& dirName);
+    // Names of the files of a sub-directory, with the time they were last used in microseconds since the epoch
+    std::vector<std::pair<Glib::ustring, gint64>> getFiles(const Glib::ustring& dirName) const;
+
+    // Deletes the pack of the cache in baseDir, unless a process has it open. False if it is left.
+    static bool removePack(const Glib::ustring& baseDir);
+    static bool hasPack(const Glib::ustring& baseDir);
+
+    // Reads a file of the cache, from the pack if it is open
+    static bool readFile(const Glib::ustring& fname, std::string& data);
+    // Writes a file of the cache, to the pack if it is open
+    static bool writeFile(const Glib::ustring& fname, const std::string& data, bool text);
+
+private:
+    struct Entry {
+        std::uint64_t offset; // of the data
+        std::uint32_t size;
+        gint64 lastUsed;
+    };
+
+    CachePack();
+    ~CachePack();
+
+    std::string getKey(const Glib::ustring& fname) const;
+    bool appendRecord(const std::string& key, const char* data, std::uint32_t size);
+    bool scan(std::uint64_t start);
+    // Returns the size of the pack covered by the index, 0 if it can't be used
+    std::uint64_t loadIndex();
+    bool saveIndex() const;
+    bool map(std::uint64_t size);
+    void unmap();
+    bool compact();
+    void reset();
+    void unlock();
+
+    mutable MyMutex mutex;
+    Glib::ustring baseDir;
+    std::string packPath;
+    std::string indexPath;
+    int lockFd;
+    FILE* file;
+    GMappedFile* mapping;
+    std::uint64_t packId;
+    std::uint64_t packSize;
+    std::uint64_t unusedSize;
+    std::unordered_map<std::string, Entry> entries;
+};
+
+}
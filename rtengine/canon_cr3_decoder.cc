@@ -829,18 +829,13 @@ inline void crxFillBuffer(CrxBitstream* bitStrm)
     if (bitStrm->curPos >= bitStrm->curBufSize && bitStrm->mdatSize) {
         bitStrm->curPos = 0;
         bitStrm->curBufOffset += bitStrm->curBufSize;
-#ifdef _OPENMP
+#if defined( _OPENMP ) && !defined( MYFILE_MMAP )
         #pragma omp critical
 #endif
         {
-#ifndef _OPENMP
-            bitStrm->input->lock();
-#endif
+            // each worker reads through its own copy of the file with MYFILE_MMAP
             bitStrm->input->seek(bitStrm->curBufOffset, SEEK_SET);
             bitStrm->curBufSize = bitStrm->input->read(bitStrm->mdatBuf, 1, std::min(bitStrm->mdatSize, CRX_BUF_SIZE));
-#ifndef _OPENMP
-            bitStrm->input->unlock();
-#endif
 
             if (bitStrm->curBufSize < 1) {  // nothing read
                 throw std::exception();
@@ -2440,7 +2435,8 @@ bool crxSetupSubbandData(
     CrxImage* img,
     CrxPlaneComp* planeComp,
     const CrxTile* tile,
-    std::uint32_t mdatOffset
+    std::uint32_t mdatOffset,
+    LibRaw_abstract_datastream* input
 )
 {
     long compDataSize = 0;
@@ -2553,7 +2549,7 @@ bool crxSetupSubbandData(
                     subbands[subbandNum].height,
                     supportsPartial,
                     roundedBitsMask,
-                    img->input
+                    input
                 )
             ) {
                 return false;
@@ -2566,61 +2562,67 @@ bool crxSetupSubbandData(
 
 } // namespace
 
-bool DCraw::crxDecodePlane(void* p, std::uint32_t planeNumber)
+bool DCraw::crxDecodePlane(void* p, std::uint32_t planeNumber, std::uint32_t tileNumber, IMFILE* input)
 {
     CrxImage* const img = static_cast<CrxImage*>(p);
+    const int tRow = tileNumber / img->tileCols;
+    const int tCol = tileNumber % img->tileCols;
+
     int imageRow = 0;
 
-    for (int tRow = 0; tRow < img->tileRows; ++tRow) {
-        int imageCol = 0;
+    for (int i = 0; i < tRow; ++i) {
+        imageRow += img->tiles[i * img->tileCols].height;
+    }
 
-        for (int tCol = 0; tCol < img->tileCols; ++tCol) {
-            const CrxTile* const tile = img->tiles + tRow * img->tileRows + tCol;
-            CrxPlaneComp* const planeComp = tile->comps + planeNumber;
-            const std::uint64_t tileMdatOffset = tile->dataOffset + planeComp->dataOffset;
+    int imageCol = 0;
 
-            // decode single tile
-            if (!crxSetupSubbandData(img, planeComp, tile, tileMdatOffset)) {
-                return false;
-            }
+    for (int i = 0; i < tCol; ++i) {
+        imageCol += img->tiles[tRow * img->tileCols + i].width;
+    }
 
-            if (img->levels) {
-                if (!crxIdwt53FilterInitialize(planeComp, img->levels - 1)) {
-                    return false;
-                }
+    const CrxTile* const tile = img->tiles + tileNumber;
+    CrxPlaneComp* const planeComp = tile->comps + planeNumber;
+    const std::uint64_t tileMdatOffset = tile->dataOffset + planeComp->dataOffset;
+    LibRaw_abstract_datastream stream = {input};
 
-                for (int i = 0; i < tile->height; ++i) {
-                    if (!crxIdwt53FilterDecode(planeComp, img->levels - 1) || !crxIdwt53FilterTransform(planeComp, img->levels - 1)) {
-                        return false;
-                    }
+    bool result = true;
 
+    try {
+        // decode single tile
+        if (!crxSetupSubbandData(img, planeComp, tile, tileMdatOffset, &stream)) {
+            result = false;
+        } else if (img->levels) {
+            if (!crxIdwt53FilterInitialize(planeComp, img->levels - 1)) {
+                result = false;
+            }
+
+            for (int i = 0; result && i < tile->height; ++i) {
+                if (!crxIdwt53FilterDecode(planeComp, img->levels - 1) || !crxIdwt53FilterTransform(planeComp, img->levels - 1)) {
+                    result = false;
+                } else {
                     const std::int32_t* const lineData = crxIdwt53FilterGetLine(planeComp, img->levels - 1);
                     crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
                 }
-            } else {
-                // we have the only subband in this case
-                if (!planeComp->subBands->dataSize) {
-                    memset(planeComp->subBands->bandBuf, 0, planeComp->subBands->bandSize);
-                    return true;
-                }
-
-                for (int i = 0; i < tile->height; ++i) {
-                    if (!crxDecodeLine(planeComp->subBands->bandParam, planeComp->subBands->bandBuf)) {
-                        return false;
-                    }
-
+            }
+        } else if (planeComp->subBands->dataSize) {
+            // we have the only subband in this case
+            for (int i = 0; result && i < tile->height; ++i) {
+                if (!crxDecodeLine(planeComp->subBands->bandParam, planeComp->subBands->bandBuf)) {
+                    result = false;
+                } else {
                     const std::int32_t* const lineData = reinterpret_cast<std::int32_t*>(planeComp->subBands->bandBuf);
                     crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
                 }
             }
-
-            imageCol += tile->width;
         }
-
-        imageRow += img->tiles[tRow * img->tileRows].height;
+    } catch (const std::exception&) { // truncated data
+        result = false;
     }
 
-    return true;
+    // the line buffers of this tile plane are not needed anymore
+    crxFreeSubbandData(img, planeComp);
+
+    return result;
 }
 
 namespace
@@ -3070,29 +3072,38 @@ void crxFreeImageData(CrxImage* img)
 
 void DCraw::crxLoadDecodeLoop(void* img, int nPlanes)
 {
-#ifdef _OPENMP
-    bool results[4]; // nPlanes is always <= 4
-    #pragma omp parallel for
-
-    for (std::int32_t plane = 0; plane < nPlanes; ++plane) {
-        results[plane] = crxDecodePlane(img, plane);
-    }
+    // The planes of each tile are coded independently, so all of them are decoded in parallel,
+    // each worker reading through its own copy of the file and with its own line buffers
+    const int nTiles = static_cast<CrxImage*>(img)->tileRows * static_cast<CrxImage*>(img)->tileCols;
+    const int nJobs = nTiles * nPlanes;
+    bool error = false;
+
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+    #pragma omp parallel
+#endif
+    {
+        IMFILE ifpthr = *ifp;
 
-    for (std::int32_t plane = 0; plane < nPlanes; ++plane) {
-        if (!results[plane]) {
-            derror();
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+        // only master thread will update the progress bar
+        ifpthr.plistener = nullptr;
+        #pragma omp master
+        {
+            ifpthr.plistener = ifp->plistener;
         }
-    }
-
-#else
+        #pragma omp for schedule(dynamic) reduction(||:error) nowait
+#endif
 
-    for (std::int32_t plane = 0; plane < nPlanes; ++plane) {
-        if (!crxDecodePlane(img, plane)) {
-            derror();
+        for (int job = 0; job < nJobs; ++job) {
+            if (!crxDecodePlane(img, job % nPlanes, job / nPlanes, &ifpthr)) {
+                error = true;
+            }
         }
     }
 
-#endif
+    if (error) {
+        derror();
+    }
 }
 
 void DCraw::crxConvertPlaneLineDf(void* p, int imageRow)
@@ -30,6 +30,7 @@
 #include "StopWatch.h"
 #include "opthelper.h"
 #include "../rtgui/multilangmgr.h"
+#include "pipelinetrace.h"
 
 namespace {
 
@@ -1000,6 +1001,7 @@ namespace rtengine
 {
 
 void RawImageSource::captureSharpening(const procparams::CaptureSharpeningParams &sharpeningParams, bool showMask, double &conrastThreshold, double &radius) {
+    TRACEFUN
 
     if (!(ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS || ri->get_colors() == 1)) {
         return;
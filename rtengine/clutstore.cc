@@ -63,7 +63,7 @@ bool loadFile(
             img_src.convertColorSpace(img_float.get(), icm, curr_wb);
         }
 
-        AlignedBuffer<std::uint16_t> image(fw * fh * 4 + 4); // getClutValues() loads one pixel in advance
+        AlignedBuffer<std::uint16_t> image(fw * fh * 4);
 
         std::size_t index = 0;
 
@@ -84,34 +84,107 @@ bool loadFile(
     return res;
 }
 
+// Above this size, the nodes are kept as 16 bit integers (Hald CLUTs of level 16 and more)
+constexpr std::size_t maxFloatClutSize = 64 * 1024 * 1024;
+
 #ifdef __SSE2__
-vfloat2 getClutValues(const AlignedBuffer<std::uint16_t>& clut_image, size_t index)
+inline vfloat getClutNode(const float* clut, std::size_t node)
+{
+    return LVF(clut[node * 4]);
+}
+
+inline vfloat getClutNode(const std::uint16_t* clut, std::size_t node)
+{
+    const vint v_values = _mm_loadl_epi64(reinterpret_cast<const vint*>(clut + node * 4));
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v_values, _mm_setzero_si128()));
+}
+#endif
+
+// Tetrahedral interpolation: the cube cell is split into 6 tetrahedra along its main diagonal, the one
+// containing the color is found by sorting the fractional parts, and only its 4 nodes are read
+template<typename T>
+void getTetrahedralRGB(
+    const T* clut,
+    unsigned int level,
+    float flevel_minus_one,
+    float flevel_minus_two,
+    float strength,
+    std::size_t line_size,
+    const float* r,
+    const float* g,
+    const float* b,
+    float* out_rgbx
+)
 {
-    const vint v_values = _mm_loadu_si128(reinterpret_cast<const vint*>(clut_image.data + index));
-#ifdef __SSE4_1__
-    return {
-        _mm_cvtepi32_ps(_mm_cvtepu16_epi32(v_values)),
-        _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(v_values, 8)))
-    };
+    const unsigned int level_square = level * level;
+
+#ifdef __SSE2__
+    const vfloat v_strength = F2V(strength);
+    const vfloat v_one = F2V(1.f);
+#endif
+
+    for (std::size_t column = 0; column < line_size; ++column, ++r, ++g, ++b, out_rgbx += 4) {
+        const unsigned int red = std::min(flevel_minus_two, *r * flevel_minus_one);
+        const unsigned int green = std::min(flevel_minus_two, *g * flevel_minus_one);
+        const unsigned int blue = std::min(flevel_minus_two, *b * flevel_minus_one);
+
+        const std::size_t color = red + green * level + blue * level_square;
+
+        float f[3] = {
+            *r * flevel_minus_one - red,
+            *g * flevel_minus_one - green,
+            *b * flevel_minus_one - blue
+        };
+        unsigned int stride[3] = {1, level, level_square};
+
+        // sort the fractional parts in decreasing order
+        if (f[0] < f[1]) {
+            std::swap(f[0], f[1]);
+            std::swap(stride[0], stride[1]);
+        }
+
+        if (f[1] < f[2]) {
+            std::swap(f[1], f[2]);
+            std::swap(stride[1], stride[2]);
+        }
+
+        if (f[0] < f[1]) {
+            std::swap(f[0], f[1]);
+            std::swap(stride[0], stride[1]);
+        }
+
+        const std::size_t node1 = color + stride[0];
+        const std::size_t node2 = node1 + stride[1];
+        const std::size_t node3 = node2 + stride[2];
+
+#ifdef __SSE2__
+        const vfloat v_in = _mm_set_ps(0.0f, *b, *g, *r);
+        const vfloat v_f0 = F2V(f[0]);
+        const vfloat v_f1 = F2V(f[1]);
+        const vfloat v_f2 = F2V(f[2]);
+
+        const vfloat v_out =
+            (v_one - v_f0) * getClutNode(clut, color)
+            + (v_f0 - v_f1) * getClutNode(clut, node1)
+            + (v_f1 - v_f2) * getClutNode(clut, node2)
+            + v_f2 * getClutNode(clut, node3);
+
+        STVF(*out_rgbx, vintpf(v_strength, v_out, v_in));
 #else
-    const vint v_mask = _mm_set1_epi32(0x0000FFFF);
-
-    vint v_low = _mm_shuffle_epi32(v_values, _MM_SHUFFLE(1, 0, 1, 0));
-    vint v_high = _mm_shuffle_epi32(v_values, _MM_SHUFFLE(3, 2, 3, 2));
-    v_low = _mm_shufflelo_epi16(v_low, _MM_SHUFFLE(1, 1, 0, 0));
-    v_high = _mm_shufflelo_epi16(v_high, _MM_SHUFFLE(1, 1, 0, 0));
-    v_low = _mm_shufflehi_epi16(v_low, _MM_SHUFFLE(3, 3, 2, 2));
-    v_high = _mm_shufflehi_epi16(v_high, _MM_SHUFFLE(3, 3, 2, 2));
-    v_low = vandm(v_low, v_mask);
-    v_high = vandm(v_high, v_mask);
-
-    return {
-        _mm_cvtepi32_ps(v_low),
-        _mm_cvtepi32_ps(v_high)
-    };
+        const float in[3] = {*r, *g, *b};
+
+        for (int c = 0; c < 3; ++c) {
+            const float out =
+                (1.f - f[0]) * clut[color * 4 + c]
+                + (f[0] - f[1]) * clut[node1 * 4 + c]
+                + (f[1] - f[2]) * clut[node2 * 4 + c]
+                + f[2] * clut[node3 * 4 + c];
+
+            out_rgbx[c] = intp<float>(strength, out, in[c]);
+        }
 #endif
+    }
 }
-#endif
 
 }
 
@@ -137,6 +210,18 @@ bool rtengine::HaldCLUT::load(const Glib::ustring& filename)
         clut_level *= clut_level;
         flevel_minus_one = static_cast<float>(clut_level - 1) / 65535.0f;
         flevel_minus_two = static_cast<float>(clut_level - 2);
+
+        // The CLUTStore shares the expanded nodes with all the images using this CLUT
+        const std::size_t size = static_cast<std::size_t>(clut_level) * clut_level * clut_level * 4;
+
+        if (size * sizeof(float) <= maxFloatClutSize && clut_float.resize(size)) {
+            for (std::size_t i = 0; i < size; ++i) {
+                clut_float.data[i] = clut_image.data[i];
+            }
+
+            AlignedBuffer<std::uint16_t>().swap(clut_image);
+        }
+
         return true;
     }
 
@@ -145,7 +230,7 @@ bool rtengine::HaldCLUT::load(const Glib::ustring& filename)
 
 rtengine::HaldCLUT::operator bool() const
 {
-    return !clut_image.isEmpty();
+    return !clut_image.isEmpty() || !clut_float.isEmpty();
 }
 
 Glib::ustring rtengine::HaldCLUT::getFilename() const
@@ -167,106 +252,10 @@ void rtengine::HaldCLUT::getRGB(
     float* out_rgbx
 ) const
 {
-    const unsigned int level = clut_level; // This is important
-
-    const unsigned int level_square = level * level;
-
-#ifdef __SSE2__
-    const vfloat v_strength = F2V(strength);
-#endif
-
-    for (std::size_t column = 0; column < line_size; ++column, ++r, ++g, ++b, out_rgbx += 4) {
-        const unsigned int red = std::min(flevel_minus_two, *r * flevel_minus_one);
-        const unsigned int green = std::min(flevel_minus_two, *g * flevel_minus_one);
-        const unsigned int blue = std::min(flevel_minus_two, *b * flevel_minus_one);
-
-        const unsigned int color = red + green * level + blue * level_square;
-
-#ifndef __SSE2__
-        const float re = *r * flevel_minus_one - red;
-        const float gr = *g * flevel_minus_one - green;
-        const float bl = *b * flevel_minus_one - blue;
-
-        size_t index = color * 4;
-
-        float tmp1[4] ALIGNED16;
-        tmp1[0] = intp<float>(re, clut_image.data[index + 4], clut_image.data[index]);
-        tmp1[1] = intp<float>(re, clut_image.data[index + 5], clut_image.data[index + 1]);
-        tmp1[2] = intp<float>(re, clut_image.data[index + 6], clut_image.data[index + 2]);
-
-        index = (color + level) * 4;
-
-        float tmp2[4] ALIGNED16;
-        tmp2[0] = intp<float>(re, clut_image.data[index + 4], clut_image.data[index]);
-        tmp2[1] = intp<float>(re, clut_image.data[index + 5], clut_image.data[index + 1]);
-        tmp2[2] = intp<float>(re, clut_image.data[index + 6], clut_image.data[index + 2]);
-
-        out_rgbx[0] = intp<float>(gr, tmp2[0], tmp1[0]);
-        out_rgbx[1] = intp<float>(gr, tmp2[1], tmp1[1]);
-        out_rgbx[2] = intp<float>(gr, tmp2[2], tmp1[2]);
-
-        index = (color + level_square) * 4;
-
-        tmp1[0] = intp<float>(re, clut_image.data[index + 4], clut_image.data[index]);
-        tmp1[1] = intp<float>(re, clut_image.data[index + 5], clut_image.data[index + 1]);
-        tmp1[2] = intp<float>(re, clut_image.data[index + 6], clut_image.data[index + 2]);
-
-        index = (color + level + level_square) * 4;
-
-        tmp2[0] = intp<float>(re, clut_image.data[index + 4], clut_image.data[index]);
-        tmp2[1] = intp<float>(re, clut_image.data[index + 5], clut_image.data[index + 1]);
-        tmp2[2] = intp<float>(re, clut_image.data[index + 6], clut_image.data[index + 2]);
-
-        tmp1[0] = intp<float>(gr, tmp2[0], tmp1[0]);
-        tmp1[1] = intp<float>(gr, tmp2[1], tmp1[1]);
-        tmp1[2] = intp<float>(gr, tmp2[2], tmp1[2]);
-
-        out_rgbx[0] = intp<float>(bl, tmp1[0], out_rgbx[0]);
-        out_rgbx[1] = intp<float>(bl, tmp1[1], out_rgbx[1]);
-        out_rgbx[2] = intp<float>(bl, tmp1[2], out_rgbx[2]);
-
-        out_rgbx[0] = intp<float>(strength, out_rgbx[0], *r);
-        out_rgbx[1] = intp<float>(strength, out_rgbx[1], *g);
-        out_rgbx[2] = intp<float>(strength, out_rgbx[2], *b);
-#else
-        const vfloat v_in = _mm_set_ps(0.0f, *b, *g, *r);
-        const vfloat v_tmp = v_in * F2V(flevel_minus_one);
-        const vfloat v_rgb = v_tmp - _mm_cvtepi32_ps(_mm_cvttps_epi32(vminf(v_tmp, F2V(flevel_minus_two))));
-
-        size_t index = color * 4;
-
-        const vfloat v_r = PERMUTEPS(v_rgb, _MM_SHUFFLE(0, 0, 0, 0));
-
-        vfloat2 v_clut_values = getClutValues(clut_image, index);
-        vfloat v_tmp1 = vintpf(v_r, v_clut_values.y, v_clut_values.x);
-
-        index = (color + level) * 4;
-
-        v_clut_values = getClutValues(clut_image, index);
-        vfloat v_tmp2 = vintpf(v_r, v_clut_values.y, v_clut_values.x);
-
-        const vfloat v_g = PERMUTEPS(v_rgb, _MM_SHUFFLE(1, 1, 1, 1));
-
-        vfloat v_out = vintpf(v_g, v_tmp2, v_tmp1);
-
-        index = (color + level_square) * 4;
-
-        v_clut_values = getClutValues(clut_image, index);
-        v_tmp1 = vintpf(v_r, v_clut_values.y, v_clut_values.x);
-
-        index = (color + level + level_square) * 4;
-
-        v_clut_values = getClutValues(clut_image, index);
-        v_tmp2 = vintpf(v_r, v_clut_values.y, v_clut_values.x);
-
-        v_tmp1 = vintpf(v_g, v_tmp2, v_tmp1);
-
-        const vfloat v_b = PERMUTEPS(v_rgb, _MM_SHUFFLE(2, 2, 2, 2));
-
-        v_out = vintpf(v_b, v_tmp1, v_out);
-
-        STVF(*out_rgbx, vintpf(v_strength, v_out, v_in));
-#endif
+    if (!clut_float.isEmpty()) {
+        getTetrahedralRGB(clut_float.data, clut_level, flevel_minus_one, flevel_minus_two, strength, line_size, r, g, b, out_rgbx);
+    } else {
+        getTetrahedralRGB(clut_image.data, clut_level, flevel_minus_one, flevel_minus_two, strength, line_size, r, g, b, out_rgbx);
     }
 }
 
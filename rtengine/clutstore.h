@@ -42,7 +42,8 @@ public:
     );
 
 private:
-    AlignedBuffer<std::uint16_t> clut_image;
+    AlignedBuffer<std::uint16_t> clut_image; // RGBX nodes, released once expanded to clut_float
+    AlignedBuffer<float> clut_float;
     unsigned int clut_level;
     float flevel_minus_one;
     float flevel_minus_two;
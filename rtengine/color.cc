@@ -1708,6 +1708,7 @@ inline float Color::computeXYZ2Lab(float f)
     }
 }
 
+TARGET_CLONES
 void Color::RGB2Lab(float *R, float *G, float *B, float *L, float *a, float *b, const float wp[3][3], int width)
 {
 
@@ -1772,6 +1773,7 @@ void Color::RGB2Lab(float *R, float *G, float *B, float *L, float *a, float *b,
     }
 }
 
+TARGET_CLONES
 void Color::RGB2L(const float *R, const float *G, const float *B, float *L, const float wp[3][3], int width)
 {
 
@@ -1811,6 +1813,7 @@ void Color::RGB2L(const float *R, const float *G, const float *B, float *L, cons
     }
 }
 
+TARGET_CLONES
 void Color::Lab2RGBLimit(float *L, float *a, float *b, float *R, float *G, float *B, const float wp[3][3], float limit, float afactor, float bfactor, int width)
 {
 
@@ -17,6 +17,7 @@
 *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <iostream>
 #include <cstdio>
 #include <cstring>
@@ -27,11 +28,13 @@
 
 #include "dcp.h"
 
+#include "alignedbuffer.h"
 #include "cJSON.h"
 #include "color.h"
 #include "iccmatrices.h"
 #include "iccstore.h"
 #include "imagefloat.h"
+#include "opthelper.h"
 #include "rawimagesource.h"
 #include "rt_math.h"
 #include "utils.h"
@@ -432,6 +435,125 @@ std::map<std::string, std::string> getAliases(const Glib::ustring& profile_dir)
 
 }
 
+namespace rtengine
+{
+
+/*
+ * A ProPhoto to ProPhoto transform sampled on a grid covering [0, 65535]^3 and applied with a tetrahedral
+ * interpolation. The nodes are spaced evenly in the square root of the values, which follows the spacing of
+ * the DCP tables in the shadows much better than a linear grid.
+ */
+class DCPBakedLut final :
+    public NonCopyable
+{
+public:
+    static constexpr int size = 65;
+    static constexpr std::size_t node_count = static_cast<std::size_t>(size) * size * size;
+
+    explicit DCPBakedLut(const std::function<void (float&, float&, float&)>& transform) :
+        nodes(node_count * 4),
+        encode_scale((size - 1) / std::sqrt(65535.f))
+    {
+        constexpr float decode_scale = 65535.f / ((size - 1) * (size - 1));
+
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+
+        for (int i = 0; i < size; ++i) {
+            for (int j = 0; j < size; ++j) {
+                for (int k = 0; k < size; ++k) {
+                    float r = SQR(i) * decode_scale;
+                    float g = SQR(j) * decode_scale;
+                    float b = SQR(k) * decode_scale;
+                    transform(r, g, b);
+
+                    float* const node = nodes.data + ((i * size + j) * size + k) * 4;
+                    node[0] = r;
+                    node[1] = g;
+                    node[2] = b;
+                    node[3] = 0.f;
+                }
+            }
+        }
+    }
+
+    // Returns false and leaves r, g and b untouched when the colour is outside of the grid
+    bool getRGB(float& r, float& g, float& b) const
+    {
+        if (!(r >= 0.f && g >= 0.f && b >= 0.f && r <= 65535.f && g <= 65535.f && b <= 65535.f)) {
+            return false;
+        }
+
+        const float fr = std::sqrt(r) * encode_scale;
+        const float fg = std::sqrt(g) * encode_scale;
+        const float fb = std::sqrt(b) * encode_scale;
+        const int ir = std::min(static_cast<int>(fr), size - 2);
+        const int ig = std::min(static_cast<int>(fg), size - 2);
+        const int ib = std::min(static_cast<int>(fb), size - 2);
+        const float dr = fr - ir;
+        const float dg = fg - ig;
+        const float db = fb - ib;
+
+        constexpr int sr = size * size * 4;
+        constexpr int sg = size * 4;
+        constexpr int sb = 4;
+
+        // The tetrahedron containing the colour goes from the origin of the cell to its opposite corner
+        // through the corners corner_a and corner_b, with the weights w1 >= w2 >= w3
+        int corner_a, corner_b;
+        float w1, w2, w3;
+
+        if (dr >= dg) {
+            if (dg >= db) {
+                corner_a = sr; corner_b = sr + sg; w1 = dr; w2 = dg; w3 = db;
+            } else if (dr >= db) {
+                corner_a = sr; corner_b = sr + sb; w1 = dr; w2 = db; w3 = dg;
+            } else {
+                corner_a = sb; corner_b = sr + sb; w1 = db; w2 = dr; w3 = dg;
+            }
+        } else {
+            if (db >= dg) {
+                corner_a = sb; corner_b = sg + sb; w1 = db; w2 = dg; w3 = dr;
+            } else if (db >= dr) {
+                corner_a = sg; corner_b = sg + sb; w1 = dg; w2 = db; w3 = dr;
+            } else {
+                corner_a = sg; corner_b = sr + sg; w1 = dg; w2 = dr; w3 = db;
+            }
+        }
+
+        const float* const c = nodes.data + ((ir * size + ig) * size + ib) * 4;
+
+#ifdef __SSE2__
+        const vfloat res =
+            LVF(c[0]) * F2V(1.f - w1)
+            + LVF(c[corner_a]) * F2V(w1 - w2)
+            + LVF(c[corner_b]) * F2V(w2 - w3)
+            + LVF(c[sr + sg + sb]) * F2V(w3);
+        alignas(16) float out[4];
+        STVF(out[0], res);
+        r = out[0];
+        g = out[1];
+        b = out[2];
+#else
+        const float* const ca = c + corner_a;
+        const float* const cb = c + corner_b;
+        const float* const cd = c + sr + sg + sb;
+        r = c[0] * (1.f - w1) + ca[0] * (w1 - w2) + cb[0] * (w2 - w3) + cd[0] * w3;
+        g = c[1] * (1.f - w1) + ca[1] * (w1 - w2) + cb[1] * (w2 - w3) + cd[1] * w3;
+        b = c[2] * (1.f - w1) + ca[2] * (w1 - w2) + cb[2] * (w2 - w3) + cd[2] * w3;
+#endif
+
+        return true;
+    }
+
+private:
+    AlignedBuffer<float> nodes;
+    const float encode_scale;
+};
+
+}
+
 struct DCPProfileApplyState::Data {
     float pro_photo[3][3];
     float work[3][3];
@@ -439,6 +561,7 @@ struct DCPProfileApplyState::Data {
     bool use_tone_curve;
     bool apply_look_table;
     float bl_scale;
+    std::shared_ptr<const DCPBakedLut> baked_lut;
 };
 
 DCPProfileApplyState::DCPProfileApplyState() :
@@ -741,7 +864,7 @@ DCPProfile::DCPProfile(const Glib::ustring& filename) :
         1.00000f
     };
 
-    FILE* const file = g_fopen(filename.c_str(), "rb");
+    IMFILE* const file = gfopen_metadata(filename.c_str());
 
     if (file == nullptr) {
         printf ("Unable to load DCP profile '%s' !", filename.c_str());
@@ -1114,6 +1237,9 @@ void DCPProfile::apply(
             }
         }
 
+        // Baking the map only pays off when the image has more pixels than the LUT has nodes
+        const std::shared_ptr<const DCPBakedLut> baked_lut = getHueSatLut(delta_base, static_cast<std::size_t>(img->getWidth()) * img->getHeight() > 4 * DCPBakedLut::node_count);
+
         // Convert to ProPhoto and apply LUT
 #ifdef _OPENMP
         #pragma omp parallel for schedule(dynamic,16)
@@ -1125,23 +1251,8 @@ void DCPProfile::apply(
                 float newg = pro_photo[1][0] * img->r(y, x) + pro_photo[1][1] * img->g(y, x) + pro_photo[1][2] * img->b(y, x);
                 float newb = pro_photo[2][0] * img->r(y, x) + pro_photo[2][1] * img->g(y, x) + pro_photo[2][2] * img->b(y, x);
 
-                // If point is in negative area, just the matrix, but not the LUT. This is checked inside Color::rgb2hsvdcp
-                float h;
-                float s;
-                float v;
-
-                if (LIKELY(Color::rgb2hsvdcp(newr, newg, newb, h , s, v))) {
-
-                    hsdApply(delta_info, delta_base, h, s, v);
-
-                    // RT range correction
-                    if (h < 0.0f) {
-                        h += 6.0f;
-                    } else if (h >= 6.0f) {
-                        h -= 6.0f;
-                    }
-
-                    Color::hsv2rgbdcp(h, s, v, newr, newg, newb);
+                if (!baked_lut || !baked_lut->getRGB(newr, newg, newb)) {
+                    hueSatApply(delta_base, newr, newg, newb);
                 }
 
                 img->r(y, x) = work[0][0] * newr + work[0][1] * newg + work[0][2] * newb;
@@ -1170,6 +1281,8 @@ void DCPProfile::setStep2ApplyState(const Glib::ustring& working_space, bool use
         as_out.data->bl_scale = powf(2, baseline_exposure_offset);
     }
 
+    as_out.data->baked_lut = getStep2Lut(as_out.data->use_tone_curve, as_out.data->apply_look_table);
+
     if (working_space == "ProPhoto") {
         as_out.data->already_pro_photo = true;
     } else {
@@ -1206,10 +1319,6 @@ void DCPProfile::setStep2ApplyState(const Glib::ustring& working_space, bool use
 
 void DCPProfile::step2ApplyTile(float* rc, float* gc, float* bc, int width, int height, int tile_width, const DCPProfileApplyState& as_in) const
 {
-
-#define FCLIP(a) ((a)>0.f?((a)<65535.5f?(a):65535.5f):0.f)
-#define CLIP01(a) ((a)>0?((a)<1?(a):1):0)
-
     float exp_scale = as_in.data->bl_scale;
 
     if (!as_in.data->use_tone_curve && !as_in.data->apply_look_table) {
@@ -1225,6 +1334,8 @@ void DCPProfile::step2ApplyTile(float* rc, float* gc, float* bc, int width, int
             }
         }
     } else {
+        const DCPBakedLut* const baked_lut = as_in.data->baked_lut.get();
+
         for (int y = 0; y < height; y++) {
             for (int x = 0; x < width; x++) {
                 float r = rc[y * tile_width + x];
@@ -1257,32 +1368,8 @@ void DCPProfile::step2ApplyTile(float* rc, float* gc, float* bc, int width, int
                 // newg = FCLIP(newg);
                 // newb = FCLIP(newb);
 
-                if (as_in.data->apply_look_table) {
-                    float cnewr = FCLIP(newr);
-                    float cnewg = FCLIP(newg);
-                    float cnewb = FCLIP(newb);
-
-                    float h, s, v;
-                    Color::rgb2hsvtc(cnewr, cnewg, cnewb, h, s, v);
-
-                    hsdApply(look_info, look_table, h, s, v);
-                    s = CLIP01(s);
-                    v = CLIP01(v);
-
-                    // RT range correction
-                    if (h < 0.0f) {
-                        h += 6.0f;
-                    } else if (h >= 6.0f) {
-                        h -= 6.0f;
-                    }
-
-                    Color::hsv2rgbdcp( h, s, v, cnewr, cnewg, cnewb);
-
-                    setUnlessOOG(newr, newg, newb, cnewr, cnewg, cnewb);
-                }
-
-                if (as_in.data->use_tone_curve) {
-                    tone_curve.Apply(newr, newg, newb);
+                if (!baked_lut || !baked_lut->getRGB(newr, newg, newb)) {
+                    step2Apply(as_in.data->use_tone_curve, as_in.data->apply_look_table, newr, newg, newb);
                 }
 
                 if (as_in.data->already_pro_photo) {
@@ -1299,6 +1386,133 @@ void DCPProfile::step2ApplyTile(float* rc, float* gc, float* bc, int width, int
     }
 }
 
+void DCPProfile::hueSatApply(const std::vector<HsbModify>& delta_base, float& r, float& g, float& b) const
+{
+    // If point is in negative area, just the matrix, but not the LUT. This is checked inside Color::rgb2hsvdcp
+    float h;
+    float s;
+    float v;
+
+    if (LIKELY(Color::rgb2hsvdcp(r, g, b, h , s, v))) {
+
+        hsdApply(delta_info, delta_base, h, s, v);
+
+        // RT range correction
+        if (h < 0.0f) {
+            h += 6.0f;
+        } else if (h >= 6.0f) {
+            h -= 6.0f;
+        }
+
+        Color::hsv2rgbdcp(h, s, v, r, g, b);
+    }
+}
+
+#define FCLIP(a) ((a)>0.f?((a)<65535.5f?(a):65535.5f):0.f)
+#define CLIP01(a) ((a)>0?((a)<1?(a):1):0)
+
+void DCPProfile::step2Apply(bool use_tone_curve, bool apply_look_table, float& r, float& g, float& b) const
+{
+    if (apply_look_table) {
+        float cnewr = FCLIP(r);
+        float cnewg = FCLIP(g);
+        float cnewb = FCLIP(b);
+
+        float h, s, v;
+        Color::rgb2hsvtc(cnewr, cnewg, cnewb, h, s, v);
+
+        hsdApply(look_info, look_table, h, s, v);
+        s = CLIP01(s);
+        v = CLIP01(v);
+
+        // RT range correction
+        if (h < 0.0f) {
+            h += 6.0f;
+        } else if (h >= 6.0f) {
+            h -= 6.0f;
+        }
+
+        Color::hsv2rgbdcp( h, s, v, cnewr, cnewg, cnewb);
+
+        setUnlessOOG(r, g, b, cnewr, cnewg, cnewb);
+    }
+
+    if (use_tone_curve) {
+        tone_curve.Apply(r, g, b);
+    }
+}
+
+std::shared_ptr<const DCPBakedLut> DCPProfile::getHueSatLut(const std::vector<HsbModify>& delta_base, bool build) const
+{
+    if (!options.dcpBakedLut) {
+        return nullptr;
+    }
+
+    const auto same_map =
+        [&delta_base](const std::vector<HsbModify>& other) -> bool
+        {
+            return
+                other.size() == delta_base.size()
+                && std::equal(other.begin(), other.end(), delta_base.begin(),
+                    [](const HsbModify& x, const HsbModify& y)
+                    {
+                        return x.hue_shift == y.hue_shift && x.sat_scale == y.sat_scale && x.val_scale == y.val_scale;
+                    }
+                );
+        };
+
+    MyMutex::MyLock lock(lut_mutex);
+
+    for (auto entry = hue_sat_luts.begin(); entry != hue_sat_luts.end(); ++entry) {
+        if (same_map(entry->first)) {
+            std::rotate(entry, entry + 1, hue_sat_luts.end());
+            return hue_sat_luts.back().second;
+        }
+    }
+
+    if (!build) {
+        return nullptr;
+    }
+
+    const std::shared_ptr<const DCPBakedLut> lut = std::make_shared<const DCPBakedLut>(
+        [this, &delta_base](float& r, float& g, float& b)
+        {
+            hueSatApply(delta_base, r, g, b);
+        }
+    );
+
+    // Keep the maps of the last two white balances, e.g. the preview and a queued export
+    if (hue_sat_luts.size() == 2) {
+        hue_sat_luts.erase(hue_sat_luts.begin());
+    }
+
+    hue_sat_luts.emplace_back(delta_base, lut);
+
+    return lut;
+}
+
+std::shared_ptr<const DCPBakedLut> DCPProfile::getStep2Lut(bool use_tone_curve, bool apply_look_table) const
+{
+    if (!options.dcpBakedLut || (!use_tone_curve && !apply_look_table)) {
+        return nullptr;
+    }
+
+    MyMutex::MyLock lock(lut_mutex);
+
+    std::shared_ptr<const DCPBakedLut>& lut = step2_luts[use_tone_curve + 2 * apply_look_table];
+
+    if (!lut) {
+        lut = std::make_shared<const DCPBakedLut>(
+            [this, use_tone_curve, apply_look_table](float& r, float& g, float& b)
+            {
+                step2Apply(use_tone_curve, apply_look_table, r, g, b);
+            }
+        );
+    }
+
+    return lut;
+}
+
 DCPProfile::Matrix DCPProfile::findXyztoCamera(const std::array<double, 2>& white_xy, int preferred_illuminant) const
 {
     bool has_col_1 = has_color_matrix_1;
@@ -36,6 +36,7 @@ namespace rtengine
 
 class ColorTemp;
 class Imagefloat;
+class DCPBakedLut;
 class DCPProfileApplyState;
 
 class DCPProfile final
@@ -109,6 +110,10 @@ private:
     Matrix makeXyzCam(const ColorTemp& white_balance, const Triple& pre_mul, const Matrix& cam_wb_matrix, int preferred_illuminant) const;
     std::vector<HsbModify> makeHueSatMap(const ColorTemp& white_balance, int preferred_illuminant) const;
     void hsdApply(const HsdTableInfo& table_info, const std::vector<HsbModify>& table_base, float& h, float& s, float& v) const;
+    void hueSatApply(const std::vector<HsbModify>& delta_base, float& r, float& g, float& b) const;
+    void step2Apply(bool use_tone_curve, bool apply_look_table, float& r, float& g, float& b) const;
+    std::shared_ptr<const DCPBakedLut> getHueSatLut(const std::vector<HsbModify>& delta_base, bool build) const;
+    std::shared_ptr<const DCPBakedLut> getStep2Lut(bool use_tone_curve, bool apply_look_table) const;
 
     Matrix color_matrix_1;
     Matrix color_matrix_2;
@@ -134,6 +139,11 @@ private:
     short light_source_2;
 
     AdobeToneCurve tone_curve;
+
+    // Baked LUTs, built on demand when options.dcpBakedLut is set
+    mutable MyMutex lut_mutex;
+    mutable std::vector<std::pair<std::vector<HsbModify>, std::shared_ptr<const DCPBakedLut>>> hue_sat_luts; // one per white balance, most recently used last
+    mutable std::shared_ptr<const DCPBakedLut> step2_luts[4]; // indexed by use_tone_curve + 2 * apply_look_table
 };
 
 class DCPProfileApplyState final
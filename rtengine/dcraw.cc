@@ -26,6 +26,7 @@
 /*RT*/#include <omp.h>
 /*RT*/#endif
 
+#include <algorithm>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -923,7 +924,8 @@ ushort * CLASS ljpeg_row (int jrow, struct jhead *jh)
     }
     getbits(-1);
   }
-  FORC3 row[c] = (jh->row + ((jrow & 1) + 1) * (jh->wide*jh->clrs*((jrow+c) & 1)));
+  // RT: the two rows are kept apart in the buffer, row[1] being the previous row for predictors 2 to 7 on every jrow
+  FORC3 row[c] = jh->row + 2 * jh->wide*jh->clrs*((jrow+c) & 1);
   for (col=0; col < jh->wide; col++)
     FORC(jh->clrs) {
       diff = ljpeg_diff (jh->huff[c]);
@@ -954,6 +956,42 @@ void CLASS lossless_jpeg_load_raw()
 
   if (!ljpeg_start (&jh, 0)) return;
   int jwide = jh.wide * jh.clrs;
+
+  // RT: decode from memory, in parallel if the scan has restart markers, and unscramble the rows while decoding.
+  // The rows are placed independently of each other, except for the 3984 pixels wide layout without slices.
+  if (!(raw_width == 3984 && !cr2_slice[0]) &&
+      ljpeg_decode (jh, fdata(ftell(ifp), ifp), fdata(ifp->size, ifp), true, [&](int jrow, const ushort *rp) {
+    int row, col;
+    if (!cr2_slice[0]) {
+      const INT64 jidx = (INT64) jrow * jwide;
+      row = jidx / raw_width;
+      col = jidx % raw_width;
+      if (load_flags & 1)
+        row = jrow & 1 ? height-1-jrow/2 : jrow/2;
+    }
+    for (int jcol=0; jcol < jwide; jcol++) {
+      int val = curve[*rp++];
+      if (cr2_slice[0]) {
+	int jidx = jrow*jwide + jcol;
+	int i = jidx / (cr2_slice[1]*raw_height);
+	int j;
+	if ((j = i >= cr2_slice[0]))
+		 i  = cr2_slice[0];
+	jidx -= i * (cr2_slice[1]*raw_height);
+	row = jidx / cr2_slice[1+j];
+	col = jidx % cr2_slice[1+j] + i*cr2_slice[1];
+	if (raw_width == 3984 && (col -= 2) < 0)
+	  col += (row--,raw_width);
+      }
+      if ((unsigned) row < raw_height) RAW(row,col) = val;
+      if (++col >= raw_width)
+	col = (row++,0);
+    }
+  })) {
+    ljpeg_end (&jh);
+    return;
+  }
+
   ushort *rp[2];
   rp[0] = ljpeg_row (0, &jh);
 
@@ -1187,6 +1225,8 @@ void CLASS lossless_dng_load_raw()
   struct jhead jh;
   ushort *rp;
 
+  if (lossless_dng_load_tiles()) return;
+
   while (trow < raw_height) {
     save = ftell(ifp);
     if (tile_length < INT_MAX)
@@ -1227,6 +1267,74 @@ void CLASS lossless_dng_load_raw()
   }
 }
 
+// RT: decodes the tiles in parallel, and the restart intervals of a single tile, when they are all lossless
+// Returns false, leaving the file position unchanged, when lossless_dng_load_raw() has to decode them
+bool CLASS lossless_dng_load_tiles()
+{
+  struct Tile {
+    struct jhead jh;
+    const uchar *data;
+    unsigned trow, tcol, jwide;
+  };
+  std::vector<Tile> tiles;
+  const unsigned start = ftell(ifp);
+  unsigned trow = 0, tcol = 0;
+  bool lossless = true;
+
+  while (trow < raw_height) {
+    const unsigned save = ftell(ifp);
+    if (tile_length < INT_MAX)
+      fseek (ifp, get4(), SEEK_SET);
+    Tile tile;
+    if (!ljpeg_start (&tile.jh, 0)) break;
+    tile.data = fdata(ftell(ifp), ifp);
+    tile.trow = trow;
+    tile.tcol = tcol;
+    tile.jwide = tile.jh.wide;
+    if (filters || (colors == 1 && tile.jh.clrs > 1)) tile.jwide *= tile.jh.clrs;
+    tile.jwide /= MIN (is_raw, tiff_samples);
+    tiles.push_back(tile);
+    if (tile.jh.algo != 0xc3) {
+      lossless = false;
+      break;
+    }
+    fseek (ifp, save+4, SEEK_SET);
+    if ((tcol += tile_width) >= raw_width)
+      trow += tile_length + (tcol = 0);
+  }
+
+  bool decoded = lossless && !tiles.empty();
+
+  if (decoded) {
+    const unsigned wrap = MIN (tile_width, raw_width);
+    const uchar *end = fdata(ifp->size, ifp);
+    std::vector<char> failed(tiles.size(), 0);
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (tiles.size() > 1)
+#endif
+    for (size_t t = 0; t < tiles.size(); ++t) {
+      const Tile &tile = tiles[t];
+      failed[t] = !ljpeg_decode (tile.jh, tile.data, end, tiles.size() == 1, [&](int jrow, const ushort *rp) {
+        const INT64 jidx = (INT64) jrow * tile.jwide;
+        unsigned row = jidx / wrap;
+        unsigned col = jidx % wrap;
+        ushort *pixel = const_cast<ushort *>(rp);
+        for (unsigned jcol=0; jcol < tile.jwide; jcol++) {
+          adobe_copy_pixel (tile.trow+row, tile.tcol+col, &pixel);
+          if (++col >= wrap)
+            row += 1 + (col = 0);
+        }
+      });
+    }
+    decoded = std::find(failed.begin(), failed.end(), 1) == failed.end();
+  }
+
+  for (Tile &tile : tiles)
+    ljpeg_end (&tile.jh);
+  fseek (ifp, start, SEEK_SET);
+  return decoded;
+}
+
 static uint32_t DNG_HalfToFloat(uint16_t halfValue);
 
 void CLASS packed_dng_load_raw()
@@ -11003,11 +11111,33 @@ void CLASS nikon_14bit_load_raw()
 {
     const unsigned linelen = (unsigned)(ceilf((float)(raw_width * 7 / 4) / 16.0)) * 16; // 14512; // S.raw_width * 7 / 4;
     const unsigned pitch = raw_width; //S.raw_pitch ? S.raw_pitch / 2 : S.raw_width;
+    const int pos = ftell(ifp);
+
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+#pragma omp parallel
+#endif
+{
     unsigned char *buf = (unsigned char *)malloc(linelen);
     merror(buf, "nikon_14bit_load_raw()");
+    IMFILE ifpthr = *ifp;
+
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+    // only master thread will update the progress bar
+    ifpthr.plistener = nullptr;
+    #pragma omp master
+    {
+    ifpthr.plistener = ifp->plistener;
+    }
+    #pragma omp for schedule(dynamic,16) nowait
+#endif
+
     for (int row = 0; row < raw_height; row++)
     {
-        unsigned bytesread = fread(buf, 1, linelen, ifp);
+        // the rows have a fixed size, each one is read on its own
+        if (pos + (INT64) row * linelen >= ifpthr.size)
+            continue;
+        fseek(&ifpthr, pos + row * linelen, SEEK_SET);
+        unsigned bytesread = fread(buf, 1, linelen, &ifpthr);
         unsigned short *dest = &raw_image[pitch * row];
         //swab32arr((unsigned *)buf, bytesread / 4);
         for (int sp = 0, dp = 0; dp < pitch - 3 && sp < linelen - 6 && sp < bytesread - 6; sp += 7, dp += 4)
@@ -11015,6 +11145,7 @@ void CLASS nikon_14bit_load_raw()
     }
     free(buf);
 }
+}
 
 /* RT: Delete from here */
 /*RT*/#undef SQR
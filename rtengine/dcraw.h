@@ -19,8 +19,11 @@
 
 #pragma once
 
-#include "myfile.h"
 #include <csetjmp>
+#include <functional>
+#include <string>
+
+#include "myfile.h"
 
 
 class DCraw
@@ -322,6 +325,7 @@ int ljpeg_start (struct jhead *jh, int info_only);
 void ljpeg_end (struct jhead *jh);
 int ljpeg_diff (ushort *huff);
 ushort * ljpeg_row (int jrow, struct jhead *jh);
+bool ljpeg_decode (const struct jhead &jh, const uchar *data, const uchar *end, bool parallel, const std::function<void (int jrow, const ushort *row)> &store);
 void lossless_jpeg_load_raw();
 void ljpeg_idct (struct jhead *jh);
 
@@ -329,6 +333,7 @@ void ljpeg_idct (struct jhead *jh);
 void canon_sraw_load_raw();
 void adobe_copy_pixel (unsigned row, unsigned col, ushort **rp);
 void lossless_dng_load_raw();
+bool lossless_dng_load_tiles();
 void lossless_dnglj92_load_raw();
 void packed_dng_load_raw();
 void deflate_dng_load_raw();
@@ -348,7 +353,7 @@ void fuji_extend_green(ushort *linebuf[_ltotal], int line_width);
 void fuji_extend_blue(ushort *linebuf[_ltotal], int line_width);
 void xtrans_decode_block(struct fuji_compressed_block* info, const struct fuji_compressed_params *params);
 void fuji_bayer_decode_block(struct fuji_compressed_block* info, const struct fuji_compressed_params *params);
-void fuji_decode_strip(const struct fuji_compressed_params* info_common, int cur_block, INT64 raw_offset, unsigned dsize);
+void fuji_decode_strip(const struct fuji_compressed_params* info_common, struct fuji_compressed_block* block, int cur_block, INT64 raw_offset, unsigned dsize);
 void fuji_compressed_load_raw();
 void fuji_decode_loop(const struct fuji_compressed_params* common_info, int count, INT64* raw_block_offsets, unsigned *block_sizes);
 void parse_fuji_compressed_header();
@@ -567,7 +572,7 @@ void selectCRXTrack(unsigned short maxTrack);
 int parseCR3(unsigned long long oAtomList,
              unsigned long long szAtomList, short &nesting,
              char *AtomNameStack, unsigned short &nTrack, short &TrackType);
-bool crxDecodePlane(void *p, uint32_t planeNumber);
+bool crxDecodePlane(void *p, uint32_t planeNumber, uint32_t tileNumber, IMFILE *input);
 void crxLoadDecodeLoop(void *img, int nPlanes);
 void crxConvertPlaneLineDf(void *p, int imageRow);
 void crxLoadFinalizeLoopE3(void *p, int planeHeight);
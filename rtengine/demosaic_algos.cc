@@ -215,6 +215,7 @@ void RawImageSource::border_interpolate( int winw, int winh, int lborders, const
 // Adapted to RawTherapee by Jacques Desmis 3/2013
 // SSE version by Ingo Weyrich 5/2013
 #ifdef __SSE2__
+TARGET_CLONES
 void RawImageSource::igv_interpolate(int winw, int winh)
 {
     static const float eps = 1e-5f, epssq = 1e-5f; //mod epssq -10f =>-5f Jacques 3/2013 to prevent artifact (divide by zero)
@@ -606,6 +607,7 @@ void RawImageSource::igv_interpolate(int winw, int winh)
     free(hdif);
 }
 #else
+TARGET_CLONES
 void RawImageSource::igv_interpolate(int winw, int winh)
 {
     static const float eps = 1e-5f, epssq = 1e-5f; //mod epssq -10f =>-5f Jacques 3/2013 to prevent artifact (divide by zero)
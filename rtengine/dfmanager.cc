@@ -27,6 +27,7 @@
 #include "../rtgui/options.h"
 #include "rawimage.h"
 #include "imagedata.h"
+#include "masterframecache.h"
 #include "utils.h"
 
 namespace rtengine
@@ -116,7 +117,6 @@ RawImage* dfInfo::getRawImage()
     }
 
     updateRawImage();
-    updateBadPixelList( ri );
 
     return ri;
 }
@@ -125,7 +125,6 @@ std::vector<badPix>& dfInfo::getHotPixels()
 {
     if( !ri ) {
         updateRawImage();
-        updateBadPixelList( ri );
     }
 
     return badPixels;
@@ -133,6 +132,8 @@ std::vector<badPix>& dfInfo::getHotPixels()
 /* updateRawImage() load into ri the actual pixel data from pathname if there is a single shot
  * otherwise load each file from the pathNames list and extract a template from the media;
  * the first file is used also for reading all information other than pixels
+ * The template and its hot pixels are kept in the master frame cache, which spares the
+ * loading of the other files in the next sessions. It also fills the list of hot pixels.
  */
 void dfInfo::updateRawImage()
 {
@@ -149,6 +150,11 @@ void dfInfo::updateRawImage()
             int H = ri->get_height();
             int W = ri->get_width();
             ri->compress_image(0);
+
+            if (MasterFrameCache::load("darkframe", pathNames, ri, &badPixels)) {
+                return;
+            }
+
             int rSize = W * ((ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS) ? 1 : 3);
             acc_t **acc = new acc_t*[H];
 
@@ -200,6 +206,9 @@ void dfInfo::updateRawImage()
             }
 
             delete [] acc;
+
+            updateBadPixelList( ri );
+            MasterFrameCache::save("darkframe", pathNames, ri, &badPixels);
         }
     } else {
         ri = new RawImage(pathname);
@@ -209,6 +218,7 @@ void dfInfo::updateRawImage()
             ri = nullptr;
         } else {
             ri->compress_image(0);
+            updateBadPixelList( ri );
         }
     }
 }
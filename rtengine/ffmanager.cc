@@ -24,6 +24,7 @@
 #include "../rtgui/options.h"
 #include "rawimage.h"
 #include "imagedata.h"
+#include "masterframecache.h"
 #include "median.h"
 #include "utils.h"
 
@@ -128,6 +129,8 @@ RawImage* ffInfo::getRawImage()
 /* updateRawImage() load into ri the actual pixel data from pathname if there is a single shot
  * otherwise load each file from the pathNames list and extract a template from the media;
  * the first file is used also for reading all information other than pixels
+ * The template is kept in the master frame cache after the median, which spares the loading
+ * of the other files in the next sessions.
  */
 void ffInfo::updateRawImage()
 {
@@ -145,6 +148,11 @@ void ffInfo::updateRawImage()
             int H = ri->get_height();
             int W = ri->get_width();
             ri->compress_image(0);
+
+            if (MasterFrameCache::load("flatfield", pathNames, ri, nullptr)) {
+                return;
+            }
+
             int rSize = W * ((ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS || ri->get_colors() == 1) ? 1 : 3);
             acc_t **acc = new acc_t*[H];
 
@@ -233,6 +241,9 @@ void ffInfo::updateRawImage()
 
         free (cfatmp);
 
+        if (!pathNames.empty()) {
+            MasterFrameCache::save("flatfield", pathNames, ri, nullptr);
+        }
     }
 }
 
@@ -0,0 +1,226 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <new>
+
+#include <glib/gstdio.h>
+#include <glibmm/miscutils.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "fftwplans.h"
+
+#include "settings.h"
+
+#include "../rtgui/options.h"
+
+namespace
+{
+
+// Tile denoise uses 4 plans per image size, Fattal and local adjustments 1 to 3
+constexpr std::size_t maxPlans = 32;
+
+// Upper bound of the time spent by FFTW_MEASURE on a new transform size, before the wisdom knows it
+constexpr double planningTimeLimit = 2.0;
+
+}
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+bool FFTWPlanCache::Key::operator ==(const Key& other) const
+{
+    return
+        n0 == other.n0
+        && n1 == other.n1
+        && howmany == other.howmany
+        && kind0 == other.kind0
+        && kind1 == other.kind1
+        && flags == other.flags
+        && inPlace == other.inPlace
+        && threads == other.threads;
+}
+
+FFTWPlanCache::FFTWPlanCache() :
+    measure(false)
+{
+}
+
+FFTWPlanCache& FFTWPlanCache::getInstance()
+{
+    static FFTWPlanCache instance;
+    return instance;
+}
+
+void FFTWPlanCache::init()
+{
+    MyMutex::MyLock lock(plannerMutex);
+
+#ifdef RT_FFTW3F_OMP
+    fftwf_init_threads();
+#endif
+
+    measure = options.fftwWisdom;
+
+    if (!measure) {
+        return;
+    }
+
+    fftwf_set_timelimit(planningTimeLimit);
+    wisdomFile = Glib::build_filename(options.cacheBaseDir, "fftw-wisdom");
+
+    FILE* const f = g_fopen(wisdomFile.c_str(), "r");
+
+    if (f) {
+        if (!fftwf_import_wisdom_from_file(f) && settings->verbose) {
+            printf("Could not import the FFTW wisdom from %s\n", wisdomFile.c_str());
+        }
+
+        fclose(f);
+    }
+}
+
+void FFTWPlanCache::cleanup()
+{
+    std::list<Entry> oldPlans;
+
+    {
+        MyMutex::MyLock lock(mutex);
+        oldPlans.swap(plans);
+    }
+
+    // The plans still in use are destroyed when released
+}
+
+FFTWPlanCache::Plan FFTWPlanCache::getR2R(int n0, int n1, fftw_r2r_kind kind0, fftw_r2r_kind kind1, const float* in, const float* out, unsigned flags, bool multiThread, int howmany)
+{
+    // The scratch arrays are aligned for SIMD, the arrays given at execution have to be aligned the same way
+    if ((in && fftwf_alignment_of(const_cast<float*>(in))) || (out && fftwf_alignment_of(const_cast<float*>(out)))) {
+        flags |= FFTW_UNALIGNED;
+    }
+
+#ifdef RT_FFTW3F_OMP
+    const int threads = multiThread ? omp_get_max_threads() : 1;
+#else
+    const int threads = 1;
+#endif
+
+    const Key key = {n0, n1, howmany, kind0, kind1, flags, in && in == out, threads};
+
+    {
+        MyMutex::MyLock lock(mutex);
+        const Plan plan = find(key);
+
+        if (plan) {
+            return plan;
+        }
+    }
+
+    // Planning with FFTW_MEASURE can take seconds, the lookups of the other threads must not wait for it
+    Plan evicted; // destroyed after the unlock, as the deleter locks the planner mutex
+    MyMutex::MyLock plannerLock(plannerMutex);
+
+    {
+        // another thread may have created the plan while this one was waiting
+        MyMutex::MyLock lock(mutex);
+        const Plan plan = find(key);
+
+        if (plan) {
+            return plan;
+        }
+    }
+
+    const std::size_t size = static_cast<std::size_t>(howmany) * n0 * n1;
+    float* const scratchIn = static_cast<float*>(fftwf_malloc(size * sizeof(float)));
+    float* const scratchOut = key.inPlace ? scratchIn : static_cast<float*>(fftwf_malloc(size * sizeof(float)));
+
+    if (!scratchIn || !scratchOut) {
+        fftwf_free(scratchIn);
+        fftwf_free(scratchOut);
+        throw std::bad_alloc();
+    }
+
+#ifdef RT_FFTW3F_OMP
+    fftwf_plan_with_nthreads(threads);
+#endif
+
+    const int n[2] = {n0, n1};
+    const fftw_r2r_kind kinds[2] = {kind0, kind1};
+    const Plan plan(fftwf_plan_many_r2r(2, n, howmany, scratchIn, nullptr, 1, n0 * n1, scratchOut, nullptr, 1, n0 * n1, kinds, flags), [this](fftwf_plan p) {
+        MyMutex::MyLock lock(plannerMutex);
+        fftwf_destroy_plan(p);
+    });
+
+    if (!key.inPlace) {
+        fftwf_free(scratchOut);
+    }
+
+    fftwf_free(scratchIn);
+
+    if (measure && !(flags & FFTW_ESTIMATE)) {
+        saveWisdom();
+    }
+
+    MyMutex::MyLock lock(mutex);
+    plans.push_front({key, plan});
+
+    if (plans.size() > maxPlans) {
+        evicted = std::move(plans.back().plan);
+        plans.pop_back();
+    }
+
+    return plan;
+}
+
+FFTWPlanCache::Plan FFTWPlanCache::find(const Key& key)
+{
+    for (auto entry = plans.begin(); entry != plans.end(); ++entry) {
+        if (entry->key == key) {
+            plans.splice(plans.begin(), plans, entry);
+            return entry->plan;
+        }
+    }
+
+    return Plan();
+}
+
+void FFTWPlanCache::saveWisdom() const
+{
+    // Written aside and renamed, as several instances may share the cache directory
+    const Glib::ustring tmpFile = wisdomFile + ".tmp";
+
+    g_mkdir_with_parents(Glib::path_get_dirname(wisdomFile).c_str(), 0755);
+    FILE* const f = g_fopen(tmpFile.c_str(), "w");
+
+    if (!f) {
+        return;
+    }
+
+    fftwf_export_wisdom_to_file(f);
+
+    if (fclose(f) == 0) {
+        g_rename(tmpFile.c_str(), wisdomFile.c_str());
+    } else {
+        g_remove(tmpFile.c_str());
+    }
+}
+
+}
@@ -0,0 +1,101 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <list>
+#include <memory>
+#include <type_traits>
+
+#include <fftw3.h>
+
+#include <glibmm/ustring.h>
+
+#include "noncopyable.h"
+
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+/**
+ * @brief Process wide cache of the real-to-real FFTW plans, backed by a wisdom file in the cache directory
+ *
+ * Plans are created on scratch arrays, so planning with FFTW_MEASURE never overwrites the data of the
+ * caller, and must be executed with fftwf_execute_r2r() on the actual arrays. FFTW allows to execute a plan
+ * from several threads at the same time, but not to create or destroy plans concurrently: the cache
+ * serializes that with its own planner lock, so its plans must not be destroyed and fftwf_cleanup() must
+ * not be called elsewhere. The lookups of the plans already created don't wait for a planning in progress.
+ *
+ * With Performance/FFTWWisdom enabled, the wisdom gathered by the FFTW_MEASURE requests (the fixed tile
+ * sizes of the denoise) is saved in the cache directory after each new plan, so that the next sessions
+ * and batch exports can reuse it. FFTW_ESTIMATE requests are left as is: their sizes follow the preview,
+ * which can't wait for a measurement.
+ */
+class FFTWPlanCache final :
+    public NonCopyable
+{
+public:
+    using Plan = std::shared_ptr<std::remove_pointer<fftwf_plan>::type>;
+
+    static FFTWPlanCache& getInstance();
+
+    void init();
+    void cleanup();
+
+    /**
+     * @brief Returns a plan computing howmany 2D transforms of n0 rows by n1 columns stored one after the other
+     *
+     * @param in the input array the plan will be executed on, or nullptr if it is not known yet
+     * @param out the output array, or nullptr if it is not known yet
+     * If in or out is nullptr, the arrays have to be distinct and allocated with fftwf_malloc().
+     * @param flags FFTW_ESTIMATE or FFTW_MEASURE, optionally with FFTW_DESTROY_INPUT
+     * @param multiThread whether the transforms themselves may use all the threads (requires RT_FFTW3F_OMP)
+     */
+    Plan getR2R(int n0, int n1, fftw_r2r_kind kind0, fftw_r2r_kind kind1, const float* in, const float* out, unsigned flags, bool multiThread, int howmany = 1);
+
+private:
+    struct Key {
+        int n0;
+        int n1;
+        int howmany;
+        fftw_r2r_kind kind0;
+        fftw_r2r_kind kind1;
+        unsigned flags;
+        bool inPlace;
+        int threads;
+
+        bool operator ==(const Key& other) const;
+    };
+
+    struct Entry {
+        Key key;
+        Plan plan;
+    };
+
+    FFTWPlanCache();
+
+    Plan find(const Key& key); // with mutex locked
+    void saveWisdom() const;
+
+    MyMutex plannerMutex; // FFTW planner and wisdom, locked before mutex when both are needed
+    MyMutex mutex; // plans
+    std::list<Entry> plans; // most recently used first
+    Glib::ustring wisdomFile;
+    bool measure;
+};
+
+}
@@ -129,10 +129,10 @@ void CLASS fuji_fill_buffer (struct fuji_compressed_block *info)
     }
 }
 
+// The line buffers (and the read buffer without MYFILE_MMAP) are allocated by the caller and reused for several strips
 void CLASS init_fuji_block (struct fuji_compressed_block* info, const struct fuji_compressed_params *params, INT64 raw_offset, unsigned dsize)
 {
-    info->linealloc = (ushort*)calloc (sizeof (ushort), _ltotal * (params->line_width + 2));
-    merror (info->linealloc, "init_fuji_block()");
+    memset (info->linealloc, 0, sizeof (ushort) * _ltotal * (params->line_width + 2));
 
     info->input = ifp;
     INT64 fsize = info->input->size;
@@ -146,10 +146,6 @@ void CLASS init_fuji_block (struct fuji_compressed_block* info, const struct fuj
     }
 
     // init buffer
-#ifndef MYFILE_MMAP
-    info->cur_buf = (uchar*)malloc (FUJI_BUF_SIZE);
-    merror (info->cur_buf, "init_fuji_block()");
-#endif
     info->cur_bit = 0;
     info->cur_pos = 0;
     info->cur_buf_offset = raw_offset;
@@ -842,11 +838,11 @@ void CLASS fuji_bayer_decode_block (struct fuji_compressed_block *info, const st
     }
 }
 
-void CLASS fuji_decode_strip (const struct fuji_compressed_params* info_common, int cur_block, INT64 raw_offset, unsigned dsize)
+void CLASS fuji_decode_strip (const struct fuji_compressed_params* info_common, struct fuji_compressed_block* block, int cur_block, INT64 raw_offset, unsigned dsize)
 {
     int cur_block_width, cur_line;
     unsigned line_size;
-    struct fuji_compressed_block info;
+    struct fuji_compressed_block &info = *block;
 
     init_fuji_block (&info, info_common, raw_offset, dsize);
     line_size = sizeof (ushort) * (info_common->line_width + 2);
@@ -888,12 +884,6 @@ void CLASS fuji_decode_strip (const struct fuji_compressed_params* info_common,
             info.linebuf[ztable[i].a][info_common->line_width + 1] = info.linebuf[ztable[i].a - 1][info_common->line_width];
         }
     }
-
-    // release data
-    free (info.linealloc);
-#ifndef MYFILE_MMAP
-    free (info.cur_buf);
-#endif
 }
 
 static unsigned sgetn (int n, uchar *s)
@@ -955,13 +945,43 @@ void CLASS fuji_compressed_load_raw()
 
 void CLASS fuji_decode_loop (const struct fuji_compressed_params* common_info, int count, INT64* raw_block_offsets, unsigned *block_sizes)
 {
+    // The strips can't be split, so start with the largest ones to not have a big one decoded alone at the end
+    std::vector<int> order (count);
+
+    for (int i = 0; i < count; i++) {
+        order[i] = i;
+    }
+
+    std::stable_sort (order.begin(), order.end(), [block_sizes] (int a, int b) {
+        return block_sizes[a] > block_sizes[b];
+    });
+
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+        // one block per thread, reused for all the strips it decodes
+        struct fuji_compressed_block info;
+        info.linealloc = (ushort*)malloc (sizeof (ushort) * _ltotal * (common_info->line_width + 2));
+        merror (info.linealloc, "fuji_decode_loop()");
+#ifndef MYFILE_MMAP
+        info.cur_buf = (uchar*)malloc (FUJI_BUF_SIZE);
+        merror (info.cur_buf, "fuji_decode_loop()");
+#endif
 
 #ifdef _OPENMP
-    #pragma omp parallel for schedule(dynamic,1) // dynamic scheduling is faster if count > number of cores (e.g. count for GFX 50S is 12)
+        #pragma omp for schedule(dynamic,1) nowait // dynamic scheduling is faster if count > number of cores (e.g. count for GFX 50S is 12)
 #endif
 
-    for (int cur_block = 0; cur_block < count ; cur_block++) {
-        fuji_decode_strip (common_info, cur_block, raw_block_offsets[cur_block], block_sizes[cur_block]);
+        for (int i = 0; i < count; i++) {
+            const int cur_block = order[i];
+            fuji_decode_strip (common_info, &info, cur_block, raw_block_offsets[cur_block], block_sizes[cur_block]);
+        }
+
+        free (info.linealloc);
+#ifndef MYFILE_MMAP
+        free (info.cur_buf);
+#endif
     }
 }
 
@@ -23,6 +23,7 @@
 #include "gauss.h"
 
 #include "boxblur.h"
+#include "gausskernels.h"
 #include "opthelper.h"
 #include "rt_math.h"
 
@@ -1353,12 +1354,67 @@ template<class T> void gaussVerticalmult (T** src, T** dst, const int W, const i
 }
 #endif
 
+constexpr auto GAUSS_3X3_LIMIT = 0.6;
+constexpr auto GAUSS_5X5_LIMIT = 0.84;
+constexpr auto GAUSS_7X7_LIMIT = 1.15;
+constexpr auto GAUSS_DOUBLE = 25.0;
+
+// kernels of the widest instruction set supported by the processor, nullptr if none is wider than the one rtengine is built for
+const rtengine::GaussKernels* getWideKernels()
+{
+    static const rtengine::GaussKernels* const kernels = []() -> const rtengine::GaussKernels* {
+#ifdef RT_GAUSS_AVX512
+        if (__builtin_cpu_supports("avx512f")) {
+            return rtengine::getGaussKernelsAVX512();
+        }
+#endif
+#ifdef RT_GAUSS_AVX2
+        if (__builtin_cpu_supports("avx2")) {
+            return rtengine::getGaussKernelsAVX2();
+        }
+#endif
+        return nullptr;
+    }();
+
+    return kernels;
+}
+
+#ifdef __SSE2__
+// same decisions as the SSE code of gaussianBlurImpl for 0.6 <= sigma < 25
+void gaussianBlurWide(const rtengine::GaussKernels* wide, float** src, float** dst, const int W, const int H, const double sigma, eGaussType gausstype, float** buffer2)
+{
+    if (sigma <= GAUSS_5X5_LIMIT && src != dst && gausstype != GAUSS_STANDARD) {
+        float kernel[5][5];
+        compute5x5kernel(sigma, kernel);
+        wide->conv5x5(src, dst, buffer2, W, H, kernel, gausstype);
+    } else if (sigma <= GAUSS_7X7_LIMIT && src != dst && gausstype != GAUSS_STANDARD) {
+        float kernel[7][7];
+        compute7x7kernel(sigma, kernel);
+        wide->conv7x7(src, dst, buffer2, W, H, kernel, gausstype);
+    } else {
+        rtengine::GaussIIRCoeffs coeffs;
+        calculateYvVFactors<double>(sigma, coeffs.b1, coeffs.b2, coeffs.b3, coeffs.B, coeffs.M);
+
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++) {
+                coeffs.M[i][j] *= (1.0 + coeffs.b2 + (coeffs.b1 - coeffs.b3) * coeffs.b3);
+                coeffs.M[i][j] /= (1.0 + coeffs.b1 - coeffs.b2 + coeffs.b3) * (1.0 - coeffs.b1 - coeffs.b2 - coeffs.b3);
+            }
+
+        if (gausstype == GAUSS_MULT) {
+            wide->horizontal(src, src, W, H, coeffs);
+            wide->vertical(src, dst, nullptr, W, H, coeffs, GAUSS_MULT);
+        } else {
+            wide->horizontal(src, dst, W, H, coeffs);
+            wide->vertical(dst, dst, buffer2, W, H, coeffs, gausstype);
+        }
+    }
+}
+#endif
+
 template<class T> void gaussianBlurImpl(T** src, T** dst, const int W, const int H, const double sigma, bool useBoxBlur, eGaussType gausstype = GAUSS_STANDARD, T** buffer2 = nullptr)
 {
-    static constexpr auto GAUSS_3X3_LIMIT = 0.6;
-    static constexpr auto GAUSS_5X5_LIMIT = 0.84;
-    static constexpr auto GAUSS_7X7_LIMIT = 1.15;
-    static constexpr auto GAUSS_DOUBLE = 25.0;
+    const rtengine::GaussKernels* const wide = getWideKernels();
 
     if (useBoxBlur) {
         // special variant for very large sigma, currently only used by retinex algorithm
@@ -1431,18 +1487,22 @@ template<class T> void gaussianBlurImpl(T** src, T** dst, const int W, const int
                 b1 /= bsum;
                 double b0 = 1.0 / bsum;
 
-                switch (gausstype) {
-                case GAUSS_MULT     :
-                    gauss3x3mult<T> (src, dst, W, H, c0, c1, c2, b0, b1);
-                    break;
-
-                case GAUSS_DIV      :
-                    gauss3x3div<T> (src, dst, buffer2, W, H, c0, c1, c2, b0, b1);
-                    break;
-
-                case GAUSS_STANDARD :
-                    gauss3x3<T> (src, dst, W, H, c0, c1, c2, b0, b1);
-                    break;
+                if (wide) {
+                    wide->conv3x3(src, dst, buffer2, W, H, c0, c1, c2, b0, b1, gausstype);
+                } else {
+                    switch (gausstype) {
+                    case GAUSS_MULT     :
+                        gauss3x3mult<T> (src, dst, W, H, c0, c1, c2, b0, b1);
+                        break;
+
+                    case GAUSS_DIV      :
+                        gauss3x3div<T> (src, dst, buffer2, W, H, c0, c1, c2, b0, b1);
+                        break;
+
+                    case GAUSS_STANDARD :
+                        gauss3x3<T> (src, dst, W, H, c0, c1, c2, b0, b1);
+                        break;
+                    }
                 }
             } else {
                 // compute kernel values for separated 3x3 gaussian blur
@@ -1456,7 +1516,9 @@ template<class T> void gaussianBlurImpl(T** src, T** dst, const int W, const int
         } else {
 #ifdef __SSE2__
 
-            if (sigma < GAUSS_DOUBLE) {
+            if (wide && sigma < GAUSS_DOUBLE) {
+                gaussianBlurWide(wide, src, dst, W, H, sigma, gausstype, buffer2);
+            } else if (sigma < GAUSS_DOUBLE) {
                 switch (gausstype) {
                 case GAUSS_MULT : {
                     if (sigma <= GAUSS_5X5_LIMIT && src != dst) {
@@ -0,0 +1,72 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Compiled with -mavx2, see gausskernelsimpl.h before adding includes
+
+#include <immintrin.h>
+
+namespace
+{
+
+struct AVX2 {
+    typedef __m256 vtype;
+    static constexpr int size = 8;
+
+    static vtype load(const float* p)
+    {
+        return _mm256_loadu_ps(p);
+    }
+    static void store(float* p, vtype v)
+    {
+        _mm256_storeu_ps(p, v);
+    }
+    static vtype set(float a)
+    {
+        return _mm256_set1_ps(a);
+    }
+    static vtype max(vtype a, vtype b)
+    {
+        return _mm256_max_ps(a, b);
+    }
+    // a > 0 ? a : b
+    static vtype selPositive(vtype a, vtype b)
+    {
+        return _mm256_blendv_ps(b, a, _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ));
+    }
+    // src[i + k][j] in lane k
+    static vtype gather(float** src, int i, int j)
+    {
+        return _mm256_setr_ps(src[i][j], src[i + 1][j], src[i + 2][j], src[i + 3][j], src[i + 4][j], src[i + 5][j], src[i + 6][j], src[i + 7][j]);
+    }
+};
+
+}
+
+#include "gausskernelsimpl.h"
+
+const rtengine::GaussKernels* rtengine::getGaussKernelsAVX2()
+{
+    static const GaussKernels kernels = {
+        "AVX2",
+        conv3x3<AVX2>,
+        conv5x5<AVX2>,
+        conv7x7<AVX2>,
+        gaussHorizontalIIR<AVX2>,
+        vertical<AVX2>
+    };
+    return &kernels;
+}
@@ -0,0 +1,75 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Compiled with -mavx512f, see gausskernelsimpl.h before adding includes
+
+#include <immintrin.h>
+
+namespace
+{
+
+struct AVX512 {
+    typedef __m512 vtype;
+    static constexpr int size = 16;
+
+    static vtype load(const float* p)
+    {
+        return _mm512_loadu_ps(p);
+    }
+    static void store(float* p, vtype v)
+    {
+        _mm512_storeu_ps(p, v);
+    }
+    static vtype set(float a)
+    {
+        return _mm512_set1_ps(a);
+    }
+    static vtype max(vtype a, vtype b)
+    {
+        // _mm512_max_ps() merges into _mm512_undefined_ps(), which GCC 12 reports as maybe uninitialized.
+        // With a full mask the zeroing form compiles to the same vmaxps.
+        return _mm512_maskz_max_ps(0xffff, a, b);
+    }
+    // a > 0 ? a : b
+    static vtype selPositive(vtype a, vtype b)
+    {
+        return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_GT_OQ), b, a);
+    }
+    // src[i + k][j] in lane k
+    static vtype gather(float** src, int i, int j)
+    {
+        return _mm512_setr_ps(src[i][j], src[i + 1][j], src[i + 2][j], src[i + 3][j], src[i + 4][j], src[i + 5][j], src[i + 6][j], src[i + 7][j],
+                              src[i + 8][j], src[i + 9][j], src[i + 10][j], src[i + 11][j], src[i + 12][j], src[i + 13][j], src[i + 14][j], src[i + 15][j]);
+    }
+};
+
+}
+
+#include "gausskernelsimpl.h"
+
+const rtengine::GaussKernels* rtengine::getGaussKernelsAVX512()
+{
+    static const GaussKernels kernels = {
+        "AVX-512",
+        conv3x3<AVX512>,
+        conv5x5<AVX512>,
+        conv7x7<AVX512>,
+        gaussHorizontalIIR<AVX512>,
+        vertical<AVX512>
+    };
+    return &kernels;
+}
@@ -0,0 +1,50 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "gauss.h"
+
+namespace rtengine
+{
+
+// Coefficients of the Young - van Vliet recursive filter, with the boundary matrix scaled as in the SSE code of gauss.cc
+struct GaussIIRCoeffs {
+    double B, b1, b2, b3;
+    double M[3][3];
+};
+
+/**
+ * @brief Gaussian blur kernels built for a wider instruction set than the rest of rtengine
+ *
+ * They live in their own translation units (gaussavx2.cc, gaussavx512.cc) compiled with the
+ * corresponding flags, so a single binary still runs on SSE2 only processors: gaussianBlur()
+ * checks the features of the processor once and only calls them when they are supported.
+ * Like the kernels of gauss.cc, they have to be called by all the threads of a parallel region.
+ */
+struct GaussKernels {
+    const char* name;
+    void (*conv3x3)(float** src, float** dst, float** divBuffer, int W, int H, float c0, float c1, float c2, float b0, float b1, eGaussType type);
+    void (*conv5x5)(float** src, float** dst, float** divBuffer, int W, int H, const float kernel[5][5], eGaussType type); // GAUSS_MULT and GAUSS_DIV only
+    void (*conv7x7)(float** src, float** dst, float** divBuffer, int W, int H, const float kernel[7][7], eGaussType type); // GAUSS_MULT and GAUSS_DIV only
+    void (*horizontal)(float** src, float** dst, int W, int H, const GaussIIRCoeffs& coeffs);
+    void (*vertical)(float** src, float** dst, float** divBuffer, int W, int H, const GaussIIRCoeffs& coeffs, eGaussType type);
+};
+
+const GaussKernels* getGaussKernelsAVX2();
+const GaussKernels* getGaussKernelsAVX512();
+
+}
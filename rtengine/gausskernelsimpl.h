@@ -0,0 +1,577 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Width independent part of the wide gaussian blur kernels, included by gaussavx2.cc and gaussavx512.cc
+// after the definition of their vector class (vtype, size, load, store, set, max, selPositive, gather).
+//
+// These translation units are compiled with flags the processor may not support, so everything here
+// has internal linkage and nothing shared with the rest of rtengine is instantiated (no opthelper.h,
+// no rt_math.h, no std::max, no containers): the linker could otherwise keep the AVX copy of an inline
+// function and run it on any processor. They compute the same expressions as the kernels of gauss.cc.
+
+#pragma once
+
+#include <immintrin.h>
+
+#include "gausskernels.h"
+
+namespace
+{
+
+using rtengine::GaussIIRCoeffs;
+using rtengine::GaussKernels;
+
+// one lane of the vector classes, for the borders and the remaining columns
+struct Scalar {
+    typedef float vtype;
+    static constexpr int size = 1;
+
+    static float load(const float* p)
+    {
+        return *p;
+    }
+    static void store(float* p, float v)
+    {
+        *p = v;
+    }
+    static float set(float a)
+    {
+        return a;
+    }
+    static float max(float a, float b)
+    {
+        return a < b ? b : a;
+    }
+    static float selPositive(float a, float b)
+    {
+        return a > 0.f ? a : b;
+    }
+};
+
+enum class Op {
+    SET,
+    MULT,
+    DIV,            // max(divBuffer / (v > 0 ? v : 1), 0)
+    DIV_UNCLAMPED,  // divBuffer / (v > 0 ? v : 1), used by the SSE code for the last 3 rows of the vertical pass
+    DIV_EPS         // divBuffer / max(v, 0.00001), used by the 5x5 and 7x7 kernels
+};
+
+template<class L, Op op>
+inline void put(float** dst, float** divBuffer, int i, int j, typename L::vtype v)
+{
+    switch (op) { // resolved at compile time
+        case Op::SET:
+            L::store(&dst[i][j], v);
+            break;
+
+        case Op::MULT:
+            L::store(&dst[i][j], L::load(&dst[i][j]) * v);
+            break;
+
+        case Op::DIV:
+            L::store(&dst[i][j], L::max(L::load(&divBuffer[i][j]) / L::selPositive(v, L::set(1.f)), L::set(0.f)));
+            break;
+
+        case Op::DIV_UNCLAMPED:
+            L::store(&dst[i][j], L::load(&divBuffer[i][j]) / L::selPositive(v, L::set(1.f)));
+            break;
+
+        case Op::DIV_EPS:
+            L::store(&dst[i][j], L::load(&divBuffer[i][j]) / L::max(v, L::set(0.00001f)));
+            break;
+    }
+}
+
+template<class L>
+inline typename L::vtype conv3x3At(float** src, int i, int j, typename L::vtype c0, typename L::vtype c1, typename L::vtype c2)
+{
+    return c2 * (L::load(&src[i - 1][j - 1]) + L::load(&src[i - 1][j + 1]) + L::load(&src[i + 1][j - 1]) + L::load(&src[i + 1][j + 1])) + c1 * (L::load(&src[i - 1][j]) + L::load(&src[i][j - 1]) + L::load(&src[i][j + 1]) + L::load(&src[i + 1][j])) + c0 * L::load(&src[i][j]);
+}
+
+template<class L>
+struct Kernel5x5 {
+    typedef typename L::vtype V;
+
+    explicit Kernel5x5(const float kernel[5][5]) :
+        c21(L::set(kernel[0][1])),
+        c20(L::set(kernel[0][2])),
+        c11(L::set(kernel[1][1])),
+        c10(L::set(kernel[1][2])),
+        c00(L::set(kernel[2][2]))
+    {
+    }
+
+    V operator ()(float** src, int i, int j) const
+    {
+        return c21 * (L::load(&src[i - 2][j - 1]) + L::load(&src[i - 2][j + 1]) + L::load(&src[i - 1][j - 2]) + L::load(&src[i - 1][j + 2]) + L::load(&src[i + 1][j - 2]) + L::load(&src[i + 1][j + 2]) + L::load(&src[i + 2][j - 1]) + L::load(&src[i + 2][j + 1])) +
+               c20 * (L::load(&src[i - 2][j]) + L::load(&src[i][j - 2]) + L::load(&src[i][j + 2]) + L::load(&src[i + 2][j])) +
+               c11 * (L::load(&src[i - 1][j - 1]) + L::load(&src[i - 1][j + 1]) + L::load(&src[i + 1][j - 1]) + L::load(&src[i + 1][j + 1])) +
+               c10 * (L::load(&src[i - 1][j]) + L::load(&src[i][j - 1]) + L::load(&src[i][j + 1]) + L::load(&src[i + 1][j])) +
+               c00 * L::load(&src[i][j]);
+    }
+
+    static constexpr int radius = 2;
+    const V c21, c20, c11, c10, c00;
+};
+
+template<class L>
+struct Kernel7x7 {
+    typedef typename L::vtype V;
+
+    explicit Kernel7x7(const float kernel[7][7]) :
+        c31(L::set(kernel[0][2])),
+        c30(L::set(kernel[0][3])),
+        c22(L::set(kernel[1][1])),
+        c21(L::set(kernel[1][2])),
+        c20(L::set(kernel[1][3])),
+        c11(L::set(kernel[2][2])),
+        c10(L::set(kernel[2][3])),
+        c00(L::set(kernel[3][3]))
+    {
+    }
+
+    // same weights as gauss7x7mult and gauss7x7div, including the extra c21 factor of src[i - 2][j + 1]
+    V operator ()(float** src, int i, int j) const
+    {
+        return c31 * (L::load(&src[i - 3][j - 1]) + L::load(&src[i - 3][j + 1]) + L::load(&src[i - 1][j - 3]) + L::load(&src[i - 1][j + 3]) + L::load(&src[i + 1][j - 3]) + L::load(&src[i + 1][j + 3]) + L::load(&src[i + 3][j - 1]) + L::load(&src[i + 3][j + 1])) +
+               c30 * (L::load(&src[i - 3][j]) + L::load(&src[i][j - 3]) + L::load(&src[i][j + 3]) + L::load(&src[i + 3][j])) +
+               c22 * (L::load(&src[i - 2][j - 2]) + L::load(&src[i - 2][j + 2]) + L::load(&src[i + 2][j - 2]) + L::load(&src[i + 2][j + 2])) +
+               c21 * (L::load(&src[i - 2][j - 1]) + L::load(&src[i - 2][j + 1]) * c21 + L::load(&src[i - 1][j - 2]) + L::load(&src[i - 1][j + 2]) + L::load(&src[i + 1][j - 2]) + L::load(&src[i + 1][j + 2]) + L::load(&src[i + 2][j - 1]) + L::load(&src[i + 2][j + 1])) +
+               c20 * (L::load(&src[i - 2][j]) + L::load(&src[i][j - 2]) + L::load(&src[i][j + 2]) + L::load(&src[i + 2][j])) +
+               c11 * (L::load(&src[i - 1][j - 1]) + L::load(&src[i - 1][j + 1]) + L::load(&src[i + 1][j - 1]) + L::load(&src[i + 1][j + 1])) +
+               c10 * (L::load(&src[i - 1][j]) + L::load(&src[i][j - 1]) + L::load(&src[i][j + 1]) + L::load(&src[i + 1][j])) +
+               c00 * L::load(&src[i][j]);
+    }
+
+    static constexpr int radius = 3;
+    const V c31, c30, c22, c21, c20, c11, c10, c00;
+};
+
+template<class L, Op op>
+void gauss3x3(float** src, float** dst, float** divBuffer, const int W, const int H, const float c0, const float c1, const float c2, const float b0, const float b1)
+{
+    const typename L::vtype c0v = L::set(c0);
+    const typename L::vtype c1v = L::set(c1);
+    const typename L::vtype c2v = L::set(c2);
+
+    // first row
+#ifdef _OPENMP
+    #pragma omp single nowait
+#endif
+    {
+        put<Scalar, op>(dst, divBuffer, 0, 0, src[0][0]);
+
+        for (int j = 1; j < W - 1; j++) {
+            put<Scalar, op>(dst, divBuffer, 0, j, b1 * (src[0][j - 1] + src[0][j + 1]) + b0 * src[0][j]);
+        }
+
+        put<Scalar, op>(dst, divBuffer, 0, W - 1, src[0][W - 1]);
+    }
+
+#ifdef _OPENMP
+    #pragma omp for nowait
+#endif
+
+    for (int i = 1; i < H - 1; i++) {
+        put<Scalar, op>(dst, divBuffer, i, 0, b1 * (src[i - 1][0] + src[i + 1][0]) + b0 * src[i][0]);
+
+        int j = 1;
+
+        for (; j < W - L::size; j += L::size) {
+            put<L, op>(dst, divBuffer, i, j, conv3x3At<L>(src, i, j, c0v, c1v, c2v));
+        }
+
+        for (; j < W - 1; j++) {
+            put<Scalar, op>(dst, divBuffer, i, j, conv3x3At<Scalar>(src, i, j, c0, c1, c2));
+        }
+
+        put<Scalar, op>(dst, divBuffer, i, W - 1, b1 * (src[i - 1][W - 1] + src[i + 1][W - 1]) + b0 * src[i][W - 1]);
+    }
+
+    // last row
+#ifdef _OPENMP
+    #pragma omp single
+#endif
+    {
+        put<Scalar, op>(dst, divBuffer, H - 1, 0, src[H - 1][0]);
+
+        for (int j = 1; j < W - 1; j++) {
+            put<Scalar, op>(dst, divBuffer, H - 1, j, b1 * (src[H - 1][j - 1] + src[H - 1][j + 1]) + b0 * src[H - 1][j]);
+        }
+
+        put<Scalar, op>(dst, divBuffer, H - 1, W - 1, src[H - 1][W - 1]);
+    }
+}
+
+template<class L, template<class> class K>
+void gaussConvMult(float** src, float** dst, const int W, const int H, const float kernel[K<Scalar>::radius * 2 + 1][K<Scalar>::radius * 2 + 1])
+{
+    constexpr int r = K<Scalar>::radius;
+    const K<L> kernelv(kernel);
+    const K<Scalar> kernels(kernel);
+
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic, 16)
+#endif
+
+    for (int i = r; i < H - r; ++i) {
+        int j = r;
+
+        for (; j < W - r + 1 - L::size; j += L::size) {
+            put<L, Op::MULT>(dst, nullptr, i, j, kernelv(src, i, j));
+        }
+
+        for (; j < W - r; ++j) {
+            put<Scalar, Op::MULT>(dst, nullptr, i, j, kernels(src, i, j));
+        }
+    }
+}
+
+template<class L, template<class> class K>
+void gaussConvDiv(float** src, float** dst, float** divBuffer, const int W, const int H, const float kernel[K<Scalar>::radius * 2 + 1][K<Scalar>::radius * 2 + 1])
+{
+    constexpr int r = K<Scalar>::radius;
+    const K<L> kernelv(kernel);
+    const K<Scalar> kernels(kernel);
+
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic, 16) nowait
+#endif
+
+    for (int i = r; i < H - r; ++i) {
+        for (int j = 0; j < r; ++j) {
+            dst[i][j] = dst[i][W - 1 - j] = 1.f;
+        }
+
+        int j = r;
+
+        for (; j < W - r + 1 - L::size; j += L::size) {
+            put<L, Op::DIV_EPS>(dst, divBuffer, i, j, kernelv(src, i, j));
+        }
+
+        for (; j < W - r; ++j) {
+            put<Scalar, Op::DIV_EPS>(dst, divBuffer, i, j, kernels(src, i, j));
+        }
+    }
+
+    // first and last rows
+#ifdef _OPENMP
+    #pragma omp single
+#endif
+    {
+        for (int i = 0; i < r; ++i) {
+            for (int j = 0; j < W; ++j) {
+                dst[i][j] = dst[H - 1 - i][j] = 1.f;
+            }
+        }
+    }
+}
+
+// The rows are processed 'L::size' at a time, gathered in the lanes of the vectors
+template<class L>
+void gaussHorizontalIIR(float** src, float** dst, const int W, const int H, const GaussIIRCoeffs& c)
+{
+    typedef typename L::vtype V;
+    constexpr int n = L::size;
+
+    const double B = c.B, b1 = c.b1, b2 = c.b2, b3 = c.b3;
+    const V Bv = L::set(B);
+    const V b1v = L::set(b1);
+    const V b2v = L::set(b2);
+    const V b3v = L::set(b3);
+    V Mv[3][3];
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            Mv[i][j] = L::set(c.M[i][j]);
+        }
+    }
+
+    // too large for the stack with wide vectors and wide images
+    float* const tmp = static_cast<float*>(_mm_malloc(W * n * sizeof(float), 64));
+
+#ifdef _OPENMP
+    #pragma omp for nowait
+#endif
+
+    for (int i = 0; i < H - (n - 1); i += n) {
+        V Tv = L::gather(src, i, 0);
+        V Tm3v = Tv * (Bv + b1v + b2v + b3v);
+        L::store(&tmp[0], Tm3v);
+
+        V Tm2v = L::gather(src, i, 1) * Bv + Tm3v * b1v + Tv * (b2v + b3v);
+        L::store(&tmp[n], Tm2v);
+
+        V Rv = L::gather(src, i, 2) * Bv + Tm2v * b1v + Tm3v * b2v + Tv * b3v;
+        L::store(&tmp[2 * n], Rv);
+
+        for (int j = 3; j < W; j++) {
+            Tv = Rv;
+            Rv = L::gather(src, i, j) * Bv + Tv * b1v + Tm2v * b2v + Tm3v * b3v;
+            L::store(&tmp[j * n], Rv);
+            Tm3v = Tm2v;
+            Tm2v = Tv;
+        }
+
+        Tv = L::gather(src, i, W - 1);
+
+        const V temp2Wp1 = Tv + Mv[2][0] * (Rv - Tv) + Mv[2][1] * (Tm2v - Tv) + Mv[2][2] * (Tm3v - Tv);
+        const V temp2W = Tv + Mv[1][0] * (Rv - Tv) + Mv[1][1] * (Tm2v - Tv) + Mv[1][2] * (Tm3v - Tv);
+
+        Rv = Tv + Mv[0][0] * (Rv - Tv) + Mv[0][1] * (Tm2v - Tv) + Mv[0][2] * (Tm3v - Tv);
+        L::store(&tmp[(W - 1) * n], Rv);
+
+        Tm2v = Bv * Tm2v + b1v * Rv + b2v * temp2W + b3v * temp2Wp1;
+        L::store(&tmp[(W - 2) * n], Tm2v);
+
+        Tm3v = Bv * Tm3v + b1v * Tm2v + b2v * Rv + b3v * temp2W;
+        L::store(&tmp[(W - 3) * n], Tm3v);
+
+        Tv = Rv;
+        Rv = Tm3v;
+        Tm3v = Tv;
+
+        for (int j = W - 4; j >= 0; j--) {
+            Tv = Rv;
+            Rv = L::load(&tmp[j * n]) * Bv + Tv * b1v + Tm2v * b2v + Tm3v * b3v;
+            L::store(&tmp[j * n], Rv);
+            Tm3v = Tm2v;
+            Tm2v = Tv;
+        }
+
+        for (int k = 0; k < n; k++) {
+            for (int j = 0; j < W; j++) {
+                dst[i + k][j] = tmp[j * n + k];
+            }
+        }
+    }
+
+    // remaining rows
+#ifdef _OPENMP
+    #pragma omp single
+#endif
+
+    for (int i = H - (H % n); i < H; i++) {
+        tmp[0] = src[i][0] * (B + b1 + b2 + b3);
+        tmp[1] = B * src[i][1] + b1 * tmp[0]  + src[i][0] * (b2 + b3);
+        tmp[2] = B * src[i][2] + b1 * tmp[1]  + b2 * tmp[0]  + b3 * src[i][0];
+
+        for (int j = 3; j < W; j++) {
+            tmp[j] = B * src[i][j] + b1 * tmp[j - 1] + b2 * tmp[j - 2] + b3 * tmp[j - 3];
+        }
+
+        const float temp2Wm1 = src[i][W - 1] + c.M[0][0] * (tmp[W - 1] - src[i][W - 1]) + c.M[0][1] * (tmp[W - 2] - src[i][W - 1]) + c.M[0][2] * (tmp[W - 3] - src[i][W - 1]);
+        const float temp2W   = src[i][W - 1] + c.M[1][0] * (tmp[W - 1] - src[i][W - 1]) + c.M[1][1] * (tmp[W - 2] - src[i][W - 1]) + c.M[1][2] * (tmp[W - 3] - src[i][W - 1]);
+        const float temp2Wp1 = src[i][W - 1] + c.M[2][0] * (tmp[W - 1] - src[i][W - 1]) + c.M[2][1] * (tmp[W - 2] - src[i][W - 1]) + c.M[2][2] * (tmp[W - 3] - src[i][W - 1]);
+
+        tmp[W - 1] = temp2Wm1;
+        tmp[W - 2] = B * tmp[W - 2] + b1 * tmp[W - 1] + b2 * temp2W + b3 * temp2Wp1;
+        tmp[W - 3] = B * tmp[W - 3] + b1 * tmp[W - 2] + b2 * tmp[W - 1] + b3 * temp2W;
+
+        for (int j = W - 4; j >= 0; j--) {
+            tmp[j] = B * tmp[j] + b1 * tmp[j + 1] + b2 * tmp[j + 2] + b3 * tmp[j + 3];
+        }
+
+        for (int j = 0; j < W; j++) {
+            dst[i][j] = tmp[j];
+        }
+    }
+
+    _mm_free(tmp);
+}
+
+// 16 columns per iteration: a whole cache line of each row
+template<class L, Op op>
+void gaussVerticalIIR(float** src, float** dst, float** divBuffer, const int W, const int H, const GaussIIRCoeffs& c)
+{
+    typedef typename L::vtype V;
+    constexpr int cols = 16;
+    constexpr int nv = cols / L::size;
+    // the SSE code doesn't clamp the division of the last 3 rows, kept for identical results
+    constexpr Op lastOp = op == Op::DIV ? Op::DIV_UNCLAMPED : op;
+
+    const double B = c.B, b1 = c.b1, b2 = c.b2, b3 = c.b3;
+    const V Bv = L::set(B);
+    const V b1v = L::set(b1);
+    const V b2v = L::set(b2);
+    const V b3v = L::set(b3);
+    V Mv[3][3];
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            Mv[i][j] = L::set(c.M[i][j]);
+        }
+    }
+
+    // too large for the stack with tall images
+    float (* const tmp)[cols] = static_cast<float (*)[cols]>(_mm_malloc(H * cols * sizeof(float), 64));
+
+#ifdef _OPENMP
+    #pragma omp for nowait
+#endif
+
+    for (int i = 0; i < W - (cols - 1); i += cols) {
+        V Rv[nv], Tv[nv], Tm2v[nv], Tm3v[nv];
+
+        for (int k = 0; k < nv; ++k) {
+            const int col = i + k * L::size;
+            Tv[k] = L::load(&src[0][col]);
+            Rv[k] = Tv[k] * (Bv + b1v + b2v + b3v);
+            Tm3v[k] = Rv[k];
+            L::store(&tmp[0][k * L::size], Rv[k]);
+
+            Rv[k] = L::load(&src[1][col]) * Bv + Rv[k] * b1v + Tv[k] * (b2v + b3v);
+            Tm2v[k] = Rv[k];
+            L::store(&tmp[1][k * L::size], Rv[k]);
+
+            Rv[k] = L::load(&src[2][col]) * Bv + Rv[k] * b1v + Tm3v[k] * b2v + Tv[k] * b3v;
+            L::store(&tmp[2][k * L::size], Rv[k]);
+        }
+
+        for (int j = 3; j < H; j++) {
+            for (int k = 0; k < nv; ++k) {
+                Tv[k] = Rv[k];
+                Rv[k] = L::load(&src[j][i + k * L::size]) * Bv + Tv[k] * b1v + Tm2v[k] * b2v + Tm3v[k] * b3v;
+                L::store(&tmp[j][k * L::size], Rv[k]);
+                Tm3v[k] = Tm2v[k];
+                Tm2v[k] = Tv[k];
+            }
+        }
+
+        for (int k = 0; k < nv; ++k) {
+            const int col = i + k * L::size;
+            Tv[k] = L::load(&src[H - 1][col]);
+
+            const V temp2Wp1 = Tv[k] + Mv[2][0] * (Rv[k] - Tv[k]) + Mv[2][1] * (Tm2v[k] - Tv[k]) + Mv[2][2] * (Tm3v[k] - Tv[k]);
+            const V temp2W = Tv[k] + Mv[1][0] * (Rv[k] - Tv[k]) + Mv[1][1] * (Tm2v[k] - Tv[k]) + Mv[1][2] * (Tm3v[k] - Tv[k]);
+
+            Rv[k] = Tv[k] + Mv[0][0] * (Rv[k] - Tv[k]) + Mv[0][1] * (Tm2v[k] - Tv[k]) + Mv[0][2] * (Tm3v[k] - Tv[k]);
+            put<L, lastOp>(dst, divBuffer, H - 1, col, Rv[k]);
+
+            Tm2v[k] = Bv * Tm2v[k] + b1v * Rv[k] + b2v * temp2W + b3v * temp2Wp1;
+            put<L, lastOp>(dst, divBuffer, H - 2, col, Tm2v[k]);
+
+            Tm3v[k] = Bv * Tm3v[k] + b1v * Tm2v[k] + b2v * Rv[k] + b3v * temp2W;
+            put<L, lastOp>(dst, divBuffer, H - 3, col, Tm3v[k]);
+
+            Tv[k] = Rv[k];
+            Rv[k] = Tm3v[k];
+            Tm3v[k] = Tv[k];
+        }
+
+        for (int j = H - 4; j >= 0; j--) {
+            for (int k = 0; k < nv; ++k) {
+                Tv[k] = Rv[k];
+                Rv[k] = L::load(&tmp[j][k * L::size]) * Bv + Tv[k] * b1v + Tm2v[k] * b2v + Tm3v[k] * b3v;
+                put<L, op>(dst, divBuffer, j, i + k * L::size, Rv[k]);
+                Tm3v[k] = Tm2v[k];
+                Tm2v[k] = Tv[k];
+            }
+        }
+    }
+
+    // remaining columns
+#ifdef _OPENMP
+    #pragma omp single
+#endif
+
+    for (int i = W - (W % cols); i < W; i++) {
+        tmp[0][0] = src[0][i] * (B + b1 + b2 + b3);
+        tmp[1][0] = B * src[1][i] + b1 * tmp[0][0] + src[0][i] * (b2 + b3);
+        tmp[2][0] = B * src[2][i] + b1 * tmp[1][0] + b2 * tmp[0][0] + b3 * src[0][i];
+
+        for (int j = 3; j < H; j++) {
+            tmp[j][0] = B * src[j][i] + b1 * tmp[j - 1][0] + b2 * tmp[j - 2][0] + b3 * tmp[j - 3][0];
+        }
+
+        const float temp2Hm1 = src[H - 1][i] + c.M[0][0] * (tmp[H - 1][0] - src[H - 1][i]) + c.M[0][1] * (tmp[H - 2][0] - src[H - 1][i]) + c.M[0][2] * (tmp[H - 3][0] - src[H - 1][i]);
+        const float temp2H   = src[H - 1][i] + c.M[1][0] * (tmp[H - 1][0] - src[H - 1][i]) + c.M[1][1] * (tmp[H - 2][0] - src[H - 1][i]) + c.M[1][2] * (tmp[H - 3][0] - src[H - 1][i]);
+        const float temp2Hp1 = src[H - 1][i] + c.M[2][0] * (tmp[H - 1][0] - src[H - 1][i]) + c.M[2][1] * (tmp[H - 2][0] - src[H - 1][i]) + c.M[2][2] * (tmp[H - 3][0] - src[H - 1][i]);
+
+        tmp[H - 1][0] = temp2Hm1;
+        tmp[H - 2][0] = B * tmp[H - 2][0] + b1 * tmp[H - 1][0] + b2 * temp2H + b3 * temp2Hp1;
+        tmp[H - 3][0] = B * tmp[H - 3][0] + b1 * tmp[H - 2][0] + b2 * tmp[H - 1][0] + b3 * temp2H;
+
+        for (int j = H - 4; j >= 0; j--) {
+            tmp[j][0] = B * tmp[j][0] + b1 * tmp[j + 1][0] + b2 * tmp[j + 2][0] + b3 * tmp[j + 3][0];
+        }
+
+        for (int j = 0; j < H; j++) {
+            put<Scalar, op>(dst, divBuffer, j, i, tmp[j][0]);
+        }
+    }
+
+    _mm_free(tmp);
+}
+
+template<class L>
+void conv3x3(float** src, float** dst, float** divBuffer, int W, int H, float c0, float c1, float c2, float b0, float b1, eGaussType type)
+{
+    switch (type) {
+        case GAUSS_MULT:
+            gauss3x3<L, Op::MULT>(src, dst, nullptr, W, H, c0, c1, c2, b0, b1);
+            break;
+
+        case GAUSS_DIV:
+            gauss3x3<L, Op::DIV>(src, dst, divBuffer, W, H, c0, c1, c2, b0, b1);
+            break;
+
+        case GAUSS_STANDARD:
+            gauss3x3<L, Op::SET>(src, dst, nullptr, W, H, c0, c1, c2, b0, b1);
+            break;
+    }
+}
+
+template<class L>
+void conv5x5(float** src, float** dst, float** divBuffer, int W, int H, const float kernel[5][5], eGaussType type)
+{
+    if (type == GAUSS_DIV) {
+        gaussConvDiv<L, Kernel5x5>(src, dst, divBuffer, W, H, kernel);
+    } else {
+        gaussConvMult<L, Kernel5x5>(src, dst, W, H, kernel);
+    }
+}
+
+template<class L>
+void conv7x7(float** src, float** dst, float** divBuffer, int W, int H, const float kernel[7][7], eGaussType type)
+{
+    if (type == GAUSS_DIV) {
+        gaussConvDiv<L, Kernel7x7>(src, dst, divBuffer, W, H, kernel);
+    } else {
+        gaussConvMult<L, Kernel7x7>(src, dst, W, H, kernel);
+    }
+}
+
+template<class L>
+void vertical(float** src, float** dst, float** divBuffer, int W, int H, const GaussIIRCoeffs& coeffs, eGaussType type)
+{
+    switch (type) {
+        case GAUSS_MULT:
+            gaussVerticalIIR<L, Op::MULT>(src, dst, nullptr, W, H, coeffs);
+            break;
+
+        case GAUSS_DIV:
+            gaussVerticalIIR<L, Op::DIV>(src, dst, divBuffer, W, H, coeffs);
+            break;
+
+        case GAUSS_STANDARD:
+            gaussVerticalIIR<L, Op::SET>(src, dst, nullptr, W, H, coeffs);
+            break;
+    }
+}
+
+}
@@ -19,6 +19,7 @@
 #include <functional>
 
 #include <strings.h>
+#include <vector>
 
 #include <tiff.h>
 
@@ -39,7 +40,7 @@
 
 using namespace rtengine;
 
-extern "C" IptcData *iptc_data_new_from_jpeg_file(FILE* infile);
+extern "C" IptcData *iptc_data_new_from_jpeg_file(IMFILE* infile);
 
 namespace
 {
@@ -1306,59 +1307,67 @@ extern "C" {
 #include <libiptcdata/iptc-data.h>
 #include <libiptcdata/iptc-jpeg.h>
 
-    struct _IptcDataPrivate {
-        unsigned int ref_count;
-
-        IptcLog *log;
-        IptcMem *mem;
-    };
-
+    // Same as iptc_jpeg_read_ps3() followed by iptc_data_load(), but on an IMFILE
     IptcData *
-    iptc_data_new_from_jpeg_file(FILE *infile)
+    iptc_data_new_from_jpeg_file(IMFILE *infile)
     {
-        IptcData *d;
-        unsigned char * buf;
-        int buf_len = 256 * 256;
-        int len, offset;
-        unsigned int iptc_len;
+        unsigned char buf[4];
 
-        if (!infile) {
+        if (!infile || fseek(infile, 0, SEEK_SET) || fread(buf, 1, 2, infile) != 2 || buf[0] != 0xff || buf[1] != 0xd8) {
             return nullptr;
         }
 
-        d = iptc_data_new();
-
-        if (!d) {
+        if (fread(buf, 1, 2, infile) != 2) {
             return nullptr;
         }
 
-        buf = (unsigned char*)iptc_mem_alloc(d->priv->mem, buf_len);
+        while (buf[0] == 0xff) {
+            const unsigned char marker = buf[1];
 
-        if (!buf) {
-            iptc_data_unref(d);
-            return nullptr;
-        }
+            if (marker == 0xff) { // fill byte
+                if (fread(buf + 1, 1, 1, infile) != 1) {
+                    return nullptr;
+                }
 
-        len = iptc_jpeg_read_ps3(infile, buf, buf_len);
+                continue;
+            }
 
-        if (len <= 0) {
-            goto failure;
-        }
+            if (marker == 0xda || marker == 0xd9) { // no metadata after the start of scan
+                return nullptr;
+            }
 
-        offset = iptc_jpeg_ps3_find_iptc(buf, len, &iptc_len);
+            if (fread(buf + 2, 1, 2, infile) != 2) {
+                return nullptr;
+            }
 
-        if (offset <= 0) {
-            goto failure;
-        }
+            const int len = buf[2] << 8 | buf[3];
 
-        iptc_data_load(d, buf + offset, iptc_len);
+            if (len < 2) {
+                return nullptr;
+            }
+
+            if (marker == 0xed && len > 2) { // APP13
+                std::vector<unsigned char> segment(len - 2);
+
+                if (fread(segment.data(), 1, len - 2, infile) != len - 2) {
+                    return nullptr;
+                }
+
+                unsigned int iptc_len;
+                const int offset = iptc_jpeg_ps3_find_iptc(segment.data(), len - 2, &iptc_len);
 
-        iptc_mem_free(d->priv->mem, buf);
-        return d;
+                if (offset > 0) {
+                    return iptc_data_new_from_data(segment.data() + offset, iptc_len);
+                }
+            } else if (fseek(infile, len - 2, SEEK_CUR)) {
+                return nullptr;
+            }
+
+            if (fread(buf, 1, 2, infile) != 2) {
+                return nullptr;
+            }
+        }
 
-failure:
-        iptc_mem_free(d->priv->mem, buf);
-        iptc_data_unref(d);
         return nullptr;
     }
 
@@ -1368,7 +1377,7 @@ FramesData::FramesData(const Glib::ustring& fname, std::unique_ptr<RawMetaDataLo
     iptc(nullptr), dcrawFrameCount(0)
 {
     if (rml && (rml->exifBase >= 0 || rml->ciffBase >= 0)) {
-        FILE* f = g_fopen(fname.c_str(), "rb");
+        IMFILE* f = gfopen_metadata(fname.c_str());
 
         if (f) {
             rtexif::ExifManager exifManager(f, std::move(rml), firstFrameOnly);
@@ -1401,7 +1410,7 @@ FramesData::FramesData(const Glib::ustring& fname, std::unique_ptr<RawMetaDataLo
             fclose(f);
         }
     } else if (hasJpegExtension(fname)) {
-        FILE* f = g_fopen(fname.c_str(), "rb");
+        IMFILE* f = gfopen_metadata(fname.c_str());
 
         if (f) {
             rtexif::ExifManager exifManager(f, std::move(rml), true);
@@ -1414,14 +1423,13 @@ FramesData::FramesData(const Glib::ustring& fname, std::unique_ptr<RawMetaDataLo
                     frames.push_back(std::unique_ptr<FrameData>(new FrameData(currFrame, currFrame->getRoot(), roots.at(0))));
                 }
 
-                rewind(exifManager.f);  // Not sure this is necessary
                 iptc = iptc_data_new_from_jpeg_file(exifManager.f);
             }
 
             fclose(f);
         }
     } else if (hasTiffExtension(fname)) {
-        FILE* f = g_fopen(fname.c_str(), "rb");
+        IMFILE* f = gfopen_metadata(fname.c_str());
 
         if (f) {
             rtexif::ExifManager exifManager(f, std::move(rml), firstFrameOnly);
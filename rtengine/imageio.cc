@@ -21,9 +21,14 @@
 #include <glib/gstdio.h>
 #include <tiff.h>
 #include <tiffio.h>
+#include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <fcntl.h>
+#include <functional>
+#include <vector>
+#include <zlib.h>
 #include <libiptcdata/iptc-jpeg.h>
 #include "rt_math.h"
 #include "procparams.h"
@@ -44,6 +49,11 @@
 #include "color.h"
 
 #include "jpeg.h"
+#include "opthelper.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace rtengine;
@@ -78,6 +88,89 @@ FILE* g_fopen_withBinaryAndLock(const Glib::ustring& fname)
     return f;
 }
 
+// Rows of the strips of the compressed TIFFs, small enough to get a strip per thread even for small images
+constexpr int tiffStripRows = 32;
+
+#ifdef __SSE2__
+inline __m128i subSamples(__m128i a, __m128i b, uint8_t)
+{
+    return _mm_sub_epi8(a, b);
+}
+
+inline __m128i subSamples(__m128i a, __m128i b, uint16_t)
+{
+    return _mm_sub_epi16(a, b);
+}
+
+inline __m128i subSamples(__m128i a, __m128i b, uint32_t)
+{
+    return _mm_sub_epi32(a, b);
+}
+#endif
+
+// Differences of each sample with the sample stride positions before it, as the TIFF horizontal predictor does
+template<typename T>
+void horizontalDiff(const T* in, T* out, int count, int stride)
+{
+    int i = 0;
+
+    for (; i < std::min(stride, count); ++i) {
+        out[i] = in[i];
+    }
+
+#ifdef __SSE2__
+    constexpr int vecSize = 16 / sizeof(T);
+
+    for (; i + vecSize <= count; i += vecSize) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i - stride));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), subSamples(a, b, T()));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        out[i] = in[i] - in[i - stride];
+    }
+}
+
+// Applies the predictor of the TIFF to a row of RGB samples in the byte order of the machine, and puts the
+// result in the byte order of the file. tmp has to hold lineWidth bytes.
+void predictTiffRow(const unsigned char* in, unsigned char* out, unsigned char* tmp, int lineWidth, int bps, bool isFloat, bool byteSwapped)
+{
+    if (isFloat) {
+        // floating point predictor: the bytes of the samples are split in planes, the most significant first,
+        // then differenced, so the byte order of the file doesn't matter
+        const int bytes = bps / 8;
+        const int count = lineWidth / bytes;
+
+        for (int i = 0; i < count; ++i) {
+            for (int b = 0; b < bytes; ++b) {
+#if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+                tmp[(bytes - 1 - b) * count + i] = in[i * bytes + b];
+#else
+                tmp[b * count + i] = in[i * bytes + b];
+#endif
+            }
+        }
+
+        horizontalDiff(tmp, out, lineWidth, 3);
+    } else if (bps == 8) {
+        horizontalDiff(in, out, lineWidth, 3);
+    } else if (bps == 16) {
+        horizontalDiff(reinterpret_cast<const uint16_t*>(in), reinterpret_cast<uint16_t*>(out), lineWidth / 2, 3);
+
+        if (byteSwapped) {
+            TIFFSwabArrayOfShort(reinterpret_cast<uint16_t*>(out), lineWidth / 2);
+        }
+    } else {
+        horizontalDiff(reinterpret_cast<const uint32_t*>(in), reinterpret_cast<uint32_t*>(out), lineWidth / 4, 3);
+
+        if (byteSwapped) {
+            TIFFSwabArrayOfLong(reinterpret_cast<uint32_t*>(out), lineWidth / 4);
+        }
+    }
+}
+
 }
 
 Glib::ustring ImageIO::errorMsg[6] = {"Success", "Cannot read file.", "Invalid header.", "Error while reading header.", "File reading error", "Image format not supported."};
@@ -474,7 +567,7 @@ void my_error_exit (j_common_ptr cinfo)
 }
 
 
-int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize)
+int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize, int minWidth, int minHeight, int* fullWidth, int* fullHeight)
 {
     jpeg_decompress_struct cinfo;
     jpeg_create_decompress(&cinfo);
@@ -525,6 +618,26 @@ int ImageIO::loadJPEGFromMemory (const char* buffer, int bufsize)
         embProfile = nullptr;
     }
 
+    if (fullWidth) {
+        *fullWidth = cinfo.image_width;
+    }
+
+    if (fullHeight) {
+        *fullHeight = cinfo.image_height;
+    }
+
+    if (minWidth > 0 || minHeight > 0) {
+        // The IDCT then outputs the scaled image directly, so the discarded pixels are neither upsampled nor
+        // color converted
+        for (unsigned int denom = 8; denom > 1; denom /= 2) {
+            if ((cinfo.image_width + denom - 1) / denom >= static_cast<unsigned int>(minWidth) && (cinfo.image_height + denom - 1) / denom >= static_cast<unsigned int>(minHeight)) {
+                cinfo.scale_num = 1;
+                cinfo.scale_denom = denom;
+                break;
+            }
+        }
+    }
+
     jpeg_start_decompress(&cinfo);
 
     unsigned int width = cinfo.output_width;
@@ -993,6 +1106,120 @@ void PNGwriteRawProfile(png_struct *ping, png_info *ping_info, const char *profi
     png_free(ping, text);
 }
 
+// Rows compressed together by savePNG(), as an independent part of the zlib stream of the image
+constexpr int pngChunkRows = 64;
+
+inline int paethPredictor (int left, int up, int upLeft)
+{
+    const int p = left + up - upLeft;
+    const int pa = std::abs (p - left);
+    const int pb = std::abs (p - up);
+    const int pc = std::abs (p - upLeft);
+    return pa <= pb && pa <= pc ? left : pb <= pc ? up : upLeft;
+}
+
+template<int type>
+inline int predictPng (int left, int up, int upLeft)
+{
+    switch (type) {
+        case PNG_FILTER_VALUE_SUB:
+            return left;
+
+        case PNG_FILTER_VALUE_UP:
+            return up;
+
+        case PNG_FILTER_VALUE_AVG:
+            return (left + up) >> 1;
+
+        case PNG_FILTER_VALUE_PAETH:
+            return paethPredictor (left, up, upLeft);
+
+        default:
+            return 0;
+    }
+}
+
+// Filters row with the filter type, returns the sum of the absolute values of the filtered bytes taken as signed
+template<int type>
+unsigned int filterPngRow (const unsigned char* row, const unsigned char* prev, int length, int bpp, unsigned char* out)
+{
+    unsigned int sum = 0;
+
+    for (int i = 0; i < std::min (bpp, length); ++i) {
+        out[i] = row[i] - predictPng<type> (0, prev[i], 0);
+        sum += std::abs (static_cast<signed char>(out[i]));
+    }
+
+    for (int i = bpp; i < length; ++i) {
+        out[i] = row[i] - predictPng<type> (row[i - bpp], prev[i], prev[i - bpp]);
+        sum += std::abs (static_cast<signed char>(out[i]));
+    }
+
+    return sum;
+}
+
+// Filters row, prev being the previous row or zeros for the first one, with the filter giving the lowest sum of
+// absolute values, the heuristic recommended by the PNG specification. out receives the filter type then the
+// filtered row, candidate has to hold length bytes.
+void filterPngRow (const unsigned char* row, const unsigned char* prev, int length, int bpp, unsigned char* out, unsigned char* candidate)
+{
+    out[0] = PNG_FILTER_VALUE_NONE;
+    unsigned int best = filterPngRow<PNG_FILTER_VALUE_NONE> (row, prev, length, bpp, out + 1);
+
+    const auto tryFilter = [&](int type, unsigned int sum) {
+        if (sum < best) {
+            best = sum;
+            out[0] = type;
+            memcpy (out + 1, candidate, length);
+        }
+    };
+
+    tryFilter (PNG_FILTER_VALUE_SUB, filterPngRow<PNG_FILTER_VALUE_SUB> (row, prev, length, bpp, candidate));
+    tryFilter (PNG_FILTER_VALUE_UP, filterPngRow<PNG_FILTER_VALUE_UP> (row, prev, length, bpp, candidate));
+    tryFilter (PNG_FILTER_VALUE_AVG, filterPngRow<PNG_FILTER_VALUE_AVG> (row, prev, length, bpp, candidate));
+    tryFilter (PNG_FILTER_VALUE_PAETH, filterPngRow<PNG_FILTER_VALUE_PAETH> (row, prev, length, bpp, candidate));
+}
+
+// Compresses data as a part of a raw deflate stream, ending the stream if last. out is empty on error.
+void deflatePngChunk (const unsigned char* data, size_t size, bool last, std::vector<unsigned char>& out)
+{
+    z_stream stream = {};
+
+    // the compression level and strategy (Z_RLE) formerly set to libpng
+    if (deflateInit2 (&stream, 6, Z_DEFLATED, -15, 8, Z_RLE) != Z_OK) {
+        out.clear();
+        return;
+    }
+
+    // room for the empty stored block of the sync flush
+    out.resize (deflateBound (&stream, size) + 16);
+    stream.next_in = const_cast<Bytef*>(data);
+    stream.avail_in = size;
+    stream.next_out = out.data();
+    stream.avail_out = out.size();
+
+    const int result = deflate (&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+
+    if (result == (last ? Z_STREAM_END : Z_OK) && !stream.avail_in) {
+        out.resize (stream.total_out);
+    } else {
+        out.clear();
+    }
+
+    deflateEnd (&stream);
+}
+
+// Writes a chunk through libpng, which reports write errors with a jump
+bool writePngChunk (png_structp png, const char* type, const unsigned char* data, size_t size)
+{
+    if (setjmp (png_jmpbuf (png))) {
+        return false;
+    }
+
+    png_write_chunk (png, reinterpret_cast<png_bytep>(const_cast<char*>(type)), const_cast<png_bytep>(data), size);
+    return true;
+}
+
 } // namespace
 
 int ImageIO::savePNG  (const Glib::ustring &fname, int bps) const
@@ -1040,10 +1267,6 @@ int ImageIO::savePNG  (const Glib::ustring &fname, int bps) const
 
     png_set_write_fn (png, file, png_write_data, png_flush);
 
-    png_set_filter(png, 0, PNG_FILTER_PAETH);
-    png_set_compression_level(png, 6);
-    png_set_compression_strategy(png, 3);
-
     int width = getWidth ();
     int height = getHeight ();
 
@@ -1090,18 +1313,18 @@ int ImageIO::savePNG  (const Glib::ustring &fname, int bps) const
     }
 
 
-    int rowlen = width * 3 * bps / 8;
-    unsigned char *row = new unsigned char [rowlen];
+    const int rowlen = width * 3 * bps / 8;
 
     png_write_info(png, info);
 
-    for (int i = 0; i < height; i++) {
+    const auto getRow = [this, bps, rowlen](int i, unsigned char* row)
+    {
         getScanline (i, row, bps);
 
         if (bps == 16) {
             // convert to network byte order
 #if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
-            for (int j = 0; j < width * 6; j += 2) {
+            for (int j = 0; j < rowlen; j += 2) {
                 unsigned char tmp = row[j];
                 row[j] = row[j + 1];
                 row[j + 1] = tmp;
@@ -1109,19 +1332,104 @@ int ImageIO::savePNG  (const Glib::ustring &fname, int bps) const
 
 #endif
         }
+    };
+
+    // The rows are filtered and compressed in parallel by chunks, spliced in one zlib stream thanks to sync flushes.
+    // The IDAT chunks are written from this thread, batch after batch, as libpng reports errors with a jump.
+    const int bpp = 3 * bps / 8;
+    const int chunks = (height + pngChunkRows - 1) / pngChunkRows;
+#ifdef _OPENMP
+    const int batchSize = 2 * omp_get_max_threads();
+#else
+    const int batchSize = 1;
+#endif
+    std::vector<std::vector<unsigned char>> compressed (std::min (chunks, batchSize));
+    std::vector<uLong> adlers (compressed.size());
+    uLong adler = adler32 (0, nullptr, 0);
+    bool writeOk = true;
 
-        png_write_row (png, (png_byte*)row);
+    for (int batchStart = 0; batchStart < chunks && writeOk; batchStart += batchSize) {
+        const int batchEnd = std::min (chunks, batchStart + batchSize);
 
-        if (pl && !(i % 100)) {
-            pl->setProgress ((double)(i + 1) / height);
+#ifdef _OPENMP
+        #pragma omp parallel
+#endif
+        {
+            std::vector<unsigned char> rows (2 * rowlen);
+            std::vector<unsigned char> filtered (static_cast<size_t>(pngChunkRows) * (rowlen + 1));
+            std::vector<unsigned char> candidate (rowlen);
+
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic)
+#endif
+            for (int chunk = batchStart; chunk < batchEnd; ++chunk) {
+                const int firstRow = chunk * pngChunkRows;
+                const int lastRow = std::min (height, firstRow + pngChunkRows);
+                unsigned char* prev = rows.data();
+                unsigned char* row = rows.data() + rowlen;
+
+                if (firstRow) {
+                    getRow (firstRow - 1, prev);
+                } else {
+                    memset (prev, 0, rowlen);
+                }
+
+                for (int i = firstRow; i < lastRow; ++i) {
+                    getRow (i, row);
+                    filterPngRow (row, prev, rowlen, bpp, &filtered[static_cast<size_t>(i - firstRow) * (rowlen + 1)], candidate.data());
+                    std::swap (row, prev);
+                }
+
+                const size_t size = static_cast<size_t>(lastRow - firstRow) * (rowlen + 1);
+                adlers[chunk - batchStart] = adler32 (adler32 (0, nullptr, 0), filtered.data(), size);
+                deflatePngChunk (filtered.data(), size, chunk == chunks - 1, compressed[chunk - batchStart]);
+            }
+        }
+
+        for (int chunk = batchStart; chunk < batchEnd && writeOk; ++chunk) {
+            std::vector<unsigned char>& data = compressed[chunk - batchStart];
+
+            if (data.empty()) {
+                writeOk = false;
+                break;
+            }
+
+            const size_t size = static_cast<size_t>(std::min (height - chunk * pngChunkRows, pngChunkRows)) * (rowlen + 1);
+            adler = adler32_combine (adler, adlers[chunk - batchStart], size);
+
+            if (!chunk) {
+                // zlib header, deflate with a 32K window and the default level
+                const unsigned char header[2] = {0x78, 0x9c};
+                data.insert (data.begin(), header, header + 2);
+            }
+
+            if (chunk == chunks - 1) {
+                const unsigned char trailer[4] = {
+                    static_cast<unsigned char>(adler >> 24),
+                    static_cast<unsigned char>(adler >> 16),
+                    static_cast<unsigned char>(adler >> 8),
+                    static_cast<unsigned char>(adler)
+                };
+                data.insert (data.end(), trailer, trailer + 4);
+            }
+
+            writeOk = writePngChunk (png, "IDAT", data.data(), data.size());
+        }
+
+        if (pl) {
+            pl->setProgress ((double)std::min (height, batchEnd * pngChunkRows) / height);
         }
     }
 
-    png_write_end(png, info);
+    // the text chunks are written with the header, so IEND is all that png_write_end() would write
+    writeOk = writeOk && writePngChunk (png, "IEND", nullptr, 0);
+
     png_destroy_write_struct(&png, &info);
 
-    delete [] row;
-    fclose (file);
+    if (fclose (file) || !writeOk) {
+        g_remove (fname.c_str());
+        return IMIO_CANNOTWRITEFILE;
+    }
 
     if (pl) {
         pl->setProgressStr ("PROGRESSBAR_READY");
@@ -1133,30 +1441,94 @@ int ImageIO::savePNG  (const Glib::ustring &fname, int bps) const
 
 
 
+namespace
+{
+
+// The parameters of the JPEGs written by RT, to be set once the size and color space of cinfo are known
 // Quality 0..100, subsampling: 1=low quality, 2=medium, 3=high
-int ImageIO::saveJPEG (const Glib::ustring &fname, int quality, int subSamp) const
+void setJpegParameters (j_compress_ptr cinfo, int quality, int subSamp)
 {
-    if (getWidth() < 1 || getHeight() < 1) {
-        return IMIO_HEADERERROR;
+    jpeg_set_defaults (cinfo);
+    cinfo->write_JFIF_header = FALSE;
+
+    // compute optimal Huffman coding tables for the image. Bit slower to generate, but size of result image is a bit less (default was FALSE)
+    cinfo->optimize_coding = TRUE;
+
+    // Since math coprocessors are common these days, FLOAT should be a bit more accurate AND fast (default is ISLOW)
+    // (machine dependency is not really an issue, since we all run on x86 and having exactly the same file is not a requirement)
+    cinfo->dct_method = JDCT_FLOAT;
+
+    if (quality >= 0 && quality <= 100) {
+        jpeg_set_quality (cinfo, quality, true);
     }
 
-    FILE* const file = g_fopen_withBinaryAndLock (fname);
+    cinfo->comp_info[1].h_samp_factor = cinfo->comp_info[1].v_samp_factor = 1;
+    cinfo->comp_info[2].h_samp_factor = cinfo->comp_info[2].v_samp_factor = 1;
 
-    if (!file) {
-        return IMIO_CANNOTWRITEFILE;
+    if (subSamp == 1) {
+        // Best compression, default of the JPEG library:  2x2, 1x1, 1x1 (4:2:0)
+        cinfo->comp_info[0].h_samp_factor = cinfo->comp_info[0].v_samp_factor = 2;
+    } else if (subSamp == 2) {
+        // Widely used normal ratio 2x1, 1x1, 1x1 (4:2:2)
+        cinfo->comp_info[0].h_samp_factor = 2;
+        cinfo->comp_info[0].v_samp_factor = 1;
+    } else if (subSamp == 3) {
+        // Best quality 1x1 1x1 1x1 (4:4:4)
+        cinfo->comp_info[0].h_samp_factor = cinfo->comp_info[0].v_samp_factor = 1;
     }
+}
+
+#ifdef _OPENMP
+
+// Rows of an MCU with the sampling set by setJpegParameters()
+int getJpegMcuHeight (int subSamp)
+{
+    return subSamp == 2 || subSamp == 3 ? 8 : 16;
+}
+
+// Destination manager of libjpeg appending the compressed data to a vector
+struct JpegVectorDestination {
+    jpeg_destination_mgr pub;
+    std::vector<JOCTET>* data;
+};
+
+void initJpegVectorDestination (j_compress_ptr cinfo)
+{
+    JpegVectorDestination* const dest = reinterpret_cast<JpegVectorDestination*>(cinfo->dest);
+    dest->data->resize (65536);
+    dest->pub.next_output_byte = dest->data->data();
+    dest->pub.free_in_buffer = dest->data->size();
+}
+
+boolean emptyJpegVectorDestination (j_compress_ptr cinfo)
+{
+    // the whole buffer is used when this is called
+    JpegVectorDestination* const dest = reinterpret_cast<JpegVectorDestination*>(cinfo->dest);
+    const size_t used = dest->data->size();
+    dest->data->resize (2 * used);
+    dest->pub.next_output_byte = dest->data->data() + used;
+    dest->pub.free_in_buffer = dest->data->size() - used;
+    return TRUE;
+}
+
+void termJpegVectorDestination (j_compress_ptr cinfo)
+{
+    JpegVectorDestination* const dest = reinterpret_cast<JpegVectorDestination*>(cinfo->dest);
+    dest->data->resize (dest->data->size() - dest->pub.free_in_buffer);
+}
+
+// Encodes the rows firstRow to lastRow - 1 of image as a JPEG of their own, restarting the entropy coding after
+// each MCU row. The Huffman tables are optimized for the band if huffTables is null, else set to huffTables
+// (DC 0, DC 1, AC 0, AC 1). writeMarkers, if set, is called to write the markers following SOI.
+bool encodeJpegBand (const ImageIO& image, int firstRow, int lastRow, int quality, int subSamp, const JHUFF_TBL* huffTables, const std::function<void (j_compress_ptr)>& writeMarkers, std::vector<JOCTET>& data)
+{
+    std::vector<unsigned char> row (image.getWidth() * 3);
 
     jpeg_compress_struct cinfo;
-    /* We use our private extension JPEG error handler.
-       Note that this struct must live as long as the main JPEG parameter
-       struct, to avoid dangling-pointer problems.
-    */
     my_error_mgr jerr;
-    /* We set up the normal JPEG error routines, then override error_exit. */
-    cinfo.err = jpeg_std_error(&jerr.pub);
+    cinfo.err = jpeg_std_error (&jerr.pub);
     jerr.pub.error_exit = my_error_exit;
 
-    /* Establish the setjmp return context for my_error_exit to use. */
 #if defined( WIN32 ) && defined( __x86_64__ ) && !defined(__clang__)
 
     if (__builtin_setjmp(jerr.setjmp_buffer)) {
@@ -1164,112 +1536,448 @@ int ImageIO::saveJPEG (const Glib::ustring &fname, int quality, int subSamp) con
 
     if (setjmp(jerr.setjmp_buffer)) {
 #endif
-        /* If we get here, the JPEG code has signaled an error.
-           We need to clean up the JPEG object, close the file, remove the already saved part of the file and return.
-        */
-        jpeg_destroy_compress(&cinfo);
-        fclose(file);
-        g_remove (fname.c_str());
-        return IMIO_CANNOTWRITEFILE;
+        jpeg_destroy_compress (&cinfo);
+        return false;
     }
 
     jpeg_create_compress (&cinfo);
 
+    JpegVectorDestination dest;
+    dest.pub.init_destination = initJpegVectorDestination;
+    dest.pub.empty_output_buffer = emptyJpegVectorDestination;
+    dest.pub.term_destination = termJpegVectorDestination;
+    dest.data = &data;
+    cinfo.dest = &dest.pub;
 
+    cinfo.image_width  = image.getWidth();
+    cinfo.image_height = lastRow - firstRow;
+    cinfo.in_color_space = JCS_RGB;
+    cinfo.input_components = 3;
+    setJpegParameters (&cinfo, quality, subSamp);
+    cinfo.restart_in_rows = 1;
 
-    if (pl) {
-        pl->setProgressStr ("PROGRESSBAR_SAVEJPEG");
-        pl->setProgress (0.0);
+    if (huffTables) {
+        cinfo.optimize_coding = FALSE;
+
+        for (int i = 0; i < 2; ++i) {
+            *cinfo.dc_huff_tbl_ptrs[i] = huffTables[i];
+            *cinfo.ac_huff_tbl_ptrs[i] = huffTables[2 + i];
+        }
     }
 
-    jpeg_stdio_dest (&cinfo, file);
+    jpeg_start_compress (&cinfo, TRUE);
 
-    int width = getWidth ();
-    int height = getHeight ();
+    if (writeMarkers) {
+        writeMarkers (&cinfo);
+    }
 
-    cinfo.image_width  = width;
-    cinfo.image_height = height;
-    cinfo.in_color_space = JCS_RGB;
-    cinfo.input_components = 3;
-    jpeg_set_defaults (&cinfo);
-    cinfo.write_JFIF_header = FALSE;
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW rowPointer = row.data();
+        image.getScanline (firstRow + cinfo.next_scanline, rowPointer, 8);
+        jpeg_write_scanlines (&cinfo, &rowPointer, 1);
+    }
 
-    // compute optimal Huffman coding tables for the image. Bit slower to generate, but size of result image is a bit less (default was FALSE)
-    cinfo.optimize_coding = TRUE;
+    jpeg_finish_compress (&cinfo);
+    jpeg_destroy_compress (&cinfo);
 
-    // Since math coprocessors are common these days, FLOAT should be a bit more accurate AND fast (default is ISLOW)
-    // (machine dependency is not really an issue, since we all run on x86 and having exactly the same file is not a requirement)
-    cinfo.dct_method = JDCT_FLOAT;
+    return true;
+}
 
-    if (quality >= 0 && quality <= 100) {
-        jpeg_set_quality (&cinfo, quality, true);
+// Position of the first segment with marker in the header of a JPEG, starting at the segment at start, or 0
+size_t findJpegSegment (const std::vector<JOCTET>& data, JOCTET marker, size_t start = 2)
+{
+    for (size_t pos = start; pos + 4 <= data.size() && data[pos] == 0xff;) {
+        if (data[pos + 1] == marker) {
+            return pos;
+        }
+
+        if (data[pos + 1] == 0xda) { // start of scan
+            break;
+        }
+
+        pos += 2 + (data[pos + 2] << 8 | data[pos + 3]);
     }
 
-    cinfo.comp_info[1].h_samp_factor = cinfo.comp_info[1].v_samp_factor = 1;
-    cinfo.comp_info[2].h_samp_factor = cinfo.comp_info[2].v_samp_factor = 1;
+    return 0;
+}
 
-    if (subSamp == 1) {
-        // Best compression, default of the JPEG library:  2x2, 1x1, 1x1 (4:2:0)
-        cinfo.comp_info[0].h_samp_factor = cinfo.comp_info[0].v_samp_factor = 2;
-    } else if (subSamp == 2) {
-        // Widely used normal ratio 2x1, 1x1, 1x1 (4:2:2)
-        cinfo.comp_info[0].h_samp_factor = 2;
-        cinfo.comp_info[0].v_samp_factor = 1;
-    } else if (subSamp == 3) {
-        // Best quality 1x1 1x1 1x1 (4:4:4)
-        cinfo.comp_info[0].h_samp_factor = cinfo.comp_info[0].v_samp_factor = 1;
+size_t getJpegSegmentEnd (const std::vector<JOCTET>& data, size_t pos)
+{
+    return pos + 2 + (data[pos + 2] << 8 | data[pos + 3]);
+}
+
+// Adds the frequencies of the symbols of the Huffman tables of a band, estimated from the lengths of their codes
+// and weighted by the size of the band, to freqs (DC 0, DC 1, AC 0, AC 1)
+void addJpegBandFrequencies (const std::vector<JOCTET>& data, uint64_t weight, uint64_t freqs[4][257])
+{
+    for (size_t pos = findJpegSegment (data, 0xc4); pos; pos = findJpegSegment (data, 0xc4, getJpegSegmentEnd (data, pos))) {
+        const size_t end = std::min (getJpegSegmentEnd (data, pos), data.size());
+
+        for (size_t table = pos + 4; table + 17 <= end;) {
+            const int index = (data[table] >> 4) * 2 + (data[table] & 0x0f);
+            size_t symbol = table + 17;
+
+            for (int length = 1; length <= 16; ++length) {
+                for (int i = 0; i < data[table + length] && symbol < end; ++i, ++symbol) {
+                    if (index < 4) {
+                        freqs[index][data[symbol]] += weight << (16 - length);
+                    }
+                }
+            }
+
+            table = symbol;
+        }
     }
+}
 
-    jpeg_start_compress(&cinfo, TRUE);
+// Huffman table of the frequencies of the 256 symbols, limited to codes of 16 bits as in section K.2 of the JPEG
+// standard. The frequencies are changed.
+JHUFF_TBL getOptimalHuffmanTable (uint64_t freqs[257])
+{
+    // up to 256 for the 257 symbols before limiting the lengths
+    int bits[258] = {};
+    int codesize[257] = {};
+    int others[257];
+    std::fill_n (others, 257, -1);
+
+    // reserves the code of only ones
+    freqs[256] = 1;
+
+    while (true) {
+        int c1 = -1;
+        int c2 = -1;
+
+        for (int i = 0; i <= 256; ++i) {
+            if (freqs[i] && (c1 < 0 || freqs[i] <= freqs[c1])) {
+                c1 = i;
+            }
+        }
 
-    // buffer for exif and iptc markers
-    unsigned char* buffer = new unsigned char[165535]; //FIXME: no buffer size check so it can be overflowed in createJPEGMarker() for large tags, and then software will crash
-    unsigned int size;
+        for (int i = 0; i <= 256; ++i) {
+            if (freqs[i] && i != c1 && (c2 < 0 || freqs[i] <= freqs[c2])) {
+                c2 = i;
+            }
+        }
 
-    // assemble and write exif marker
-    if (exifRoot) {
-        int size = rtexif::ExifManager::createJPEGMarker (exifRoot, *exifChange, cinfo.image_width, cinfo.image_height, buffer);
+        if (c2 < 0) {
+            break;
+        }
 
-        if (size > 0 && size < 65530) {
-            jpeg_write_marker(&cinfo, JPEG_APP0 + 1, buffer, size);
+        freqs[c1] += freqs[c2];
+        freqs[c2] = 0;
+
+        ++codesize[c1];
+
+        while (others[c1] >= 0) {
+            c1 = others[c1];
+            ++codesize[c1];
+        }
+
+        others[c1] = c2;
+
+        ++codesize[c2];
+
+        while (others[c2] >= 0) {
+            c2 = others[c2];
+            ++codesize[c2];
+        }
+    }
+
+    for (int i = 0; i <= 256; ++i) {
+        if (codesize[i]) {
+            ++bits[codesize[i]];
+        }
+    }
+
+    for (int i = 257; i > 16; --i) {
+        while (bits[i] > 0) {
+            int j = i - 2;
+
+            while (bits[j] == 0) {
+                --j;
+            }
+
+            bits[i] -= 2;
+            ++bits[i - 1];
+            bits[j + 1] += 2;
+            --bits[j];
         }
     }
 
-    // assemble and write iptc marker
-    if (iptc) {
-        unsigned char* iptcdata;
-        bool error = false;
+    int i = 16;
+
+    while (bits[i] == 0) {
+        --i;
+    }
+
+    // removes the reserved code
+    --bits[i];
+
+    JHUFF_TBL table = {};
+    std::copy (bits, bits + 17, table.bits);
+
+    int p = 0;
+
+    for (int length = 1; length <= 257; ++length) {
+        for (int symbol = 0; symbol < 256; ++symbol) {
+            if (codesize[symbol] == length) {
+                table.huffval[p++] = symbol;
+            }
+        }
+    }
+
+    table.sent_table = FALSE;
+
+    return table;
+}
+
+// Compresses the bands of bandHeight rows of image in parallel, twice to use Huffman tables optimized for the
+// whole image, and writes them to file as one JPEG restarting the entropy coding after each MCU row
+bool saveJpegBands (const ImageIO& image, FILE* file, int quality, int subSamp, int bandHeight, const std::function<void (j_compress_ptr)>& writeMarkers, ProgressListener* pl)
+{
+    const int height = image.getHeight();
+    const int bandCount = (height + bandHeight - 1) / bandHeight;
+    const std::function<void (j_compress_ptr)> noMarkers;
+
+    std::vector<std::vector<JOCTET>> bands (bandCount);
+    JHUFF_TBL huffTables[4];
+    bool ok = true;
+    int done = 0;
+
+    for (int pass = 0; pass < 2 && ok; ++pass) {
+        #pragma omp parallel for schedule(dynamic)
+
+        for (int band = 0; band < bandCount; ++band) {
+            const bool bandOk = encodeJpegBand (image, band * bandHeight, std::min (height, (band + 1) * bandHeight), quality, subSamp, pass ? huffTables : nullptr, pass && !band ? writeMarkers : noMarkers, bands[band]);
+
+            #pragma omp critical
+            {
+                ok = ok && bandOk;
+
+                if (pl) {
+                    pl->setProgress ((double)(++done) / (2 * bandCount));
+                }
+            }
+        }
+
+        if (!pass && ok) {
+            // the bands are encoded with their own optimized tables first, the second pass uses tables built from them
+            uint64_t freqs[4][257] = {};
+
+            for (const auto& data : bands) {
+                addJpegBandFrequencies (data, data.size(), freqs);
+            }
+
+            for (int i = 0; i < 4; ++i) {
+                huffTables[i] = getOptimalHuffmanTable (freqs[i]);
+            }
+        }
+    }
+
+    if (!ok) {
+        return false;
+    }
+
+    unsigned int restarts = 0;
+
+    for (int band = 0; band < bandCount; ++band) {
+        std::vector<JOCTET>& data = bands[band];
+        const size_t scan = findJpegSegment (data, 0xda);
+
+        if (!scan || data.size() < getJpegSegmentEnd (data, scan) + 2 || data[data.size() - 2] != 0xff || data.back() != 0xd9) {
+            return false;
+        }
+
+        const size_t scanStart = getJpegSegmentEnd (data, scan);
+        const size_t scanEnd = data.size() - 2;
+        size_t start = scanStart;
+
+        if (!band) {
+            // the headers of the first band are those of the image, with its height
+            const size_t frame = findJpegSegment (data, 0xc0);
+
+            if (!frame) {
+                return false;
+            }
+
+            data[frame + 5] = height >> 8;
+            data[frame + 6] = height & 0xff;
+            start = 0;
+        } else {
+            const JOCTET marker[2] = {0xff, static_cast<JOCTET>(0xd0 + (restarts++ & 7))};
+
+            if (fwrite (marker, 1, 2, file) != 2) {
+                return false;
+            }
+        }
+
+        // the restart markers of the band are numbered from 0
+        for (size_t pos = scanStart; pos + 1 < scanEnd; ++pos) {
+            if (data[pos] == 0xff && data[pos + 1] >= 0xd0 && data[pos + 1] <= 0xd7) {
+                data[pos + 1] = 0xd0 + (restarts++ & 7);
+                ++pos;
+            }
+        }
+
+        if (fwrite (data.data() + start, 1, scanEnd - start, file) != scanEnd - start) {
+            return false;
+        }
+    }
+
+    const JOCTET endOfImage[2] = {0xff, 0xd9};
+    return fwrite (endOfImage, 1, 2, file) == 2;
+}
+
+#endif
+
+}
+
+
+// Quality 0..100, subsampling: 1=low quality, 2=medium, 3=high
+int ImageIO::saveJPEG (const Glib::ustring &fname, int quality, int subSamp) const
+{
+    if (getWidth() < 1 || getHeight() < 1) {
+        return IMIO_HEADERERROR;
+    }
+
+    FILE* const file = g_fopen_withBinaryAndLock (fname);
+
+    if (!file) {
+        return IMIO_CANNOTWRITEFILE;
+    }
+
+    const int width = getWidth ();
+    const int height = getHeight ();
+
+    // Writes the exif, iptc and icc markers following SOI
+    const auto writeMarkers = [this, width, height](j_compress_ptr cinfo)
+    {
+        // buffer for exif and iptc markers
+        unsigned char* buffer = new unsigned char[165535]; //FIXME: no buffer size check so it can be overflowed in createJPEGMarker() for large tags, and then software will crash
+        unsigned int size;
+
+        // assemble and write exif marker
+        if (exifRoot) {
+            int size = rtexif::ExifManager::createJPEGMarker (exifRoot, *exifChange, width, height, buffer);
+
+            if (size > 0 && size < 65530) {
+                jpeg_write_marker(cinfo, JPEG_APP0 + 1, buffer, size);
+            }
+        }
+
+        // assemble and write iptc marker
+        if (iptc) {
+            unsigned char* iptcdata;
+            bool error = false;
+
+            if (iptc_data_save (iptc, &iptcdata, &size)) {
+                if (iptcdata) {
+                    iptc_data_free_buf (iptc, iptcdata);
+                }
+
+                error = true;
+            }
+
+            int bytes = 0;
+
+            if (!error && (bytes = iptc_jpeg_ps3_save_iptc (nullptr, 0, iptcdata, size, buffer, 65532)) < 0) {
+                error = true;
+            }
 
-        if (iptc_data_save (iptc, &iptcdata, &size)) {
             if (iptcdata) {
                 iptc_data_free_buf (iptc, iptcdata);
             }
 
-            error = true;
+            if (!error) {
+                jpeg_write_marker(cinfo, JPEG_APP0 + 13, buffer, bytes);
+            }
         }
 
-        int bytes = 0;
+        delete [] buffer;
 
-        if (!error && (bytes = iptc_jpeg_ps3_save_iptc (nullptr, 0, iptcdata, size, buffer, 65532)) < 0) {
-            error = true;
+        // write icc profile to the output
+        if (profileData) {
+            write_icc_profile (cinfo, (JOCTET*)profileData, profileLength);
         }
+    };
 
-        if (iptcdata) {
-            iptc_data_free_buf (iptc, iptcdata);
+#ifdef _OPENMP
+    // Large images are split in bands of MCU rows, about 4 per thread, compressed in parallel and joined with
+    // restart markers
+    const int threads = omp_get_max_threads();
+    const int mcuHeight = getJpegMcuHeight (subSamp);
+    const int bandHeight = std::max (8, (height + 4 * threads * mcuHeight - 1) / (4 * threads * mcuHeight)) * mcuHeight;
+
+    if (threads > 1 && height > bandHeight) {
+        if (pl) {
+            pl->setProgressStr ("PROGRESSBAR_SAVEJPEG");
+            pl->setProgress (0.0);
         }
 
-        if (!error) {
-            jpeg_write_marker(&cinfo, JPEG_APP0 + 13, buffer, bytes);
+        const bool ok = saveJpegBands (*this, file, quality, subSamp, bandHeight, writeMarkers, pl);
+
+        if (fclose (file) || !ok) {
+            g_remove (fname.c_str());
+            return IMIO_CANNOTWRITEFILE;
         }
+
+        if (pl) {
+            pl->setProgressStr ("PROGRESSBAR_READY");
+            pl->setProgress (1.0);
+        }
+
+        return IMIO_SUCCESS;
     }
+#endif
 
-    delete [] buffer;
+    jpeg_compress_struct cinfo;
+    /* We use our private extension JPEG error handler.
+       Note that this struct must live as long as the main JPEG parameter
+       struct, to avoid dangling-pointer problems.
+    */
+    my_error_mgr jerr;
+    /* We set up the normal JPEG error routines, then override error_exit. */
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = my_error_exit;
 
-    // write icc profile to the output
-    if (profileData) {
-        write_icc_profile (&cinfo, (JOCTET*)profileData, profileLength);
+    /* Establish the setjmp return context for my_error_exit to use. */
+#if defined( WIN32 ) && defined( __x86_64__ ) && !defined(__clang__)
+
+    if (__builtin_setjmp(jerr.setjmp_buffer)) {
+#else
+
+    if (setjmp(jerr.setjmp_buffer)) {
+#endif
+        /* If we get here, the JPEG code has signaled an error.
+           We need to clean up the JPEG object, close the file, remove the already saved part of the file and return.
+        */
+        jpeg_destroy_compress(&cinfo);
+        fclose(file);
+        g_remove (fname.c_str());
+        return IMIO_CANNOTWRITEFILE;
     }
 
+    jpeg_create_compress (&cinfo);
+
+
+
+    if (pl) {
+        pl->setProgressStr ("PROGRESSBAR_SAVEJPEG");
+        pl->setProgress (0.0);
+    }
+
+    jpeg_stdio_dest (&cinfo, file);
+
+    cinfo.image_width  = width;
+    cinfo.image_height = height;
+    cinfo.in_color_space = JCS_RGB;
+    cinfo.input_components = 3;
+    setJpegParameters (&cinfo, quality, subSamp);
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    writeMarkers (&cinfo);
+
     // write image data
     int rowlen = width * 3;
     unsigned char *row = new unsigned char [rowlen];
@@ -1476,7 +2184,7 @@ int ImageIO::saveTIFF (const Glib::ustring &fname, int bps, bool isFloat, bool u
     TIFFSetField (out, TIFFTAG_IMAGELENGTH, height);
     TIFFSetField (out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
     TIFFSetField (out, TIFFTAG_SAMPLESPERPIXEL, 3);
-    TIFFSetField (out, TIFFTAG_ROWSPERSTRIP, height);
+    TIFFSetField (out, TIFFTAG_ROWSPERSTRIP, uncompressed ? height : std::min (height, tiffStripRows));
     TIFFSetField (out, TIFFTAG_BITSPERSAMPLE, bps);
     TIFFSetField (out, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
     TIFFSetField (out, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
@@ -1503,39 +2211,71 @@ int ImageIO::saveTIFF (const Glib::ustring &fname, int bps, bool isFloat, bool u
         TIFFSetField (out, TIFFTAG_ICCPROFILE, profileLength, profileData);
     }
 
-    for (int row = 0; row < height; row++) {
-        getScanline (row, linebuffer, bps, isFloat);
+    if (uncompressed) {
+        for (int row = 0; row < height; row++) {
+            getScanline (row, linebuffer, bps, isFloat);
 
-        if (bps == 16) {
-            if(needsReverse && !uncompressed && isFloat) {
-                for(int i = 0; i < lineWidth; i += 2) {
-                    char temp = linebuffer[i];
-                    linebuffer[i] = linebuffer[i + 1];
-                    linebuffer[i + 1] = temp;
-                }
+            if (TIFFWriteScanline (out, linebuffer, row, 0) < 0) {
+                TIFFClose (out);
+                delete [] linebuffer;
+                return IMIO_CANNOTWRITEFILE;
             }
-        } else if (bps == 32) {
-            if(needsReverse && !uncompressed) {
-                for(int i = 0; i < lineWidth; i += 4) {
-                    char temp = linebuffer[i];
-                    linebuffer[i] = linebuffer[i + 3];
-                    linebuffer[i + 3] = temp;
-                    temp = linebuffer[i + 1];
-                    linebuffer[i + 1] = linebuffer[i + 2];
-                    linebuffer[i + 2] = temp;
+
+            if (pl && !(row % 100)) {
+                pl->setProgress ((double)(row + 1) / height);
+            }
+        }
+    } else {
+        // The strips are predicted and compressed in parallel, here rather than by libtiff, and written in order
+        const bool floatPredictor = (bps == 16 || bps == 32) && isFloat;
+        const bool byteSwapped = TIFFIsByteSwapped (out);
+        const int strips = (height + tiffStripRows - 1) / tiffStripRows;
+        bool stripsOk = true;
+
+#ifdef _OPENMP
+        #pragma omp parallel
+#endif
+        {
+            std::vector<unsigned char> scanline (lineWidth);
+            std::vector<unsigned char> planes (floatPredictor ? lineWidth : 0);
+            std::vector<unsigned char> strip (static_cast<size_t>(tiffStripRows) * lineWidth);
+            std::vector<unsigned char> compressed (compressBound (strip.size()));
+
+#ifdef _OPENMP
+            #pragma omp for ordered schedule(dynamic)
+#endif
+            for (int s = 0; s < strips; ++s) {
+                const int firstRow = s * tiffStripRows;
+                const int rows = std::min (tiffStripRows, height - firstRow);
+
+                for (int row = 0; row < rows; ++row) {
+                    getScanline (firstRow + row, scanline.data(), bps, isFloat);
+                    predictTiffRow (scanline.data(), strip.data() + static_cast<size_t>(row) * lineWidth, planes.data(), lineWidth, bps, floatPredictor, byteSwapped);
+                }
+
+                uLongf compressedSize = compressed.size();
+                const bool compressOk = compress2 (compressed.data(), &compressedSize, strip.data(), static_cast<uLong>(rows) * lineWidth, Z_DEFAULT_COMPRESSION) == Z_OK;
+
+#ifdef _OPENMP
+                #pragma omp ordered
+#endif
+                {
+                    if (stripsOk && (!compressOk || TIFFWriteRawStrip (out, s, compressed.data(), compressedSize) < 0)) {
+                        stripsOk = false;
+                    }
+
+                    if (pl && !(s % 4)) {
+                        pl->setProgress ((double)(firstRow + rows) / height);
+                    }
                 }
             }
         }
 
-        if (TIFFWriteScanline (out, linebuffer, row, 0) < 0) {
+        if (!stripsOk) {
             TIFFClose (out);
             delete [] linebuffer;
             return IMIO_CANNOTWRITEFILE;
         }
-
-        if (pl && !(row % 100)) {
-            pl->setProgress ((double)(row + 1) / height);
-        }
     }
 
     if (TIFFFlush(out) != 1) {
@@ -109,7 +109,9 @@ public:
     static int getPNGSampleFormat (const Glib::ustring &fname, IIOSampleFormat &sFormat, IIOSampleArrangement &sArrangement);
     static int getTIFFSampleFormat (const Glib::ustring &fname, IIOSampleFormat &sFormat, IIOSampleArrangement &sArrangement);
 
-    int loadJPEGFromMemory (const char* buffer, int bufsize);
+    // Decodes at the smallest DCT scaling of libjpeg (1/8 to 1/1) giving at least minWidth x minHeight,
+    // fullWidth and fullHeight receiving the size of the JPEG before scaling if not null
+    int loadJPEGFromMemory (const char* buffer, int bufsize, int minWidth = 0, int minHeight = 0, int* fullWidth = nullptr, int* fullHeight = nullptr);
     int loadPPMFromMemory(const char* buffer, int width, int height, bool swap, int bps);
 
     int savePNG (const Glib::ustring &fname, int bps = -1) const;
@@ -40,6 +40,7 @@
 #include "guidedfilter.h"
 
 #include "../rtgui/options.h"
+#include "pipelinetrace.h"
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -184,6 +185,8 @@ ImProcCoordinator::ImProcCoordinator() :
     customTransformIn(nullptr),
     customTransformOut(nullptr),
     ipf(params.get(), true),
+    labStageCache(6),
+    oprevlVersion(0),
 
     // Locallab
     locallListener(nullptr),
@@ -288,6 +291,7 @@ DetailedCrop* ImProcCoordinator::createCrop(::EditDataProvider *editDataProvider
 // todo: bitmask containing desired actions, taken from changesSinceLast
 void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
 {
+    TRACEFUN
     // TODO Locallab printf
 
     MyMutex::MyLock processingLock(mProcessing);
@@ -944,6 +948,7 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
                 DCPProfileApplyState as;
                 DCPProfile *dcpProf = imgsrc->getDCP(params->icm, as);
 
+                ++oprevlVersion;
                 ipf.rgbProc(oprevi, oprevl, nullptr, hltonecurve, shtonecurve, tonecurve, params->toneCurve.saturation,
                             rCurve, gCurve, bCurve, colourToningSatLimit, colourToningSatLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, beforeToneCurveBW, afterToneCurveBW, rrm, ggm, bbm, bwAutoR, bwAutoG, bwAutoB, params->toneCurve.expcomp, params->toneCurve.hlcompr, params->toneCurve.hlcomprthresh, dcpProf, as, histToneCurve);
 
@@ -1012,7 +1017,23 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
         //scale = 1;
 
         if ((todo & (M_LUMINANCE + M_COLOR)) || (todo & M_AUTOEXP)) {
-            nprevl->CopyFrom(oprevl);
+            // Local adjustments come first and report to their listeners, so they disable the reuse of the next stages
+            const bool useStageCache = !(params->locallab.enabled && !params->locallab.spots.empty());
+            const LabStageCache::Stage cachedStage =
+                useStageCache
+                    ? labStageCache.restore(oprevlVersion, scale, *params, nprevl, histCCurve, histLCurve)
+                    : LabStageCache::NONE;
+            const auto storeStage =
+                [this, useStageCache](LabStageCache::Stage stage)
+                {
+                    if (useStageCache) {
+                        labStageCache.store(stage, oprevlVersion, scale, *params, nprevl, histCCurve, histLCurve);
+                    }
+                };
+
+            if (cachedStage == LabStageCache::NONE) {
+                nprevl->CopyFrom(oprevl);
+            }
 
             //  int maxspot = 1;
             //*************************************************************
@@ -1257,25 +1278,39 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
             // end locallab
             //*************************************************************
 
-            histCCurve.clear();
-            histLCurve.clear();
-            ipf.chromiLuminanceCurve(nullptr, pW, nprevl, nprevl, chroma_acurve, chroma_bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, histCCurve, histLCurve);
-            ipf.vibrance(nprevl, params->vibrance, params->toneCurve.hrenabled, params->icm.workingProfile);
-            ipf.labColorCorrectionRegions(nprevl);
+            // Each stage result is stored only when the stage changed the image
+            if (cachedStage < LabStageCache::CHROMILUMINANCE) {
+                histCCurve.clear();
+                histLCurve.clear();
+                ipf.chromiLuminanceCurve(nullptr, pW, nprevl, nprevl, chroma_acurve, chroma_bcurve, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, histCCurve, histLCurve);
+                storeStage(LabStageCache::CHROMILUMINANCE);
+            }
+
+            if (cachedStage < LabStageCache::VIBRANCE && params->vibrance.enabled) {
+                ipf.vibrance(nprevl, params->vibrance, params->toneCurve.hrenabled, params->icm.workingProfile);
+                storeStage(LabStageCache::VIBRANCE);
+            }
+
+            if (cachedStage < LabStageCache::COLOR_REGIONS && params->colorToning.enabled && params->colorToning.method == "LabRegions") {
+                ipf.labColorCorrectionRegions(nprevl);
+                storeStage(LabStageCache::COLOR_REGIONS);
+            }
 
-            if ((params->colorappearance.enabled && !params->colorappearance.tonecie) || (!params->colorappearance.enabled)) {
+            if (cachedStage < LabStageCache::EPD && params->epd.enabled && ((params->colorappearance.enabled && !params->colorappearance.tonecie) || (!params->colorappearance.enabled))) {
                 ipf.EPDToneMap(nprevl, 0, scale);
+                storeStage(LabStageCache::EPD);
             }
 
-            if (params->dirpyrequalizer.cbdlMethod == "aft") {
+            if (cachedStage < LabStageCache::CBDL && params->dirpyrequalizer.enabled && params->dirpyrequalizer.cbdlMethod == "aft") {
                 if (((params->colorappearance.enabled && !settings->autocielab) || (!params->colorappearance.enabled))) {
                     ipf.dirpyrequalizer(nprevl, scale);
+                    storeStage(LabStageCache::CBDL);
                 }
             }
 
             wavcontlutili = CurveFactory::diagonalCurve2Lut(params->wavelet.wavclCurve, wavclCurve, scale == 1 ? 1 : 16);
 
-            if ((params->wavelet.enabled)) {
+            if (cachedStage < LabStageCache::WAVELET && params->wavelet.enabled) {
                 WaveletParams WaveParams = params->wavelet;
                 WaveParams.getCurves(wavCLVCurve, wavdenoise, wavdenoiseh, wavblcurve, waOpacityCurveRG, waOpacityCurveSH, waOpacityCurveBY, waOpacityCurveW, waOpacityCurveWL);
                 int kall = 0;
@@ -1481,10 +1516,14 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
 
 
                 }
-               
+
+                storeStage(LabStageCache::WAVELET);
             }
 
-            ipf.softLight(nprevl, params->softlight);
+            if (cachedStage < LabStageCache::SOFTLIGHT && params->softlight.enabled && params->softlight.strength) {
+                ipf.softLight(nprevl, params->softlight);
+                storeStage(LabStageCache::SOFTLIGHT);
+            }
 
             if (params->colorappearance.enabled) {
                 // L histo  and Chroma histo for ciecam
@@ -1720,6 +1759,8 @@ void ImProcCoordinator::setScale(int prevscale)
         oprevi = orig_prev;
         oprevl = new LabImage(pW, pH);
         nprevl = new LabImage(pW, pH);
+        ++oprevlVersion;
+        labStageCache.clear();
 
         //ncie is only used in ImProcCoordinator::updatePreviewImage, it will be allocated on first use and deleted if not used anymore
         previmg = new Image8(pW, pH);
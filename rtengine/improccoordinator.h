@@ -26,6 +26,7 @@
 #include "dcrop.h"
 #include "imagesource.h"
 #include "improcfun.h"
+#include "labstagecache.h"
 #include "LUT.h"
 #include "rtengine.h"
 
@@ -234,6 +235,8 @@ protected:
     cmsHTRANSFORM customTransformIn;
     cmsHTRANSFORM customTransformOut;
     ImProcFunctions ipf;
+    LabStageCache labStageCache;  // Lab stages of the preview, reused while their inputs don't change
+    unsigned int oprevlVersion;   // changes each time oprevl is recomputed
     
     //locallab
     LocallabListener* locallListener;
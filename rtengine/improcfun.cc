@@ -40,6 +40,7 @@
 #include "imagesource.h"
 #include "improcfun.h"
 #include "labimage.h"
+#include "opthelper.h"
 #include "pipettebuffer.h"
 #include "procparams.h"
 #include "rt_math.h"
@@ -50,6 +51,7 @@
 #include "utils.h"
 
 #include "../rtgui/editcallbacks.h"
+#include "pipelinetrace.h"
 
 namespace {
 
@@ -255,6 +257,32 @@ void customToneCurve(const ToneCurve &customToneCurve, ToneCurveMode curveMode,
     }
 }
 
+// Composes per-channel curves applied one after the other into a single LUT per channel
+// Returns false when an intermediate curve leaves [0, 65535]: the next curve would then be skipped for some
+// colours, which a composed LUT can't reproduce
+bool fuseChannelCurves(const std::vector<const LUTf*> (&chains)[3], LUTf (&fused)[3])
+{
+    for (int c = 0; c < 3; ++c) {
+        fused[c](65536, LUT_CLIP_BELOW | LUT_CLIP_ABOVE);
+
+        for (int i = 0; i < 65536; ++i) {
+            float val = i;
+
+            for (size_t k = 0; k < chains[c].size(); ++k) {
+                if (k > 0 && OOG(val)) {
+                    return false;
+                }
+
+                val = (*chains[c][k])[val];
+            }
+
+            fused[c][i] = val;
+        }
+    }
+
+    return true;
+}
+
 void fillEditFloat(float *editIFloatTmpR, float *editIFloatTmpG, float *editIFloatTmpB, float *rtemp, float *gtemp, float *btemp, int istart, int tH, int jstart, int tW, int tileSize)
 {
     for (int i = istart, ti = 0; i < tH; i++, ti++) {
@@ -435,6 +463,7 @@ void ImProcFunctions::updateColorProfiles(const Glib::ustring& monitorProfile, R
 
 void ImProcFunctions::firstAnalysis(const Imagefloat* const original, const ProcParams &params, LUTu & histogram)
 {
+    TRACEFUN
 
     TMatrix wprof = ICCStore::getInstance()->workingSpaceMatrix (params.icm.workingProfile);
 
@@ -506,6 +535,7 @@ void ImProcFunctions::ciecam_02float(CieImage* ncie, float adap, int pW, int pwb
                                      LUTu & histLCAM, LUTu & histCCAM, LUTf & CAMBrightCurveJ, LUTf & CAMBrightCurveQ, float &mean, int Iterates, int scale, bool execsharp, float &d, float &dj, float &yb, int rtt,
                                      bool showSharpMask)
 {
+    TRACEFUN
     if (params->colorappearance.enabled) {
         //preparate for histograms CIECAM
         LUTu hist16JCAM;
@@ -2027,6 +2057,7 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
                                double &rrm, double &ggm, double &bbm, float &autor, float &autog, float &autob, double expcomp, int hlcompr, int hlcomprthresh,
                                DCPProfile *dcpProf, const DCPProfileApplyState& asIn, LUTu& histToneCurve, size_t chunkSize, bool measure)
 {
+    TRACEFUN
 
     std::unique_ptr<StopWatch> stop;
 
@@ -2346,6 +2377,46 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
         histToneCurveCompression = log2(65536 / toneCurveHistSize);
     }
 
+    // The tone curve, the custom tone curves in standard mode and the RGB curves in normal mode map each channel
+    // independently, and none of them applies to colours that are out of gamut in all three channels. They are
+    // composed into one LUT per channel, which saves a pass over each tile for each curve.
+    const bool rgbCurvesEnabled = params->rgbCurves.enabled && (rCurve || gCurve || bCurve);
+    LUTf fusedCurves[3];
+    bool curvesFused =
+        (hasToneCurve1 || hasToneCurve2 || rgbCurvesEnabled)
+        && (!hasToneCurve1 || curveMode == ToneCurveMode::STD)
+        && (!hasToneCurve2 || curveMode2 == ToneCurveMode::STD)
+        && (!rgbCurvesEnabled || !params->rgbCurves.lumamode)
+        && editID != EUID_ToneCurve1 && editID != EUID_ToneCurve2
+        && editID != EUID_RGB_R && editID != EUID_RGB_G && editID != EUID_RGB_B;
+
+    if (curvesFused) {
+        std::vector<const LUTf*> chains[3];
+        const LUTf* const channelCurves[3] = {&rCurve, &gCurve, &bCurve};
+
+        for (int c = 0; c < 3; ++c) {
+            chains[c].push_back(&tonecurve);
+
+            if (hasToneCurve1) {
+                chains[c].push_back(&customToneCurve1.lutToneCurve);
+            }
+
+            if (hasToneCurve2) {
+                chains[c].push_back(&customToneCurve2.lutToneCurve);
+            }
+
+            if (rgbCurvesEnabled && *channelCurves[c]) {
+                chains[c].push_back(channelCurves[c]);
+            }
+        }
+
+        curvesFused = fuseChannelCurves(chains, fusedCurves);
+    }
+
+    const LUTf& rToneCurve = curvesFused ? fusedCurves[0] : tonecurve;
+    const LUTf& gToneCurve = curvesFused ? fusedCurves[1] : tonecurve;
+    const LUTf& bToneCurve = curvesFused ? fusedCurves[2] : tonecurve;
+
     // For tonecurve histogram
     const float lumimulf[3] = {static_cast<float>(lumimul[0]), static_cast<float>(lumimul[1]), static_cast<float>(lumimul[2])};
 
@@ -2475,9 +2546,9 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
                         for (int j = jstart, tj = 0; j < tW; j++, tj++) {
 
                             //brightness/contrast
-                            float r = tonecurve[ CLIP(rtemp[ti * TS + tj]) ];
-                            float g = tonecurve[ CLIP(gtemp[ti * TS + tj]) ];
-                            float b = tonecurve[ CLIP(btemp[ti * TS + tj]) ];
+                            float r = rToneCurve[ CLIP(rtemp[ti * TS + tj]) ];
+                            float g = gToneCurve[ CLIP(gtemp[ti * TS + tj]) ];
+                            float b = bToneCurve[ CLIP(btemp[ti * TS + tj]) ];
 
                             int y = CLIP<int> (lumimulf[0] * Color::gamma2curve[rtemp[ti * TS + tj]] + lumimulf[1] * Color::gamma2curve[gtemp[ti * TS + tj]] + lumimulf[2] * Color::gamma2curve[btemp[ti * TS + tj]]);
                             histToneCurveThr[y >> histToneCurveCompression]++;
@@ -2495,9 +2566,9 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
 
                         for (; j < tW - 3; j+=4, tj+=4) {
                             //brightness/contrast
-                            STVF(tmpr[0], tonecurve(LVF(rtemp[ti * TS + tj])));
-                            STVF(tmpg[0], tonecurve(LVF(gtemp[ti * TS + tj])));
-                            STVF(tmpb[0], tonecurve(LVF(btemp[ti * TS + tj])));
+                            STVF(tmpr[0], rToneCurve(LVF(rtemp[ti * TS + tj])));
+                            STVF(tmpg[0], gToneCurve(LVF(gtemp[ti * TS + tj])));
+                            STVF(tmpb[0], bToneCurve(LVF(btemp[ti * TS + tj])));
 
                             for (int k = 0; k < 4; ++k) {
                                 setUnlessOOG(rtemp[ti * TS + tj + k], gtemp[ti * TS + tj + k], btemp[ti * TS + tj + k], tmpr[k], tmpg[k], tmpb[k]);
@@ -2508,7 +2579,7 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
 
                         for (; j < tW; j++, tj++) {
                             //brightness/contrast
-                            setUnlessOOG(rtemp[ti * TS + tj], gtemp[ti * TS + tj], btemp[ti * TS + tj], tonecurve[rtemp[ti * TS + tj]], tonecurve[gtemp[ti * TS + tj]], tonecurve[btemp[ti * TS + tj]]);
+                            setUnlessOOG(rtemp[ti * TS + tj], gtemp[ti * TS + tj], btemp[ti * TS + tj], rToneCurve[rtemp[ti * TS + tj]], gToneCurve[gtemp[ti * TS + tj]], bToneCurve[btemp[ti * TS + tj]]);
                         }
                     }
                 }
@@ -2517,7 +2588,7 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
                     fillEditFloat(editIFloatTmpR, editIFloatTmpG, editIFloatTmpB, rtemp, gtemp, btemp, istart, tH, jstart, tW, TS);
                 }
 
-                if (hasToneCurve1) {
+                if (hasToneCurve1 && !curvesFused) {
                     customToneCurve(customToneCurve1, curveMode, rtemp, gtemp, btemp, istart, tH, jstart, tW, TS, ptc1ApplyState);
                 }
 
@@ -2525,7 +2596,7 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
                     fillEditFloat(editIFloatTmpR, editIFloatTmpG, editIFloatTmpB, rtemp, gtemp, btemp, istart, tH, jstart, tW, TS);
                 }
 
-                if (hasToneCurve2) {
+                if (hasToneCurve2 && !curvesFused) {
                     customToneCurve(customToneCurve2, curveMode2, rtemp, gtemp, btemp, istart, tH, jstart, tW, TS, ptc2ApplyState);
                 }
 
@@ -2549,7 +2620,7 @@ void ImProcFunctions::rgbProc (Imagefloat* working, LabImage* lab, PipetteBuffer
                     }
                 }
 
-                if (params->rgbCurves.enabled && (rCurve || gCurve || bCurve)) { // if any of the RGB curves is engaged
+                if (rgbCurvesEnabled && !curvesFused) { // if any of the RGB curves is engaged
                     if (!params->rgbCurves.lumamode) { // normal RGB mode
 
                         for (int i = istart, ti = 0; i < tH; i++, ti++) {
@@ -4134,6 +4205,7 @@ void ImProcFunctions::luminanceCurve (LabImage* lold, LabImage* lnew, const LUTf
 
 void ImProcFunctions::chromiLuminanceCurve (PipetteBuffer *pipetteBuffer, int pW, LabImage* lold, LabImage* lnew, const LUTf& acurve, const LUTf& bcurve, const LUTf& satcurve, const LUTf& lhskcurve, const LUTf& clcurve, LUTf & curve, bool utili, bool autili, bool butili, bool ccutili, bool cclutili, bool clcutili, LUTu &histCCurve, LUTu &histLCurve)
 {
+    TRACEFUN
     int W = lold->W;
     int H = lold->H;
 
@@ -4983,6 +5055,7 @@ void ImProcFunctions::chromiLuminanceCurve (PipetteBuffer *pipetteBuffer, int pW
 
 void ImProcFunctions::impulsedenoise(LabImage* lab)
 {
+    TRACEFUN
 
     if (params->impulseDenoise.enabled && lab->W >= 8 && lab->H >= 8)
 
@@ -4991,6 +5064,62 @@ void ImProcFunctions::impulsedenoise(LabImage* lab)
     }
 }
 
+int ImProcFunctions::getBandHalo(const procparams::ProcParams& params)
+{
+    // The recursive gaussian blurs only settle to the rounding noise of the whole image after about 7 sigma
+    const auto blurHalo =
+        [](double sigma)
+        {
+            return static_cast<int>(std::ceil(7.0 * sigma));
+        };
+
+    // buildBlendMask() takes a gradient over +-2 rows and blurs it with a sigma of 2
+    const int maskHalo = 2 + blurHalo(2.0);
+
+    int halo = 0;
+
+    if (params.impulseDenoise.enabled) {
+        // impulse_nr(): blur, then the impulses are detected over +-2 rows and replaced from +-2 rows
+        halo += blurHalo(std::max(2.0, params.impulseDenoise.thresh / 20.0 - 1.0)) + 4;
+    }
+
+    if (params.sharpenEdge.enabled) {
+        halo += 2 * params.sharpenEdge.passes;
+    }
+
+    if (params.sharpenMicro.enabled) {
+        halo += std::max(params.sharpenMicro.contrast > 0 ? maskHalo : 0, 2 + (params.sharpenMicro.matrix ? 1 : 2));
+    }
+
+    if (params.sharpening.enabled) {
+        const procparams::SharpeningParams& sharpening = params.sharpening;
+        // the blend mask, the blur and the sharpening all start from the same L channel
+        int sharpenHalo = sharpening.contrast > 0 ? maskHalo : 0;
+
+        if (sharpening.blurradius >= 0.25) {
+            sharpenHalo = std::max(sharpenHalo, blurHalo(sharpening.blurradius));
+        }
+
+        if (sharpening.method == "rld") {
+            // two dependent blurs per iteration
+            sharpenHalo = std::max(sharpenHalo, 2 * sharpening.deconviter * blurHalo(sharpening.deconvradius));
+        } else {
+            int usmHalo = blurHalo(sharpening.radius) + 2; // blur, then the +-2 rows of the halo control
+
+            if (sharpening.edgesonly) {
+                // the bilateral filter before the blur has kernels of up to 11x11
+                usmHalo += std::min(5, static_cast<int>(std::ceil(2.0 * sharpening.edges_radius)));
+            }
+
+            sharpenHalo = std::max(sharpenHalo, usmHalo);
+        }
+
+        halo += sharpenHalo;
+    }
+
+    return halo;
+}
+
 void ImProcFunctions::impulsedenoisecam(CieImage* ncie, float **buffers[3])
 {
 
@@ -5003,6 +5132,7 @@ void ImProcFunctions::impulsedenoisecam(CieImage* ncie, float **buffers[3])
 
 void ImProcFunctions::defringe(LabImage* lab)
 {
+    TRACEFUN
 
     if (params->defringe.enabled && lab->W >= 8 && lab->H >= 8)
 
@@ -5034,6 +5164,7 @@ void ImProcFunctions::badpixlab(LabImage* lab, double rad, int thr, float chrom)
 
 void ImProcFunctions::dirpyrequalizer(LabImage* lab, int scale)
 {
+    TRACEFUN
     if (params->dirpyrequalizer.enabled && lab->W >= 8 && lab->H >= 8) {
         float b_l = static_cast<float>(params->dirpyrequalizer.hueskin.getBottomLeft()) / 100.f;
         float t_l = static_cast<float>(params->dirpyrequalizer.hueskin.getTopLeft()) / 100.f;
@@ -5252,6 +5383,7 @@ void ImProcFunctions::EPDToneMaplocal(int sp, LabImage *lab, LabImage *tmp1, uns
 //Map tones by way of edge preserving decomposition.
 void ImProcFunctions::EPDToneMap(LabImage *lab, unsigned int Iterates, int skip)
 {
+    TRACEFUN
 
     if (!params->epd.enabled) {
         return;
@@ -5322,6 +5454,7 @@ void ImProcFunctions::EPDToneMap(LabImage *lab, unsigned int Iterates, int skip)
 
 void ImProcFunctions::getAutoExp(const LUTu &histogram, int histcompr, double clip, double& expcomp, int& bright, int& contr, int& black, int& hlcompr, int& hlcomprthresh)
 {
+    TRACEFUN
 
     float scale = 65536.0f;
     float midgray = 0.1842f; //middle gray in linear gamma =1 50% luminance
@@ -5690,6 +5823,7 @@ double ImProcFunctions::getAutoDistor(const Glib::ustring &fname, int thumb_size
     }
 }
 
+TARGET_CLONES
 void ImProcFunctions::rgb2lab(const Imagefloat &src, LabImage &dst, const Glib::ustring &workingSpace)
 {
     TMatrix wprof = ICCStore::getInstance()->workingSpaceMatrix(workingSpace);
@@ -5716,6 +5850,7 @@ void ImProcFunctions::rgb2lab(const Imagefloat &src, LabImage &dst, const Glib::
     }
 }
 
+TARGET_CLONES
 void ImProcFunctions::lab2rgb(const LabImage &src, Imagefloat &dst, const Glib::ustring &workingSpace)
 {
     TMatrix wiprof = ICCStore::getInstance()->workingSpaceInverseMatrix(workingSpace);
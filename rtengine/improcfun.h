@@ -113,7 +113,7 @@ class ImProcFunctions
     void calcVignettingParams(int oW, int oH, const procparams::VignettingParams& vignetting, double &w2, double &h2, double& maxRadius, double &v, double &b, double &mul);
 
     void transformLuminanceOnly(Imagefloat* original, Imagefloat* transformed, int cx, int cy, int oW, int oH, int fW, int fH);
-    void transformGeneral(bool highQuality, Imagefloat *original, Imagefloat *transformed, int cx, int cy, int sx, int sy, int oW, int oH, int fW, int fH, const LensCorrection *pLCPMap, bool useOriginalBuffer);
+    void transformGeneral(bool highQuality, Imagefloat *original, Imagefloat *transformed, int cx, int cy, int sx, int sy, int oW, int oH, int fW, int fH, const LensCorrection *pLCPMap, const FramesMetaData *metadata, int rawRotationDeg, bool useOriginalBuffer);
     void transformLCPCAOnly(Imagefloat *original, Imagefloat *transformed, int cx, int cy, const LensCorrection *pLCPMap, bool useOriginalBuffer);
 
     bool needsCA() const;
@@ -204,6 +204,8 @@ public:
     void MLmicrocontrastcam(CieImage* ncie);   //Manuel's microcontrast
 
     void impulsedenoise(LabImage* lab);   //Emil's impulse denoise
+    // Rows needed on each side of a band for impulsedenoise(), MLsharpen(), MLmicrocontrast() and sharpening() to give the result of the whole image
+    static int getBandHalo(const procparams::ProcParams& params);
     void impulsedenoisecam(CieImage* ncie, float **buffers[3]);
     void impulse_nr(LabImage* lab, double thresh);
     void impulse_nrcam(CieImage* ncie, double thresh, float **buffers[3]);
@@ -29,11 +29,13 @@
 #include "improccoordinator.h"
 #include "dfmanager.h"
 #include "ffmanager.h"
+#include "fftwplans.h"
 #include "rtthumbnail.h"
 #include "profilestore.h"
 #include "../rtgui/threadutils.h"
 #include "rtlensfun.h"
 #include "procparams.h"
+#include "pipelinetrace.h"
 
 namespace rtengine
 {
@@ -46,6 +48,7 @@ MyMutex *fftwMutex = nullptr;
 int init (const Settings* s, const Glib::ustring& baseDir, const Glib::ustring& userSettingsDir, bool loadAll)
 {
     settings = s;
+    PipelineTrace::getInstance().setOutputFile(s->traceFile);
     ProcParams::init();
     PerceptualToneCurve::init();
     RawImageSource::init();
@@ -106,14 +109,17 @@ int init (const Settings* s, const Glib::ustring& baseDir, const Glib::ustring&
     delete lcmsMutex;
     lcmsMutex = new MyMutex;
     fftwMutex = new MyMutex;
+    FFTWPlanCache::getInstance().init();
     return 0;
 }
 
 void cleanup ()
 {
+    PipelineTrace::getInstance().save();
     ProcParams::cleanup ();
     Color::cleanup ();
     RawImageSource::cleanup ();
+    FFTWPlanCache::getInstance().cleanup();
 
 #ifdef RT_FFTW3F_OMP
     fftwf_cleanup_threads();
@@ -45,6 +45,7 @@
 #include "StopWatch.h"
 
 #include "../rtgui/options.h"
+#include "pipelinetrace.h"
 
 namespace rtengine
 {
@@ -303,6 +304,7 @@ void extract_channels(Imagefloat *img, array2D<float> &r, array2D<float> &g, arr
 
 void ImProcFunctions::dehaze(Imagefloat *img, const DehazeParams &dehazeParams)
 {
+    TRACEFUN
     if (!dehazeParams.enabled || dehazeParams.strength == 0.0) {
         return;
     }
@@ -28,6 +28,7 @@
 #include "alignedbuffer.h"
 #include "color.h"
 #include "procparams.h"
+#include "pipelinetrace.h"
 
 namespace rtengine
 {
@@ -82,6 +83,7 @@ inline void copyAndClamp(const LabImage *src, unsigned char *dst, const double r
 // otherwise divide by 327.68, convert to xyz and apply the sRGB transform, before converting with gamma2curve
 void ImProcFunctions::lab2monitorRgb(LabImage* lab, Image8* image)
 {
+    TRACEFUN
     if (monitorTransform) {
 
         const int W = lab->W;
@@ -332,6 +334,7 @@ Imagefloat* ImProcFunctions::lab2rgbOut(LabImage* lab, int cx, int cy, int cw, i
 
 void ImProcFunctions::workingtrc(const Imagefloat* src, Imagefloat* dst, int cw, int ch, int mul, const Glib::ustring &profile, double gampos, double slpos, cmsHTRANSFORM &transform, bool normalizeIn, bool normalizeOut, bool keepTransForm) const
 {
+    TRACEFUN
     const TMatrix wprof = ICCStore::getInstance()->workingSpaceMatrix(params->icm.workingProfile);
 
     const float toxyz[3][3] = {
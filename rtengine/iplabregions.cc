@@ -30,6 +30,7 @@
 
 //#define BENCHMARK
 #include "StopWatch.h"
+#include "pipelinetrace.h"
 
 namespace {
 
@@ -58,6 +59,7 @@ namespace rtengine
 
 void ImProcFunctions::labColorCorrectionRegions(LabImage *lab)
 {
+    TRACEFUN
     if (!params->colorToning.enabled || params->colorToning.method != "LabRegions") {
         return;
     }
@@ -26,6 +26,7 @@
 #include "improcfun.h"
 #include "colortemp.h"
 #include "curves.h"
+#include "fftwplans.h"
 #include "gauss.h"
 #include "iccstore.h"
 #include "imagefloat.h"
@@ -50,6 +51,7 @@
 #define BENCHMARK
 #include "StopWatch.h"
 #include "guidedfilter.h"
+#include "pipelinetrace.h"
 
 
 #pragma GCC diagnostic warning "-Wall"
@@ -3661,12 +3663,6 @@ void ImProcFunctions::retinex_pde(const float * datain, float * dataout, int bfw
      */
 
    // BENCHFUN
-#ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads(omp_get_max_threads());
-    }
-#endif
 
     float *datashow = nullptr;
     if (show != 0) {
@@ -3701,9 +3697,9 @@ void ImProcFunctions::retinex_pde(const float * datain, float * dataout, int bfw
     }
 
     //execute first
-    const auto dct_fw = fftwf_plan_r2r_2d(bfh, bfw, data_tmp, data_fft, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
-    fftwf_execute(dct_fw);
-    fftwf_destroy_plan(dct_fw);
+    FFTWPlanCache& plans = FFTWPlanCache::getInstance();
+    const auto dct_fw = plans.getR2R(bfh, bfw, FFTW_REDFT10, FFTW_REDFT10, data_tmp, data_fft, FFTW_ESTIMATE | FFTW_DESTROY_INPUT, multiThread);
+    fftwf_execute_r2r(dct_fw.get(), data_tmp, data_fft);
 
     //execute second
     if (dEenable == 1) {
@@ -3715,9 +3711,7 @@ void ImProcFunctions::retinex_pde(const float * datain, float * dataout, int bfw
         }
         //second call to laplacian with 40% strength ==> reduce effect if we are far from ref (deltaE)
         discrete_laplacian_threshold(data_tmp04, datain, bfw, bfh, 0.4f * thresh);
-        const auto dct_fw04 = fftwf_plan_r2r_2d(bfh, bfw, data_tmp04, data_fft04, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
-        fftwf_execute(dct_fw04);
-        fftwf_destroy_plan(dct_fw04);
+        fftwf_execute_r2r(dct_fw.get(), data_tmp04, data_fft04);
         constexpr float exponent = 4.5f;
 
 #ifdef _OPENMP
@@ -3765,9 +3759,8 @@ void ImProcFunctions::retinex_pde(const float * datain, float * dataout, int bfw
         }
     }
 
-    const auto dct_bw = fftwf_plan_r2r_2d(bfh, bfw, data_fft, data_tmp, FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
-    fftwf_execute(dct_bw);
-    fftwf_destroy_plan(dct_bw);
+    const auto dct_bw = plans.getR2R(bfh, bfw, FFTW_REDFT01, FFTW_REDFT01, data_fft, data_tmp, FFTW_ESTIMATE | FFTW_DESTROY_INPUT, multiThread);
+    fftwf_execute_r2r(dct_bw.get(), data_fft, data_tmp);
     fftwf_free(data_fft);
 
     if (show != 4 && normalize == 1) {
@@ -3796,13 +3789,6 @@ void ImProcFunctions::retinex_pde(const float * datain, float * dataout, int bfw
     if (datashow) {
         fftwf_free(datashow);
     }
-    fftwf_cleanup();
-
-#ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_cleanup_threads();
-    }
-#endif
 }
 
 void ImProcFunctions::maskcalccol(bool invmask, bool pde, int bfw, int bfh, int xstart, int ystart, int sk, int cx, int cy, LabImage* bufcolorig, LabImage* bufmaskblurcol, LabImage* originalmaskcol, LabImage* original, LabImage* reserved, int inv, struct local_params & lp,
@@ -5605,6 +5591,7 @@ void ImProcFunctions::InverseColorLight_Local(bool tonequ, bool tonecurv, int sp
 
 void ImProcFunctions::calc_ref(int sp, LabImage * original, LabImage * transformed, int cx, int cy, int oW, int oH, int sk, double & huerefblur, double & chromarefblur, double & lumarefblur, double & hueref, double & chromaref, double & lumaref, double & sobelref, float & avg, const LocwavCurve & locwavCurveden, bool locwavdenutili)
 {
+    TRACEFUN
     if (params->locallab.enabled) {
         //always calculate hueref, chromaref, lumaref  before others operations use in normal mode for all modules exceprt denoise
         struct local_params lp;
@@ -6406,13 +6393,6 @@ void ImProcFunctions::exposure_pde(float * dataor, float * datain, float * datao
 {
 
     //BENCHFUN
-#ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads(omp_get_max_threads());
-    }
-
-#endif
     float *data_fft, *data_tmp, *data;
 
     if (NULL == (data_tmp = (float *) fftwf_malloc(sizeof(float) * bfw * bfh))) {
@@ -6432,8 +6412,9 @@ void ImProcFunctions::exposure_pde(float * dataor, float * datain, float * datao
         abort();
     }
 
-    const auto dct_fw = fftwf_plan_r2r_2d(bfh, bfw, data_tmp, data_fft, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
-    fftwf_execute(dct_fw);
+    FFTWPlanCache& plans = FFTWPlanCache::getInstance();
+    const auto dct_fw = plans.getR2R(bfh, bfw, FFTW_REDFT10, FFTW_REDFT10, data_tmp, data_fft, FFTW_ESTIMATE | FFTW_DESTROY_INPUT, multiThread);
+    fftwf_execute_r2r(dct_fw.get(), data_tmp, data_fft);
 
     fftwf_free(data_tmp);
 
@@ -6441,18 +6422,9 @@ void ImProcFunctions::exposure_pde(float * dataor, float * datain, float * datao
     /* 1. / (float) (bfw * bfh)) is the DCT normalisation term, see libfftw */
     ImProcFunctions::rex_poisson_dct(data_fft, bfw, bfh, 1. / (double)(bfw * bfh));
 
-    const auto dct_bw = fftwf_plan_r2r_2d(bfh, bfw, data_fft, data, FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE | FFTW_DESTROY_INPUT);
-    fftwf_execute(dct_bw);
-    fftwf_destroy_plan(dct_fw);
-    fftwf_destroy_plan(dct_bw);
+    const auto dct_bw = plans.getR2R(bfh, bfw, FFTW_REDFT01, FFTW_REDFT01, data_fft, data, FFTW_ESTIMATE | FFTW_DESTROY_INPUT, multiThread);
+    fftwf_execute_r2r(dct_bw.get(), data_fft, data);
     fftwf_free(data_fft);
-    fftwf_cleanup();
-
-#ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_cleanup_threads();
-    }
-#endif
 
     normalize_mean_dt(data, dataor, bfw * bfh, mod, 1.f);
     {
@@ -6492,19 +6464,11 @@ void ImProcFunctions::fftw_convol_blur(float * input, float * output, int bfw, i
     */
     //BENCHFUN
 
-#ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads(omp_get_max_threads());
-    }
-#endif
 
 
     float *out; //for FFT data
     float *kern = nullptr;//for kernel gauss
     float *outkern = nullptr;//for FFT kernel
-    fftwf_plan p;
-    fftwf_plan pkern;//plan for FFT
     int image_size, image_sizechange;
     float n_x = 1.f;
     float n_y = 1.f;//relative coordinates for kernel Gauss
@@ -6520,10 +6484,9 @@ void ImProcFunctions::fftw_convol_blur(float * input, float * output, int bfw, i
 
     /*compute the Fourier transform of the input data*/
 
-    p = fftwf_plan_r2r_2d(bfh, bfw, input, out, FFTW_REDFT10, FFTW_REDFT10,  FFTW_ESTIMATE);//FFT 2 dimensions forward  FFTW_MEASURE FFTW_ESTIMATE
-
-    fftwf_execute(p);
-    fftwf_destroy_plan(p);
+    FFTWPlanCache& plans = FFTWPlanCache::getInstance();
+    const auto p = plans.getR2R(bfh, bfw, FFTW_REDFT10, FFTW_REDFT10, input, out, FFTW_ESTIMATE, multiThread);//FFT 2 dimensions forward
+    fftwf_execute_r2r(p.get(), input, out);
 
     /*define the gaussian constants for the convolution kernel*/
     if (algo == 0) {
@@ -6557,9 +6520,7 @@ void ImProcFunctions::fftw_convol_blur(float * input, float * output, int bfw, i
         }
 
         /*compute the Fourier transform of the kernel data*/
-        pkern = fftwf_plan_r2r_2d(bfh, bfw, kern, outkern, FFTW_REDFT10, FFTW_REDFT10, FFTW_ESTIMATE); //FFT 2 dimensions forward
-        fftwf_execute(pkern);
-        fftwf_destroy_plan(pkern);
+        fftwf_execute_r2r(p.get(), kern, outkern); //FFT 2 dimensions forward
 
 #ifdef _OPENMP
         #pragma omp parallel for if (multiThread)
@@ -6603,8 +6564,8 @@ void ImProcFunctions::fftw_convol_blur(float * input, float * output, int bfw, i
         }
     }
 
-    p = fftwf_plan_r2r_2d(bfh, bfw, out, output, FFTW_REDFT01, FFTW_REDFT01, FFTW_ESTIMATE);//FFT 2 dimensions backward
-    fftwf_execute(p);
+    const auto pback = plans.getR2R(bfh, bfw, FFTW_REDFT01, FFTW_REDFT01, out, output, FFTW_ESTIMATE, multiThread);//FFT 2 dimensions backward
+    fftwf_execute_r2r(pback.get(), out, output);
 
 #ifdef _OPENMP
     #pragma omp parallel for if (multiThread)
@@ -6613,14 +6574,7 @@ void ImProcFunctions::fftw_convol_blur(float * input, float * output, int bfw, i
         output[index] /= image_sizechange;
     }
 
-    fftwf_destroy_plan(p);
     fftwf_free(out);
-
-#ifdef RT_FFTW3F_OMP
-    if (multiThread) {
-        fftwf_cleanup_threads();
-    }
-#endif
 }
 
 void ImProcFunctions::fftw_convol_blur2(float **input2, float **output2, int bfw, int bfh, float radius, int fftkern, int algo)
@@ -6670,28 +6624,19 @@ void ImProcFunctions::fftw_tile_blur(int GW, int GH, int tilssize, int max_numbl
 {
     //BENCHFUN
     float epsil = 0.001f / (tilssize * tilssize);
-    fftwf_plan plan_forward_blox[2];
-    fftwf_plan plan_backward_blox[2];
+    FFTWPlanCache::Plan plan_forward_blox[2];
+    FFTWPlanCache::Plan plan_backward_blox[2];
 
     array2D<float> tilemask_in(tilssize, tilssize);
     array2D<float> tilemask_out(tilssize, tilssize);
 
-    float *Lbloxtmp  = reinterpret_cast<float*>(fftwf_malloc(max_numblox_W * tilssize * tilssize * sizeof(float)));
-    float *fLbloxtmp = reinterpret_cast<float*>(fftwf_malloc(max_numblox_W * tilssize * tilssize * sizeof(float)));
-
-    int nfwd[2] = {tilssize, tilssize};
-
-    //for DCT:
-    fftw_r2r_kind fwdkind[2] = {FFTW_REDFT10, FFTW_REDFT10};
-    fftw_r2r_kind bwdkind[2] = {FFTW_REDFT01, FFTW_REDFT01};
 
-    // Creating the plans with FFTW_MEASURE instead of FFTW_ESTIMATE speeds up the execute a bit
-    plan_forward_blox[0]  = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, Lbloxtmp, nullptr, 1, tilssize * tilssize, fLbloxtmp, nullptr, 1, tilssize * tilssize, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_backward_blox[0] = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, fLbloxtmp, nullptr, 1, tilssize * tilssize, Lbloxtmp, nullptr, 1, tilssize * tilssize, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_forward_blox[1]  = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, Lbloxtmp, nullptr, 1, tilssize * tilssize, fLbloxtmp, nullptr, 1, tilssize * tilssize, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_backward_blox[1] = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, fLbloxtmp, nullptr, 1, tilssize * tilssize, Lbloxtmp, nullptr, 1, tilssize * tilssize, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    fftwf_free(Lbloxtmp);
-    fftwf_free(fLbloxtmp);
+    // Measured plans speed up the execute a bit, the cache and the wisdom make their creation cheap after the first image
+    FFTWPlanCache& plans = FFTWPlanCache::getInstance();
+    plan_forward_blox[0]  = plans.getR2R(tilssize, tilssize, FFTW_REDFT10, FFTW_REDFT10, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, max_numblox_W);
+    plan_backward_blox[0] = plans.getR2R(tilssize, tilssize, FFTW_REDFT01, FFTW_REDFT01, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, max_numblox_W);
+    plan_forward_blox[1]  = plans.getR2R(tilssize, tilssize, FFTW_REDFT10, FFTW_REDFT10, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, min_numblox_W);
+    plan_backward_blox[1] = plans.getR2R(tilssize, tilssize, FFTW_REDFT01, FFTW_REDFT01, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, min_numblox_W);
     const int border = rtengine::max(2, tilssize / 16);
 
     for (int i = 0; i < tilssize; ++i) {
@@ -6797,9 +6742,9 @@ void ImProcFunctions::fftw_tile_blur(int GW, int GH, int tilssize, int max_numbl
 
             //fftwf_print_plan (plan_forward_blox);
             if (numblox_W == max_numblox_W) {
-                fftwf_execute_r2r(plan_forward_blox[0], Lblox, fLblox);    // DCT an entire row of tiles
+                fftwf_execute_r2r(plan_forward_blox[0].get(), Lblox, fLblox);    // DCT an entire row of tiles
             } else {
-                fftwf_execute_r2r(plan_forward_blox[1], Lblox, fLblox);    // DCT an entire row of tiles
+                fftwf_execute_r2r(plan_forward_blox[1].get(), Lblox, fLblox);    // DCT an entire row of tiles
             }
 
             const float n_xy = rtengine::SQR(rtengine::RT_PI / tilssize);
@@ -6819,9 +6764,9 @@ void ImProcFunctions::fftw_tile_blur(int GW, int GH, int tilssize, int max_numbl
 
             //now perform inverse FT of an entire row of blocks
             if (numblox_W == max_numblox_W) {
-                fftwf_execute_r2r(plan_backward_blox[0], fLblox, Lblox);    //for DCT
+                fftwf_execute_r2r(plan_backward_blox[0].get(), fLblox, Lblox);    //for DCT
             } else {
-                fftwf_execute_r2r(plan_backward_blox[1], fLblox, Lblox);    //for DCT
+                fftwf_execute_r2r(plan_backward_blox[1].get(), fLblox, Lblox);    //for DCT
             }
 
             int topproc = (vblk - 1) * offset;
@@ -6863,11 +6808,6 @@ void ImProcFunctions::fftw_tile_blur(int GW, int GH, int tilssize, int max_numbl
         fftwf_free(fLbloxArray[i]);
     }
 
-    fftwf_destroy_plan(plan_forward_blox[0]);
-    fftwf_destroy_plan(plan_backward_blox[0]);
-    fftwf_destroy_plan(plan_forward_blox[1]);
-    fftwf_destroy_plan(plan_backward_blox[1]);
-    fftwf_cleanup();
 }
 
 void ImProcFunctions::wavcbd(wavelet_decomposition &wdspot, int level_bl, int maxlvl,
@@ -7968,29 +7908,20 @@ void ImProcFunctions::fftw_denoise(int GW, int GH, int max_numblox_W, int min_nu
 {
    // BENCHFUN
 
-    fftwf_plan plan_forward_blox[2];
-    fftwf_plan plan_backward_blox[2];
+    FFTWPlanCache::Plan plan_forward_blox[2];
+    FFTWPlanCache::Plan plan_backward_blox[2];
 
     array2D<float> tilemask_in(TS, TS);
     array2D<float> tilemask_out(TS, TS);
 
-    float *Lbloxtmp  = reinterpret_cast<float*>(fftwf_malloc(max_numblox_W * TS * TS * sizeof(float)));
-    float *fLbloxtmp = reinterpret_cast<float*>(fftwf_malloc(max_numblox_W * TS * TS * sizeof(float)));
     float params_Ldetail = 0.f;
 
-    int nfwd[2] = {TS, TS};
-
-    //for DCT:
-    fftw_r2r_kind fwdkind[2] = {FFTW_REDFT10, FFTW_REDFT10};
-    fftw_r2r_kind bwdkind[2] = {FFTW_REDFT01, FFTW_REDFT01};
-
-    // Creating the plans with FFTW_MEASURE instead of FFTW_ESTIMATE speeds up the execute a bit
-    plan_forward_blox[0]  = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_backward_blox[0] = fftwf_plan_many_r2r(2, nfwd, max_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_forward_blox[1]  = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, Lbloxtmp, nullptr, 1, TS * TS, fLbloxtmp, nullptr, 1, TS * TS, fwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    plan_backward_blox[1] = fftwf_plan_many_r2r(2, nfwd, min_numblox_W, fLbloxtmp, nullptr, 1, TS * TS, Lbloxtmp, nullptr, 1, TS * TS, bwdkind, FFTW_MEASURE | FFTW_DESTROY_INPUT);
-    fftwf_free(Lbloxtmp);
-    fftwf_free(fLbloxtmp);
+    // Measured plans speed up the execute a bit, the cache and the wisdom make their creation cheap after the first image
+    FFTWPlanCache& plans = FFTWPlanCache::getInstance();
+    plan_forward_blox[0]  = plans.getR2R(TS, TS, FFTW_REDFT10, FFTW_REDFT10, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, max_numblox_W);
+    plan_backward_blox[0] = plans.getR2R(TS, TS, FFTW_REDFT01, FFTW_REDFT01, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, max_numblox_W);
+    plan_forward_blox[1]  = plans.getR2R(TS, TS, FFTW_REDFT10, FFTW_REDFT10, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, min_numblox_W);
+    plan_backward_blox[1] = plans.getR2R(TS, TS, FFTW_REDFT01, FFTW_REDFT01, nullptr, nullptr, FFTW_MEASURE | FFTW_DESTROY_INPUT, false, min_numblox_W);
     const int border = rtengine::max(2, TS / 16);
 
     for (int i = 0; i < TS; ++i) {
@@ -8105,9 +8036,9 @@ void ImProcFunctions::fftw_denoise(int GW, int GH, int max_numblox_W, int min_nu
 
             //fftwf_print_plan (plan_forward_blox);
             if (numblox_W == max_numblox_W) {
-                fftwf_execute_r2r(plan_forward_blox[0], Lblox, fLblox);    // DCT an entire row of tiles
+                fftwf_execute_r2r(plan_forward_blox[0].get(), Lblox, fLblox);    // DCT an entire row of tiles
             } else {
-                fftwf_execute_r2r(plan_forward_blox[1], Lblox, fLblox);    // DCT an entire row of tiles
+                fftwf_execute_r2r(plan_forward_blox[1].get(), Lblox, fLblox);    // DCT an entire row of tiles
             }
 
             // now process the vblk row of blocks for noise reduction
@@ -8135,9 +8066,9 @@ void ImProcFunctions::fftw_denoise(int GW, int GH, int max_numblox_W, int min_nu
 
             //now perform inverse FT of an entire row of blocks
             if (numblox_W == max_numblox_W) {
-                fftwf_execute_r2r(plan_backward_blox[0], fLblox, Lblox);    //for DCT
+                fftwf_execute_r2r(plan_backward_blox[0].get(), fLblox, Lblox);    //for DCT
             } else {
-                fftwf_execute_r2r(plan_backward_blox[1], fLblox, Lblox);    //for DCT
+                fftwf_execute_r2r(plan_backward_blox[1].get(), fLblox, Lblox);    //for DCT
             }
 
             int topproc = (vblk - 1) * offset;
@@ -8203,11 +8134,6 @@ void ImProcFunctions::fftw_denoise(int GW, int GH, int max_numblox_W, int min_nu
         fftwf_free(fLbloxArray[i]);
     }
 
-    fftwf_destroy_plan(plan_forward_blox[0]);
-    fftwf_destroy_plan(plan_backward_blox[0]);
-    fftwf_destroy_plan(plan_forward_blox[1]);
-    fftwf_destroy_plan(plan_backward_blox[1]);
-    fftwf_cleanup();
 
 
 }
@@ -9542,6 +9468,7 @@ void ImProcFunctions::Lab_Local(
     float& minCD, float& maxCD, float& mini, float& maxi, float& Tmean, float& Tsigma, float& Tmin, float& Tmax
     )
 {
+    TRACEFUN
     //general call of others functions : important return hueref, chromaref, lumaref
     if (!params->locallab.enabled) {
         return;
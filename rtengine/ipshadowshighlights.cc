@@ -30,11 +30,13 @@
 #include "opthelper.h"
 #include "procparams.h"
 #include "sleef.h"
+#include "pipelinetrace.h"
 
 namespace rtengine {
 //modifications to pass parameters needs by locallab, to avoid 2 functions - no change in process - J.Desmis march 2019
 void ImProcFunctions::shadowsHighlights(LabImage *lab, bool ena, int labmode, int hightli, int shado, int rad, int scal, int hltonal, int shtonal)
 {
+    TRACEFUN
     if (!ena || (!hightli && !shado)){
         return;
     }
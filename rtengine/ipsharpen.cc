@@ -32,6 +32,7 @@
 
 //#define BENCHMARK
 #include "StopWatch.h"
+#include "pipelinetrace.h"
 
 using namespace std;
 
@@ -350,6 +351,7 @@ void ImProcFunctions::deconvsharpeningloc (float** luminance, float** tmp, int W
 
 void ImProcFunctions::sharpening (LabImage* lab, const procparams::SharpeningParams &sharpenParam, bool showMask)
 {
+    TRACEFUN
 
     if ((!sharpenParam.enabled) || sharpenParam.amount < 1 || lab->W < 8 || lab->H < 8) {
         return;
@@ -734,6 +736,7 @@ BENCHFUN
 
 void ImProcFunctions::MLmicrocontrast(LabImage* lab)
 {
+    TRACEFUN
     MLmicrocontrast(lab->L, lab->W, lab->H);
 }
 
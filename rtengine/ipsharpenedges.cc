@@ -22,6 +22,7 @@
 #include "labimage.h"
 #include "procparams.h"
 #include "rt_math.h"
+#include "pipelinetrace.h"
 
 namespace {
 #ifdef __SSE2__
@@ -65,6 +66,7 @@ namespace rtengine
 // Thanks to Manuel for this excellent job (Jacques Desmis JDC or frej83)
 void ImProcFunctions::MLsharpen (LabImage* lab)
 {
+    TRACEFUN
     // JD: this algorithm maximize clarity of images; it does not play on accutance. It can remove (partially) the effects of the AA filter)
     // I think we can use this algorithm alone in most cases, or first to clarify image and if you want a very little USM (unsharp mask sharpening) after...
     if (!params->sharpenEdge.enabled || params->sharpenEdge.amount == 0) {
@@ -25,6 +25,7 @@
 #include "labimage.h"
 
 #include "procparams.h"
+#include "pipelinetrace.h"
 
 namespace rtengine
 {
@@ -64,6 +65,7 @@ inline vfloat sl(vfloat blend, vfloat x)
 
 void ImProcFunctions::softLight(LabImage *lab, const rtengine::procparams::SoftLightParams &softLightParams)
 {
+    TRACEFUN
     if (!softLightParams.enabled || !softLightParams.strength) {
         return;
     }
@@ -27,6 +27,8 @@
 #include "rtengine.h"
 #include "rtlensfun.h"
 #include "sleef.h"
+#include "transformgrid.h"
+#include "pipelinetrace.h"
 
 using namespace std;
 
@@ -653,6 +655,7 @@ void ImProcFunctions::transform (Imagefloat* original, Imagefloat* transformed,
                                  const FramesMetaData *metadata,
                                  int rawRotationDeg, bool fullImage, bool useOriginalBuffer)
 {
+    TRACEFUN
     double focalLen = metadata->getFocalLen();
     double focalLen35mm = metadata->getFocalLen35mm();
     float focusDist = metadata->getFocusDist();
@@ -699,7 +702,7 @@ void ImProcFunctions::transform (Imagefloat* original, Imagefloat* transformed,
                 dest = tmpimg.get();
             }
         }
-        transformGeneral(highQuality, original, dest, cx, cy, sx, sy, oW, oH, fW, fH, pLCPMap.get(), useOriginalBuffer);
+        transformGeneral(highQuality, original, dest, cx, cy, sx, sy, oW, oH, fW, fH, pLCPMap.get(), metadata, rawRotationDeg, useOriginalBuffer);
         
         if (highQuality && dest != transformed) {
             transformLCPCAOnly(dest, transformed, cx, cy, pLCPMap.get(), useOriginalBuffer);
@@ -1025,6 +1028,7 @@ static float calcPCVignetteFactor (const struct pcv_params& pcv, int x, int y)
     return val;
 }
 
+TARGET_CLONES
 void ImProcFunctions::transformLuminanceOnly (Imagefloat* original, Imagefloat* transformed, int cx, int cy, int oW, int oH, int fW, int fH)
 {
 
@@ -1089,7 +1093,8 @@ void ImProcFunctions::transformLuminanceOnly (Imagefloat* original, Imagefloat*
 }
 
 
-void ImProcFunctions::transformGeneral(bool highQuality, Imagefloat *original, Imagefloat *transformed, int cx, int cy, int sx, int sy, int oW, int oH, int fW, int fH, const LensCorrection *pLCPMap, bool useOriginalBuffer)
+TARGET_CLONES
+void ImProcFunctions::transformGeneral(bool highQuality, Imagefloat *original, Imagefloat *transformed, int cx, int cy, int sx, int sy, int oW, int oH, int fW, int fH, const LensCorrection *pLCPMap, const FramesMetaData *metadata, int rawRotationDeg, bool useOriginalBuffer)
 {
 
     // set up stuff, depending on the mode we are
@@ -1186,8 +1191,6 @@ void ImProcFunctions::transformGeneral(bool highQuality, Imagefloat *original, I
 
     const bool darkening = (params->vignetting.amount <= 0.0);
     const bool useLog = params->commonTrans.method == "log" && highQuality;
-    const double centerFactorx = cx - w2;
-    const double centerFactory = cy - h2;
 
     std::unique_ptr<Imagefloat> tempLog;
     if (useLog) {
@@ -1206,18 +1209,12 @@ void ImProcFunctions::transformGeneral(bool highQuality, Imagefloat *original, I
         original->b.ptrs
     };
 
-    // main cycle
-#ifdef _OPENMP
-    #pragma omp parallel for schedule(dynamic, 16) if(multiThread)
-#endif
-
-    for (int y = 0; y < transformed->getHeight(); ++y) {
-        for (int x = 0; x < transformed->getWidth(); ++x) {
-            double x_d = x;
-            double y_d = y;
-
-            x_d = ascale * (x_d + centerFactorx);     // centering x coord & scale
-            y_d = ascale * (y_d + centerFactory);     // centering y coord & scale
+    // geometric part of the transform at (x, y) in full image coordinates
+    const auto mapPoint =
+        [&](double x_d, double y_d, double &Dxc, double &Dyc, double &s)
+        {
+            x_d = ascale * (x_d - w2);     // centering x coord & scale
+            y_d = ascale * (y_d - h2);     // centering y coord & scale
 
             switch (perspectiveType) {
                 case PerspType::NONE:
@@ -1245,111 +1242,174 @@ void ImProcFunctions::transformGeneral(bool highQuality, Imagefloat *original, I
             }
 
             // rotate
-            const double Dxc = x_d * cost - y_d * sint;
-            const double Dyc = x_d * sint + y_d * cost;
+            Dxc = x_d * cost - y_d * sint;
+            Dyc = x_d * sint + y_d * cost;
 
             // distortion correction
-            double s = 1.0;
+            s = 1.0;
 
             if (enableDistortion) {
                 const double r = sqrt(Dxc * Dxc + Dyc * Dyc) / maxRadius;
                 s = 1.0 - distAmount + distAmount * r;
             }
+        };
+
+    // The geometric transform is sampled on a coarse grid, which is kept for the next calls. It covers the area
+    // being processed plus a margin, so that a detail window doesn't sample the full image and can pan a little
+    // without a new grid.
+    const int width = transformed->getWidth();
+    const int height = transformed->getHeight();
+    const int marginX = std::max(width / 2, TransformGrid::step);
+    const int marginY = std::max(height / 2, TransformGrid::step);
+    const int gridX = std::min(cx, std::max(cx - marginX, 0));
+    const int gridY = std::min(cy, std::max(cy - marginY, 0));
+    const int gridWidth = std::max(cx + width, std::min(cx + width + marginX, oW)) - gridX;
+    const int gridHeight = std::max(cy + height, std::min(cy + height + marginY, oH)) - gridY;
+
+    TransformGridKey gridKey = {
+        oW, oH, ascale, params->rotate.degree, distAmount, params->perspective, enableLCPDist,
+        params->lensProf, params->coarse, rawRotationDeg,
+        metadata->getMake(), metadata->getModel(), metadata->getLens(),
+        metadata->getFocalLen(), metadata->getFocalLen35mm(), metadata->getFNumber(), metadata->getFocusDist()
+    };
 
-            for (int c = 0; c < (enableCA ? 3 : 1); ++c) {
-                double Dx = Dxc * (s + chDist[c]);
-                double Dy = Dyc * (s + chDist[c]);
+    std::shared_ptr<const TransformGrid> grid = TransformGridCache::getInstance().get(gridKey, cx, cy, width, height);
 
-                // de-center
-                Dx += w2;
-                Dy += h2;
+    if (!grid) {
+        TransformGrid* const newGrid = new TransformGrid(gridX, gridY, gridWidth, gridHeight);
+        grid.reset(newGrid);
 
-                // Extract integer and fractions of source screen coordinates
-                int xc = Dx;
-                Dx -= xc;
-                xc -= sx;
-                int yc = Dy;
-                Dy -= yc;
-                yc -= sy;
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic, 16) if(multiThread)
+#endif
 
-                // Convert only valid pixels
-                if (yc >= 0 && yc < original->getHeight() && xc >= 0 && xc < original->getWidth()) {
-                    // multiplier for vignetting correction
-                    double vignmul = 1.0;
-
-                    if (enableVignetting) {
-                        const double vig_x_d = ascale * (x + cx - vig_w2); // centering x coord & scale
-                        const double vig_y_d = ascale * (y + cy - vig_h2); // centering y coord & scale
-                        const double vig_Dx = vig_x_d * cost - vig_y_d * sint;
-                        const double vig_Dy = vig_x_d * sint + vig_y_d * cost;
-                        const double r2 = sqrt(vig_Dx * vig_Dx + vig_Dy * vig_Dy);
-                        if (darkening) {
-                            vignmul /= std::max(v + mul * tanh(b * (maxRadius - s * r2) / maxRadius), 0.001);
-                        } else {
-                            vignmul *= (v + mul * tanh(b * (maxRadius - s * r2) / maxRadius));
-                        }
-                    }
+        for (int row = 0; row < newGrid->getRows(); ++row) {
+            for (int col = 0; col < newGrid->getCols(); ++col) {
+                double Dxc, Dyc, s;
+                mapPoint(newGrid->getX() + col * TransformGrid::step, newGrid->getY() + row * TransformGrid::step, Dxc, Dyc, s);
+                newGrid->set(row, col, Dxc, Dyc, s);
+            }
+        }
 
-                    if (enableGradient) {
-                        vignmul *= static_cast<double>(calcGradientFactor(gp, cx + x, cy + y));
-                    }
+        TransformGridCache::getInstance().put(gridKey, grid);
+    }
 
-                    if (enablePCVignetting) {
-                        vignmul *= static_cast<double>(calcPCVignetteFactor(pcv, cx + x, cy + y));
-                    }
+    // main cycle
+#ifdef _OPENMP
+    #pragma omp parallel if(multiThread)
+#endif
+    {
+        std::vector<float> rowDxc(width);
+        std::vector<float> rowDyc(width);
+        std::vector<float> rowS(width);
 
-                    if (yc > 0 && yc < original->getHeight() - 2 && xc > 0 && xc < original->getWidth() - 2) {
-                        // all interpolation pixels inside image
-                        if (!highQuality) {
-                            transformed->r(y, x) = vignmul * (original->r(yc, xc) * (1.0 - Dx) * (1.0 - Dy) + original->r(yc, xc + 1) * Dx * (1.0 - Dy) + original->r(yc + 1, xc) * (1.0 - Dx) * Dy + original->r(yc + 1, xc + 1) * Dx * Dy);
-                            transformed->g(y, x) = vignmul * (original->g(yc, xc) * (1.0 - Dx) * (1.0 - Dy) + original->g(yc, xc + 1) * Dx * (1.0 - Dy) + original->g(yc + 1, xc) * (1.0 - Dx) * Dy + original->g(yc + 1, xc + 1) * Dx * Dy);
-                            transformed->b(y, x) = vignmul * (original->b(yc, xc) * (1.0 - Dx) * (1.0 - Dy) + original->b(yc, xc + 1) * Dx * (1.0 - Dy) + original->b(yc + 1, xc) * (1.0 - Dx) * Dy + original->b(yc + 1, xc + 1) * Dx * Dy);
-                        } else if (!useLog) {
-                            if (enableCA) {
-                                interpolateTransformChannelsCubic(chOrig[c], xc - 1, yc - 1, Dx, Dy, chTrans[c][y][x], vignmul);
-                            } else {
-                                interpolateTransformCubic(original, xc - 1, yc - 1, Dx, Dy, transformed->r(y, x), transformed->g(y, x), transformed->b(y, x), vignmul);
-                            }
-                        } else {
-                            if (enableCA) {
-                                interpolateTransformChannelsCubicLog(chOrig[c], xc - 1, yc - 1, Dx, Dy, chTrans[c][y][x], vignmul);
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic, 16)
+#endif
+
+        for (int y = 0; y < height; ++y) {
+            grid->interpolateRow(y + cy, cx, width, rowDxc.data(), rowDyc.data(), rowS.data());
+
+            for (int x = 0; x < width; ++x) {
+                const double Dxc = rowDxc[x];
+                const double Dyc = rowDyc[x];
+                const double s = rowS[x];
+
+                for (int c = 0; c < (enableCA ? 3 : 1); ++c) {
+                    double Dx = Dxc * (s + chDist[c]);
+                    double Dy = Dyc * (s + chDist[c]);
+
+                    // de-center
+                    Dx += w2;
+                    Dy += h2;
+
+                    // Extract integer and fractions of source screen coordinates
+                    int xc = Dx;
+                    Dx -= xc;
+                    xc -= sx;
+                    int yc = Dy;
+                    Dy -= yc;
+                    yc -= sy;
+
+                    // Convert only valid pixels
+                    if (yc >= 0 && yc < original->getHeight() && xc >= 0 && xc < original->getWidth()) {
+                        // multiplier for vignetting correction
+                        double vignmul = 1.0;
+
+                        if (enableVignetting) {
+                            const double vig_x_d = ascale * (x + cx - vig_w2); // centering x coord & scale
+                            const double vig_y_d = ascale * (y + cy - vig_h2); // centering y coord & scale
+                            const double vig_Dx = vig_x_d * cost - vig_y_d * sint;
+                            const double vig_Dy = vig_x_d * sint + vig_y_d * cost;
+                            const double r2 = sqrt(vig_Dx * vig_Dx + vig_Dy * vig_Dy);
+                            if (darkening) {
+                                vignmul /= std::max(v + mul * tanh(b * (maxRadius - s * r2) / maxRadius), 0.001);
                             } else {
-                                interpolateTransformCubicLog(original, xc - 1, yc - 1, Dx, Dy, transformed->r(y, x), transformed->g(y, x), transformed->b(y, x), vignmul);
+                                vignmul *= (v + mul * tanh(b * (maxRadius - s * r2) / maxRadius));
                             }
                         }
-                    } else {
-                        // edge pixels
-                        const int y1 = LIM(yc, 0, original->getHeight() - 1);
-                        const int y2 = LIM(yc + 1, 0, original->getHeight() - 1);
-                        const int x1 = LIM(xc, 0, original->getWidth() - 1);
-                        const int x2 = LIM(xc + 1, 0, original->getWidth() - 1);
-
-                        if (useLog) {
-                            if (enableCA) {
-                                chTrans[c][y][x] = vignmul * xexpf(chOrig[c][y1][x1] * (1.0 - Dx) * (1.0 - Dy) + chOrig[c][y1][x2] * Dx * (1.0 - Dy) + chOrig[c][y2][x1] * (1.0 - Dx) * Dy + chOrig[c][y2][x2] * Dx * Dy);
+
+                        if (enableGradient) {
+                            vignmul *= static_cast<double>(calcGradientFactor(gp, cx + x, cy + y));
+                        }
+
+                        if (enablePCVignetting) {
+                            vignmul *= static_cast<double>(calcPCVignetteFactor(pcv, cx + x, cy + y));
+                        }
+
+                        if (yc > 0 && yc < original->getHeight() - 2 && xc > 0 && xc < original->getWidth() - 2) {
+                            // all interpolation pixels inside image
+                            if (!highQuality) {
+                                transformed->r(y, x) = vignmul * (original->r(yc, xc) * (1.0 - Dx) * (1.0 - Dy) + original->r(yc, xc + 1) * Dx * (1.0 - Dy) + original->r(yc + 1, xc) * (1.0 - Dx) * Dy + original->r(yc + 1, xc + 1) * Dx * Dy);
+                                transformed->g(y, x) = vignmul * (original->g(yc, xc) * (1.0 - Dx) * (1.0 - Dy) + original->g(yc, xc + 1) * Dx * (1.0 - Dy) + original->g(yc + 1, xc) * (1.0 - Dx) * Dy + original->g(yc + 1, xc + 1) * Dx * Dy);
+                                transformed->b(y, x) = vignmul * (original->b(yc, xc) * (1.0 - Dx) * (1.0 - Dy) + original->b(yc, xc + 1) * Dx * (1.0 - Dy) + original->b(yc + 1, xc) * (1.0 - Dx) * Dy + original->b(yc + 1, xc + 1) * Dx * Dy);
+                            } else if (!useLog) {
+                                if (enableCA) {
+                                    interpolateTransformChannelsCubic(chOrig[c], xc - 1, yc - 1, Dx, Dy, chTrans[c][y][x], vignmul);
+                                } else {
+                                    interpolateTransformCubic(original, xc - 1, yc - 1, Dx, Dy, transformed->r(y, x), transformed->g(y, x), transformed->b(y, x), vignmul);
+                                }
                             } else {
-                                transformed->r(y, x) = vignmul * xexpf(original->r(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->r(y1, x2) * Dx * (1.0 - Dy) + original->r(y2, x1) * (1.0 - Dx) * Dy + original->r(y2, x2) * Dx * Dy);
-                                transformed->g(y, x) = vignmul * xexpf(original->g(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->g(y1, x2) * Dx * (1.0 - Dy) + original->g(y2, x1) * (1.0 - Dx) * Dy + original->g(y2, x2) * Dx * Dy);
-                                transformed->b(y, x) = vignmul * xexpf(original->b(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->b(y1, x2) * Dx * (1.0 - Dy) + original->b(y2, x1) * (1.0 - Dx) * Dy + original->b(y2, x2) * Dx * Dy);
+                                if (enableCA) {
+                                    interpolateTransformChannelsCubicLog(chOrig[c], xc - 1, yc - 1, Dx, Dy, chTrans[c][y][x], vignmul);
+                                } else {
+                                    interpolateTransformCubicLog(original, xc - 1, yc - 1, Dx, Dy, transformed->r(y, x), transformed->g(y, x), transformed->b(y, x), vignmul);
+                                }
                             }
                         } else {
-                            if (enableCA) {
-                                chTrans[c][y][x] = vignmul * (chOrig[c][y1][x1] * (1.0 - Dx) * (1.0 - Dy) + chOrig[c][y1][x2] * Dx * (1.0 - Dy) + chOrig[c][y2][x1] * (1.0 - Dx) * Dy + chOrig[c][y2][x2] * Dx * Dy);
+                            // edge pixels
+                            const int y1 = LIM(yc, 0, original->getHeight() - 1);
+                            const int y2 = LIM(yc + 1, 0, original->getHeight() - 1);
+                            const int x1 = LIM(xc, 0, original->getWidth() - 1);
+                            const int x2 = LIM(xc + 1, 0, original->getWidth() - 1);
+
+                            if (useLog) {
+                                if (enableCA) {
+                                    chTrans[c][y][x] = vignmul * xexpf(chOrig[c][y1][x1] * (1.0 - Dx) * (1.0 - Dy) + chOrig[c][y1][x2] * Dx * (1.0 - Dy) + chOrig[c][y2][x1] * (1.0 - Dx) * Dy + chOrig[c][y2][x2] * Dx * Dy);
+                                } else {
+                                    transformed->r(y, x) = vignmul * xexpf(original->r(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->r(y1, x2) * Dx * (1.0 - Dy) + original->r(y2, x1) * (1.0 - Dx) * Dy + original->r(y2, x2) * Dx * Dy);
+                                    transformed->g(y, x) = vignmul * xexpf(original->g(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->g(y1, x2) * Dx * (1.0 - Dy) + original->g(y2, x1) * (1.0 - Dx) * Dy + original->g(y2, x2) * Dx * Dy);
+                                    transformed->b(y, x) = vignmul * xexpf(original->b(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->b(y1, x2) * Dx * (1.0 - Dy) + original->b(y2, x1) * (1.0 - Dx) * Dy + original->b(y2, x2) * Dx * Dy);
+                                }
                             } else {
-                                transformed->r(y, x) = vignmul * (original->r(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->r(y1, x2) * Dx * (1.0 - Dy) + original->r(y2, x1) * (1.0 - Dx) * Dy + original->r(y2, x2) * Dx * Dy);
-                                transformed->g(y, x) = vignmul * (original->g(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->g(y1, x2) * Dx * (1.0 - Dy) + original->g(y2, x1) * (1.0 - Dx) * Dy + original->g(y2, x2) * Dx * Dy);
-                                transformed->b(y, x) = vignmul * (original->b(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->b(y1, x2) * Dx * (1.0 - Dy) + original->b(y2, x1) * (1.0 - Dx) * Dy + original->b(y2, x2) * Dx * Dy);
+                                if (enableCA) {
+                                    chTrans[c][y][x] = vignmul * (chOrig[c][y1][x1] * (1.0 - Dx) * (1.0 - Dy) + chOrig[c][y1][x2] * Dx * (1.0 - Dy) + chOrig[c][y2][x1] * (1.0 - Dx) * Dy + chOrig[c][y2][x2] * Dx * Dy);
+                                } else {
+                                    transformed->r(y, x) = vignmul * (original->r(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->r(y1, x2) * Dx * (1.0 - Dy) + original->r(y2, x1) * (1.0 - Dx) * Dy + original->r(y2, x2) * Dx * Dy);
+                                    transformed->g(y, x) = vignmul * (original->g(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->g(y1, x2) * Dx * (1.0 - Dy) + original->g(y2, x1) * (1.0 - Dx) * Dy + original->g(y2, x2) * Dx * Dy);
+                                    transformed->b(y, x) = vignmul * (original->b(y1, x1) * (1.0 - Dx) * (1.0 - Dy) + original->b(y1, x2) * Dx * (1.0 - Dy) + original->b(y2, x1) * (1.0 - Dx) * Dy + original->b(y2, x2) * Dx * Dy);
+                                }
                             }
                         }
-                    }
-                } else {
-                    if (enableCA) {
-                        // not valid (source pixel x,y not inside source image, etc.)
-                        chTrans[c][y][x] = 0;
                     } else {
-                        transformed->r(y, x) = 0;
-                        transformed->g(y, x) = 0;
-                        transformed->b(y, x) = 0;
+                        if (enableCA) {
+                            // not valid (source pixel x,y not inside source image, etc.)
+                            chTrans[c][y][x] = 0;
+                        } else {
+                            transformed->r(y, x) = 0;
+                            transformed->g(y, x) = 0;
+                            transformed->b(y, x) = 0;
+                        }
                     }
                 }
             }
@@ -1358,6 +1418,7 @@ void ImProcFunctions::transformGeneral(bool highQuality, Imagefloat *original, I
 }
 
 
+TARGET_CLONES
 void ImProcFunctions::transformLCPCAOnly(Imagefloat *original, Imagefloat *transformed, int cx, int cy, const LensCorrection *pLCPMap, bool useOriginalBuffer)
 {
     assert(pLCPMap && params->lensProf.useCA && pLCPMap->isCACorrectionAvailable());
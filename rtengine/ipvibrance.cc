@@ -28,6 +28,7 @@
 #include "color.h"
 #include "procparams.h"
 #include "StopWatch.h"
+#include "pipelinetrace.h"
 
 using namespace std;
 
@@ -63,6 +64,7 @@ void fillCurveArrayVib (DiagonalCurve* diagCurve, LUTf &outCurve)
  */
 void ImProcFunctions::vibrance (LabImage* lab, const procparams::VibranceParams &vibranceParams, bool highlight, const Glib::ustring &workingProfile)
 {
+    TRACEFUN
     if (!vibranceParams.enabled) {
         return;
     }
@@ -52,6 +52,7 @@
 #include "cplx_wavelet_dec.h"
 #define BENCHMARK
 #include "StopWatch.h"
+#include "pipelinetrace.h"
 
 namespace rtengine
 {
@@ -217,6 +218,7 @@ void ImProcFunctions::ip_wavelet(LabImage * lab, LabImage * dst, int kall, const
 
 
 {
+    TRACEFUN
     TMatrix wiprof = ICCStore::getInstance()->workingSpaceInverseMatrix(params->icm.workingProfile);
     const double wip[3][3] = {
         {wiprof[0][0], wiprof[0][1], wiprof[0][2]},
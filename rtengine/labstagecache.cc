@@ -0,0 +1,152 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "labstagecache.h"
+
+#include "labimage.h"
+
+namespace rtengine
+{
+
+LabStageCache::StageParams::StageParams(const procparams::ProcParams& params) :
+    workingProfile(params.icm.workingProfile),
+    hrenabled(params.toneCurve.hrenabled),
+    blackwhiteEnabled(params.blackwhite.enabled),
+    ciecamEnabled(params.colorappearance.enabled),
+    ciecamGamut(params.colorappearance.gamut),
+    ciecamToneCie(params.colorappearance.tonecie),
+    localContrastEnabled(params.localContrast.enabled),
+    denoiseEnabled(params.dirpyrDenoise.enabled),
+    denoiseChroma(params.dirpyrDenoise.chroma),
+    labCurve(params.labCurve),
+    vibrance(params.vibrance),
+    colorToning(params.colorToning),
+    epd(params.epd),
+    dirpyrequalizer(params.dirpyrequalizer),
+    wavelet(params.wavelet),
+    softlight(params.softlight)
+{
+}
+
+bool LabStageCache::StageParams::equals(const StageParams& other, Stage stage) const
+{
+    // The result of a stage also depends on the parameters of all the previous ones.
+    // The flags and the color toning are read by several stages, starting with the first one.
+    return
+        workingProfile == other.workingProfile
+        && hrenabled == other.hrenabled
+        && blackwhiteEnabled == other.blackwhiteEnabled
+        && ciecamEnabled == other.ciecamEnabled
+        && ciecamGamut == other.ciecamGamut
+        && ciecamToneCie == other.ciecamToneCie
+        && localContrastEnabled == other.localContrastEnabled
+        && denoiseEnabled == other.denoiseEnabled
+        && (!denoiseEnabled || denoiseChroma == other.denoiseChroma)
+        && labCurve == other.labCurve
+        && colorToning == other.colorToning
+        && (stage < VIBRANCE || vibrance == other.vibrance)
+        && (stage < EPD || epd == other.epd)
+        && (stage < CBDL || dirpyrequalizer == other.dirpyrequalizer)
+        && (stage < WAVELET || wavelet == other.wavelet)
+        && (stage < SOFTLIGHT || softlight == other.softlight);
+}
+
+LabStageCache::Entry::Entry(Stage stage, unsigned int inputVersion, int scale, const procparams::ProcParams& params) :
+    stage(stage),
+    inputVersion(inputVersion),
+    scale(scale),
+    params(params)
+{
+}
+
+LabStageCache::LabStageCache(std::size_t maxImages) :
+    maxImages(maxImages)
+{
+}
+
+LabStageCache::~LabStageCache() = default;
+
+LabStageCache::Stage LabStageCache::restore(unsigned int inputVersion, int scale, const procparams::ProcParams& params, LabImage* dst, LUTu& histCCurve, LUTu& histLCurve)
+{
+    const StageParams key(params);
+    auto best = entries.end();
+
+    for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+        if (
+            entry->inputVersion == inputVersion
+            && entry->scale == scale
+            && entry->image->W == dst->W
+            && entry->image->H == dst->H
+            && (best == entries.end() || entry->stage > best->stage)
+            && entry->params.equals(key, entry->stage)
+        ) {
+            best = entry;
+        }
+    }
+
+    if (best == entries.end()) {
+        return NONE;
+    }
+
+    entries.splice(entries.begin(), entries, best);
+    dst->CopyFrom(best->image.get());
+    histCCurve = best->histCCurve;
+    histLCurve = best->histLCurve;
+    return best->stage;
+}
+
+void LabStageCache::store(Stage stage, unsigned int inputVersion, int scale, const procparams::ProcParams& params, const LabImage* img, const LUTu& histCCurve, const LUTu& histLCurve)
+{
+    if (maxImages == 0) {
+        return;
+    }
+
+    const StageParams key(params);
+    std::unique_ptr<LabImage> image;
+
+    for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+        if (entry->stage == stage && entry->inputVersion == inputVersion && entry->scale == scale && entry->params.equals(key, stage)) {
+            // Same result computed again (e.g. after the eviction of a deeper stage)
+            image = std::move(entry->image);
+            entries.erase(entry);
+            break;
+        }
+    }
+
+    if (!image && entries.size() >= maxImages) {
+        image = std::move(entries.back().image);
+        entries.pop_back();
+    }
+
+    if (!image || image->W != img->W || image->H != img->H) {
+        image.reset(new LabImage(img->W, img->H));
+    }
+
+    image->CopyFrom(img);
+
+    entries.emplace_front(stage, inputVersion, scale, params);
+    Entry& entry = entries.front();
+    entry.image = std::move(image);
+    entry.histCCurve = histCCurve;
+    entry.histLCurve = histLCurve;
+}
+
+void LabStageCache::clear()
+{
+    entries.clear();
+}
+
+}
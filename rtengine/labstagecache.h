@@ -0,0 +1,115 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+
+#include "LUT.h"
+#include "noncopyable.h"
+#include "procparams.h"
+
+namespace rtengine
+{
+
+class LabImage;
+
+/**
+ * @brief Results of the Lab stages of the preview pipeline, for reuse by later updates
+ *
+ * The refresh map only tells ImProcCoordinator that "something in the Lab pipeline" changed,
+ * so each edit used to rerun all the Lab stages from the output of rgbProc. Here, the result of
+ * each stage is stored along with the parameters consumed by this stage and all the previous
+ * ones. An update then restarts from the deepest stage whose inputs are unchanged, which also
+ * serves the case of a slider going back to a previous value.
+ *
+ * The input of the first stage is identified by a version number, to be changed by the caller
+ * whenever the input image is recomputed.
+ */
+class LabStageCache final :
+    public NonCopyable
+{
+public:
+    enum Stage {
+        CHROMILUMINANCE,
+        VIBRANCE,
+        COLOR_REGIONS,
+        EPD,
+        CBDL,
+        WAVELET,
+        SOFTLIGHT,
+        NONE = -1
+    };
+
+    explicit LabStageCache(std::size_t maxImages);
+    ~LabStageCache();
+
+    /**
+     * Looks for the deepest cached stage matching the parameters.
+     * @return the stage whose result has been copied into dst, along with the curve histograms
+     * computed by the chromaticity/luminance stage, or NONE
+     */
+    Stage restore(unsigned int inputVersion, int scale, const procparams::ProcParams& params, LabImage* dst, LUTu& histCCurve, LUTu& histLCurve);
+
+    /** Stores the result of a stage, evicting the least recently used entries when full */
+    void store(Stage stage, unsigned int inputVersion, int scale, const procparams::ProcParams& params, const LabImage* img, const LUTu& histCCurve, const LUTu& histLCurve);
+
+    void clear();
+
+private:
+    // The parts of ProcParams consumed by the cached stages
+    struct StageParams {
+        explicit StageParams(const procparams::ProcParams& params);
+
+        bool equals(const StageParams& other, Stage stage) const;
+
+        Glib::ustring workingProfile;
+        bool hrenabled;
+        bool blackwhiteEnabled;
+        bool ciecamEnabled;
+        bool ciecamGamut;
+        bool ciecamToneCie;
+        bool localContrastEnabled;
+        bool denoiseEnabled;
+        double denoiseChroma; // raises the saturation of the lab adjustments when the noise reduction is enabled
+        procparams::LCurveParams labCurve;
+        procparams::VibranceParams vibrance;
+        procparams::ColorToningParams colorToning;
+        procparams::EPDParams epd;
+        procparams::DirPyrEqualizerParams dirpyrequalizer;
+        procparams::WaveletParams wavelet;
+        procparams::SoftLightParams softlight;
+    };
+
+    struct Entry {
+        Entry(Stage stage, unsigned int inputVersion, int scale, const procparams::ProcParams& params);
+
+        Stage stage;
+        unsigned int inputVersion;
+        int scale;
+        StageParams params;
+        std::unique_ptr<LabImage> image;
+        LUTu histCCurve;
+        LUTu histLCurve;
+    };
+
+    const std::size_t maxImages;
+    std::list<Entry> entries; // most recently used first
+};
+
+}
@@ -0,0 +1,266 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "dcraw.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "opthelper.h"
+
+namespace
+{
+
+using uchar = DCraw::uchar;
+using ushort = DCraw::ushort;
+
+// Bit reader over the entropy coded data of a lossless JPEG, in memory
+// It stops at the first marker and feeds zeros past it, like getbithuff() does after a reset
+class LJpegBits
+{
+public:
+    LJpegBits(const uchar* data, const uchar* end) :
+        data(data),
+        end(end),
+        bitbuf(0),
+        vbits(0),
+        padding(0)
+    {
+    }
+
+    int diff(const ushort* huff, bool len16_is_32768)
+    {
+        const int max = huff[0];
+        fill(max);
+        const ushort entry = huff[1 + peek(max)];
+        vbits -= entry >> 8;
+        const int len = entry & 0xff;
+
+        if (len == 16 && len16_is_32768) {
+            return -32768;
+        }
+
+        if (len == 0) {
+            return 0;
+        }
+
+        fill(len);
+        int diff = peek(len);
+        vbits -= len;
+
+        if ((diff & (1 << (len - 1))) == 0) {
+            diff -= (1 << len) - 1;
+        }
+
+        return diff;
+    }
+
+    // true if the decoder used the zeros fed past the end of the data
+    bool overrun() const
+    {
+        return vbits < 0 || static_cast<unsigned>(vbits) < 8 * padding;
+    }
+
+private:
+    void fill(int nbits)
+    {
+        while (vbits < nbits) {
+            uchar c = 0;
+
+            if (LIKELY(data < end && (*data != 0xff || (data + 1 < end && data[1] == 0)))) {
+                c = *data;
+                data += c == 0xff ? 2 : 1;
+            } else {
+                ++padding;
+            }
+
+            bitbuf = (bitbuf << 8) | c;
+            vbits += 8;
+        }
+    }
+
+    unsigned peek(int nbits) const
+    {
+        return (bitbuf >> (vbits - nbits)) & ((1u << nbits) - 1);
+    }
+
+    const uchar* data;
+    const uchar* const end;
+    uint64_t bitbuf;
+    int vbits;
+    unsigned padding;
+};
+
+// Finds the start of the entropy coded segments following each restart marker
+void findRestartSegments(const uchar* data, const uchar* end, std::vector<const uchar*>& segments)
+{
+    segments.assign(1, data);
+
+    while (data + 1 < end) {
+        data = static_cast<const uchar*>(memchr(data, 0xff, end - data - 1));
+
+        if (!data) {
+            return;
+        }
+
+        const uchar marker = data[1];
+
+        if (marker == 0xff) { // fill byte
+            ++data;
+        } else if (marker == 0) { // stuffed byte
+            data += 2;
+        } else if (marker >= 0xd0 && marker <= 0xd7) {
+            data += 2;
+            segments.push_back(data);
+        } else { // end of scan
+            return;
+        }
+    }
+}
+
+}
+
+// Decodes the lossless JPEG scan starting at data (just after the SOS segment) and calls store for each row
+// When the scan has restart markers and the rows of each interval don't depend on the previous ones, the
+// intervals are decoded in parallel, store being called from several threads then.
+// Returns false if the restart markers don't match the header, nothing is decoded in that case.
+bool DCraw::ljpeg_decode (const struct jhead &jh, const uchar *data, const uchar *end, bool parallel, const std::function<void (int jrow, const ushort *row)> &store)
+{
+    const int jwide = jh.wide * jh.clrs;
+    const bool len16_is_32768 = !dng_version || dng_version >= 0x1010000;
+
+    int rows_per_segment = jh.high;
+    std::vector<const uchar*> segments(1, data);
+
+    if (jh.restart < INT_MAX) {
+        if (jh.restart <= 0 || jh.restart % jh.wide) {
+            return false;
+        }
+
+        rows_per_segment = jh.restart / jh.wide;
+        findRestartSegments(data, end, segments);
+
+        if (segments.size() < static_cast<size_t>((jh.high + rows_per_segment - 1) / rows_per_segment)) {
+            return false;
+        }
+
+        segments.resize((jh.high + rows_per_segment - 1) / rows_per_segment);
+    }
+
+    // Predictors other than 1 use the previous row, which crosses the restart intervals in ljpeg_row()
+    if (jh.psv != 1) {
+        parallel = false;
+    }
+
+    bool error = false;
+
+#ifdef _OPENMP
+    #pragma omp parallel if (parallel && segments.size() > 1)
+#endif
+    {
+        std::vector<ushort> rows(2 * jwide);
+        bool thread_error = false;
+
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+        for (size_t s = 0; s < segments.size(); ++s) {
+            LJpegBits bits(segments[s], end);
+            int vpred[6];
+
+            for (int c = 0; c < 6; ++c) {
+                vpred[c] = 1 << (jh.bits - 1);
+            }
+
+            const int first_row = s * rows_per_segment;
+            const int last_row = std::min<int>(first_row + rows_per_segment, jh.high);
+
+            for (int jrow = first_row; jrow < last_row; ++jrow) {
+                ushort* row = &rows[(jrow & 1) * jwide];
+                const ushort* prev = &rows[((jrow + 1) & 1) * jwide];
+                int spred = 0;
+
+                for (int col = 0; col < jh.wide; ++col) {
+                    for (int c = 0; c < jh.clrs; ++c) {
+                        const int diff = bits.diff(jh.huff[c], len16_is_32768);
+                        int pred;
+
+                        if (jh.sraw && c <= jh.sraw && (col | c)) {
+                            pred = spred;
+                        } else if (col) {
+                            pred = row[-jh.clrs];
+                        } else {
+                            pred = (vpred[c] += diff) - diff;
+                        }
+
+                        if (jh.psv != 1 && jrow && col) {
+                            switch (jh.psv) {
+                                case 2: pred = prev[0];                                  break;
+                                case 3: pred = prev[-jh.clrs];                           break;
+                                case 4: pred = pred +   prev[0] - prev[-jh.clrs];        break;
+                                case 5: pred = pred + ((prev[0] - prev[-jh.clrs]) >> 1); break;
+                                case 6: pred = prev[0] + ((pred - prev[-jh.clrs]) >> 1); break;
+                                case 7: pred = (pred + prev[0]) >> 1;                    break;
+                                default: pred = 0;
+                            }
+                        }
+
+                        const ushort val = pred + diff;
+                        *row = val;
+
+                        if (UNLIKELY(val >> jh.bits)) {
+                            thread_error = true;
+                        }
+
+                        if (c <= jh.sraw) {
+                            spred = val;
+                        }
+
+                        ++row;
+                        ++prev;
+                    }
+                }
+
+                store(jrow, row - jwide);
+            }
+
+            if (bits.overrun()) {
+                thread_error = true;
+            }
+        }
+
+        if (thread_error) {
+#ifdef _OPENMP
+            #pragma omp critical
+#endif
+            error = true;
+        }
+    }
+
+    if (error) {
+        derror();
+    }
+
+    return true;
+}
@@ -39,6 +39,7 @@ namespace rtengine
 // Adapted to RawTherapee by Jacques Desmis 3/2013
 // Improved speed and reduced memory consumption by Ingo Weyrich 2/2015
 // TODO Tiles to reduce memory consumption
+TARGET_CLONES
 void RawImageSource::lmmse_interpolate_omp(int winw, int winh, const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue, int iterations)
 {
     // Test for RGB cfa
@@ -0,0 +1,379 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+
+#include <zlib.h>
+
+#include <glib/gstdio.h>
+#include <glibmm/checksum.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include "masterframecache.h"
+
+#include "rawimage.h"
+#include "settings.h"
+
+#include "../rtgui/options.h"
+
+namespace rtengine
+{
+
+extern const Settings* settings;
+
+}
+
+namespace
+{
+
+// Identifies the format of the entries, to be changed with it
+constexpr char magic[8] = {'R', 'T', 'M', 'F', '0', '0', '0', '1'};
+
+int getRowSize(const rtengine::RawImage* ri)
+{
+    const bool oneValuePerPixel =
+        ri->getSensorType() == rtengine::ST_BAYER
+        || ri->getSensorType() == rtengine::ST_FUJI_XTRANS
+        || ri->get_colors() == 1;
+
+    return ri->get_width() * (oneValuePerPixel ? 1 : 3);
+}
+
+// The temporary files left by an interrupted process are removed after that time, in seconds
+constexpr time_t tmpFileLifetime = 24 * 3600;
+
+std::vector<Glib::ustring> getSortedPaths(const std::list<Glib::ustring>& sources)
+{
+    std::vector<Glib::ustring> paths(sources.begin(), sources.end());
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// The kind and the path, size and modification time of each source, empty if one of them can't be read
+std::string getKey(const std::string& kind, const std::list<Glib::ustring>& sources)
+{
+    std::ostringstream key;
+    key << kind << '\n';
+
+    for (const auto& path : getSortedPaths(sources)) {
+        GStatBuf info;
+
+        if (g_stat(path.c_str(), &info)) {
+            return std::string();
+        }
+
+        key << path << '\t' << info.st_size << '\t' << info.st_mtime << '\n';
+    }
+
+    return key.str();
+}
+
+std::string getCacheDir()
+{
+    return Glib::build_filename(options.cacheBaseDir, "masterframes");
+}
+
+// Named after the kind and the paths only, so that the entry of a source set is replaced when one of its files changes
+std::string getEntryPath(const std::string& kind, const std::list<Glib::ustring>& sources)
+{
+    std::string name = kind + '\n';
+
+    for (const auto& path : getSortedPaths(sources)) {
+        name += path + '\n';
+    }
+
+    return Glib::build_filename(getCacheDir(), Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, name) + ".rtmf");
+}
+
+// Removes the least recently used entries while the cache exceeds its size limit
+void trimCache()
+{
+    struct Entry {
+        std::string path;
+        std::int64_t size;
+        time_t time;
+    };
+
+    const std::string dirName = getCacheDir();
+    const std::int64_t maxSize = static_cast<std::int64_t>(options.masterFrameCacheSize) << 20;
+    const time_t now = time(nullptr);
+
+    std::vector<Entry> entries;
+    std::int64_t totalSize = 0;
+
+    try {
+        Glib::Dir dir(dirName);
+
+        for (Glib::DirIterator entry = dir.begin(); entry != dir.end(); ++entry) {
+            const std::string fileName = *entry;
+            const std::string path = Glib::build_filename(dirName, fileName);
+            GStatBuf info;
+
+            if (g_stat(path.c_str(), &info)) {
+                continue;
+            }
+
+            if (fileName.size() > 5 && fileName.compare(fileName.size() - 5, 5, ".rtmf") == 0) {
+                entries.push_back({path, static_cast<std::int64_t>(info.st_size), info.st_mtime});
+                totalSize += info.st_size;
+            } else if (fileName.find(".rtmf.") != std::string::npos && now - info.st_mtime > tmpFileLifetime) {
+                g_remove(path.c_str());
+            }
+        }
+    } catch (Glib::Exception&) {
+        return;
+    }
+
+    if (totalSize <= maxSize) {
+        return;
+    }
+
+    // loading an entry updates its modification time
+    std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+        return lhs.time < rhs.time;
+    });
+
+    for (const auto& entry : entries) {
+        if (totalSize <= maxSize) {
+            break;
+        }
+
+        if (!g_remove(entry.path.c_str())) {
+            totalSize -= entry.size;
+
+            if (rtengine::settings->verbose) {
+                printf("Removed the master frame %s from the cache\n", entry.path.c_str());
+            }
+        }
+    }
+}
+
+template<typename T>
+bool readValue(FILE* f, T& value)
+{
+    return fread(&value, sizeof(T), 1, f) == 1;
+}
+
+template<typename T>
+bool writeValue(FILE* f, const T& value)
+{
+    return fwrite(&value, sizeof(T), 1, f) == 1;
+}
+
+}
+
+namespace rtengine
+{
+
+bool MasterFrameCache::load(const std::string& kind, const std::list<Glib::ustring>& sources, RawImage* ri, std::vector<badPix>* badPixels)
+{
+    if (!options.masterFrameCache || !ri || !ri->data) {
+        return false;
+    }
+
+    const std::string key = getKey(kind, sources);
+
+    if (key.empty()) {
+        return false;
+    }
+
+    const std::string path = getEntryPath(kind, sources);
+    FILE* const f = g_fopen(path.c_str(), "rb");
+
+    if (!f) {
+        return false;
+    }
+
+    const int width = ri->get_width();
+    const int height = ri->get_height();
+    const int rowSize = getRowSize(ri);
+
+    std::vector<float> pixels;
+    std::vector<badPix> hotPixels;
+    bool valid = false;
+    bool stale = true; // another format, or sources which have been modified since
+
+    char fileMagic[sizeof(magic)];
+    uint32_t keySize;
+
+    if (
+        fread(fileMagic, sizeof(magic), 1, f) == 1
+        && !memcmp(fileMagic, magic, sizeof(magic))
+        && readValue(f, keySize)
+        && keySize == key.size()
+    ) {
+        std::string fileKey(keySize, '\0');
+        int32_t fileWidth, fileHeight, fileRowSize;
+        uint32_t compressedSize;
+
+        stale = fread(&fileKey[0], 1, keySize, f) != keySize || fileKey != key;
+
+        if (
+            !stale
+            && readValue(f, fileWidth)
+            && readValue(f, fileHeight)
+            && readValue(f, fileRowSize)
+            && fileWidth == width
+            && fileHeight == height
+            && fileRowSize == rowSize
+            && readValue(f, compressedSize)
+        ) {
+            std::vector<Bytef> compressed(compressedSize);
+            pixels.resize(static_cast<std::size_t>(height) * rowSize);
+            uLongf pixelsSize = pixels.size() * sizeof(float);
+            uint32_t hotPixelCount;
+
+            if (
+                fread(compressed.data(), 1, compressedSize, f) == compressedSize
+                && uncompress(reinterpret_cast<Bytef*>(pixels.data()), &pixelsSize, compressed.data(), compressedSize) == Z_OK
+                && pixelsSize == pixels.size() * sizeof(float)
+                && readValue(f, hotPixelCount)
+            ) {
+                valid = true;
+
+                for (uint32_t i = 0; valid && i < hotPixelCount; ++i) {
+                    uint16_t xy[2];
+                    valid = fread(xy, sizeof(xy), 1, f) == 1;
+
+                    if (valid) {
+                        hotPixels.emplace_back(xy[0], xy[1]);
+                    }
+                }
+            }
+        }
+    }
+
+    fclose(f);
+
+    if (!valid) {
+        if (stale) {
+            g_remove(path.c_str());
+        }
+
+        return false;
+    }
+
+    // keeps the entry among the most recently used ones
+    g_utime(path.c_str(), nullptr);
+
+    for (int row = 0; row < height; ++row) {
+        memcpy(ri->data[row], &pixels[static_cast<std::size_t>(row) * rowSize], rowSize * sizeof(float));
+    }
+
+    if (badPixels) {
+        badPixels->swap(hotPixels);
+    }
+
+    if (settings->verbose) {
+        printf("Loaded the %s master frame of %d files from %s\n", kind.c_str(), static_cast<int>(sources.size()), path.c_str());
+    }
+
+    return true;
+}
+
+void MasterFrameCache::save(const std::string& kind, const std::list<Glib::ustring>& sources, const RawImage* ri, const std::vector<badPix>* badPixels)
+{
+    if (!options.masterFrameCache || !ri || !ri->data) {
+        return;
+    }
+
+    const std::string key = getKey(kind, sources);
+
+    if (key.empty()) {
+        return;
+    }
+
+    const int width = ri->get_width();
+    const int height = ri->get_height();
+    const int rowSize = getRowSize(ri);
+
+    std::vector<float> pixels(static_cast<std::size_t>(height) * rowSize);
+
+    for (int row = 0; row < height; ++row) {
+        memcpy(&pixels[static_cast<std::size_t>(row) * rowSize], ri->data[row], rowSize * sizeof(float));
+    }
+
+    uLongf compressedSize = compressBound(pixels.size() * sizeof(float));
+    std::vector<Bytef> compressed(compressedSize);
+
+    if (compress2(compressed.data(), &compressedSize, reinterpret_cast<const Bytef*>(pixels.data()), pixels.size() * sizeof(float), Z_BEST_SPEED) != Z_OK) {
+        return;
+    }
+
+    const std::string path = getEntryPath(kind, sources);
+
+    g_mkdir_with_parents(getCacheDir().c_str(), 0755);
+
+    // Written under a unique temporary name, so that another process never reads a partial entry nor writes the same file
+    std::string tmpPath = path + ".XXXXXX";
+    const int fd = g_mkstemp(&tmpPath[0]);
+
+    if (fd < 0) {
+        return;
+    }
+
+#ifdef WIN32
+    FILE* const f = _fdopen(fd, "wb");
+#else
+    FILE* const f = fdopen(fd, "wb");
+#endif
+
+    if (!f) {
+        g_close(fd, nullptr);
+        g_remove(tmpPath.c_str());
+        return;
+    }
+
+    const uint32_t hotPixelCount = badPixels ? badPixels->size() : 0;
+    bool written =
+        fwrite(magic, sizeof(magic), 1, f) == 1
+        && writeValue(f, static_cast<uint32_t>(key.size()))
+        && fwrite(key.data(), 1, key.size(), f) == key.size()
+        && writeValue(f, static_cast<int32_t>(width))
+        && writeValue(f, static_cast<int32_t>(height))
+        && writeValue(f, static_cast<int32_t>(rowSize))
+        && writeValue(f, static_cast<uint32_t>(compressedSize))
+        && fwrite(compressed.data(), 1, compressedSize, f) == compressedSize
+        && writeValue(f, hotPixelCount);
+
+    for (uint32_t i = 0; written && i < hotPixelCount; ++i) {
+        const uint16_t xy[2] = {(*badPixels)[i].x, (*badPixels)[i].y};
+        written = fwrite(xy, sizeof(xy), 1, f) == 1;
+    }
+
+    written = fclose(f) == 0 && written;
+
+    g_remove(path.c_str());
+
+    if (!written || g_rename(tmpPath.c_str(), path.c_str())) {
+        g_remove(tmpPath.c_str());
+        return;
+    }
+
+    if (settings->verbose) {
+        printf("Saved the %s master frame of %d files to %s\n", kind.c_str(), static_cast<int>(sources.size()), path.c_str());
+    }
+
+    trimCache();
+}
+
+}
@@ -0,0 +1,57 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include <glibmm/ustring.h>
+
+#include "pixelsmap.h"
+
+namespace rtengine
+{
+
+class RawImage;
+
+/**
+ * @brief On-disk cache of the master frames averaged from several dark frames or flat fields
+ *
+ * An entry holds the pixels of the master frame, compressed, and optionally its hot pixels. It is named
+ * after the kind of frame and the paths of the source files, and keyed by their size and modification
+ * time as well, so that the entry of a set whose files have been replaced is removed when found outdated.
+ * The entries are stored in the "masterframes" folder of the cache directory, the least recently used
+ * ones being removed when it exceeds Options::masterFrameCacheSize.
+ */
+class MasterFrameCache final
+{
+public:
+    /**
+     * @brief Replaces the pixels of ri by the cached master frame of sources
+     *
+     * ri has to be the first source, loaded and compressed. Its size has to match the cached frame.
+     * @param badPixels receives the cached hot pixels if not null
+     * @return false if there is no valid entry, ri is left unchanged then
+     */
+    static bool load(const std::string& kind, const std::list<Glib::ustring>& sources, RawImage* ri, std::vector<badPix>* badPixels);
+
+    // Stores the pixels of ri, and badPixels if not null, as the master frame of sources
+    static void save(const std::string& kind, const std::list<Glib::ustring>& sources, const RawImage* ri, const std::vector<badPix>* badPixels);
+};
+
+}
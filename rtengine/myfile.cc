@@ -17,6 +17,7 @@
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "myfile.h"
+#include <algorithm>
 #include <cstdarg>
 #include "rtengine.h"
 // get mmap() sorted out
@@ -127,6 +128,11 @@ IMFILE* gfopen (const char* fname)
 {
     return fopen(fname);
 }
+
+IMFILE* gfopen_metadata (const char* fname)
+{
+    return fopen(fname);
+}
 #else
 
 IMFILE* fopen (const char* fname)
@@ -174,6 +180,45 @@ IMFILE* gfopen (const char* fname)
 
     return mf;
 }
+
+IMFILE* gfopen_metadata (const char* fname)
+{
+    // The metadata readers only touch a few parts of the file, loading a whole raw file for them would be a waste
+    FILE* f = g_fopen (fname, "rb");
+
+    if (!f) {
+        return NULL;
+    }
+
+    IMFILE* mf = new IMFILE;
+    memset(mf, 0, sizeof(*mf));
+    fseek (f, 0, SEEK_END);
+    mf->size = ftell (f);
+    fseek (f, 0, SEEK_SET);
+    mf->file = f;
+    mf->pos = 0;
+    mf->eof = false;
+
+    return mf;
+}
+
+int imfile_read(IMFILE* f, void* dst, int size)
+{
+    const int avail = f->pos < f->size ? std::min<ssize_t>(size, f->size - f->pos) : 0;
+    int n = 0;
+
+    // the stream is only moved when the IMFILE was
+    if (avail > 0 && (ftell(f->file) == f->pos || !fseek(f->file, f->pos, SEEK_SET))) {
+        n = fread(dst, 1, avail, f->file);
+        f->pos += n;
+    }
+
+    if (n < size) {
+        f->eof = true;
+    }
+
+    return n;
+}
 #endif //MYFILE_MMAP
 
 IMFILE* fopen (unsigned* buf, int size)
@@ -202,6 +247,11 @@ void fclose (IMFILE* f)
     }
 
 #else
+
+    if (f->file) {
+        fclose(f->file);
+    }
+
     delete [] f->data;
 #endif
     delete f;
@@ -42,6 +42,7 @@ struct IMFILE {
     double progress_range;
     ssize_t progress_next;
     ssize_t progress_current;
+    FILE* file; // without MYFILE_MMAP, gfopen() leaves data empty and reads from there on demand
 };
 
 /*
@@ -52,8 +53,16 @@ struct IMFILE {
 void imfile_set_plistener(IMFILE *f, rtengine::ProgressListener *plistener, double progress_range);
 void imfile_update_progress(IMFILE *f);
 
+#ifndef MYFILE_MMAP
+// Reads up to size bytes at the position of an IMFILE opened by gfopen_metadata()
+int imfile_read(IMFILE *f, void* dst, int size);
+#endif
+
 IMFILE* fopen (const char* fname);
 IMFILE* gfopen (const char* fname);
+// For the metadata readers (rtexif, FramesData, DCP): without MYFILE_MMAP, the file is read on demand
+// instead of being loaded, so fdata(), fscanf() and fgets() can't be used on it
+IMFILE* gfopen_metadata (const char* fname);
 IMFILE* fopen (unsigned* buf, int size);
 void fclose (IMFILE* f);
 inline long ftell (IMFILE* f)
@@ -66,7 +75,8 @@ inline int feof (IMFILE* f)
     return f->eof;
 }
 
-inline void fseek (IMFILE* f, long p, int how)
+// Returns 0 on success and -1 if the position would be outside of the file, which is left unchanged then
+inline int fseek (IMFILE* f, long p, int how)
 {
     ssize_t fpos = f->pos;
 
@@ -77,17 +87,27 @@ inline void fseek (IMFILE* f, long p, int how)
     } else if (how == SEEK_END) {
         if (p <= 0 && -p <= f->size) {
             f->pos = f->size + p;
+            return 0;
         }
-        return;
+        return -1;
     }
 
     if (f->pos < 0  || f->pos > f->size) {
         f->pos = fpos;
+        return -1;
     }
+
+    return 0;
 }
 
 inline int fgetc (IMFILE* f)
 {
+#ifndef MYFILE_MMAP
+    if (UNLIKELY(f->file)) {
+        unsigned char c;
+        return imfile_read(f, &c, 1) == 1 ? c : EOF;
+    }
+#endif
 
     if (LIKELY(f->pos < f->size)) {
         if (f->plistener && ++f->progress_current >= f->progress_next) {
@@ -109,6 +129,11 @@ inline int getc (IMFILE* f)
 
 inline int fread (void* dst, int es, int count, IMFILE* f)
 {
+#ifndef MYFILE_MMAP
+    if (UNLIKELY(f->file)) {
+        return imfile_read(f, dst, es * count) / es;
+    }
+#endif
 
     int s = es * count;
     int avail = f->size - f->pos;
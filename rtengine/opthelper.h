@@ -39,3 +39,13 @@
     #define ALIGNED64
     #define ALIGNED16
 #endif
+
+// Heavy functions compiled for several instruction sets, the best one for the processor being
+// selected when the program is loaded. Only the code the compiler vectorizes by itself gets wider,
+// the hand written SSE code stays SSE. The files using it are built with -ffp-contract=off (see
+// rtengine/CMakeLists.txt), so that all the clones give the same results.
+#ifdef RT_TARGET_CLONES
+    #define TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+    #define TARGET_CLONES
+#endif
@@ -15,6 +15,7 @@
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <iostream>
 #include "dcraw.h"
 
@@ -103,37 +104,67 @@ void DCraw::panasonic_load_raw()
 {
     int enc_blck_size = RT_pana_info.bpp == 12 ? 10 : 9;
     if (RT_pana_info.encoding == 5) {
-        pana_bits_t pana_bits(ifp, load_flags, RT_pana_info.encoding);
-        pana_bits(0, 0);
-        unsigned bytes[16] = {};
-        for (int row = 0; row < raw_height; ++row) {
-            ushort* raw_block_data = raw_image + row * raw_width;
-
-            for (int col = 0; col < raw_width; col += enc_blck_size) {
-                pana_bits(0, bytes);
-
-                if (RT_pana_info.bpp == 12) {
-                    raw_block_data[col] = ((bytes[1] & 0xF) << 8) + bytes[0];
-                    raw_block_data[col + 1] = 16 * bytes[2] + (bytes[1] >> 4);
-                    raw_block_data[col + 2] = ((bytes[4] & 0xF) << 8) + bytes[3];
-                    raw_block_data[col + 3] = 16 * bytes[5] + (bytes[4] >> 4);
-                    raw_block_data[col + 4] = ((bytes[7] & 0xF) << 8) + bytes[6];
-                    raw_block_data[col + 5] = 16 * bytes[8] + (bytes[7] >> 4);
-                    raw_block_data[col + 6] = ((bytes[10] & 0xF) << 8) + bytes[9];
-                    raw_block_data[col + 7] = 16 * bytes[11] + (bytes[10] >> 4);
-                    raw_block_data[col + 8] = ((bytes[13] & 0xF) << 8) + bytes[12];
-                    raw_block_data[col + 9] = 16 * bytes[14] + (bytes[13] >> 4);
-                }
-                else if (RT_pana_info.bpp == 14) {
-                    raw_block_data[col] = bytes[0] + ((bytes[1] & 0x3F) << 8);
-                    raw_block_data[col + 1] = (bytes[1] >> 6) + 4 * (bytes[2]) + ((bytes[3] & 0xF) << 10);
-                    raw_block_data[col + 2] = (bytes[3] >> 4) + 16 * (bytes[4]) + ((bytes[5] & 3) << 12);
-                    raw_block_data[col + 3] = ((bytes[5] & 0xFC) >> 2) + (bytes[6] << 6);
-                    raw_block_data[col + 4] = bytes[7] + ((bytes[8] & 0x3F) << 8);
-                    raw_block_data[col + 5] = (bytes[8] >> 6) + 4 * bytes[9] + ((bytes[10] & 0xF) << 10);
-                    raw_block_data[col + 6] = (bytes[10] >> 4) + 16 * bytes[11] + ((bytes[12] & 3) << 12);
-                    raw_block_data[col + 7] = ((bytes[12] & 0xFC) >> 2) + (bytes[13] << 6);
-                    raw_block_data[col + 8] = bytes[14] + ((bytes[15] & 0x3F) << 8);
+        // The blocks of 16 bytes are read from chunks of 0x4000 bytes, which are decoded in parallel
+        constexpr int blocks_per_chunk = 0x4000 / 16;
+        const int blocks_per_row = (raw_width + enc_blck_size - 1) / enc_blck_size;
+        const int blocks = raw_height * blocks_per_row;
+        const int chunks = (blocks + blocks_per_chunk - 1) / blocks_per_chunk;
+        const int pos = ftell(ifp);
+
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+        #pragma omp parallel
+#endif
+        {
+            IMFILE ifpthr = *ifp;
+
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+            // only master thread will update the progress bar
+            ifpthr.plistener = nullptr;
+            #pragma omp master
+            {
+                ifpthr.plistener = ifp->plistener;
+            }
+#endif
+
+            pana_bits_t pana_bits(&ifpthr, load_flags, RT_pana_info.encoding);
+            unsigned bytes[16] = {};
+
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+            #pragma omp for schedule(dynamic,16) nowait
+#endif
+            for (int chunk = 0; chunk < chunks; ++chunk) {
+                fseek(&ifpthr, pos + chunk * 0x4000, SEEK_SET);
+                pana_bits(0, 0);
+
+                for (int block = chunk * blocks_per_chunk; block < std::min(blocks, (chunk + 1) * blocks_per_chunk); ++block) {
+                    pana_bits(0, bytes);
+
+                    ushort* raw_block_data = raw_image + (block / blocks_per_row) * raw_width;
+                    const int col = (block % blocks_per_row) * enc_blck_size;
+
+                    if (RT_pana_info.bpp == 12) {
+                        raw_block_data[col] = ((bytes[1] & 0xF) << 8) + bytes[0];
+                        raw_block_data[col + 1] = 16 * bytes[2] + (bytes[1] >> 4);
+                        raw_block_data[col + 2] = ((bytes[4] & 0xF) << 8) + bytes[3];
+                        raw_block_data[col + 3] = 16 * bytes[5] + (bytes[4] >> 4);
+                        raw_block_data[col + 4] = ((bytes[7] & 0xF) << 8) + bytes[6];
+                        raw_block_data[col + 5] = 16 * bytes[8] + (bytes[7] >> 4);
+                        raw_block_data[col + 6] = ((bytes[10] & 0xF) << 8) + bytes[9];
+                        raw_block_data[col + 7] = 16 * bytes[11] + (bytes[10] >> 4);
+                        raw_block_data[col + 8] = ((bytes[13] & 0xF) << 8) + bytes[12];
+                        raw_block_data[col + 9] = 16 * bytes[14] + (bytes[13] >> 4);
+                    }
+                    else if (RT_pana_info.bpp == 14) {
+                        raw_block_data[col] = bytes[0] + ((bytes[1] & 0x3F) << 8);
+                        raw_block_data[col + 1] = (bytes[1] >> 6) + 4 * (bytes[2]) + ((bytes[3] & 0xF) << 10);
+                        raw_block_data[col + 2] = (bytes[3] >> 4) + 16 * (bytes[4]) + ((bytes[5] & 3) << 12);
+                        raw_block_data[col + 3] = ((bytes[5] & 0xFC) >> 2) + (bytes[6] << 6);
+                        raw_block_data[col + 4] = bytes[7] + ((bytes[8] & 0x3F) << 8);
+                        raw_block_data[col + 5] = (bytes[8] >> 6) + 4 * bytes[9] + ((bytes[10] & 0xF) << 10);
+                        raw_block_data[col + 6] = (bytes[10] >> 4) + 16 * bytes[11] + ((bytes[12] & 3) << 12);
+                        raw_block_data[col + 7] = ((bytes[12] & 0xFC) >> 2) + (bytes[13] << 6);
+                        raw_block_data[col + 8] = bytes[14] + ((bytes[15] & 0x3F) << 8);
+                    }
                 }
             }
         }
@@ -178,58 +209,84 @@ void DCraw::panasonicC6_load_raw()
     constexpr int rowstep = 16;
     const int blocksperrow = raw_width / 11;
     const int rowbytes = blocksperrow * 16;
-    unsigned char *iobuf = (unsigned char *)malloc(rowbytes * rowstep);
-    merror(iobuf, "panasonicC6_load_raw()");
-
-    for (int row = 0; row < raw_height - rowstep + 1; row += rowstep) {
-        const int rowstoread = MIN(rowstep, raw_height - row);
-        fread(iobuf, rowbytes, rowstoread, ifp);
-        pana_cs6_page_decoder page(iobuf, rowbytes * rowstoread);
-        for (int crow = 0, col = 0; crow < rowstoread; ++crow, col = 0) {
-            unsigned short *rowptr = &raw_image[(row + crow) * raw_width];
-            for (int rblock = 0; rblock < blocksperrow; rblock++) {
-                page.read_page();
-                unsigned oddeven[2] = {0, 0}, nonzero[2] = {0, 0};
-                unsigned pmul = 0, pixel_base = 0;
-                for (int pix = 0; pix < 11; ++pix) {
-                    if (pix % 3 == 2) {
-                        unsigned base = page.nextpixel();
-                        if (base > 3) {
-                            derror();
-                        }
-                        if (base == 3) {
-                            base = 4;
-                        }
-                        pixel_base = 0x200 << base;
-                        pmul = 1 << base;
-                    }
-                    unsigned epixel = page.nextpixel();
-                    if (oddeven[pix % 2]) {
-                        epixel *= pmul;
-                        if (pixel_base < 0x2000 && nonzero[pix % 2] > pixel_base) {
-                            epixel += nonzero[pix % 2] - pixel_base;
+    const int pos = ftell(ifp);
+
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+    #pragma omp parallel
+#endif
+    {
+        IMFILE ifpthr = *ifp;
+
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+        // only master thread will update the progress bar
+        ifpthr.plistener = nullptr;
+        #pragma omp master
+        {
+            ifpthr.plistener = ifp->plistener;
+        }
+#endif
+
+        unsigned char *iobuf = (unsigned char *)malloc(rowbytes * rowstep);
+        merror(iobuf, "panasonicC6_load_raw()");
+
+        // the groups of rowstep rows have a fixed size and are decoded in parallel
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+        #pragma omp for schedule(dynamic) nowait
+#endif
+        for (int group = 0; group < raw_height / rowstep; ++group) {
+            const int row = group * rowstep;
+            const int rowstoread = rowstep;
+            fseek(&ifpthr, pos + row * rowbytes, SEEK_SET);
+            fread(iobuf, rowbytes, rowstoread, &ifpthr);
+            pana_cs6_page_decoder page(iobuf, rowbytes * rowstoread);
+            for (int crow = 0, col = 0; crow < rowstoread; ++crow, col = 0) {
+                unsigned short *rowptr = &raw_image[(row + crow) * raw_width];
+                for (int rblock = 0; rblock < blocksperrow; rblock++) {
+                    page.read_page();
+                    unsigned oddeven[2] = {0, 0}, nonzero[2] = {0, 0};
+                    unsigned pmul = 0, pixel_base = 0;
+                    for (int pix = 0; pix < 11; ++pix) {
+                        if (pix % 3 == 2) {
+                            unsigned base = page.nextpixel();
+                            if (base > 3) {
+                                derror();
+                            }
+                            if (base == 3) {
+                                base = 4;
+                            }
+                            pixel_base = 0x200 << base;
+                            pmul = 1 << base;
                         }
-                        nonzero[pix % 2] = epixel;
-                    } else {
-                        oddeven[pix % 2] = epixel;
-                        if (epixel) {
+                        unsigned epixel = page.nextpixel();
+                        if (oddeven[pix % 2]) {
+                            epixel *= pmul;
+                            if (pixel_base < 0x2000 && nonzero[pix % 2] > pixel_base) {
+                                epixel += nonzero[pix % 2] - pixel_base;
+                            }
                             nonzero[pix % 2] = epixel;
                         } else {
-                            epixel = nonzero[pix % 2];
+                            oddeven[pix % 2] = epixel;
+                            if (epixel) {
+                                nonzero[pix % 2] = epixel;
+                            } else {
+                                epixel = nonzero[pix % 2];
+                            }
+                        }
+                        const unsigned spix = epixel - 0xf;
+                        if (spix <= 0xffff) {
+                            rowptr[col++] = spix & 0xffff;
+                        } else {
+                            epixel = (((signed int)(epixel + 0x7ffffff1)) >> 0x1f);
+                            rowptr[col++] = epixel & 0x3fff;
                         }
-                    }
-                    const unsigned spix = epixel - 0xf;
-                    if (spix <= 0xffff) {
-                        rowptr[col++] = spix & 0xffff;
-                    } else {
-                        epixel = (((signed int)(epixel + 0x7ffffff1)) >> 0x1f);
-                        rowptr[col++] = epixel & 0x3fff;
                     }
                 }
             }
         }
+
+        free(iobuf);
     }
-    free(iobuf);
+
     tiff_bps = RT_pana_info.bpp;
 }
 
@@ -238,41 +295,67 @@ void DCraw::panasonicC7_load_raw()
     constexpr int rowstep = 16;
     const int pixperblock = RT_pana_info.bpp == 14 ? 9 : 10;
     const int rowbytes = raw_width / pixperblock * 16;
+    const int pos = ftell(ifp);
 
-    unsigned char *iobuf = (unsigned char *)malloc(rowbytes * rowstep);
-    merror(iobuf, "panasonicC7_load_raw()");
-    for (int row = 0; row < raw_height - rowstep + 1; row += rowstep) {
-        const int rowstoread = MIN(rowstep, raw_height - row);
-        fread (iobuf, rowbytes, rowstoread, ifp);
-        unsigned char *bytes = iobuf;
-        for (int crow = 0; crow < rowstoread; crow++) {
-            ushort *rowptr = &raw_image[(row + crow) * raw_width];
-            for (int col = 0; col < raw_width - pixperblock + 1; col += pixperblock, bytes += 16) {
-                if (RT_pana_info.bpp == 14) {
-                    rowptr[col] = bytes[0] + ((bytes[1] & 0x3F) << 8);
-                    rowptr[col + 1] = (bytes[1] >> 6) + 4 * (bytes[2]) + ((bytes[3] & 0xF) << 10);
-                    rowptr[col + 2] = (bytes[3] >> 4) + 16 * (bytes[4]) + ((bytes[5] & 3) << 12);
-                    rowptr[col + 3] = ((bytes[5] & 0xFC) >> 2) + (bytes[6] << 6);
-                    rowptr[col + 4] = bytes[7] + ((bytes[8] & 0x3F) << 8);
-                    rowptr[col + 5] = (bytes[8] >> 6) + 4 * bytes[9] + ((bytes[10] & 0xF) << 10);
-                    rowptr[col + 6] = (bytes[10] >> 4) + 16 * bytes[11] + ((bytes[12] & 3) << 12);
-                    rowptr[col + 7] = ((bytes[12] & 0xFC) >> 2) + (bytes[13] << 6);
-                    rowptr[col + 8] = bytes[14] + ((bytes[15] & 0x3F) << 8);
-                } else if (RT_pana_info.bpp == 12) { // have not seen in the wild yet
-                    rowptr[col] = ((bytes[1] & 0xF) << 8) + bytes[0];
-                    rowptr[col + 1] = 16 * bytes[2] + (bytes[1] >> 4);
-                    rowptr[col + 2] = ((bytes[4] & 0xF) << 8) + bytes[3];
-                    rowptr[col + 3] = 16 * bytes[5] + (bytes[4] >> 4);
-                    rowptr[col + 4] = ((bytes[7] & 0xF) << 8) + bytes[6];
-                    rowptr[col + 5] = 16 * bytes[8] + (bytes[7] >> 4);
-                    rowptr[col + 6] = ((bytes[10] & 0xF) << 8) + bytes[9];
-                    rowptr[col + 7] = 16 * bytes[11] + (bytes[10] >> 4);
-                    rowptr[col + 8] = ((bytes[13] & 0xF) << 8) + bytes[12];
-                    rowptr[col + 9] = 16 * bytes[14] + (bytes[13] >> 4);
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+    #pragma omp parallel
+#endif
+    {
+        IMFILE ifpthr = *ifp;
+
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+        // only master thread will update the progress bar
+        ifpthr.plistener = nullptr;
+        #pragma omp master
+        {
+            ifpthr.plistener = ifp->plistener;
+        }
+#endif
+
+        unsigned char *iobuf = (unsigned char *)malloc(rowbytes * rowstep);
+        merror(iobuf, "panasonicC7_load_raw()");
+
+        // the groups of rowstep rows have a fixed size and are decoded in parallel
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+        #pragma omp for schedule(dynamic) nowait
+#endif
+        for (int group = 0; group < raw_height / rowstep; ++group) {
+            const int row = group * rowstep;
+            const int rowstoread = rowstep;
+            fseek(&ifpthr, pos + row * rowbytes, SEEK_SET);
+            fread(iobuf, rowbytes, rowstoread, &ifpthr);
+            unsigned char *bytes = iobuf;
+            for (int crow = 0; crow < rowstoread; crow++) {
+                ushort *rowptr = &raw_image[(row + crow) * raw_width];
+                for (int col = 0; col < raw_width - pixperblock + 1; col += pixperblock, bytes += 16) {
+                    if (RT_pana_info.bpp == 14) {
+                        rowptr[col] = bytes[0] + ((bytes[1] & 0x3F) << 8);
+                        rowptr[col + 1] = (bytes[1] >> 6) + 4 * (bytes[2]) + ((bytes[3] & 0xF) << 10);
+                        rowptr[col + 2] = (bytes[3] >> 4) + 16 * (bytes[4]) + ((bytes[5] & 3) << 12);
+                        rowptr[col + 3] = ((bytes[5] & 0xFC) >> 2) + (bytes[6] << 6);
+                        rowptr[col + 4] = bytes[7] + ((bytes[8] & 0x3F) << 8);
+                        rowptr[col + 5] = (bytes[8] >> 6) + 4 * bytes[9] + ((bytes[10] & 0xF) << 10);
+                        rowptr[col + 6] = (bytes[10] >> 4) + 16 * bytes[11] + ((bytes[12] & 3) << 12);
+                        rowptr[col + 7] = ((bytes[12] & 0xFC) >> 2) + (bytes[13] << 6);
+                        rowptr[col + 8] = bytes[14] + ((bytes[15] & 0x3F) << 8);
+                    } else if (RT_pana_info.bpp == 12) { // have not seen in the wild yet
+                        rowptr[col] = ((bytes[1] & 0xF) << 8) + bytes[0];
+                        rowptr[col + 1] = 16 * bytes[2] + (bytes[1] >> 4);
+                        rowptr[col + 2] = ((bytes[4] & 0xF) << 8) + bytes[3];
+                        rowptr[col + 3] = 16 * bytes[5] + (bytes[4] >> 4);
+                        rowptr[col + 4] = ((bytes[7] & 0xF) << 8) + bytes[6];
+                        rowptr[col + 5] = 16 * bytes[8] + (bytes[7] >> 4);
+                        rowptr[col + 6] = ((bytes[10] & 0xF) << 8) + bytes[9];
+                        rowptr[col + 7] = 16 * bytes[11] + (bytes[10] >> 4);
+                        rowptr[col + 8] = ((bytes[13] & 0xF) << 8) + bytes[12];
+                        rowptr[col + 9] = 16 * bytes[14] + (bytes[13] >> 4);
+                    }
                 }
             }
         }
+
+        free(iobuf);
     }
-    free(iobuf);
+
     tiff_bps = RT_pana_info.bpp;
 }
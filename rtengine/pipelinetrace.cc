@@ -0,0 +1,285 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#ifdef WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "pipelinetrace.h"
+
+namespace
+{
+
+// Beyond that, the records are dropped to keep long GUI sessions from growing unbounded
+constexpr std::size_t maxRecords = 1 << 20;
+
+std::int64_t getThreadCpuTime()
+{
+#ifdef WIN32
+    FILETIME creation, exit, kernel, user;
+
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+
+    // FILETIME is in units of 100 ns
+    const std::int64_t k = (static_cast<std::int64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+    const std::int64_t u = (static_cast<std::int64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+    return (k + u) / 10;
+#else
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts)) {
+        return 0;
+    }
+
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+// RUSAGE_SELF would count the threads of the other images processed at the same time. OpenMP
+// reuses the threads of a team for the next parallel regions of the same thread, so the CPU time
+// of the threads the stages run on is summed over a team of the size the stages get.
+std::int64_t getTeamCpuTime(int threads)
+{
+    std::int64_t cpu = 0;
+
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(threads) reduction(+:cpu)
+#endif
+    cpu += getThreadCpuTime();
+
+    return cpu;
+}
+
+std::int64_t getCurrentRss()
+{
+#if defined(WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+
+    return counters.WorkingSetSize;
+#elif defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+        return 0;
+    }
+
+    return info.resident_size;
+#else
+    // ru_maxrss is the high-water mark of the whole process life, the current size is only in /proc
+    FILE* const file = fopen("/proc/self/statm", "r");
+
+    if (!file) {
+        return 0;
+    }
+
+    unsigned long long size, resident;
+    const bool ok = fscanf(file, "%llu %llu", &size, &resident) == 2;
+    fclose(file);
+
+    return ok ? static_cast<std::int64_t>(resident) * sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+int getThreadIndex()
+{
+    static std::atomic<int> threadCount(0);
+    thread_local const int index = threadCount++;
+    return index;
+}
+
+bool hasSuffix(const Glib::ustring& str, const char* suffix)
+{
+    const std::string s = Glib::ustring(str).lowercase();
+    const std::size_t len = std::strlen(suffix);
+    return s.size() >= len && s.compare(s.size() - len, len, suffix) == 0;
+}
+
+}
+
+namespace rtengine
+{
+
+PipelineTrace& PipelineTrace::getInstance()
+{
+    static PipelineTrace instance;
+    return instance;
+}
+
+PipelineTrace::PipelineTrace() :
+    enabled(false),
+    origin(g_get_monotonic_time()),
+    dropped(0)
+{
+}
+
+void PipelineTrace::setOutputFile(const Glib::ustring& fileName)
+{
+    MyMutex::MyLock lock(mutex);
+
+    outputFile = fileName;
+    enabled = !fileName.empty();
+}
+
+void PipelineTrace::add(const Record& record)
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (records.size() < maxRecords) {
+        records.push_back(record);
+    } else {
+        ++dropped;
+    }
+}
+
+void PipelineTrace::save()
+{
+    MyMutex::MyLock lock(mutex);
+
+    if (outputFile.empty() || records.empty()) {
+        return;
+    }
+
+    FILE* const file = g_fopen(outputFile.c_str(), "wt");
+
+    if (!file) {
+        fprintf(stderr, "PipelineTrace: unable to write \"%s\"\n", outputFile.c_str());
+        return;
+    }
+
+    if (hasSuffix(outputFile, ".json")) {
+        saveEvents(file);
+    } else {
+        saveSummary(file);
+    }
+
+    fclose(file);
+
+    if (dropped) {
+        fprintf(stderr, "PipelineTrace: %llu records dropped\n", static_cast<unsigned long long>(dropped));
+    }
+}
+
+void PipelineTrace::saveEvents(FILE* file) const
+{
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        const Record& r = records[i];
+        fprintf(file,
+            "{\"name\":\"%s\",\"cat\":\"rtengine\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,"
+            "\"args\":{\"team_cpu_us\":%lld,\"rss_growth\":%lld,\"threads\":%d}}%s\n",
+            r.name, r.thread, static_cast<long long>(r.start), static_cast<long long>(r.wall),
+            static_cast<long long>(r.cpu), static_cast<long long>(r.rssDelta), r.threads, i + 1 < records.size() ? "," : "");
+    }
+
+    fprintf(file, "]}\n");
+}
+
+void PipelineTrace::saveSummary(FILE* file) const
+{
+    struct Summary {
+        std::size_t calls = 0;
+        std::int64_t wall = 0;
+        std::int64_t cpu = 0;
+        std::int64_t rssDelta = 0;
+        int threads = 0;
+    };
+
+    // the same literal can have several addresses, so the names are compared by content
+    std::map<std::string, Summary> summaries;
+
+    for (const auto& r : records) {
+        Summary& s = summaries[r.name];
+        ++s.calls;
+        s.wall += r.wall;
+        s.cpu += r.cpu;
+        s.rssDelta = s.calls == 1 ? r.rssDelta : std::max(s.rssDelta, r.rssDelta);
+        s.threads = std::max(s.threads, r.threads);
+    }
+
+    // the largest growth of the resident memory over the calls, which is not the peak of the allocations in them:
+    // memory allocated and freed within a call doesn't show up, and pages released by others can make it negative
+    fprintf(file, "function,calls,wall_ms,team_cpu_ms,max_rss_growth_bytes,threads\n");
+
+    for (const auto& entry : summaries) {
+        const Summary& s = entry.second;
+        fprintf(file, "%s,%llu,%.3f,%.3f,%lld,%d\n", entry.first.c_str(), static_cast<unsigned long long>(s.calls), s.wall / 1000.0, s.cpu / 1000.0, static_cast<long long>(s.rssDelta), s.threads);
+    }
+}
+
+PipelineTrace::Scope::Scope(const char* name) :
+    name(name),
+    active(PipelineTrace::getInstance().isEnabled()),
+    startWall(0),
+    startCpu(0),
+    startRss(0),
+    threads(1)
+{
+    if (active) {
+#ifdef _OPENMP
+        threads = omp_get_max_threads();
+#endif
+        startRss = getCurrentRss();
+        startCpu = getTeamCpuTime(threads);
+        startWall = g_get_monotonic_time();
+    }
+}
+
+PipelineTrace::Scope::~Scope()
+{
+    if (active) {
+        const std::int64_t stopWall = g_get_monotonic_time();
+        const std::int64_t stopCpu = getTeamCpuTime(threads);
+        PipelineTrace& trace = PipelineTrace::getInstance();
+        trace.add({
+            name,
+            getThreadIndex(),
+            startWall - trace.origin,
+            stopWall - startWall,
+            stopCpu - startCpu,
+            getCurrentRss() - startRss,
+            threads
+        });
+    }
+}
+
+}
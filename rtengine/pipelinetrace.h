@@ -0,0 +1,109 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <glibmm/ustring.h>
+
+#include "noncopyable.h"
+
+#include "../rtgui/threadutils.h"
+
+// Unlike BENCHFUN, TRACEFUN is always compiled in and costs a single test when tracing is disabled
+#define TRACEFUN rtengine::PipelineTrace::Scope traceFun(__func__);
+
+namespace rtengine
+{
+
+/**
+ * @brief Runtime instrumentation of the processing pipeline
+ *
+ * When an output file is set (Settings::traceFile), each traced scope records its wall time,
+ * the CPU time of the OpenMP team of the calling thread, the change of the resident memory of
+ * the process and the number of OpenMP threads available to it. The CPU time is summed over a
+ * team of that size at both ends of the scope, which leaves out the other images processed at
+ * the same time, whereas the resident memory includes them. The resident memory (working set on
+ * Windows) is sampled at both ends of the scope only, so this growth is not the peak allocation of
+ * the scope: the buffers freed before it returns don't show up. The records are written by save(),
+ * either as Chrome trace events (output file ending with ".json", to be loaded in chrome://tracing
+ * or Perfetto) or as a CSV summary with one line per traced function.
+ */
+class PipelineTrace final :
+    public NonCopyable
+{
+public:
+    class Scope;
+
+    static PipelineTrace& getInstance();
+
+    void setOutputFile(const Glib::ustring& fileName);
+
+    bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    /** Writes the records collected so far, overwriting the output file */
+    void save();
+
+private:
+    struct Record {
+        const char* name;
+        int thread;
+        std::int64_t start;    // wall clock, in us since the tracing started
+        std::int64_t wall;     // in us
+        std::int64_t cpu;      // in us, threads of the OpenMP team
+        std::int64_t rssDelta; // in bytes, resident memory at the end minus at the start
+        int threads;
+    };
+
+    PipelineTrace();
+
+    void add(const Record& record);
+    void saveEvents(FILE* file) const;
+    void saveSummary(FILE* file) const;
+
+    std::atomic<bool> enabled;
+    std::int64_t origin;
+    std::size_t dropped;
+    Glib::ustring outputFile;
+    std::vector<Record> records;
+    mutable MyMutex mutex;
+};
+
+class PipelineTrace::Scope final :
+    public NonCopyable
+{
+public:
+    explicit Scope(const char* name);
+    ~Scope();
+
+private:
+    const char* const name;
+    const bool active;
+    std::int64_t startWall;
+    std::int64_t startCpu;
+    std::int64_t startRss;
+    int threads;
+};
+
+}
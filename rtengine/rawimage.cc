@@ -840,6 +840,51 @@ RawImage::is_ppmThumb() const
             !thumb_load_raw);
 }
 
+#ifdef RT_BENCHMARK_HOOKS
+void RawImage::initSynthetic(int width, int height, bool xtrans)
+{
+    // layout of the X-Trans II/III sensors, 0 = red, 1 = green, 2 = blue
+    constexpr int xtransPattern[6][6] = {
+        {1, 1, 0, 1, 1, 2},
+        {1, 1, 2, 1, 1, 0},
+        {2, 0, 1, 0, 2, 1},
+        {1, 1, 2, 1, 1, 0},
+        {1, 1, 0, 1, 1, 2},
+        {0, 2, 1, 2, 0, 1}
+    };
+
+    strcpy(make, "Synthetic");
+    strcpy(model, xtrans ? "X-Trans" : "Bayer");
+    this->width = raw_width = iwidth = width;
+    this->height = raw_height = iheight = height;
+    top_margin = left_margin = 0;
+    fuji_width = 0;
+    shrink = 0;
+    is_raw = 1;
+    is_foveon = 0;
+    colors = 3;
+    black = 0;
+    memset(cblack, 0, sizeof(cblack));
+    maximum = 65535;
+    filters = xtrans ? 9 : 0x94949494; // RGGB
+    prefilters = filters;
+
+    for (int row = 0; row < 6; row++) {
+        for (int col = 0; col < 6; col++) {
+            this->xtrans[row][col] = xtransPattern[row][col];
+        }
+    }
+
+    for (int c = 0; c < 4; c++) {
+        cam_mul[c] = pre_mul[c] = 1.f;
+
+        for (int i = 0; i < 3; i++) {
+            rgb_cam[i][c] = i == c;
+        }
+    }
+}
+#endif
+
 void RawImage::getXtransMatrix(int XtransMatrix[6][6])
 {
     for (int row = 0; row < 6; row++)
@@ -264,6 +264,11 @@ public:
         filters = f;
     }
 
+#ifdef RT_BENCHMARK_HOOKS
+    // Turns this image into an empty RGGB or X-Trans sensor without loading any file (used by rawtherapee-bench)
+    void initSynthetic(int width, int height, bool xtrans);
+#endif
+
 public:
     // dcraw functions
     void pre_interpolate()
@@ -51,6 +51,7 @@
 #endif
 
 #include "opthelper.h"
+#include "pipelinetrace.h"
 
 namespace
 {
@@ -638,6 +639,7 @@ float calculate_scale_mul(float scale_mul[4], const float pre_mul_[4], const flo
 
 void RawImageSource::getImage (const ColorTemp &ctemp, int tran, Imagefloat* image, const PreviewProps &pp, const ToneCurveParams &hrp, const RAWParams &raw)
 {
+    TRACEFUN
     MyMutex::MyLock lock(getImageMutex);
 
     tran = defTransform (tran);
@@ -953,6 +955,7 @@ DCPProfile *RawImageSource::getDCP(const ColorManagementParams &cmp, DCPProfileA
 
 void RawImageSource::convertColorSpace(Imagefloat* image, const ColorManagementParams &cmp, const ColorTemp &wb)
 {
+    TRACEFUN
     double pre_mul[3] = { ri->get_pre_mul(0), ri->get_pre_mul(1), ri->get_pre_mul(2) };
     colorSpaceConversion (image, cmp, wb, pre_mul, embProfile, camProfile, imatrices.xyz_cam, (static_cast<const FramesData*>(getMetaData()))->getCamera());
 }
@@ -1010,6 +1013,7 @@ void RawImageSource::vflip (Imagefloat* image)
 
 int RawImageSource::load (const Glib::ustring &fname, bool firstFrameOnly)
 {
+    TRACEFUN
 
     MyTime t1, t2;
     t1.set();
@@ -1224,11 +1228,52 @@ int RawImageSource::load (const Glib::ustring &fname, bool firstFrameOnly)
     return 0; // OK!
 }
 
+#ifdef RT_BENCHMARK_HOOKS
+void RawImageSource::setSyntheticRaw(RawImage* image, const array2D<float>& data)
+{
+    for (unsigned int i = 0; i < numFrames; ++i) {
+        delete riFrames[i];
+    }
+
+    ri = riFrames[0] = image;
+    numFrames = 1;
+    currFrame = 0;
+    W = ri->get_width();
+    H = ri->get_height();
+    fuji = false;
+    d1x = false;
+    border = ri->getSensorType() == ST_FUJI_XTRANS ? 7 : 4;
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            imatrices.rgb_cam[i][j] = imatrices.cam_rgb[i][j] = i == j;
+        }
+    }
+
+    rawData(W, H);
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int row = 0; row < H; row++) {
+        for (int col = 0; col < W; col++) {
+            rawData[row][col] = data[row][col];
+        }
+    }
+
+    green(W, H);
+    red(W, H);
+    blue(W, H);
+    rgbSourceModified = false;
+}
+#endif
+
 //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 
 void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &lensProf, const CoarseTransformParams& coarse, bool prepareDenoise)
 {
 //    BENCHFUN
+    TRACEFUN
     MyTime t1, t2;
     t1.set();
 
@@ -1566,6 +1611,7 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
 
 void RawImageSource::demosaic(const RAWParams &raw, bool autoContrast, double &contrastThreshold, bool cache)
 {
+    TRACEFUN
     MyTime t1, t2;
     t1.set();
 
@@ -1961,6 +2007,7 @@ void RawImageSource::retinexPrepareCurves(const RetinexParams &retinexParams, LU
 
 void RawImageSource::retinex(const ColorManagementParams& cmp, const RetinexParams &deh, const ToneCurveParams& Tc, LUTf & cdcurve, LUTf & mapcurve, const RetinextransmissionCurve & dehatransmissionCurve, const RetinexgaintransmissionCurve & dehagaintransmissionCurve, multi_array2D<float, 4> &conversionBuffer, bool dehacontlutili, bool mapcontlutili, bool useHsl, float &minCD, float &maxCD, float &mini, float &maxi, float &Tmean, float &Tsigma, float &Tmin, float &Tmax, LUTu &histLRETI)
 {
+    TRACEFUN
     MyTime t4, t5;
     t4.set();
 
@@ -123,6 +123,10 @@ public:
 
     int load(const Glib::ustring &fname) override { return load(fname, false); }
     int load(const Glib::ustring &fname, bool firstFrameOnly);
+#ifdef RT_BENCHMARK_HOOKS
+    // Replaces load() for rawtherapee-bench: takes ownership of image and uses data as preprocessed sensor values
+    void setSyntheticRaw(RawImage* image, const array2D<float>& data);
+#endif
     void        preprocess  (const procparams::RAWParams &raw, const procparams::LensProfParams &lensProf, const procparams::CoarseTransformParams& coarse, bool prepareDenoise = true) override;
     void        filmNegativeProcess (const procparams::FilmNegativeParams &params, std::array<float, 3>& filmBaseValues) override;
     bool        getFilmNegativeExponents (Coord2D spotA, Coord2D spotB, int tran, const procparams::FilmNegativeParams &currentParams, std::array<float, 3>& newExps) override;
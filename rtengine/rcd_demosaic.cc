@@ -46,6 +46,7 @@ namespace rtengine
 * Licensed under the GNU GPL version 3
 */
 // Tiled version by Ingo Weyrich (heckflosse67@gmx.de)
+TARGET_CLONES
 void RawImageSource::rcd_demosaic(size_t chunkSize, bool measure)
 {
     // Test for RGB cfa
@@ -656,20 +656,26 @@ public:
    * @return the resulting image, with the output profile applied, exif and iptc data set. You have to save it or you can access the pixel data directly.  */
 IImagefloat* processImage (ProcessingJob* job, int& errorCode, ProgressListener* pl = nullptr, bool flush = false);
 
-/** This class is used to control the batch processing. The class implementing this interface will be called when the full processing of an
-   * image is ready and the next job to process is needed. */
+/** This class is used to control the batch processing. The batch processing is a pipeline of three stages running concurrently:
+   * the input file of the next job is decoded and the previous image is saved while the current image is being developed.
+   * The class implementing this interface is asked for the next job when the development of an image starts, and is called
+   * when the full processing of an image is ready. */
 class BatchProcessingListener : public ProgressListener
 {
 public:
-    /** This function is called when an image gets ready during the batch processing. It has to return with the next job, or with NULL if
-                   * there is no jobs left.
-                   * @param img is the result of the last ProcessingJob
+    /** This function is called when the development of the last job returned (or of the job given to startBatchProcessing) starts.
+                   * It has to return with the next job, whose input file will be decoded in the meantime, or with NULL if there is no jobs left.
                    * @return the next ProcessingJob to process */
-    virtual ProcessingJob* imageReady(IImagefloat* img) = 0;
+    virtual ProcessingJob* nextJob() = 0;
+    /** This function is called when an image gets ready during the batch processing, from the saving stage. The images are handed
+                   * over in the order of their jobs. Errors are reported by throwing a Glib::Exception, which stops the batch processing.
+                   * @param img is the result of the oldest pending ProcessingJob */
+    virtual void imageReady(IImagefloat* img) = 0;
 };
 /** This function performs all the image processing steps corresponding to the given ProcessingJob. It runs in the background, thus it returns immediately,
-   * When it finishes, it calls the BatchProcessingListener with the resulting image and asks for the next job. It the listener gives a new job, it goes on
-   * with processing. If no new job is given, it finishes.
+   * When an image is developed, it calls the BatchProcessingListener with the resulting image. The next job is asked to the listener when the development
+   * of the previous one starts. It the listener gives a new job, it goes on with processing. If no new job is given, it finishes once the pending images are saved.
+   * If an error occurs, the pending jobs are dropped and the listener's error function is called once all the stages are stopped.
    * The ProcessingJob passed becomes invalid, you can not use it any more.
    * @param job the ProcessingJob to cancel.
    * @param bpl is the BatchProcessingListener that is called when the image is ready or the next job is needed. It also acts as a ProgressListener.
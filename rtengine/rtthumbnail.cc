@@ -26,6 +26,7 @@
 #include <glibmm/fileutils.h>
 #include <glibmm/keyfile.h>
 
+#include "cachepack.h"
 #include "cieimage.h"
 #include "color.h"
 #include "colortemp.h"
@@ -187,6 +188,49 @@ void scale_colors (rtengine::RawImage *ri, float scale_mul[4], float cblack[4],
     }
 }
 
+// Copies size bytes of a file read from the cache to dest, false if there are not enough of them left
+bool readCacheData (const std::string& data, std::size_t& pos, void* dest, std::size_t size)
+{
+    if (data.size() - pos < size) {
+        return false;
+    }
+
+    memcpy (dest, data.data() + pos, size);
+    pos += size;
+    return true;
+}
+
+// Same layout as PlanarRGBData::readData() and writeData(), in memory
+template<class T>
+void readPlanarData (const std::string& data, std::size_t& pos, T* image)
+{
+    const std::size_t rowSize = image->getWidth() * sizeof (*image->r (0));
+
+    for (int i = 0; i < image->getHeight() && readCacheData (data, pos, image->r (i), rowSize); i++) {}
+
+    for (int i = 0; i < image->getHeight() && readCacheData (data, pos, image->g (i), rowSize); i++) {}
+
+    for (int i = 0; i < image->getHeight() && readCacheData (data, pos, image->b (i), rowSize); i++) {}
+}
+
+template<class T>
+void writePlanarData (std::string& data, T* image)
+{
+    const std::size_t rowSize = image->getWidth() * sizeof (*image->r (0));
+
+    for (int i = 0; i < image->getHeight(); i++) {
+        data.append (reinterpret_cast<const char*> (image->r (i)), rowSize);
+    }
+
+    for (int i = 0; i < image->getHeight(); i++) {
+        data.append (reinterpret_cast<const char*> (image->g (i)), rowSize);
+    }
+
+    for (int i = 0; i < image->getHeight(); i++) {
+        data.append (reinterpret_cast<const char*> (image->b (i)), rowSize);
+    }
+}
+
 }
 
 namespace rtengine
@@ -416,13 +460,20 @@ Thumbnail* Thumbnail::loadQuickFromRaw (const Glib::ustring& fname, RawMetaDataL
     img->setSampleArrangement (IIOSA_CHUNKY);
 
     int err = 1;
+    int fullWidth = 0;
+    int fullHeight = 0;
 
     // See if it is something we support
     if (checkRawImageThumb (*ri)) {
         const char* data ((const char*)fdata (ri->get_thumbOffset(), ri->get_file()));
 
         if ( (unsigned char)data[1] == 0xd8 ) {
-            err = img->loadJPEGFromMemory (data, ri->get_thumbLength());
+            if (inspectorMode) {
+                err = img->loadJPEGFromMemory (data, ri->get_thumbLength());
+            } else {
+                // the embedded JPEG is often full sized, only the requested thumbnail size is decoded
+                err = img->loadJPEGFromMemory (data, ri->get_thumbLength(), fixwh == 1 ? 0 : w, fixwh == 1 ? h : 0, &fullWidth, &fullHeight);
+            }
         } else if (ri->is_ppmThumb()) {
             err = img->loadPPMFromMemory (data, ri->get_thumbWidth(), ri->get_thumbHeight(), ri->get_thumbSwap(), ri->get_thumbBPS());
         }
@@ -461,12 +512,18 @@ Thumbnail* Thumbnail::loadQuickFromRaw (const Glib::ustring& fname, RawMetaDataL
             return tpp;
         }
     } else {
+        // the scale is relative to the embedded image, even if it was decoded smaller
+        if (!fullWidth || !fullHeight) {
+            fullWidth = img->getWidth();
+            fullHeight = img->getHeight();
+        }
+
         if (fixwh == 1) {
-            w = h * img->getWidth() / img->getHeight();
-            tpp->scale = (double)img->getHeight() / h;
+            w = h * fullWidth / fullHeight;
+            tpp->scale = (double)fullHeight / h;
         } else {
-            h = w * img->getHeight() / img->getWidth();
-            tpp->scale = (double)img->getWidth() / w;
+            h = w * fullHeight / fullWidth;
+            tpp->scale = (double)fullWidth / w;
         }
     }
 
@@ -1922,35 +1979,32 @@ bool Thumbnail::writeImage (const Glib::ustring& fname)
         return false;
     }
 
-    Glib::ustring fullFName = fname + ".rtti";
-
-    FILE* f = g_fopen (fullFName.c_str (), "wb");
-
-    if (!f) {
-        return false;
-    }
-
-    fwrite (thumbImg->getType(), sizeof (char), strlen (thumbImg->getType()), f);
-    fputc ('\n', f);
+    // assembled in memory, the cache may store it in its pack
+    std::string data (thumbImg->getType());
+    data += '\n';
     guint32 w = guint32 (thumbImg->getWidth());
     guint32 h = guint32 (thumbImg->getHeight());
-    fwrite (&w, sizeof (guint32), 1, f);
-    fwrite (&h, sizeof (guint32), 1, f);
+    data.append (reinterpret_cast<const char*> (&w), sizeof (guint32));
+    data.append (reinterpret_cast<const char*> (&h), sizeof (guint32));
 
     if (thumbImg->getType() == sImage8) {
         Image8 *image = static_cast<Image8*> (thumbImg);
-        image->writeData (f);
+        data.reserve (data.size() + 3 * static_cast<std::size_t> (w) * h);
+
+        for (guint32 i = 0; i < h; i++) {
+            data.append (reinterpret_cast<const char*> (image->r (i)), 3 * w);
+        }
     } else if (thumbImg->getType() == sImage16) {
         Image16 *image = static_cast<Image16*> (thumbImg);
-        image->writeData (f);
+        data.reserve (data.size() + 3 * sizeof (unsigned short) * w * h);
+        writePlanarData (data, image);
     } else if (thumbImg->getType() == sImagefloat) {
         Imagefloat *image = static_cast<Imagefloat*> (thumbImg);
-        image->writeData (f);
+        data.reserve (data.size() + 3 * sizeof (float) * w * h);
+        writePlanarData (data, image);
     }
 
-    //thumbImg->writeData(f);
-    fclose (f);
-    return true;
+    return CachePack::writeFile (fname + ".rtti", data, false);
 }
 
 bool Thumbnail::readImage (const Glib::ustring& fname)
@@ -1961,55 +2015,57 @@ bool Thumbnail::readImage (const Glib::ustring& fname)
         thumbImg = nullptr;
     }
 
-    Glib::ustring fullFName = fname + ".rtti";
+    std::string data;
 
-    if (!Glib::file_test(fullFName, Glib::FILE_TEST_EXISTS)) {
+    if (!CachePack::readFile (fname + ".rtti", data)) {
         return false;
     }
 
-    FILE* f = g_fopen(fullFName.c_str (), "rb");
+    // 30 -> arbitrary size, but should be enough for all image type's name
+    const std::size_t typeEnd = data.find ('\n');
 
-    if (!f) {
+    if (typeEnd == std::string::npos || typeEnd >= 30) {
         return false;
     }
 
-    char imgType[31];  // 30 -> arbitrary size, but should be enough for all image type's name
-    fgets(imgType, 30, f);
-    imgType[strlen(imgType) - 1] = '\0'; // imgType has a \n trailing character, so we overwrite it by the \0 char
+    const std::string imgType = data.substr (0, typeEnd);
+    std::size_t pos = typeEnd + 1;
 
     guint32 width, height;
 
-    if (fread(&width, 1, sizeof(guint32), f) < sizeof(guint32)) {
+    if (!readCacheData (data, pos, &width, sizeof (guint32))) {
         width = 0;
     }
 
-    if (fread(&height, 1, sizeof(guint32), f) < sizeof(guint32)) {
+    if (!readCacheData (data, pos, &height, sizeof (guint32))) {
         height = 0;
     }
 
     bool success = false;
 
     if (std::min(width , height) > 0) {
-        if (!strcmp(imgType, sImage8)) {
+        if (imgType == sImage8) {
             Image8 *image = new Image8(width, height);
-            image->readData(f);
+
+            for (guint32 i = 0; i < height && readCacheData (data, pos, image->r (i), 3 * width); i++) {}
+
             thumbImg = image;
             success = true;
-        } else if (!strcmp(imgType, sImage16)) {
+        } else if (imgType == sImage16) {
             Image16 *image = new Image16(width, height);
-            image->readData(f);
+            readPlanarData (data, pos, image);
             thumbImg = image;
             success = true;
-        } else if (!strcmp(imgType, sImagefloat)) {
+        } else if (imgType == sImagefloat) {
             Imagefloat *image = new Imagefloat(width, height);
-            image->readData(f);
+            readPlanarData (data, pos, image);
             thumbImg = image;
             success = true;
         } else {
-            printf ("readImage: Unsupported image type \"%s\"!\n", imgType);
+            printf ("readImage: Unsupported image type \"%s\"!\n", imgType.c_str());
         }
     }
-    fclose(f);
+
     return success;
 }
 
@@ -2022,7 +2078,13 @@ bool Thumbnail::readData  (const Glib::ustring& fname)
         MyMutex::MyLock thmbLock (thumbMutex);
 
         try {
-            keyFile.load_from_file (fname);
+            std::string data;
+
+            if (!CachePack::readFile (fname, data)) {
+                return false;
+            }
+
+            keyFile.load_from_data (data);
         } catch (Glib::Error&) {
             return false;
         }
@@ -2156,7 +2218,11 @@ bool Thumbnail::writeData  (const Glib::ustring& fname)
         Glib::KeyFile keyFile;
 
         try {
-            keyFile.load_from_file (fname);
+            std::string data;
+
+            if (CachePack::readFile (fname, data)) {
+                keyFile.load_from_data (data);
+            }
         } catch (Glib::Error&) {}
 
         keyFile.set_double  ("LiveThumbData", "CamWBRed", camwbRed);
@@ -2198,17 +2264,12 @@ bool Thumbnail::writeData  (const Glib::ustring& fname)
         return false;
     }
 
-    FILE *f = g_fopen (fname.c_str (), "wt");
-
-    if (!f) {
+    if (!CachePack::writeFile (fname, keyData.raw (), true)) {
         if (settings->verbose) {
             printf ("Thumbnail::writeData / Error: unable to open file \"%s\" with write access!\n", fname.c_str());
         }
 
         return false;
-    } else {
-        fprintf (f, "%s", keyData.c_str ());
-        fclose (f);
     }
 
     return true;
@@ -2221,24 +2282,16 @@ bool Thumbnail::readEmbProfile  (const Glib::ustring& fname)
     embProfile = nullptr;
     embProfileLength = 0;
 
-    FILE* f = g_fopen (fname.c_str (), "rb");
+    std::string data;
 
-    if (f) {
-        if (!fseek (f, 0, SEEK_END)) {
-            int profileLength = ftell (f);
-
-            if (profileLength > 0) {
-                embProfileLength = profileLength;
-
-                if (!fseek (f, 0, SEEK_SET)) {
-                    embProfileData = new unsigned char[embProfileLength];
-                    embProfileLength = fread (embProfileData, 1, embProfileLength, f);
-                    embProfile = cmsOpenProfileFromMem (embProfileData, embProfileLength);
-                }
-            }
+    if (CachePack::readFile (fname, data)) {
+        if (!data.empty()) {
+            embProfileLength = data.size();
+            embProfileData = new unsigned char[embProfileLength];
+            memcpy (embProfileData, data.data(), embProfileLength);
+            embProfile = cmsOpenProfileFromMem (embProfileData, embProfileLength);
         }
 
-        fclose (f);
         return embProfile != nullptr;
     }
 
@@ -2249,13 +2302,7 @@ bool Thumbnail::writeEmbProfile (const Glib::ustring& fname)
 {
 
     if (embProfileData) {
-        FILE* f = g_fopen (fname.c_str (), "wb");
-
-        if (f) {
-            fwrite (embProfileData, 1, embProfileLength, f);
-            fclose (f);
-            return true;
-        }
+        return CachePack::writeFile (fname, std::string (reinterpret_cast<const char*> (embProfileData), embProfileLength), false);
     }
 
     return false;
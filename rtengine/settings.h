@@ -46,6 +46,7 @@ public:
     bool            autocielab;
     bool            rgbcurveslumamode_gamut;// controls gamut enforcement for RGB curves in lumamode
     bool            verbose;
+    Glib::ustring   traceFile;              ///< If not empty, the timings of the processing steps are written there (Chrome trace events for a .json file, CSV summary otherwise)
     Glib::ustring   darkFramesPath;         ///< The default directory for dark frames
     Glib::ustring   flatFieldsPath;         ///< The default directory for flat fields
 
@@ -29,6 +29,9 @@
 #include "clutstore.h"
 #include "processingjob.h"
 #include "procparams.h"
+#include "boundedqueue.h"
+#include <atomic>
+#include <cstring>
 #include <glibmm/ustring.h>
 #include <glibmm/thread.h>
 #include "../rtgui/options.h"
@@ -37,6 +40,7 @@
 #include "mytime.h"
 #include "guidedfilter.h"
 #include "color.h"
+#include "pipelinetrace.h"
 
 #undef THREAD_PRIORITY_NORMAL
 
@@ -144,6 +148,7 @@ private:
 
     bool stage_init()
     {
+        TRACEFUN
         errorCode = 0;
 
         if (pl) {
@@ -814,6 +819,7 @@ private:
 
     void stage_denoise()
     {
+        TRACEFUN
         const procparams::ProcParams& params = job->pparams;
 
         DirPyrDenoiseParams denoiseParams = params.dirpyrDenoise;   // make a copy because we cheat here
@@ -869,6 +875,7 @@ private:
 
     void stage_transform()
     {
+        TRACEFUN
         const procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = * (ipf_p.get());
@@ -905,6 +912,7 @@ private:
 
     Imagefloat *stage_finish()
     {
+        TRACEFUN
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = * (ipf_p.get());
@@ -970,8 +978,6 @@ private:
             CurveFactory::diagonalCurve2Lut(params.colorToning.cl2curve, cl2Toningcurve, 1);
         }
 
-        labView = new LabImage(fw, fh);
-
         if (params.blackwhite.enabled) {
             CurveFactory::curveBW(params.blackwhite.beforeCurve, params.blackwhite.afterCurve, hist16, dummy, customToneCurvebw1, customToneCurvebw2, 1);
         }
@@ -1006,6 +1012,12 @@ private:
 
         LUTu histToneCurve;
 
+        if (options.exportTileHeight > 0 && tiled_finish_supported()) {
+            return stage_finish_tiled(opautili, satLimit, satLimitOpacity, dcpProf, as);
+        }
+
+        labView = new LabImage(fw, fh);
+
         ipf.rgbProc(baseImg, labView, nullptr, curve1, curve2, curve, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit, satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve, options.chunkSizeRGB, options.measure);
 
         if (settings->verbose) {
@@ -1675,6 +1687,14 @@ private:
             }
         }
 
+        return stage_output(readyImg, tmpScale, imw, imh);
+    }
+
+    Imagefloat *stage_output(Imagefloat *readyImg, double tmpScale, int imw, int imh)
+    {
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = * (ipf_p.get());
+
         if (pl) {
             pl->setProgress(0.70);
         }
@@ -1758,8 +1778,177 @@ private:
         return readyImg;
     }
 
+    bool tiled_finish_supported()
+    {
+        const procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = * (ipf_p.get());
+
+        int imw, imh;
+        const double tmpScale = ipf.resizeScale(&params, fw, fh, imw, imh);
+        const bool labResize = params.resize.enabled && params.resize.method != "Nearest" && (tmpScale != 1.0 || params.prsharpening.enabled);
+
+        // Only point-wise tools and tools with a bounded support can be run on bands.
+        // The others need the whole image, e.g. for a mean or a histogram.
+        return
+            !(params.locallab.enabled && !params.locallab.spots.empty())
+            && params.labCurve.contrast == 0 // uses the histogram of the whole image
+            && !(params.blackwhite.enabled && params.blackwhite.autoc)
+            && !params.epd.enabled
+            && !params.defringe.enabled // uses the mean chroma of the whole image
+            && !(params.colorToning.enabled && params.colorToning.method == "LabRegions")
+            && !(params.dirpyrequalizer.enabled && params.dirpyrequalizer.cbdlMethod == "aft")
+            && !params.wavelet.enabled
+            && !params.colorappearance.enabled
+            && !labResize;
+    }
+
+    Imagefloat *stage_finish_tiled(bool opautili, float satLimit, float satLimitOpacity, DCPProfile *dcpProf, const DCPProfileApplyState &as)
+    {
+        TRACEFUN
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = * (ipf_p.get());
+
+        // Same steps as in stage_finish, but run over bands of rows so that the Lab image,
+        // the temporary buffers of the tools and the output image never exist for the whole frame.
+        // Without cropping, the output is written over baseImg.
+
+        bool utili;
+        CurveFactory::complexLCurve(params.labCurve.brightness, params.labCurve.contrast, params.labCurve.lcurve, hist16, lumacurve, dummy, 1, utili);
+
+        const bool clcutili = CurveFactory::diagonalCurve2Lut(params.labCurve.clcurve, clcurve, 1);
+
+        bool ccutili, cclutili;
+        CurveFactory::complexsgnCurve(autili, butili, ccutili, cclutili, params.labCurve.acurve, params.labCurve.bcurve, params.labCurve.cccurve,
+                                      params.labCurve.lccurve, curve1, curve2, satcurve, lhskcurve, 1);
+
+        int imw, imh;
+        const double tmpScale = ipf.resizeScale(&params, fw, fh, imw, imh);
+
+        int cx = 0, cy = 0, cw = fw, ch = fh;
+
+        if (params.crop.enabled) {
+            cx = LIM(params.crop.x, 0, fw - 1);
+            cy = LIM(params.crop.y, 0, fh - 1);
+            cw = std::min(params.crop.w, fw - cx);
+            ch = std::min(params.crop.h, fh - cy);
+        }
+
+        const int halo = ImProcFunctions::getBandHalo(params);
+        // keeps the overhead of the halos below 50%
+        const int tileHeight = std::max(options.exportTileHeight, 4 * halo);
+        const bool inPlace = cw == fw && ch == fh;
+
+        if (settings->verbose) {
+            printf("Tiled export: bands of %d rows with a halo of %d rows\n", tileHeight, halo);
+        }
+
+        Imagefloat *readyImg = inPlace ? baseImg : new Imagefloat(cw, ch);
+        // input rows above the current band, already overwritten by the output of the previous band
+        std::unique_ptr<Imagefloat> carry(inPlace && halo > 0 ? new Imagefloat(fw, halo) : nullptr);
+
+        const bool bwonly = params.blackwhite.enabled && !params.colorToning.enabled && !autili && !butili;
+        double rrm, ggm, bbm;
+        float autor = -9000.f, autog, autob;
+        LUTu histToneCurve;
+
+        for (int y = cy; y < cy + ch; y += tileHeight) {
+            const int yEnd = std::min(y + tileHeight, cy + ch);
+            const int top = std::max(y - halo, 0);
+            const int bottom = std::min(yEnd + halo, fh);
+
+            std::unique_ptr<LabImage> bandLab(new LabImage(fw, bottom - top));
+
+            {
+                Imagefloat band(fw, bottom - top);
+
+                for (int row = top; row < bottom; ++row) {
+                    const bool fromCarry = carry && row < y;
+                    const Imagefloat* const src = fromCarry ? carry.get() : baseImg;
+                    const int srcRow = fromCarry ? row - (y - halo) : row;
+                    memcpy(band.r(row - top), src->r(srcRow), fw * sizeof(float));
+                    memcpy(band.g(row - top), src->g(srcRow), fw * sizeof(float));
+                    memcpy(band.b(row - top), src->b(srcRow), fw * sizeof(float));
+                }
+
+                ipf.rgbProc(&band, bandLab.get(), nullptr, curve1, curve2, curve, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit, satLimitOpacity, ctColorCurve, ctOpacityCurve, opautili, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve, options.chunkSizeRGB, options.measure);
+            }
+
+            LabImage* const lab = bandLab.get();
+            ipf.chromiLuminanceCurve(nullptr, 1, lab, lab, curve1, curve2, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+            ipf.vibrance(lab, params.vibrance, params.toneCurve.hrenabled, params.icm.workingProfile);
+            ipf.impulsedenoise(lab);
+
+            if (params.sharpenEdge.enabled) {
+                ipf.MLsharpen(lab);
+            }
+
+            if (params.sharpenMicro.enabled) {
+                ipf.MLmicrocontrast(lab);
+            }
+
+            if (params.sharpening.enabled) {
+                ipf.sharpening(lab, params.sharpening);
+            }
+
+            ipf.softLight(lab, params.softlight);
+
+            const std::unique_ptr<Imagefloat> bandOut(ipf.lab2rgbOut(lab, cx, y - top, cw, yEnd - y, params.icm));
+            bandLab.reset();
+
+            if (carry && yEnd < cy + ch) {
+                for (int row = yEnd - halo; row < yEnd; ++row) {
+                    memcpy(carry->r(row - (yEnd - halo)), baseImg->r(row), fw * sizeof(float));
+                    memcpy(carry->g(row - (yEnd - halo)), baseImg->g(row), fw * sizeof(float));
+                    memcpy(carry->b(row - (yEnd - halo)), baseImg->b(row), fw * sizeof(float));
+                }
+            }
+
+            for (int row = y; row < yEnd; ++row) {
+                memcpy(readyImg->r(row - cy), bandOut->r(row - y), cw * sizeof(float));
+                memcpy(readyImg->g(row - cy), bandOut->g(row - y), cw * sizeof(float));
+                memcpy(readyImg->b(row - cy), bandOut->b(row - y), cw * sizeof(float));
+
+                if (bwonly) {
+                    memcpy(readyImg->r(row - cy), bandOut->g(row - y), cw * sizeof(float));
+                    memcpy(readyImg->b(row - cy), bandOut->g(row - y), cw * sizeof(float));
+                }
+            }
+
+            if (pl) {
+                pl->setProgress(0.55 + 0.15 * (yEnd - cy) / ch);
+            }
+        }
+
+        if (settings->verbose) {
+            printf("Output profile_: \"%s\"\n", params.icm.outputProfile.c_str());
+        }
+
+        // if clut was used and size of clut cache == 1 we free the memory used by the clutstore (default clut cache size = 1 for 32 bit OS)
+        if (params.filmSimulation.enabled && !params.filmSimulation.clutFilename.empty() && options.clutCacheSize == 1) {
+            CLUTStore::getInstance().clearCache();
+        }
+
+        customToneCurve1.Reset();
+        customToneCurve2.Reset();
+        ctColorCurve.Reset();
+        ctOpacityCurve.Reset();
+        noiseLCurve.Reset();
+        noiseCCurve.Reset();
+        customToneCurvebw1.Reset();
+        customToneCurvebw2.Reset();
+
+        if (!inPlace) {
+            delete baseImg;
+        }
+
+        baseImg = nullptr;
+
+        return stage_output(readyImg, tmpScale, imw, imh);
+    }
+
     void stage_early_resize()
     {
+        TRACEFUN
         procparams::ProcParams& params = job->pparams;
         //ImProcFunctions ipf (&params, true);
         ImProcFunctions &ipf = * (ipf_p.get());
@@ -1974,27 +2163,147 @@ IImagefloat* processImage(ProcessingJob* pjob, int& errorCode, ProgressListener*
     return proc();
 }
 
-void batchProcessingThread(ProcessingJob* job, BatchProcessingListener* bpl)
+namespace
+{
+
+// The batch processing runs as three stages connected by bounded queues: while an image is
+// being developed, the input file of the next job is decoded and the previous image is saved.
+// At most one decoded job and one developed image wait between two stages, which keeps the
+// memory footprint predictable.
+class BatchProcessingPipeline :
+    public NonCopyable
 {
+public:
+    explicit BatchProcessingPipeline(BatchProcessingListener* bpl) :
+        bpl(bpl),
+        aborted(false),
+        jobQueue(1),
+        decodedQueue(1),
+        imageQueue(1)
+    {
+    }
 
-    ProcessingJob* currentJob = job;
+    void run(ProcessingJob* job)
+    {
+        jobQueue.push(job);
 
-    while (currentJob) {
-        int errorCode;
-        IImagefloat* img = processImage(currentJob, errorCode, bpl, true);
+        Glib::Thread* const decoder = Glib::Thread::create(sigc::mem_fun(*this, &BatchProcessingPipeline::decodeStage), 0, true, true, Glib::THREAD_PRIORITY_LOW);
+        Glib::Thread* const saver = Glib::Thread::create(sigc::mem_fun(*this, &BatchProcessingPipeline::saveStage), 0, true, true, Glib::THREAD_PRIORITY_LOW);
+
+        developStage();
+
+        decoder->join();
+        saver->join();
+
+        // the listener is told about the error once nothing is in flight anymore
+        if (aborted) {
+            bpl->error(errorMessage);
+        }
+    }
+
+private:
+    void abort(const Glib::ustring& message)
+    {
+        {
+            MyMutex::MyLock lock(errorMutex);
+
+            if (!aborted) {
+                errorMessage = message;
+                aborted = true;
+            }
+        }
+
+        jobQueue.close();
+    }
+
+    void decodeStage()
+    {
+        ProcessingJob* job;
+
+        while (jobQueue.pop(job)) {
+            ProcessingJobImpl* const jobImpl = static_cast<ProcessingJobImpl*>(job);
+
+            if (!aborted && !jobImpl->initialImage) {
+                // loading errors are reported by the development stage, which tries again
+                int errorCode = 0;
+                jobImpl->initialImage = InitialImage::load(jobImpl->fname, jobImpl->isRaw, &errorCode);
+            }
+
+            if (aborted || !decodedQueue.push(job)) {
+                ProcessingJob::destroy(job);
+            }
+        }
+
+        decodedQueue.close();
+    }
+
+    void developStage()
+    {
+        ProcessingJob* job;
+
+        while (decodedQueue.pop(job)) {
+            if (aborted) {
+                ProcessingJob::destroy(job);
+                continue;
+            }
+
+            // asking for the next job tells the listener that this one is being developed
+            ProcessingJob* const next = bpl->nextJob();
+
+            if (!next) {
+                jobQueue.close();
+            } else if (!jobQueue.push(next)) {
+                ProcessingJob::destroy(next);
+            }
+
+            int errorCode;
+            IImagefloat* const img = processImage(job, errorCode, bpl, true);
+
+            if (errorCode) {
+                abort(M("MAIN_MSG_CANNOTLOAD"));
+            } else if (!imageQueue.push(img)) {
+                delete img;
+            }
+        }
+
+        imageQueue.close();
+    }
+
+    void saveStage()
+    {
+        IImagefloat* img;
+
+        while (imageQueue.pop(img)) {
+            if (aborted) {
+                delete img;
+                continue;
+            }
 
-        if (errorCode) {
-            bpl->error(M("MAIN_MSG_CANNOTLOAD"));
-            currentJob = nullptr;
-        } else {
             try {
-                currentJob = bpl->imageReady(img);
+                bpl->imageReady(img);
             } catch (Glib::Exception& ex) {
-                bpl->error(ex.what());
-                currentJob = nullptr;
+                abort(ex.what());
             }
         }
     }
+
+    BatchProcessingListener* const bpl;
+
+    std::atomic<bool> aborted;
+    Glib::ustring errorMessage;
+    MyMutex errorMutex;
+
+    BoundedQueue<ProcessingJob*> jobQueue;
+    BoundedQueue<ProcessingJob*> decodedQueue;
+    BoundedQueue<IImagefloat*> imageQueue;
+};
+
+void batchProcessingThread(ProcessingJob* job, BatchProcessingListener* bpl)
+{
+    BatchProcessingPipeline pipeline(bpl);
+    pipeline.run(job);
+}
+
 }
 
 void startBatchProcessing(ProcessingJob* job, BatchProcessingListener* bpl)
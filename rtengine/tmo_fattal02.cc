@@ -67,6 +67,7 @@
 
 #include "array2D.h"
 #include "color.h"
+#include "fftwplans.h"
 #include "iccstore.h"
 #include "imagefloat.h"
 #include "improcfun.h"
@@ -77,6 +78,7 @@
 #include "settings.h"
 #include "sleef.h"
 #include "StopWatch.h"
+#include "pipelinetrace.h"
 
 namespace rtengine
 {
@@ -85,8 +87,6 @@ namespace rtengine
  * RT code
  ******************************************************************************/
 
-extern MyMutex *fftwMutex;
-
 using namespace std;
 
 namespace
@@ -653,10 +653,7 @@ void tmo_fattal02(size_t width,
     //delete Gx; // RT - reused as temp buffer in solve_pde_fft, deleted later
 
     // solve pde and exponentiate (ie recover compressed image)
-    {
-        MyMutex::MyLock lock(*fftwMutex);
-        solve_pde_fft(FI, &L, Gx, multithread, algo);
-    }
+    solve_pde_fft(FI, &L, Gx, multithread, algo);
     delete Gx;
     delete FI;
 
@@ -773,11 +770,8 @@ void transform_ev2normal(Array2Df *A, Array2Df *T, bool multithread)
     // fftwf_free(in);
 
     // executes 2d discrete cosine transform
-    fftwf_plan p;
-    p = fftwf_plan_r2r_2d(height, width, A->data(), T->data(),
-                          FFTW_REDFT00, FFTW_REDFT00, FFTW_ESTIMATE);
-    fftwf_execute(p);
-    fftwf_destroy_plan(p);
+    const FFTWPlanCache::Plan p = FFTWPlanCache::getInstance().getR2R(height, width, FFTW_REDFT00, FFTW_REDFT00, A->data(), T->data(), FFTW_ESTIMATE, multithread);
+    fftwf_execute_r2r(p.get(), A->data(), T->data());
 }
 
 
@@ -789,11 +783,8 @@ void transform_normal2ev(Array2Df *A, Array2Df *T, bool multithread)
     assert((int)T->getCols() == width && (int)T->getRows() == height);
 
     // executes 2d discrete cosine transform
-    fftwf_plan p;
-    p = fftwf_plan_r2r_2d(height, width, A->data(), T->data(),
-                          FFTW_REDFT00, FFTW_REDFT00, FFTW_ESTIMATE);
-    fftwf_execute(p);
-    fftwf_destroy_plan(p);
+    const FFTWPlanCache::Plan p = FFTWPlanCache::getInstance().getR2R(height, width, FFTW_REDFT00, FFTW_REDFT00, A->data(), T->data(), FFTW_ESTIMATE, multithread);
+    fftwf_execute_r2r(p.get(), A->data(), T->data());
 
     // need to scale the output matrix to get the right transform
     float factor = (1.0f / ((height - 1) * (width - 1)));
@@ -884,18 +875,6 @@ void solve_pde_fft(Array2Df *F, Array2Df *U, Array2Df *buf, bool multithread, in
     assert((int)U->getCols() == width && (int)U->getRows() == height);
     assert(buf->getCols() == width && buf->getRows() == height);
 
-    // activate parallel execution of fft routines
-#ifdef RT_FFTW3F_OMP
-
-    if (multithread) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads(omp_get_max_threads());
-    }
-
-// #else
-//   fftwf_plan_with_nthreads( 2 );
-#endif
-
     // in general there might not be a solution to the Poisson pde
     // with Neumann boundary conditions unless the boundary satisfies
     // an integral condition, this function modifies the boundary so that
@@ -1068,6 +1047,7 @@ void ImProcFunctions::ToneMapFattal02(Imagefloat *rgb, const FattalToneMappingPa
 //algo allows to use ART algorithme algo = 0 RT, algo = 1 ART
 //Lalone allows to use L without RGB values in RT mode
 {
+    TRACEFUN
     if (!fatParams.enabled) {
         return;
     }
@@ -0,0 +1,186 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "transformgrid.h"
+
+#include "opthelper.h"
+#include "rt_math.h"
+
+namespace
+{
+
+// Grids of the preview, a few detail windows and an export
+constexpr std::size_t maxGrids = 6;
+
+// Rounded towards minus infinity
+inline int floorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((b - 1 - a) / b);
+}
+
+// Linear interpolation between a at the start of the cell and b at its end, for the pixels first to end - 1 of the cell
+inline void fillCell(float* out, float a, float b, int first, int end)
+{
+    constexpr float invStep = 1.f / rtengine::TransformGrid::step;
+    const float d = b - a;
+    int i = first;
+
+#ifdef __SSE2__
+    if (first == 0 && end == rtengine::TransformGrid::step) {
+        const vfloat av = F2V(a);
+        const vfloat dv = F2V(d * invStep);
+        const vfloat rampv = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+        const vfloat fourv = F2V(4.f);
+
+        for (vfloat iv = rampv; i < end; i += 4, iv += fourv) {
+            STVFU(out[i - first], av + dv * iv);
+        }
+
+        return;
+    }
+#endif
+
+    for (; i < end; ++i) {
+        out[i - first] = a + d * (i * invStep);
+    }
+}
+
+}
+
+namespace rtengine
+{
+
+constexpr int TransformGrid::step;
+
+TransformGrid::TransformGrid(int x, int y, int width, int height) :
+    originX(floorDiv(x, step) * step),
+    originY(floorDiv(y, step) * step),
+    cols((x + std::max(width - 1, 0) - originX) / step + 2),
+    rows((y + std::max(height - 1, 0) - originY) / step + 2),
+    dxc(static_cast<std::size_t>(cols) * rows),
+    dyc(static_cast<std::size_t>(cols) * rows),
+    s(static_cast<std::size_t>(cols) * rows)
+{
+}
+
+bool TransformGrid::covers(int x, int y, int width, int height) const
+{
+    return
+        x >= originX
+        && y >= originY
+        && x + width - 1 <= originX + (cols - 1) * step
+        && y + height - 1 <= originY + (rows - 1) * step;
+}
+
+void TransformGrid::interpolateRow(int y, int x0, int width, float* dxcOut, float* dycOut, float* sOut) const
+{
+    // from here on, the coordinates are relative to the first node
+    y -= originY;
+    x0 -= originX;
+
+    const int gy = LIM(floorDiv(y, step), 0, rows - 2);
+    const float fy = static_cast<float>(y - gy * step) / step;
+
+    const std::vector<float>* const planes[3] = {&dxc, &dyc, &s};
+    float* const outs[3] = {dxcOut, dycOut, sOut};
+
+    for (int x = x0; x < x0 + width;) {
+        const int gx = LIM(floorDiv(x, step), 0, cols - 2);
+        // the first and last cells are extended to the pixels outside the grid
+        const int cellStart = gx * step;
+        const int cellEnd = gx == cols - 2 ? x0 + width : cellStart + step;
+        const int end = std::min(x0 + width, cellEnd);
+        const std::size_t top = static_cast<std::size_t>(gy) * cols + gx;
+        const std::size_t bottom = top + cols;
+
+        for (int p = 0; p < 3; ++p) {
+            const std::vector<float>& plane = *planes[p];
+            const float a = intp(fy, plane[bottom], plane[top]);
+            const float b = intp(fy, plane[bottom + 1], plane[top + 1]);
+            fillCell(outs[p] + (x - x0), a, b, x - cellStart, end - cellStart);
+        }
+
+        x = end;
+    }
+}
+
+bool TransformGridKey::operator ==(const TransformGridKey& other) const
+{
+    return
+        oW == other.oW
+        && oH == other.oH
+        && ascale == other.ascale
+        && rotate == other.rotate
+        && distortion == other.distortion
+        && perspective == other.perspective
+        && lensDistortion == other.lensDistortion
+        && (!lensDistortion || (
+            lensProf == other.lensProf
+            && coarse == other.coarse
+            && rawRotationDeg == other.rawRotationDeg
+            && make == other.make
+            && model == other.model
+            && lens == other.lens
+            && focalLen == other.focalLen
+            && focalLen35mm == other.focalLen35mm
+            && fNumber == other.fNumber
+            && focusDist == other.focusDist
+        ));
+}
+
+TransformGridCache& TransformGridCache::getInstance()
+{
+    static TransformGridCache instance;
+    return instance;
+}
+
+std::shared_ptr<const TransformGrid> TransformGridCache::get(const TransformGridKey& key, int x, int y, int width, int height)
+{
+    MyMutex::MyLock lock(mutex);
+
+    for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+        if (entry->key == key && entry->grid->covers(x, y, width, height)) {
+            entries.splice(entries.begin(), entries, entry);
+            return entry->grid;
+        }
+    }
+
+    return nullptr;
+}
+
+void TransformGridCache::put(const TransformGridKey& key, const std::shared_ptr<const TransformGrid>& grid)
+{
+    MyMutex::MyLock lock(mutex);
+
+    for (auto entry = entries.begin(); entry != entries.end();) {
+        const TransformGrid& other = *entry->grid;
+
+        if (entry->key == key && grid->covers(other.getX(), other.getY(), (other.getCols() - 1) * TransformGrid::step + 1, (other.getRows() - 1) * TransformGrid::step + 1)) {
+            // built concurrently by another pipeline, or for a smaller area
+            entry = entries.erase(entry);
+        } else {
+            ++entry;
+        }
+    }
+
+    entries.push_front({key, grid});
+
+    if (entries.size() > maxGrids) {
+        entries.pop_back();
+    }
+}
+
+}
@@ -0,0 +1,154 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "noncopyable.h"
+#include "procparams.h"
+
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+/**
+ * @brief The geometric part of transformGeneral() (perspective, lens distortion, rotation and distortion)
+ * sampled every TransformGrid::step pixels over an area of the full image
+ *
+ * Each node holds the rotated source coordinates relative to the center of the image (Dxc, Dyc) and the
+ * distortion scale s, as computed by transformGeneral(). They are smooth functions of the position, so
+ * interpolating them bilinearly between the nodes is far below the precision of the pixel interpolation.
+ */
+class TransformGrid final :
+    public NonCopyable
+{
+public:
+    static constexpr int step = 8;
+
+    // Grid covering the width x height pixels at (x, y) of the full image, its nodes being aligned on multiples of step
+    TransformGrid(int x, int y, int width, int height);
+
+    // Full image coordinates of the first node
+    int getX() const
+    {
+        return originX;
+    }
+
+    int getY() const
+    {
+        return originY;
+    }
+
+    int getCols() const
+    {
+        return cols;
+    }
+
+    int getRows() const
+    {
+        return rows;
+    }
+
+    void set(int row, int col, double dxc, double dyc, double s)
+    {
+        const std::size_t i = static_cast<std::size_t>(row) * cols + col;
+        this->dxc[i] = dxc;
+        this->dyc[i] = dyc;
+        this->s[i] = s;
+    }
+
+    // Whether the grid covers the width x height pixels at (x, y)
+    bool covers(int x, int y, int width, int height) const;
+
+    /**
+     * @brief Interpolates Dxc, Dyc and s for the pixels x0 to x0 + width - 1 of row y, in full image coordinates
+     *
+     * Pixels outside the grid are extrapolated from the nearest cells.
+     */
+    void interpolateRow(int y, int x0, int width, float* dxcOut, float* dycOut, float* sOut) const;
+
+private:
+    int originX;
+    int originY;
+    int cols;
+    int rows;
+    std::vector<float> dxc;
+    std::vector<float> dyc;
+    std::vector<float> s;
+};
+
+/**
+ * @brief The parameters the geometric transform of transformGeneral() depends on
+ *
+ * The lens correction object is rebuilt for each call, so it is identified by the parameters and the
+ * metadata it is created from.
+ */
+struct TransformGridKey {
+    int oW;
+    int oH;
+    double ascale;
+    double rotate;
+    double distortion;
+    procparams::PerspectiveParams perspective;
+    bool lensDistortion;
+    procparams::LensProfParams lensProf;
+    procparams::CoarseTransformParams coarse;
+    int rawRotationDeg;
+    std::string make;
+    std::string model;
+    std::string lens;
+    double focalLen;
+    double focalLen35mm;
+    double fNumber;
+    float focusDist;
+
+    bool operator ==(const TransformGridKey& other) const;
+};
+
+/**
+ * @brief The last grids used, shared by the preview, the detail windows and the exports
+ *
+ * Panning a detail window within the margin of its grid or exporting several images shot with the same
+ * lens and settings reuses them.
+ */
+class TransformGridCache final :
+    public NonCopyable
+{
+public:
+    static TransformGridCache& getInstance();
+
+    // A grid of key covering the width x height pixels at (x, y), or nullptr
+    std::shared_ptr<const TransformGrid> get(const TransformGridKey& key, int x, int y, int width, int height);
+    void put(const TransformGridKey& key, const std::shared_ptr<const TransformGrid>& grid);
+
+private:
+    TransformGridCache() = default;
+
+    struct Entry {
+        TransformGridKey key;
+        std::shared_ptr<const TransformGrid> grid;
+    };
+
+    MyMutex mutex;
+    std::list<Entry> entries; // most recently used first
+};
+
+}
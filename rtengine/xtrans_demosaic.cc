@@ -178,6 +178,7 @@ void RawImageSource::xtransborder_interpolate (int border, array2D<float> &red,
 */
 // override CLIP function to test unclipped output
 #define CLIP(x) (x)
+TARGET_CLONES
 void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab, size_t chunkSize, bool measure)
 {
 
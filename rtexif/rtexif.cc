@@ -18,6 +18,7 @@
  *  You should have received a copy of the GNU General Public License
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 #include <cmath>
@@ -47,6 +48,29 @@ using namespace std;
 namespace rtexif
 {
 
+namespace
+{
+
+// fseek() on an IMFILE refuses a position past the end of the file and keeps the current one.
+// Accept it like a FILE does, so that the following reads fail instead of reading from the old position.
+int seek (IMFILE* f, long offset, int whence)
+{
+    const long pos =
+        whence == SEEK_SET
+            ? offset
+            : whence == SEEK_CUR
+                ? ftell (f) + offset
+                : f->size + offset;
+
+    if (pos < 0) {
+        return -1;
+    }
+
+    return fseek (f, std::min<long> (pos, f->size), SEEK_SET);
+}
+
+}
+
 Interpreter stdInterpreter;
 
 //--------------- class TagDirectory ------------------------------------------
@@ -59,7 +83,7 @@ TagDirectory::TagDirectory ()
 TagDirectory::TagDirectory (TagDirectory* p, const TagAttrib* ta, ByteOrder border)
     : attribs (ta), order (border), parent (p), parseJPEG(true) {}
 
-TagDirectory::TagDirectory (TagDirectory* p, FILE* f, int base, const TagAttrib* ta, ByteOrder border, bool skipIgnored, bool parseJpeg)
+TagDirectory::TagDirectory (TagDirectory* p, IMFILE* f, int base, const TagAttrib* ta, ByteOrder border, bool skipIgnored, bool parseJpeg)
     : attribs (ta), order (border), parent (p), parseJPEG(parseJpeg)
 {
 
@@ -843,11 +867,11 @@ TagDirectoryTable::TagDirectoryTable (TagDirectory* p, unsigned char *v, int mem
     }
 }
 
-TagDirectoryTable::TagDirectoryTable (TagDirectory* p, FILE* f, int memsize, int offs, TagType type, const TagAttrib* ta, ByteOrder border)
+TagDirectoryTable::TagDirectoryTable (TagDirectory* p, IMFILE* f, int memsize, int offs, TagType type, const TagAttrib* ta, ByteOrder border)
     : TagDirectory (p, ta, border), zeroOffset (offs), valuesSize (memsize), defaultType ( type )
 {
     values = new unsigned char[valuesSize];
-    if (fread (values, 1, valuesSize, f) == static_cast<size_t>(valuesSize)) {
+    if (fread (values, 1, valuesSize, f) == valuesSize) {
 
         // Security ; will avoid to read above the buffer limit if the RT's tagDirectoryTable is longer that what's in the file
         int count = valuesSize / getTypeSize (type);
@@ -890,7 +914,7 @@ int TagDirectoryTable::write (int start, unsigned char* buffer)
 // this class represents a tag stored in the directory
 //-----------------------------------------------------------------------------
 
-Tag::Tag (TagDirectory* p, FILE* f, int base)
+Tag::Tag (TagDirectory* p, IMFILE* f, int base)
     : type (INVALID), count (0), value (nullptr), allocOwnMemory (true), attrib (nullptr), parent (p), directory (nullptr)
 {
 
@@ -923,7 +947,7 @@ Tag::Tag (TagDirectory* p, FILE* f, int base)
     valuesize = count * getTypeSize (type);
 
     if (valuesize > 4) {
-        fseek (f, get4 (f, getOrder()) + base, SEEK_SET);
+        seek (f, get4 (f, getOrder()) + base, SEEK_SET);
     }
 
     attrib = parent->getAttrib (tag);
@@ -967,12 +991,12 @@ Tag::Tag (TagDirectory* p, FILE* f, int base)
             /* SONY uses this tag to write hidden info and pointer to private encrypted tags
             {
              unsigned offset =sget4((unsigned char*)buffer, order);
-             fseek(f,offset,SEEK_SET);
+             seek(f,offset,SEEK_SET);
              makerNoteKind = TABLESUBDIR;
              directory = new TagDirectory*[2];
              directory[0] = new TagDirectory (parent, f, base, sonyDNGMakerNote, order);
              directory[1] = NULL;
-             fseek (f, save, SEEK_SET);
+             seek (f, save, SEEK_SET);
              return;
             }*/
         {
@@ -1006,7 +1030,7 @@ Tag::Tag (TagDirectory* p, FILE* f, int base)
     if (tag == 0x927C && attrib && !strcmp (attrib->name, "MakerNote") ) {
         if ( !parseMakerNote (f, base, order )) {
             type = INVALID;
-            fseek (f, save, SEEK_SET);
+            seek (f, save, SEEK_SET);
             return;
         }
     } else if (attrib && attrib->subdirAttribs) {
@@ -1216,13 +1240,13 @@ Tag::Tag (TagDirectory* p, FILE* f, int base)
     }
 
     // seek back to the saved position
-    fseek (f, save, SEEK_SET);
+    seek (f, save, SEEK_SET);
     return;
 
 defsubdirs:
     // read value
     value = new unsigned char [valuesize];
-    if (fread (value, 1, valuesize, f) != static_cast<size_t>(valuesize)) {
+    if (fread (value, 1, valuesize, f) != valuesize) {
         type = INVALID;
     } else {
         // count the number of valid subdirs
@@ -1239,7 +1263,7 @@ defsubdirs:
             // load directories
             for (size_t j = 0, i = 0; j < count; j++, i++) {
                 int newpos = base + toInt (j * 4, LONG);
-                fseek (f, newpos, SEEK_SET);
+                seek (f, newpos, SEEK_SET);
                 directory[i] = new TagDirectory (parent, f, base, attrib->subdirAttribs, order, true, parent->getParseJpeg());
             }
 
@@ -1250,12 +1274,12 @@ defsubdirs:
         }
     }
     // seek back to the saved position
-    fseek (f, save, SEEK_SET);
+    seek (f, save, SEEK_SET);
     return;
 
 }
 
-bool Tag::parseMakerNote (FILE* f, int base, ByteOrder bom )
+bool Tag::parseMakerNote (IMFILE* f, int base, ByteOrder bom )
 {
     value = nullptr;
     Tag* tmake = parent->getRoot()->findTag ("Make");
@@ -1347,7 +1371,7 @@ bool Tag::parseMakerNote (FILE* f, int base, ByteOrder bom )
             makerNoteKind = HEADERIFD;
         } else {
             makerNoteKind = IFD;
-            fseek (f, -12, SEEK_CUR);
+            seek (f, -12, SEEK_CUR);
         }
 
         directory = new TagDirectory*[2];
@@ -2159,7 +2183,7 @@ Tag* ExifManager::saveCIFFMNTag (TagDirectory* root, int len, const char* name)
         Tag* cs = new Tag (mn, lookupAttrib (canonAttribs, name));
         cs->initUndefArray (data, len);
         mn->addTag (cs);
-        fseek (f, s, SEEK_SET);
+        seek (f, s, SEEK_SET);
         delete [] data;
         return cs;
     } else {
@@ -2180,12 +2204,12 @@ void ExifManager::parseCIFF (int length, TagDirectory* root)
     char buffer[1024];
     Tag* t;
 
-    if (fseek(f, rml->ciffBase + length - 4, SEEK_SET)) {
+    if (seek(f, rml->ciffBase + length - 4, SEEK_SET)) {
         return;
     }
 
     int dirStart = get4 (f, INTEL) + rml->ciffBase;
-    if (fseek(f, dirStart, SEEK_SET)) {
+    if (seek(f, dirStart, SEEK_SET)) {
         return;
     }
 
@@ -2211,7 +2235,7 @@ void ExifManager::parseCIFF (int length, TagDirectory* root)
         int nextPos = ftell (f) + 4;
 
         // seek to the location of the value
-        fseek (f, rml->ciffBase + get4 (f, INTEL), SEEK_SET);
+        seek (f, rml->ciffBase + get4 (f, INTEL), SEEK_SET);
 
         if ((((type >> 8) + 8) | 8) == 0x38) {
             ExifManager(
@@ -2238,7 +2262,7 @@ void ExifManager::parseCIFF (int length, TagDirectory* root)
             t = new Tag (root, lookupAttrib (ifdAttribs, "Make"));
             t->initString (buffer);
             root->addTag (t);
-            if (!fseek (f, strlen (buffer) - 63, SEEK_CUR)) {
+            if (!seek (f, strlen (buffer) - 63, SEEK_CUR)) {
                 if (fread (buffer, 64, 1, f) == 1) {
                     t = new Tag (root, lookupAttrib (ifdAttribs, "Model"));
                     t->initString (buffer);
@@ -2368,7 +2392,7 @@ void ExifManager::parseCIFF (int length, TagDirectory* root)
             fnumber = pow (2, aperture / 2);
             shutter = ((short)get2 (f, INTEL)) / 32.0f;
             ev = ((short)get2 (f, INTEL)) / 32.0f;
-            fseek (f, 34, SEEK_CUR);
+            seek (f, 34, SEEK_CUR);
 
             if (shutter > 1e6f) {
                 shutter = get2 (f, INTEL) / 10.0f;
@@ -2398,7 +2422,7 @@ void ExifManager::parseCIFF (int length, TagDirectory* root)
             timestamp = mktime (gmtime (&timestamp));
         }
 
-        fseek (f, nextPos, SEEK_SET);
+        seek (f, nextPos, SEEK_SET);
     }
 
     if (shutter > -999) {
@@ -2818,7 +2842,7 @@ void ExifManager::parse (bool isRaw, bool skipIgnored, bool parseJpeg)
 
     if (order == ByteOrder::UNKNOWN) {
         // read tiff header
-        fseek (f, rml->exifBase, SEEK_SET);
+        seek (f, rml->exifBase, SEEK_SET);
         unsigned short bo;
         fread (&bo, 1, 2, f);
         order = (ByteOrder) ((int)bo);
@@ -2830,7 +2854,7 @@ void ExifManager::parse (bool isRaw, bool skipIgnored, bool parseJpeg)
 
     do {
         // seek to IFD
-        fseek (f, rml->exifBase + ifdOffset, SEEK_SET);
+        seek (f, rml->exifBase + ifdOffset, SEEK_SET);
 
         // first read the IFD directory
         TagDirectory* root =  new TagDirectory (nullptr, f, rml->exifBase, ifdAttribs, order, skipIgnored, parseJpeg);
@@ -2868,7 +2892,7 @@ void ExifManager::parse (bool isRaw, bool skipIgnored, bool parseJpeg)
         if (make && !strncmp ((char*)make->getValue(), "Kodak", 5)) {
             if (!exif) {
                 // old Kodak cameras may have exif tags in IFD0, reparse and create an exif subdir
-                fseek (f, rml->exifBase + ifdOffset, SEEK_SET);
+                seek (f, rml->exifBase + ifdOffset, SEEK_SET);
                 TagDirectory* exifdir =  new TagDirectory (nullptr, f, rml->exifBase, exifAttribs, order, true);
 
                 exif = new Tag (root, root->getAttrib ("Exif"));
@@ -3169,7 +3193,7 @@ void ExifManager::parseJPEG (int offset)
         return;
     }
 
-    if(!fseek (f, offset, SEEK_SET)) {
+    if(!seek (f, offset, SEEK_SET)) {
         unsigned char c;
         if(fread (&c, 1, 1, f) == 1) {
             constexpr unsigned char markerl = 0xff;
@@ -3428,7 +3452,7 @@ int sget4 (unsigned char *s, rtexif::ByteOrder order)
     }
 }
 
-inline unsigned short get2 (FILE* f, rtexif::ByteOrder order)
+inline unsigned short get2 (IMFILE* f, rtexif::ByteOrder order)
 {
 
     unsigned char str[2] = { 0xff, 0xff };
@@ -3436,7 +3460,7 @@ inline unsigned short get2 (FILE* f, rtexif::ByteOrder order)
     return rtexif::sget2 (str, order);
 }
 
-int get4 (FILE* f, rtexif::ByteOrder order)
+int get4 (IMFILE* f, rtexif::ByteOrder order)
 {
 
     unsigned char str[4] = { 0xff, 0xff, 0xff, 0xff };
@@ -31,6 +31,7 @@
 
 #include <glibmm/ustring.h>
 
+#include "../rtengine/myfile.h"
 #include "../rtengine/noncopyable.h"
 #include "../rtengine/rawmetadatalocation.h"
 
@@ -74,8 +75,8 @@ bool extractLensInfo (const std::string &fullname, double &minFocal, double &max
 
 unsigned short sget2 (unsigned char *s, ByteOrder order);
 int sget4 (unsigned char *s, ByteOrder order);
-unsigned short get2 (FILE* f, ByteOrder order);
-int get4 (FILE* f, ByteOrder order);
+unsigned short get2 (IMFILE* f, ByteOrder order);
+int get4 (IMFILE* f, ByteOrder order);
 void sset2 (unsigned short v, unsigned char *s, ByteOrder order);
 void sset4 (int v, unsigned char *s, ByteOrder order);
 float int_to_float (int i);
@@ -124,7 +125,7 @@ protected:
 
 public:
     TagDirectory ();
-    TagDirectory (TagDirectory* p, FILE* f, int base, const TagAttrib* ta, ByteOrder border, bool skipIgnored = true, bool parseJpeg = true);
+    TagDirectory (TagDirectory* p, IMFILE* f, int base, const TagAttrib* ta, ByteOrder border, bool skipIgnored = true, bool parseJpeg = true);
     TagDirectory (TagDirectory* p, const TagAttrib* ta, ByteOrder border);
     virtual ~TagDirectory ();
 
@@ -208,7 +209,7 @@ protected:
 public:
     TagDirectoryTable();
     TagDirectoryTable (TagDirectory* p, unsigned char *v, int memsize, int offs, TagType type, const TagAttrib* ta, ByteOrder border);
-    TagDirectoryTable (TagDirectory* p, FILE* f, int memsize, int offset, TagType type, const TagAttrib* ta, ByteOrder border);
+    TagDirectoryTable (TagDirectory* p, IMFILE* f, int memsize, int offset, TagType type, const TagAttrib* ta, ByteOrder border);
     ~TagDirectoryTable() override;
     int calculateSize () override;
     int write (int start, unsigned char* buffer) override;
@@ -233,10 +234,10 @@ protected:
     TagDirectory*    parent;
     TagDirectory**   directory;
     MNKind           makerNoteKind;
-    bool             parseMakerNote (FILE* f, int base, ByteOrder bom );
+    bool             parseMakerNote (IMFILE* f, int base, ByteOrder bom );
 
 public:
-    Tag (TagDirectory* parent, FILE* f, int base);                          // parse next tag from the file
+    Tag (TagDirectory* parent, IMFILE* f, int base);                          // parse next tag from the file
     Tag (TagDirectory* parent, const TagAttrib* attr);
     Tag (TagDirectory* parent, const TagAttrib* attr, unsigned char *data, TagType t);
     Tag (TagDirectory* parent, const TagAttrib* attr, int data, TagType t);  // create a new tag from array (used
@@ -354,7 +355,7 @@ class ExifManager
     void parse (bool isRaw, bool skipIgnored = true, bool parseJpeg = true);
 
 public:
-    FILE* f;
+    IMFILE* f;
     std::unique_ptr<rtengine::RawMetaDataLocation> rml;
     ByteOrder order;
     bool onlyFirst;  // Only first IFD
@@ -362,7 +363,7 @@ public:
     std::vector<TagDirectory*> roots;
     std::vector<TagDirectory*> frames;
 
-    ExifManager (FILE* fHandle, std::unique_ptr<rtengine::RawMetaDataLocation> _rml, bool onlyFirstIFD)
+    ExifManager (IMFILE* fHandle, std::unique_ptr<rtengine::RawMetaDataLocation> _rml, bool onlyFirstIFD)
         : f(fHandle), rml(std::move(_rml)), order(UNKNOWN), onlyFirst(onlyFirstIFD),
           IFDOffset(0) {}
 
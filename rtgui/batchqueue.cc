@@ -575,48 +575,51 @@ void BatchQueue::openItemInEditor(ThumbBrowserEntryBase* item)
 
 void BatchQueue::startProcessing ()
 {
+    MYWRITERLOCK(l, entryRW);
 
-    if (!processing) {
-        MYWRITERLOCK(l, entryRW);
-
-        if (!fd.empty()) {
-            BatchQueueEntry* next;
-
-            next = static_cast<BatchQueueEntry*>(fd[0]);
-            // tag it as processing and set sequence
-            next->processing = true;
-            next->sequence = sequence = 1;
-            processing = next;
+    // the previous run may still be saving its last images
+    if (inFlight.empty() && !fd.empty()) {
+        BatchQueueEntry* next;
 
-            // remove from selection
-            if (processing->selected) {
-                std::vector<ThumbBrowserEntryBase*>::iterator pos = std::find (selected.begin(), selected.end(), processing);
+        next = static_cast<BatchQueueEntry*>(fd[0]);
+        // tag it as processing and set sequence
+        next->processing = true;
+        next->sequence = sequence = 1;
+        processing = next;
+        inFlight.push_back (next);
 
-                if (pos != selected.end()) {
-                    selected.erase (pos);
-                }
+        // remove from selection
+        if (next->selected) {
+            std::vector<ThumbBrowserEntryBase*>::iterator pos = std::find (selected.begin(), selected.end(), next);
 
-                processing->selected = false;
+            if (pos != selected.end()) {
+                selected.erase (pos);
             }
 
-            MYWRITERLOCK_RELEASE(l);
+            next->selected = false;
+        }
 
-            // remove button set
-            next->removeButtonSet ();
+        MYWRITERLOCK_RELEASE(l);
 
-            // start batch processing
-            rtengine::startBatchProcessing (next->job, this);
-            queue_draw ();
+        // remove button set
+        next->removeButtonSet ();
 
-            notifyListener();
-        }
+        // start batch processing
+        rtengine::startBatchProcessing (next->job, this);
+        queue_draw ();
+
+        notifyListener();
     }
 }
 
 void BatchQueue::setProgress(double p)
 {
-    if (processing) {
-        processing->progress = p;
+    {
+        MYREADERLOCK(l, entryRW);
+
+        if (processing) {
+            processing->progress = p;
+        }
     }
 
     // No need to acquire the GUI, setProgressUI will do it
@@ -639,14 +642,27 @@ void BatchQueue::setProgressState(bool inProcessing)
 
 void BatchQueue::error(const Glib::ustring& descr)
 {
-    if (processing && processing->processing) {
-        // restore failed thumb
-        BatchQueueButtonSet* bqbs = new BatchQueueButtonSet (processing);
-        bqbs->setButtonListener (this);
-        processing->addButtonSet (bqbs);
-        processing->processing = false;
-        processing->job = rtengine::ProcessingJob::create(processing->filename, processing->thumbnail->getType() == FT_Raw, *processing->params);
+    bool restored = false;
+
+    {
+        MYWRITERLOCK(l, entryRW);
+
+        // restore the failed thumbs and the ones whose processing has been dropped
+        for (auto entry : inFlight) {
+            BatchQueueButtonSet* bqbs = new BatchQueueButtonSet (entry);
+            bqbs->setButtonListener (this);
+            entry->addButtonSet (bqbs);
+            entry->processing = false;
+            entry->progress = 0.0;
+            entry->job = rtengine::ProcessingJob::create(entry->filename, entry->thumbnail->getType() == FT_Raw, *entry->params);
+            restored = true;
+        }
+
+        inFlight.clear();
         processing = nullptr;
+    }
+
+    if (restored) {
         redraw ();
     }
 
@@ -663,27 +679,87 @@ void BatchQueue::error(const Glib::ustring& descr)
     }
 }
 
-rtengine::ProcessingJob* BatchQueue::imageReady(rtengine::IImagefloat* img)
+rtengine::ProcessingJob* BatchQueue::nextJob()
 {
+    BatchQueueEntry* next = nullptr;
+
+    {
+        MYWRITERLOCK(l, entryRW);
+
+        // the last job handed over is the one whose development starts now
+        processing = inFlight.empty() ? nullptr : inFlight.back();
+
+        if (listener && listener->canStartNext ()) {
+            // the entries already in flight are at the head of the queue
+            const auto pos = std::find_if (fd.begin (), fd.end (), [] (const ThumbBrowserEntryBase* fdEntry) { return !fdEntry->processing; });
+
+            if (pos != fd.end()) {
+                next = static_cast<BatchQueueEntry*>(*pos);
+                // tag it as selected and set sequence
+                next->processing = true;
+                next->sequence = ++sequence;
+                inFlight.push_back (next);
+
+                // remove from selection
+                if (next->selected) {
+                    std::vector<ThumbBrowserEntryBase*>::iterator sel = std::find (selected.begin(), selected.end(), next);
+
+                    if (sel != selected.end()) {
+                        selected.erase (sel);
+                    }
+
+                    next->selected = false;
+                }
+            }
+        }
+    }
+
+    if (next) {
+        // ButtonSet have Cairo::Surface which might be rendered while we're trying to delete them
+        GThreadLock lock;
+        next->removeButtonSet ();
+    }
+
+    redraw ();
+
+    return next ? next->job : nullptr;
+}
+
+void BatchQueue::imageReady(rtengine::IImagefloat* img)
+{
+    BatchQueueEntry* saved;
+
+    {
+        MYWRITERLOCK(l, entryRW);
+
+        // images are handed over in the order of their jobs
+        saved = inFlight.front();
+        inFlight.pop_front();
+
+        if (processing == saved) {
+            processing = nullptr;
+        }
+    }
+
     // save image img
     Glib::ustring fname;
     SaveFormat saveFormat;
 
-    if (processing->outFileName.empty()) { // auto file name
-        Glib::ustring s = calcAutoFileNameBase (processing->filename, processing->sequence);
+    if (saved->outFileName.empty()) { // auto file name
+        Glib::ustring s = calcAutoFileNameBase (saved->filename, saved->sequence);
         saveFormat = options.saveFormatBatch;
-        fname = autoCompleteFileName (s, saveFormat.format);
+        fname = autoCompleteFileName (s, saveFormat.format, saved->overwriteFile);
     } else { // use the save-as filename with automatic completion for uniqueness
-        if (processing->forceFormatOpts) {
-            saveFormat = processing->saveFormat;
+        if (saved->forceFormatOpts) {
+            saveFormat = saved->saveFormat;
         } else {
             saveFormat = options.saveFormatBatch;
         }
 
         // The output filename's extension is forced to the current or selected output format,
         // despite what the user have set in the filename's field of the "Save as" dialog box
-        fname = autoCompleteFileName (removeExtension(processing->outFileName), saveFormat.format);
-        //fname = autoCompleteFileName (removeExtension(processing->outFileName), getExtension(processing->outFileName));
+        fname = autoCompleteFileName (removeExtension(saved->outFileName), saveFormat.format, saved->overwriteFile);
+        //fname = autoCompleteFileName (removeExtension(saved->outFileName), getExtension(saved->outFileName));
     }
 
     //printf ("fname=%s, %s\n", fname.c_str(), removeExtension(fname).c_str());
@@ -702,64 +778,40 @@ rtengine::ProcessingJob* BatchQueue::imageReady(rtengine::IImagefloat* img)
         delete img;
 
         if (err) {
+            // put the entry back in flight, so that it gets restored by error()
+            MYWRITERLOCK(l, entryRW);
+            inFlight.push_front (saved);
+
             throw Glib::FileError(Glib::FileError::FAILED, M("MAIN_MSG_CANNOTSAVE") + "\n" + fname);
         }
 
         if (saveFormat.saveParams) {
             // We keep the extension to avoid overwriting the profile when we have
             // the same output filename with different extension
-            //processing->params.save (removeExtension(fname) + paramFileExtension);
-            processing->params->save (fname + ".out" + paramFileExtension);
+            //saved->params.save (removeExtension(fname) + paramFileExtension);
+            saved->params->save (fname + ".out" + paramFileExtension);
         }
 
-        if (processing->thumbnail) {
-            processing->thumbnail->imageDeveloped ();
-            processing->thumbnail->imageRemovedFromQueue ();
+        if (saved->thumbnail) {
+            saved->thumbnail->imageDeveloped ();
+            saved->thumbnail->imageRemovedFromQueue ();
         }
     }
 
     // save temporary params file name: delete as last thing
-    Glib::ustring processedParams = processing->savedParamsFile;
+    Glib::ustring processedParams = saved->savedParamsFile;
 
     // delete from the queue
-    bool remove_button_set = false;
-
     {
         MYWRITERLOCK(l, entryRW);
 
-        delete processing;
-        processing = nullptr;
-
-        fd.erase (fd.begin());
+        const auto pos = std::find (fd.begin (), fd.end (), saved);
 
-        // return next job
-        if (!fd.empty() && listener && listener->canStartNext ()) {
-            BatchQueueEntry* next = static_cast<BatchQueueEntry*>(fd[0]);
-            // tag it as selected and set sequence
-            next->processing = true;
-            next->sequence = ++sequence;
-            processing = next;
-
-            // remove from selection
-            if (processing->selected) {
-                std::vector<ThumbBrowserEntryBase*>::iterator pos = std::find (selected.begin(), selected.end(), processing);
-
-                if (pos != selected.end()) {
-                    selected.erase (pos);
-                }
-
-                processing->selected = false;
-            }
-
-            // remove button set
-            remove_button_set = true;
+        if (pos != fd.end()) {
+            fd.erase (pos);
         }
-    }
 
-    if (remove_button_set) {
-        // ButtonSet have Cairo::Surface which might be rendered while we're trying to delete them
-        GThreadLock lock;
-        processing->removeButtonSet ();
+        delete saved;
     }
 
     if (saveBatchQueue ()) {
@@ -790,10 +842,33 @@ rtengine::ProcessingJob* BatchQueue::imageReady(rtengine::IImagefloat* img)
         }
     }
 
+    bool restart;
+
+    {
+        MYREADERLOCK(l, entryRW);
+        // every job handed over is in flight, so the pipeline has no work left
+        restart = inFlight.empty() && !fd.empty();
+    }
+
     redraw ();
     notifyListener ();
 
-    return processing ? processing->job : nullptr;
+    if (restart && listener) {
+        // the queue may have been started again while the previous run was saving its last images,
+        // startProcessing() did nothing then
+        BatchQueueListener* const bql = listener;
+
+        idle_register.add(
+            [this, bql]() -> bool
+            {
+                if (bql->canStartNext()) {
+                    startProcessing();
+                }
+
+                return false;
+            }
+        );
+    }
 }
 
 // Calculates automatic filename of processed batch entry, but just the base name
@@ -929,7 +1004,7 @@ Glib::ustring BatchQueue::calcAutoFileNameBase (const Glib::ustring& origFileNam
     return path;
 }
 
-Glib::ustring BatchQueue::autoCompleteFileName (const Glib::ustring& fileName, const Glib::ustring& format)
+Glib::ustring BatchQueue::autoCompleteFileName (const Glib::ustring& fileName, const Glib::ustring& format, bool overwriteFile)
 {
 
     // separate filename and the path to the destination directory
@@ -944,7 +1019,7 @@ Glib::ustring BatchQueue::autoCompleteFileName (const Glib::ustring& fileName, c
 
     // In overwrite mode we TRY to delete the old file first.
     // if that's not possible (e.g. locked by viewer, R/O), we revert to the standard naming scheme
-    bool inOverwriteMode = processing->overwriteFile;
+    bool inOverwriteMode = overwriteFile;
 
     for (int tries = 0; tries < 100; tries++) {
         if (tries == 0) {
@@ -986,14 +1061,15 @@ void BatchQueue::buttonPressed (LWButton* button, int actionCode, void* actionDa
 
 void BatchQueue::notifyListener ()
 {
-    const bool queueRunning = processing;
     if (listener) {
         BatchQueueListener* const bql = listener;
 
         int qsize = 0;
+        bool queueRunning = false;
         {
             MYREADERLOCK(l, entryRW);
             qsize = fd.size();
+            queueRunning = !inFlight.empty();
         }
 
         idle_register.add(
@@ -17,6 +17,7 @@
  */
 #pragma once
 
+#include <deque>
 #include <set>
 
 #include <gtkmm.h>
@@ -72,7 +73,8 @@ public:
     void setProgressStr(const Glib::ustring& str) override;
     void setProgressState(bool inProcessing) override;
     void error(const Glib::ustring& descr) override;
-    rtengine::ProcessingJob* imageReady(rtengine::IImagefloat* img) override;
+    rtengine::ProcessingJob* nextJob() override;
+    void imageReady(rtengine::IImagefloat* img) override;
 
     void rightClicked () override;
     void doubleClicked (ThumbBrowserEntryBase* entry) override;
@@ -96,14 +98,15 @@ private:
     void saveThumbnailHeight (int height) override;
     int  getThumbnailHeight () override;
 
-    Glib::ustring autoCompleteFileName (const Glib::ustring& fileName, const Glib::ustring& format);
+    Glib::ustring autoCompleteFileName (const Glib::ustring& fileName, const Glib::ustring& format, bool overwriteFile);
     Glib::ustring getTempFilenameForParams( const Glib::ustring &filename );
     bool saveBatchQueue ();
     void notifyListener ();
 
     using ThumbBrowserBase::redrawNeeded;
 
-    BatchQueueEntry* processing;  // holds the currently processed image
+    BatchQueueEntry* processing;  // holds the currently developed image
+    std::deque<BatchQueueEntry*> inFlight;  // entries handed over to the batch processing and not saved yet, in order
     FileCatalog* fileCatalog;
     int sequence; // holds the current sequence index
 
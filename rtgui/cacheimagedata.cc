@@ -23,6 +23,7 @@
 #include "version.h"
 #include <locale.h>
 
+#include "../rtengine/cachepack.h"
 #include "../rtengine/procparams.h"
 #include "../rtengine/settings.h"
 
@@ -70,7 +71,9 @@ int CacheImageData::load (const Glib::ustring& fname)
     Glib::KeyFile keyFile;
 
     try {
-        if (keyFile.load_from_file (fname)) {
+        std::string data;
+
+        if (rtengine::CachePack::readFile (fname, data) && keyFile.load_from_data (data)) {
 
             if (keyFile.has_group ("General")) {
                 if (keyFile.has_key ("General", "MD5")) {
@@ -250,7 +253,11 @@ int CacheImageData::save (const Glib::ustring& fname)
     Glib::KeyFile keyFile;
 
     try {
-        keyFile.load_from_file (fname);
+        std::string data;
+
+        if (rtengine::CachePack::readFile (fname, data)) {
+            keyFile.load_from_data (data);
+        }
     } catch (Glib::Error&) {}
 
     keyFile.set_string  ("General", "MD5", md5);
@@ -320,19 +327,15 @@ int CacheImageData::save (const Glib::ustring& fname)
         return 1;
     }
 
-    FILE *f = g_fopen (fname.c_str (), "wt");
-
-    if (!f) {
+    if (!rtengine::CachePack::writeFile (fname, keyData.raw (), true)) {
         if (rtengine::settings->verbose) {
             printf("CacheImageData::save / Error: unable to open file \"%s\" with write access!\n", fname.c_str());
         }
 
         return 1;
-    } else {
-        fprintf (f, "%s", keyData.c_str ());
-        fclose (f);
-        return 0;
     }
+
+    return 0;
 }
 
 rtengine::procparams::IPTCPairs CacheImageData::getIPTCData(unsigned int frame) const
@@ -35,6 +35,8 @@
 #include "thumbnail.h"
 #include "procparamchangers.h"
 
+#include "../rtengine/cachepack.h"
+
 namespace
 {
 
@@ -65,6 +67,23 @@ void CacheManager::init ()
     if (error != 0 && rtengine::settings->verbose) {
         std::cerr << "Failed to create all cache directories: " << g_strerror(errno) << std::endl;
     }
+
+    // the storage left from the other mode can't be reached any more, it is removed on the first start after a change
+    const bool hadPack = rtengine::CachePack::hasPack (baseDir);
+
+    if (options.packedCache) {
+        if (!rtengine::CachePack::getInstance ().open (baseDir)) {
+            if (rtengine::settings->verbose) {
+                std::cerr << "Failed to open the cache pack, the cache files are used instead" << std::endl;
+            }
+        } else if (!hadPack) {
+            deleteDir ("data");
+            deleteDir ("images");
+            deleteDir ("embprofiles");
+        }
+    } else if (hadPack && !rtengine::CachePack::removePack (baseDir) && rtengine::settings->verbose) {
+        std::cerr << "The cache pack is used by another instance, it is left in place" << std::endl;
+    }
 }
 
 Thumbnail* CacheManager::getEntry (const Glib::ustring& fname)
@@ -190,9 +209,18 @@ void CacheManager::renameEntry (const std::string& oldfilename, const std::strin
     const auto newmd5 = getMD5 (newfilename);
 
     auto error = g_rename (getCacheFileName ("profiles", oldfilename, paramFileExtension, oldmd5).c_str (), getCacheFileName ("profiles", newfilename, paramFileExtension, newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("images", oldfilename, ".rtti", oldmd5).c_str (), getCacheFileName ("images", newfilename, ".rtti", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("embprofiles", oldfilename, ".icc", oldmd5).c_str (), getCacheFileName ("embprofiles", newfilename, ".icc", newmd5).c_str ());
-    error |= g_rename (getCacheFileName ("data", oldfilename, ".txt", oldmd5).c_str (), getCacheFileName ("data", newfilename, ".txt", newmd5).c_str ());
+
+    auto& pack = rtengine::CachePack::getInstance ();
+
+    if (pack.isOpen ()) {
+        pack.move (getCacheFileName ("images", oldfilename, ".rtti", oldmd5), getCacheFileName ("images", newfilename, ".rtti", newmd5));
+        pack.move (getCacheFileName ("embprofiles", oldfilename, ".icc", oldmd5), getCacheFileName ("embprofiles", newfilename, ".icc", newmd5));
+        pack.move (getCacheFileName ("data", oldfilename, ".txt", oldmd5), getCacheFileName ("data", newfilename, ".txt", newmd5));
+    } else {
+        error |= g_rename (getCacheFileName ("images", oldfilename, ".rtti", oldmd5).c_str (), getCacheFileName ("images", newfilename, ".rtti", newmd5).c_str ());
+        error |= g_rename (getCacheFileName ("embprofiles", oldfilename, ".icc", oldmd5).c_str (), getCacheFileName ("embprofiles", newfilename, ".icc", newmd5).c_str ());
+        error |= g_rename (getCacheFileName ("data", oldfilename, ".txt", oldmd5).c_str (), getCacheFileName ("data", newfilename, ".txt", newmd5).c_str ());
+    }
 
     if (error != 0 && rtengine::settings->verbose) {
         std::cerr << "Failed to rename all files for cache entry '" << oldfilename << "': " << g_strerror(errno) << std::endl;
@@ -228,6 +256,7 @@ void CacheManager::closeCache () const
     MyMutex::MyLock lock (mutex);
 
     applyCacheSizeLimitation ();
+    rtengine::CachePack::getInstance ().close ();
 }
 
 void CacheManager::clearAll () const
@@ -237,6 +266,8 @@ void CacheManager::clearAll () const
     for (const auto& cacheDir : cacheDirs) {
         deleteDir (cacheDir);
     }
+
+    removeClosedPack ();
 }
 
 void CacheManager::clearImages () const
@@ -246,6 +277,8 @@ void CacheManager::clearImages () const
     deleteDir ("data");
     deleteDir ("images");
     deleteDir ("embprofiles");
+
+    removeClosedPack ();
 }
 
 void CacheManager::clearProfiles () const
@@ -259,6 +292,9 @@ void CacheManager::clearProfiles () const
 
 void CacheManager::deleteDir (const Glib::ustring& dirName) const
 {
+    // also deletes the files left from before the pack was used
+    rtengine::CachePack::getInstance ().removeDir (dirName);
+
     try {
 
         Glib::Dir dir (Glib::build_filename (baseDir, dirName));
@@ -276,17 +312,37 @@ void CacheManager::deleteDir (const Glib::ustring& dirName) const
     } catch (Glib::Error&) {}
 }
 
+void CacheManager::removeClosedPack () const
+{
+    // deleteDir() only empties the pack when it is open
+    if (!rtengine::CachePack::getInstance ().isOpen () && !rtengine::CachePack::removePack (baseDir) && rtengine::settings->verbose) {
+        std::cerr << "The cache pack is used by another instance, it is left in place" << std::endl;
+    }
+}
+
 void CacheManager::deleteFiles (const Glib::ustring& fname, const std::string& md5, bool purgeData, bool purgeProfile) const
 {
     if (md5.empty ()) {
         return;
     }
 
-    auto error = g_remove (getCacheFileName ("images", fname, ".rtti", md5).c_str ());
-    error |= g_remove (getCacheFileName ("embprofiles", fname, ".icc", md5).c_str ());
+    auto error = 0;
+    auto& pack = rtengine::CachePack::getInstance ();
+
+    if (pack.isOpen ()) {
+        pack.erase (getCacheFileName ("images", fname, ".rtti", md5));
+        pack.erase (getCacheFileName ("embprofiles", fname, ".icc", md5));
 
-    if (purgeData) {
-        error |= g_remove (getCacheFileName ("data", fname, ".txt", md5).c_str ());
+        if (purgeData) {
+            pack.erase (getCacheFileName ("data", fname, ".txt", md5));
+        }
+    } else {
+        error |= g_remove (getCacheFileName ("images", fname, ".rtti", md5).c_str ());
+        error |= g_remove (getCacheFileName ("embprofiles", fname, ".icc", md5).c_str ());
+
+        if (purgeData) {
+            error |= g_remove (getCacheFileName ("data", fname, ".txt", md5).c_str ());
+        }
     }
 
     if (purgeProfile) {
@@ -346,45 +402,58 @@ Glib::ustring CacheManager::getCacheFileName (const Glib::ustring& subDir,
 
 void CacheManager::applyCacheSizeLimitation () const
 {
-    // first count files without fetching file name and timestamp.
-    auto cachedir = opendir(Glib::build_filename(baseDir, "data").c_str());
-    if (!cachedir) {
-        return;
-    }
-
-    std::size_t numFiles = 0;
-    while (readdir(cachedir)) {
-        ++numFiles;
-    }
-
-    closedir(cachedir);
-    if (numFiles > 2) {
-        numFiles -= 2; // because . and .. are counted
-    }
-
-    if (numFiles <= options.maxCacheEntries) {
-        return;
-    }
-
     using FNameMTime = std::pair<Glib::ustring, Glib::TimeVal>;
 
     std::vector<FNameMTime> files;
-    files.reserve(numFiles);
 
     constexpr std::size_t md5_size = 32;
-    // get filenames and timestamps
-    try {
-        const auto dir = Gio::File::create_for_path(Glib::build_filename(baseDir, "data"));
-        const auto enumerator = dir->enumerate_children("standard::name,time::modified");
 
-        while (const auto file = enumerator->next_file()) {
-            const auto name = file->get_name();
-            if (name.size() >= md5_size + 5) {
-                files.emplace_back(name, file->modification_time());
+    const auto& pack = rtengine::CachePack::getInstance();
+
+    if (pack.isOpen()) {
+        // the pack knows when each entry was last used, the least recently used ones are deleted
+        for (const auto& file : pack.getFiles("data")) {
+            if (file.first.size() >= md5_size + 5) {
+                files.emplace_back(file.first, Glib::TimeVal(file.second / G_USEC_PER_SEC, file.second % G_USEC_PER_SEC));
             }
         }
+    } else {
+        // first count files without fetching file name and timestamp.
+        auto cachedir = opendir(Glib::build_filename(baseDir, "data").c_str());
+        if (!cachedir) {
+            return;
+        }
 
-    } catch (Glib::Exception&) {}
+        std::size_t numFiles = 0;
+        while (readdir(cachedir)) {
+            ++numFiles;
+        }
+
+        closedir(cachedir);
+        if (numFiles > 2) {
+            numFiles -= 2; // because . and .. are counted
+        }
+
+        if (numFiles <= options.maxCacheEntries) {
+            return;
+        }
+
+        files.reserve(numFiles);
+
+        // get filenames and timestamps
+        try {
+            const auto dir = Gio::File::create_for_path(Glib::build_filename(baseDir, "data"));
+            const auto enumerator = dir->enumerate_children("standard::name,time::modified");
+
+            while (const auto file = enumerator->next_file()) {
+                const auto name = file->get_name();
+                if (name.size() >= md5_size + 5) {
+                    files.emplace_back(name, file->modification_time());
+                }
+            }
+
+        } catch (Glib::Exception&) {}
+    }
 
     if (files.size() <= options.maxCacheEntries) {
         // limit not reached
@@ -40,6 +40,7 @@ private:
 
     void deleteDir   (const Glib::ustring& dirName) const;
     void deleteFiles (const Glib::ustring& fname, const std::string& md5, bool purgeData, bool purgeProfile) const;
+    void removeClosedPack () const;
 
     void applyCacheSizeLimitation () const;
 
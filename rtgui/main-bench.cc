@@ -0,0 +1,712 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * rawtherapee-bench: offline micro-benchmarks of the processing engine.
+ *
+ * All the input data (Bayer and X-Trans mosaics, RGB and Lab images) is synthesized,
+ * so no raw file nor network access is needed. Each benchmark is run for each requested
+ * number of OpenMP threads; the best of several runs is reported in ms and Mpix/s, along
+ * with the speedup relative to the first thread count.
+ */
+
+#ifdef __GNUC__
+#if defined(__FAST_MATH__)
+#error Using the -ffast-math CFLAG is known to lead to problems. Disable it to compile RawTherapee.
+#endif
+#endif
+
+#include "config.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <locale.h>
+#include <giomm.h>
+#include "../rtengine/array2D.h"
+#include "../rtengine/boxblur.h"
+#include "../rtengine/curves.h"
+#include "../rtengine/gauss.h"
+#include "../rtengine/imagefloat.h"
+#include "../rtengine/improcfun.h"
+#include "../rtengine/labimage.h"
+#include "../rtengine/mytime.h"
+#include "../rtengine/procparams.h"
+#include "../rtengine/rawimage.h"
+#include "../rtengine/rawimagesource.h"
+#include "../rtengine/rt_math.h"
+#include "../rtengine/rtengine.h"
+#include "options.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// stores path to data files
+Glib::ustring argv0;
+Glib::ustring creditsPath;
+Glib::ustring licensePath;
+Glib::ustring argv1;
+
+namespace
+{
+
+using namespace rtengine;
+using namespace rtengine::procparams;
+
+struct Benchmark {
+    std::string name;
+    double megaPixels;                  // of the input, used to compute the throughput
+    std::function<void()> prepare;      // called before each run, not timed
+    std::function<void()> run;
+};
+
+int getNumProcs()
+{
+#ifdef _OPENMP
+    return omp_get_num_procs();
+#else
+    return 1;
+#endif
+}
+
+void setNumThreads(int threads)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+}
+
+// Smooth gradients, hard edges and some noise, so that the adaptive algorithms go through all their paths
+float sceneValue(int row, int col, int channel)
+{
+    const float smooth = 0.45f + 0.3f * std::sin(col * (0.011f + 0.003f * channel)) * std::cos(row * (0.007f + 0.002f * channel));
+    const float edges = ((row / 61 + col / 47 + channel) & 1) ? 0.2f : 0.f;
+
+    // reproducible noise, independent of the number of threads
+    unsigned int hash = (row * 73856093u) ^ (col * 19349663u) ^ (channel * 83492791u);
+    hash ^= hash >> 13;
+    hash *= 0x5bd1e995u;
+    hash ^= hash >> 15;
+    const float noise = (hash & 0xffff) / 65535.f - 0.5f;
+
+    return 65535.f * LIM01(smooth + edges - 0.1f + 0.02f * noise);
+}
+
+void fillMosaic(const RawImage* ri, array2D<float>& data)
+{
+    const int width = ri->get_width();
+    const int height = ri->get_height();
+    const bool xtrans = ri->isXtrans();
+    data(width, height);
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int row = 0; row < height; ++row) {
+        for (int col = 0; col < width; ++col) {
+            data[row][col] = sceneValue(row, col, xtrans ? ri->XTRANSFC(row, col) : ri->FC(row, col));
+        }
+    }
+}
+
+void fillImage(Imagefloat* img)
+{
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int row = 0; row < img->getHeight(); ++row) {
+        for (int col = 0; col < img->getWidth(); ++col) {
+            img->r(row, col) = sceneValue(row, col, 0);
+            img->g(row, col) = sceneValue(row, col, 1);
+            img->b(row, col) = sceneValue(row, col, 2);
+        }
+    }
+}
+
+void fillImage(LabImage* img)
+{
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int row = 0; row < img->H; ++row) {
+        for (int col = 0; col < img->W; ++col) {
+            img->L[row][col] = 0.5f * sceneValue(row, col, 1);
+            img->a[row][col] = 0.25f * (sceneValue(row, col, 0) - sceneValue(row, col, 1));
+            img->b[row][col] = 0.25f * (sceneValue(row, col, 1) - sceneValue(row, col, 2));
+        }
+    }
+}
+
+void copyImage(const LabImage* src, LabImage* dst)
+{
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int row = 0; row < src->H; ++row) {
+        std::copy(src->L[row], src->L[row] + src->W, dst->L[row]);
+        std::copy(src->a[row], src->a[row] + src->W, dst->a[row]);
+        std::copy(src->b[row], src->b[row] + src->W, dst->b[row]);
+    }
+}
+
+// Holds the synthetic inputs and the engine objects shared by the benchmarks
+class BenchmarkSuite
+{
+public:
+    BenchmarkSuite(int width, int height) :
+        width(width),
+        height(height),
+        megaPixels(width * static_cast<double>(height) / 1000000.0),
+        rgb(new Imagefloat(width, height)),
+        rgbOut(new Imagefloat(width, height)),
+        lab(new LabImage(width, height)),
+        labOut(new LabImage(width, height)),
+        plane(width, height),
+        planeOut(width, height),
+        metadata(FramesMetaData::fromFile("", std::unique_ptr<RawMetaDataLocation>()))
+    {
+        fillImage(rgb.get());
+        fillImage(lab.get());
+
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+        for (int row = 0; row < height; ++row) {
+            for (int col = 0; col < width; ++col) {
+                plane[row][col] = sceneValue(row, col, 1);
+            }
+        }
+
+        RawImage bayer("synthetic");
+        bayer.initSynthetic(width, height, false);
+        fillMosaic(&bayer, bayerData);
+        RawImage xtrans("synthetic");
+        xtrans.initSynthetic(width, height, true);
+        fillMosaic(&xtrans, xtransData);
+
+        addDemosaicBenchmarks();
+        addFilterBenchmarks();
+        addImProcBenchmarks();
+    }
+
+    const std::vector<Benchmark>& getBenchmarks() const
+    {
+        return benchmarks;
+    }
+
+private:
+    void addDemosaic(const std::string& name, bool xtrans, const Glib::ustring& method)
+    {
+        std::shared_ptr<RawImageSource> src(new RawImageSource);
+        std::shared_ptr<RAWParams> raw(new RAWParams);
+
+        if (xtrans) {
+            raw->xtranssensor.method = method;
+        } else {
+            raw->bayersensor.method = method;
+        }
+
+        benchmarks.push_back({
+            name,
+            megaPixels,
+            [this, src, xtrans]() {
+                // some demosaicers work in place, so each run starts from the original mosaic
+                RawImage* const ri = new RawImage("synthetic");
+                ri->initSynthetic(width, height, xtrans);
+                src->setSyntheticRaw(ri, xtrans ? xtransData : bayerData);
+            },
+            [src, raw]() {
+                double contrastThreshold = raw->bayersensor.dualDemosaicContrast;
+                src->demosaic(*raw, false, contrastThreshold);
+            }
+        });
+    }
+
+    void addDemosaicBenchmarks()
+    {
+        using Bayer = RAWParams::BayerSensor;
+        using XTrans = RAWParams::XTransSensor;
+
+        addDemosaic("demosaic/amaze", false, Bayer::getMethodString(Bayer::Method::AMAZE));
+        addDemosaic("demosaic/amazevng4", false, Bayer::getMethodString(Bayer::Method::AMAZEVNG4));
+        addDemosaic("demosaic/rcd", false, Bayer::getMethodString(Bayer::Method::RCD));
+        addDemosaic("demosaic/dcb", false, Bayer::getMethodString(Bayer::Method::DCB));
+        addDemosaic("demosaic/lmmse", false, Bayer::getMethodString(Bayer::Method::LMMSE));
+        addDemosaic("demosaic/igv", false, Bayer::getMethodString(Bayer::Method::IGV));
+        addDemosaic("demosaic/ahd", false, Bayer::getMethodString(Bayer::Method::AHD));
+        addDemosaic("demosaic/hphd", false, Bayer::getMethodString(Bayer::Method::HPHD));
+        addDemosaic("demosaic/vng4", false, Bayer::getMethodString(Bayer::Method::VNG4));
+        addDemosaic("demosaic/fast", false, Bayer::getMethodString(Bayer::Method::FAST));
+        addDemosaic("demosaic/xtrans-3-pass", true, XTrans::getMethodString(XTrans::Method::THREE_PASS));
+        addDemosaic("demosaic/xtrans-1-pass", true, XTrans::getMethodString(XTrans::Method::ONE_PASS));
+        addDemosaic("demosaic/xtrans-4-pass", true, XTrans::getMethodString(XTrans::Method::FOUR_PASS));
+        addDemosaic("demosaic/xtrans-fast", true, XTrans::getMethodString(XTrans::Method::FAST));
+    }
+
+    void addGaussianBlur(const std::string& name, double sigma)
+    {
+        benchmarks.push_back({
+            name,
+            megaPixels,
+            nullptr,
+            [this, sigma]() {
+#ifdef _OPENMP
+                #pragma omp parallel
+#endif
+                gaussianBlur(plane, planeOut, width, height, sigma);
+            }
+        });
+    }
+
+    void addFilterBenchmarks()
+    {
+        addGaussianBlur("gaussianBlur/sigma=1.5", 1.5);
+        addGaussianBlur("gaussianBlur/sigma=30", 30.0);
+
+        benchmarks.push_back({
+            "boxblur/radius=16",
+            megaPixels,
+            nullptr,
+            [this]() {
+                boxblur(plane, planeOut, 16, width, height, true);
+            }
+        });
+    }
+
+    void addImProcBenchmarks()
+    {
+        benchmarks.push_back({
+            "RGB_denoise",
+            megaPixels,
+            nullptr,
+            [this]() {
+                ProcParams params;
+                DirPyrDenoiseParams& dnparams = params.dirpyrDenoise;
+                dnparams.enabled = true;
+                dnparams.luma = 30.0;
+                dnparams.chroma = 15.0;
+                dnparams.Cmethod = "MAN";
+                dnparams.C2method = "MANU";
+                NoiseCurve noiseLCurve;
+                NoiseCurve noiseCCurve;
+                dnparams.getCurves(noiseLCurve, noiseCCurve);
+
+                ImProcFunctions ipf(&params, true);
+                int numtilesW, numtilesH, tilewidth, tileheight, tileWskip, tileHskip;
+                ipf.Tile_calc(1024, 128, 2, width, height, numtilesW, numtilesH, tilewidth, tileheight, tileWskip, tileHskip);
+                const int tiles = std::max(numtilesW * numtilesH, 9);
+                std::vector<float> chM(tiles), maxR(tiles), maxB(tiles);
+                float nresi, highresi;
+                ipf.RGB_denoise(2, rgb.get(), rgbOut.get(), nullptr, chM.data(), maxR.data(), maxB.data(), true, dnparams, 0.0, noiseLCurve, noiseCCurve, nresi, highresi);
+            }
+        });
+
+        benchmarks.push_back({
+            "ip_wavelet",
+            megaPixels,
+            [this]() {
+                copyImage(lab.get(), labOut.get());
+            },
+            [this]() {
+                ProcParams params;
+                WaveletParams& wavelet = params.wavelet;
+                wavelet.enabled = true;
+
+                for (int i = 0; i < 9; ++i) {
+                    wavelet.c[i] = 20;
+                    wavelet.ch[i] = 10;
+                }
+
+                WavCurve wavCLVCurve;
+                WavCurve wavdenoise;
+                WavCurve wavdenoiseh;
+                Wavblcurve wavblcurve;
+                WavOpacityCurveRG waOpacityCurveRG;
+                WavOpacityCurveSH waOpacityCurveSH;
+                WavOpacityCurveBY waOpacityCurveBY;
+                WavOpacityCurveW waOpacityCurveW;
+                WavOpacityCurveWL waOpacityCurveWL;
+                LUTf wavclCurve(65536, 0);
+                wavelet.getCurves(wavCLVCurve, wavdenoise, wavdenoiseh, wavblcurve, waOpacityCurveRG, waOpacityCurveSH, waOpacityCurveBY, waOpacityCurveW, waOpacityCurveWL);
+                CurveFactory::diagonalCurve2Lut(wavelet.wavclCurve, wavclCurve, 1);
+
+                ImProcFunctions ipf(&params, true);
+                ipf.ip_wavelet(labOut.get(), labOut.get(), 2, wavelet, wavCLVCurve, wavdenoise, wavdenoiseh, wavblcurve, waOpacityCurveRG, waOpacityCurveSH, waOpacityCurveBY, waOpacityCurveW, waOpacityCurveWL, wavclCurve, 1);
+            }
+        });
+
+        // the output size depends on the scale, hence the images allocated per benchmark
+        std::shared_ptr<Imagefloat> half(new Imagefloat(width / 2, height / 2));
+        benchmarks.push_back({
+            "Lanczos/scale=0.5",
+            megaPixels,
+            nullptr,
+            [this, half]() {
+                ProcParams params;
+                ImProcFunctions ipf(&params, true);
+                ipf.Lanczos(rgb.get(), half.get(), 0.5f);
+            }
+        });
+
+        std::shared_ptr<LabImage> labThird(new LabImage(width / 3, height / 3));
+        benchmarks.push_back({
+            "Lanczos/Lab/scale=0.33",
+            megaPixels,
+            nullptr,
+            [this, labThird]() {
+                ProcParams params;
+                ImProcFunctions ipf(&params, true);
+                ipf.Lanczos(lab.get(), labThird.get(), 1.f / 3.f);
+            }
+        });
+
+        // rotation goes through transformGeneral, with the high quality interpolation
+        benchmarks.push_back({
+            "transformGeneral/rotate",
+            megaPixels,
+            nullptr,
+            [this]() {
+                ProcParams params;
+                params.lensProf.lcMode = LensProfParams::LcMode::NONE;
+                params.rotate.degree = 3.0;
+                ImProcFunctions ipf(&params, true);
+                ipf.transform(rgb.get(), rgbOut.get(), 0, 0, 0, 0, width, height, width, height, metadata.get(), 0, true);
+            }
+        });
+
+        benchmarks.push_back({
+            "transformGeneral/distortion",
+            megaPixels,
+            nullptr,
+            [this]() {
+                ProcParams params;
+                params.lensProf.lcMode = LensProfParams::LcMode::NONE;
+                params.distortion.amount = 0.1;
+                params.vignetting.amount = 30;
+                ImProcFunctions ipf(&params, true);
+                ipf.transform(rgb.get(), rgbOut.get(), 0, 0, 0, 0, width, height, width, height, metadata.get(), 0, true);
+            }
+        });
+    }
+
+    const int width;
+    const int height;
+    const double megaPixels;
+    const std::unique_ptr<Imagefloat> rgb;
+    const std::unique_ptr<Imagefloat> rgbOut;
+    const std::unique_ptr<LabImage> lab;
+    const std::unique_ptr<LabImage> labOut;
+    array2D<float> plane;
+    array2D<float> planeOut;
+    array2D<float> bayerData;
+    array2D<float> xtransData;
+    const std::unique_ptr<FramesMetaData> metadata;
+    std::vector<Benchmark> benchmarks;
+};
+
+// The Lab tools the tiled export runs over bands of rows, in the order of stage_finish_tiled()
+void runBandTools(ImProcFunctions& ipf, const ProcParams& params, LabImage* lab)
+{
+    ipf.impulsedenoise(lab);
+
+    if (params.sharpenEdge.enabled) {
+        ipf.MLsharpen(lab);
+    }
+
+    if (params.sharpenMicro.enabled) {
+        ipf.MLmicrocontrast(lab);
+    }
+
+    if (params.sharpening.enabled) {
+        ipf.sharpening(lab, params.sharpening);
+    }
+}
+
+// Largest difference between the tools run on the whole image and run on bands with the halo of the tiled export
+float getBandDifference(const LabImage* source, const ProcParams& params)
+{
+    const int width = source->W;
+    const int height = source->H;
+    ImProcFunctions ipf(&params, true);
+
+    LabImage whole(width, height);
+    copyImage(source, &whole);
+    runBandTools(ipf, params, &whole);
+
+    const int halo = ImProcFunctions::getBandHalo(params);
+    // as small as the tiled export allows, for as many seams as possible
+    const int bandHeight = std::max(16, 4 * halo);
+    float maxDiff = 0.f;
+
+    for (int y = 0; y < height; y += bandHeight) {
+        const int yEnd = std::min(y + bandHeight, height);
+        const int top = std::max(y - halo, 0);
+        const int bottom = std::min(yEnd + halo, height);
+
+        LabImage band(width, bottom - top);
+
+        for (int row = top; row < bottom; ++row) {
+            std::copy(source->L[row], source->L[row] + width, band.L[row - top]);
+            std::copy(source->a[row], source->a[row] + width, band.a[row - top]);
+            std::copy(source->b[row], source->b[row] + width, band.b[row - top]);
+        }
+
+        runBandTools(ipf, params, &band);
+
+        for (int row = y; row < yEnd; ++row) {
+            for (int col = 0; col < width; ++col) {
+                maxDiff = std::max(maxDiff, std::fabs(band.L[row - top][col] - whole.L[row][col]));
+                maxDiff = std::max(maxDiff, std::fabs(band.a[row - top][col] - whole.a[row][col]));
+                maxDiff = std::max(maxDiff, std::fabs(band.b[row - top][col] - whole.b[row][col]));
+            }
+        }
+    }
+
+    return maxDiff;
+}
+
+// Checks ImProcFunctions::getBandHalo() against each tool, returns the number of tools whose bands differ
+int checkBands(int width, int height)
+{
+    struct BandCheck {
+        std::string name;
+        std::function<void(ProcParams&)> setup;
+    };
+
+    const std::vector<BandCheck> checks = {
+        {"impulse denoise", [](ProcParams& params) { params.impulseDenoise.enabled = true; params.impulseDenoise.thresh = 50; }},
+        {"impulse denoise/thresh=100", [](ProcParams& params) { params.impulseDenoise.enabled = true; params.impulseDenoise.thresh = 100; }},
+        {"edges sharpening", [](ProcParams& params) { params.sharpenEdge.enabled = true; params.sharpenEdge.passes = 2; params.sharpenEdge.amount = 50; }},
+        {"microcontrast", [](ProcParams& params) { params.sharpenMicro.enabled = true; params.sharpenMicro.matrix = false; params.sharpenMicro.contrast = 20; }},
+        {"microcontrast/3x3", [](ProcParams& params) { params.sharpenMicro.enabled = true; params.sharpenMicro.matrix = true; params.sharpenMicro.contrast = 0; }},
+        {"USM", [](ProcParams& params) { params.sharpening.enabled = true; params.sharpening.method = "usm"; params.sharpening.radius = 1.0; params.sharpening.contrast = 20; }},
+        {"USM/halo control", [](ProcParams& params) { params.sharpening.enabled = true; params.sharpening.method = "usm"; params.sharpening.radius = 2.0; params.sharpening.halocontrol = true; }},
+        {"USM/edges only", [](ProcParams& params) { params.sharpening.enabled = true; params.sharpening.method = "usm"; params.sharpening.edgesonly = true; params.sharpening.edges_radius = 2.0; }},
+        {"USM/blur", [](ProcParams& params) { params.sharpening.enabled = true; params.sharpening.method = "usm"; params.sharpening.blurradius = 1.0; params.sharpening.contrast = 20; }},
+        {"RL deconvolution", [](ProcParams& params) { params.sharpening.enabled = true; params.sharpening.method = "rld"; params.sharpening.deconvradius = 0.75; params.sharpening.deconviter = 30; params.sharpening.contrast = 20; }},
+        {"all", [](ProcParams& params) {
+            params.impulseDenoise.enabled = true;
+            params.sharpenEdge.enabled = true;
+            params.sharpenMicro.enabled = true;
+            params.sharpening.enabled = true;
+            params.sharpening.method = "rld";
+        }}
+    };
+
+    // the recursive blurs leave some rounding noise, far below what is visible
+    constexpr float tolerance = 0.01f;
+
+    LabImage source(width, height);
+    fillImage(&source);
+
+    printf("\n%-30s %8s %12s\n", "band check", "halo", "max diff");
+    int failed = 0;
+
+    for (const auto& check : checks) {
+        ProcParams params;
+        check.setup(params);
+        const float diff = getBandDifference(&source, params);
+        const bool ok = diff <= tolerance;
+        printf("%-30s %8d %12.6f%s\n", check.name.c_str(), ImProcFunctions::getBandHalo(params), diff, ok ? "" : "  FAILED");
+        fflush(stdout);
+        failed += !ok;
+    }
+
+    return failed;
+}
+
+std::vector<int> getDefaultThreadCounts()
+{
+    const int procs = getNumProcs();
+    std::vector<int> threads;
+
+    for (int n = 1; n < procs; n *= 2) {
+        threads.push_back(n);
+    }
+
+    threads.push_back(procs);
+    return threads;
+}
+
+bool parseThreadCounts(const char* arg, std::vector<int>& threads)
+{
+    threads.clear();
+
+    for (const char* p = arg; *p;) {
+        char* end;
+        const long n = std::strtol(p, &end, 10);
+
+        if (end == p || n < 1) {
+            return false;
+        }
+
+        threads.push_back(n);
+        p = *end == ',' ? end + 1 : end;
+
+        if (*end && *end != ',') {
+            return false;
+        }
+    }
+
+    return !threads.empty();
+}
+
+void printUsage(const char* progName)
+{
+    printf("Usage: %s [-s <width>x<height>] [-t <threads>[,<threads>...]] [-r <runs>] [-f <filter>] [-l] [-c]\n\n", progName);
+    printf("  -s <width>x<height>  size of the synthetic images (default: 3000x2000)\n");
+    printf("  -t <threads>,...     numbers of OpenMP threads to measure (default: 1, 2, 4, ... up to the number of cores)\n");
+    printf("  -r <runs>            runs per measurement, the fastest is reported (default: 3)\n");
+    printf("  -f <filter>          only run the benchmarks whose name contains <filter>\n");
+    printf("  -l                   list the benchmarks and exit\n");
+    printf("  -c                   check that the tools of the tiled export give the result of the whole image, and exit\n");
+    printf("  -h                   display this help\n");
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+    setlocale(LC_NUMERIC, "C"); // to set decimal point to "."
+
+    Gio::init();
+
+    int width = 3000;
+    int height = 2000;
+    int runs = 3;
+    std::string filter;
+    bool listOnly = false;
+    bool checkOnly = false;
+    std::vector<int> threads = getDefaultThreadCounts();
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "-s" && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width < 64 || height < 64) {
+                fprintf(stderr, "Invalid image size \"%s\", the minimum is 64x64.\n", argv[i]);
+                return -1;
+            }
+        } else if (arg == "-t" && hasValue) {
+            if (!parseThreadCounts(argv[++i], threads)) {
+                fprintf(stderr, "Invalid thread counts \"%s\".\n", argv[i]);
+                return -1;
+            }
+        } else if (arg == "-r" && hasValue) {
+            runs = atoi(argv[++i]);
+
+            if (runs < 1) {
+                fprintf(stderr, "The number of runs must be at least 1.\n");
+                return -1;
+            }
+        } else if (arg == "-f" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "-l") {
+            listOnly = true;
+        } else if (arg == "-c") {
+            checkOnly = true;
+        } else {
+            printUsage(argv[0]);
+            return arg == "-h" ? 0 : -1;
+        }
+    }
+
+#ifndef _OPENMP
+    threads.assign(1, 1);
+#endif
+
+    argv0 = DATA_SEARCH_PATH;
+    creditsPath = CREDITS_SEARCH_PATH;
+    licensePath = LICENCE_SEARCH_PATH;
+    options.rtSettings.lensfunDbDirectory = LENSFUN_DB_PATH;
+    options.rtSettings.verbose = false;
+
+    if (rtengine::init(&options.rtSettings, argv0, Options::rtdir, false)) {
+        fprintf(stderr, "Unable to initialize the processing engine.\n");
+        return -2;
+    }
+
+    int result = 0;
+
+    if (checkOnly) {
+        result = checkBands(width, height) ? 1 : 0;
+    } else {
+        printf("Synthesizing %dx%d images...\n", width, height);
+        fflush(stdout);
+        const BenchmarkSuite suite(width, height);
+
+        if (listOnly) {
+            for (const auto& benchmark : suite.getBenchmarks()) {
+                printf("%s\n", benchmark.name.c_str());
+            }
+        } else {
+            printf("\n%-30s %8s %12s %10s %8s\n", "benchmark", "threads", "best (ms)", "Mpix/s", "speedup");
+            int count = 0;
+
+            for (const auto& benchmark : suite.getBenchmarks()) {
+                if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+                    continue;
+                }
+
+                ++count;
+                double reference = 0.0;
+
+                for (size_t t = 0; t < threads.size(); ++t) {
+                    setNumThreads(threads[t]);
+                    int best = 0;
+
+                    for (int run = 0; run < runs; ++run) {
+                        if (benchmark.prepare) {
+                            benchmark.prepare();
+                        }
+
+                        MyTime t1, t2;
+                        t1.set();
+                        benchmark.run();
+                        t2.set();
+
+                        const int elapsed = std::max(t2.etime(t1), 1);
+                        best = run == 0 ? elapsed : std::min(best, elapsed);
+                    }
+
+                    if (t == 0) {
+                        reference = best;
+                    }
+
+                    printf("%-30s %8d %12.1f %10.2f %7.2fx\n", benchmark.name.c_str(), threads[t], best / 1000.0, benchmark.megaPixels * 1000000.0 / best, reference / best);
+                    fflush(stdout);
+                }
+            }
+
+            if (!count) {
+                fprintf(stderr, "No benchmark matches \"%s\".\n", filter.c_str());
+                result = -1;
+            }
+        }
+    }
+
+    rtengine::cleanup();
+    return result;
+}
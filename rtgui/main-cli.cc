@@ -26,11 +26,16 @@
 #include "config.h"
 #include <gtkmm.h>
 #include <giomm.h>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <sstream>
 #include <tiffio.h>
 #include <cstring>
 #include <cstdlib>
 #include <locale.h>
+#include "../rtengine/boundedqueue.h"
+#include "../rtengine/pipelinetrace.h"
 #include "../rtengine/procparams.h"
 #include "../rtengine/profilestore.h"
 #include "../rtengine/rtengine.h"
@@ -40,6 +45,7 @@
 #include "version.h"
 #include "extprog.h"
 #include "pathutils.h"
+#include "threadutils.h"
 
 #ifndef WIN32
 #include <glibmm/fileutils.h>
@@ -53,6 +59,10 @@
 #include "conio.h"
 #endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 // Set this to 1 to make RT work when started with Eclipse and arguments, at least on Windows platform
 #define ECLIPSE_ARGS 0
 
@@ -88,6 +98,97 @@ Glib::ustring fname_to_utf8 (const char* fname)
 
 bool fast_export = false;
 
+// Protects the lazy loading of the dynamic profile rules when several images are in flight
+MyMutex profileMutex;
+
+int getNumProcs()
+{
+#ifdef _OPENMP
+    return omp_get_num_procs();
+#else
+    return 1;
+#endif
+}
+
+// An input file travelling through the stages of the batch processing
+struct BatchJob {
+    explicit BatchJob (const Glib::ustring& inputFile) :
+        inputFile (inputFile),
+        ii (nullptr),
+        job (nullptr),
+        resultImage (nullptr)
+    {
+    }
+
+    Glib::ustring inputFile;
+    Glib::ustring outputFile;
+    rtengine::InitialImage* ii;
+    rtengine::ProcessingJob* job;
+    rtengine::IImagefloat* resultImage;
+    rtengine::procparams::ProcParams params;
+    std::ostringstream out;
+    std::ostringstream err;
+};
+
+// Divides the available cores between the images processed concurrently
+// and the OpenMP threads used inside each image
+int getThreadsPerImage (int concurrentImages)
+{
+    return std::max(1, getNumProcs() / std::max(1, concurrentImages));
+}
+
+// The cores shared by the decoding, development and saving stages of all the images in flight
+class ThreadBudget
+{
+public:
+    explicit ThreadBudget (int threads) : available (threads)
+    {
+    }
+
+    // Takes up to wanted threads, but at least one so that no stage waits for another
+    int acquire (int wanted)
+    {
+        MyMutex::MyLock lock (mutex);
+        const int threads = std::max (1, std::min (wanted, available));
+        available -= threads;
+        return threads;
+    }
+
+    void release (int threads)
+    {
+        MyMutex::MyLock lock (mutex);
+        available += threads;
+    }
+
+private:
+    MyMutex mutex;
+    int available;
+};
+
+// Sets the OpenMP threads of the calling stage from the budget while an image goes through it
+class ThreadShare
+{
+public:
+    ThreadShare (ThreadBudget& budget, int wanted) : budget (budget), threads (budget.acquire (wanted))
+    {
+#ifdef _OPENMP
+        omp_set_num_threads (threads);
+#endif
+    }
+
+    ~ThreadShare()
+    {
+        budget.release (threads);
+    }
+
+    ThreadShare (const ThreadShare&) = delete;
+    ThreadShare& operator = (const ThreadShare&) = delete;
+
+private:
+    ThreadBudget& budget;
+    const int threads;
+};
+
 }
 
 /* Process line command options
@@ -217,6 +318,7 @@ int main (int argc, char **argv)
 
     if (argc > 1) {
         ret = processLineParams (argc, argv);
+        rtengine::PipelineTrace::getInstance().save();
     } else {
         std::cout << "Terminating without anything to do." << std::endl;
     }
@@ -270,6 +372,7 @@ int processLineParams ( int argc, char **argv )
     int subsampling = 3;
     int bits = -1;
     bool isFloat = false;
+    int concurrentImages = 1;
     std::string outputType;
     unsigned errors = 0;
 
@@ -432,6 +535,22 @@ int processLineParams ( int argc, char **argv )
                     fast_export = true;
                     break;
 
+                case 'J':
+                    if (currParam.size() < 3) {
+                        // by default, keep one image in flight per group of 4 cores
+                        concurrentImages = std::max(1, getNumProcs() / 4);
+                    } else {
+                        concurrentImages = atoi (currParam.substr (2).c_str());
+
+                        if (concurrentImages < 1) {
+                            std::cerr << "Error: the value accompanying the -J switch has to be greater than 0!" << std::endl;
+                            deleteProcParams (processingParams);
+                            return -3;
+                        }
+                    }
+
+                    break;
+
                 case 'c': // MUST be last option
                     while (iArg + 1 < argc) {
                         iArg++;
@@ -538,7 +657,7 @@ int processLineParams ( int argc, char **argv )
                     std::cout << "  " << Glib::path_get_basename (argv[0]) << " <other options> -c <dir>|<files>   Convert files in batch with your own settings." << std::endl;
                     std::cout << std::endl;
                     std::cout << "Options:" << std::endl;
-                    std::cout << "  " << Glib::path_get_basename (argv[0]) << "[-o <output>|-O <output>] [-q] [-a] [-s|-S] [-p <one.pp3> [-p <two.pp3> ...] ] [-d] [ -j[1-100] -js<1-3> | -t[z] -b<8|16|16f|32> | -n -b<8|16> ] [-Y] [-f] -c <input>" << std::endl;
+                    std::cout << "  " << Glib::path_get_basename (argv[0]) << "[-o <output>|-O <output>] [-q] [-a] [-s|-S] [-p <one.pp3> [-p <two.pp3> ...] ] [-d] [ -j[1-100] -js<1-3> | -t[z] -b<8|16|16f|32> | -n -b<8|16> ] [-Y] [-f] [-J[n]] -c <input>" << std::endl;
                     std::cout << std::endl;
                     std::cout << "  -c <files>       Specify one or more input files or folders." << std::endl;
                     std::cout << "                   When specifying folders, Rawtherapee will look for image file types which comply" << std::endl;
@@ -580,6 +699,9 @@ int processLineParams ( int argc, char **argv )
                     std::cout << "                   Compression is hard-coded to PNG_FILTER_PAETH, Z_RLE." << std::endl;
                     std::cout << "  -Y               Overwrite output if present." << std::endl;
                     std::cout << "  -f               Use the custom fast-export processing pipeline." << std::endl;
+                    std::cout << "  -J[n]            Process n images concurrently (default: one per group of 4 cores)." << std::endl;
+                    std::cout << "                   The cores are shared between the images in flight, across their" << std::endl;
+                    std::cout << "                   decoding, development and saving." << std::endl;
                     std::cout << std::endl;
                     std::cout << "Your " << pparamsExt << " files can be incomplete, RawTherapee will build the final values as follows:" << std::endl;
                     std::cout << "  1- A new processing profile is created using neutral values," << std::endl;
@@ -672,169 +794,292 @@ int processLineParams ( int argc, char **argv )
         }
     }
 
-    for ( size_t iFile = 0; iFile < inputFiles.size(); iFile++) {
+    if ( outputType.empty() ) {
+        outputType = "jpg";
+    }
 
-        // Has to be reinstanciated at each profile to have a ProcParams object with default values
-        rtengine::procparams::ProcParams currentParams;
+    if (concurrentImages > static_cast<int>(inputFiles.size())) {
+        concurrentImages = static_cast<int>(inputFiles.size());
+    }
 
-        Glib::ustring inputFile = inputFiles[iFile];
-        std::cout << "Output is " << bits << "-bit " << (isFloat ? "floating-point" : "integer") << "." << std::endl;
-        std::cout << "Processing: " << inputFile << std::endl;
+    // The files go through three stages running concurrently: decoding and building of the processing
+    // parameters, development, and saving. The stages are connected by bounded queues, so that at most
+    // a few decoded and developed images are waiting at any time. Several images are developed at once
+    // when asked for (-J). Each stage takes the share of an image from a single budget of OpenMP threads
+    // while it works on it, so that the stages running at the same time stay within the cores.
+    const int threadsPerImage = getThreadsPerImage (concurrentImages);
+    ThreadBudget threadBudget (getNumProcs());
+    rtengine::BoundedQueue<BatchJob*> decodedQueue (concurrentImages);
+    rtengine::BoundedQueue<BatchJob*> developedQueue (concurrentImages);
+    std::atomic<size_t> nextFile (0);
+    std::atomic<unsigned> pipelineErrors (0);
+    MyMutex consoleMutex;
+
+    if (concurrentImages > 1) {
+        std::cout << "Processing " << concurrentImages << " images concurrently, using " << threadsPerImage << " thread(s) per image." << std::endl;
+    }
 
-        rtengine::InitialImage* ii = nullptr;
-        rtengine::ProcessingJob* job = nullptr;
-        int errorCode;
-        bool isRaw = false;
+    // The console output of each file is buffered and printed as a whole once the file is done
+    const auto finishJob =
+        [&](BatchJob* bj, bool failed)
+        {
+            if (failed) {
+                pipelineErrors++;
+            }
 
-        Glib::ustring outputFile;
+            {
+                MyMutex::MyLock lock (consoleMutex);
+                std::cout << bj->out.str() << std::flush;
+                std::cerr << bj->err.str() << std::flush;
+            }
 
-        if ( outputType.empty() ) {
-            outputType = "jpg";
-        }
+            if (bj->ii) {
+                bj->ii->decreaseRef();
+            }
 
-        if ( outputPath.empty() ) {
-            Glib::ustring s = inputFile;
-            Glib::ustring::size_type ext = s.find_last_of ('.');
-            outputFile = s.substr (0, ext) + "." + outputType;
-        } else if ( outputDirectory ) {
-            Glib::ustring s = Glib::path_get_basename ( inputFile );
-            Glib::ustring::size_type ext = s.find_last_of ('.');
-            outputFile = Glib::build_filename (outputPath, s.substr (0, ext) + "." + outputType);
-        } else {
-            if (leaveUntouched) {
-                outputFile = outputPath;
-            } else {
-                Glib::ustring s = outputPath;
+            delete bj->resultImage;
+            delete bj;
+        };
+
+    // Loads the image and builds its processing parameters; returns false if the file has to be dropped
+    const auto prepareJob =
+        [&](BatchJob* bj, bool& failed) -> bool
+        {
+            const Glib::ustring& inputFile = bj->inputFile;
+            std::ostream& out = bj->out;
+            std::ostream& err = bj->err;
+
+            out << "Output is " << bits << "-bit " << (isFloat ? "floating-point" : "integer") << "." << std::endl;
+            out << "Processing: " << inputFile << std::endl;
+
+            int errorCode;
+            bool isRaw = false;
+
+            Glib::ustring& outputFile = bj->outputFile;
+
+            if ( outputPath.empty() ) {
+                Glib::ustring s = inputFile;
                 Glib::ustring::size_type ext = s.find_last_of ('.');
                 outputFile = s.substr (0, ext) + "." + outputType;
+            } else if ( outputDirectory ) {
+                Glib::ustring s = Glib::path_get_basename ( inputFile );
+                Glib::ustring::size_type ext = s.find_last_of ('.');
+                outputFile = Glib::build_filename (outputPath, s.substr (0, ext) + "." + outputType);
+            } else {
+                if (leaveUntouched) {
+                    outputFile = outputPath;
+                } else {
+                    Glib::ustring s = outputPath;
+                    Glib::ustring::size_type ext = s.find_last_of ('.');
+                    outputFile = s.substr (0, ext) + "." + outputType;
+                }
             }
-        }
 
-        if ( inputFile == outputFile) {
-            std::cerr << "Cannot overwrite: " << inputFile << std::endl;
-            continue;
-        }
+            if ( inputFile == outputFile) {
+                err << "Cannot overwrite: " << inputFile << std::endl;
+                return false;
+            }
 
-        if ( !overwriteFiles && Glib::file_test ( outputFile, Glib::FILE_TEST_EXISTS ) ) {
-            std::cerr << outputFile  << " already exists: use -Y option to overwrite. This image has been skipped." << std::endl;
-            continue;
-        }
+            if ( !overwriteFiles && Glib::file_test ( outputFile, Glib::FILE_TEST_EXISTS ) ) {
+                err << outputFile  << " already exists: use -Y option to overwrite. This image has been skipped." << std::endl;
+                return false;
+            }
 
-        // Load the image
-        isRaw = true;
-        Glib::ustring ext = getExtension (inputFile);
+            // Load the image
+            isRaw = true;
+            Glib::ustring ext = getExtension (inputFile);
 
-        if (ext.lowercase() == "jpg" || ext.lowercase() == "jpeg" || ext.lowercase() == "tif" || ext.lowercase() == "tiff" || ext.lowercase() == "png") {
-            isRaw = false;
-        }
+            if (ext.lowercase() == "jpg" || ext.lowercase() == "jpeg" || ext.lowercase() == "tif" || ext.lowercase() == "tiff" || ext.lowercase() == "png") {
+                isRaw = false;
+            }
 
-        ii = rtengine::InitialImage::load ( inputFile, isRaw, &errorCode, nullptr );
+            bj->ii = rtengine::InitialImage::load ( inputFile, isRaw, &errorCode, nullptr );
 
-        if (!ii) {
-            errors++;
-            std::cerr << "Error loading file: " << inputFile << std::endl;
-            continue;
-        }
+            if (!bj->ii) {
+                failed = true;
+                err << "Error loading file: " << inputFile << std::endl;
+                return false;
+            }
+
+            // Each file comes with its own ProcParams object with default values
+            rtengine::procparams::ProcParams& currentParams = bj->params;
 
-        if (useDefault) {
-            if (isRaw) {
-                if (options.defProfRaw == DEFPROFILE_DYNAMIC) {
-                    rawParams->deleteInstance();
-                    delete rawParams;
-                    rawParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
+            if (useDefault) {
+                const Glib::ustring& defProf = isRaw ? options.defProfRaw : options.defProfImg;
+
+                if (defProf == DEFPROFILE_DYNAMIC) {
+                    rtengine::procparams::PartialProfile* dynamicParams;
+
+                    {
+                        // the dynamic profile rules are lazily loaded by the ProfileStore
+                        MyMutex::MyLock lock (profileMutex);
+                        dynamicParams = ProfileStore::getInstance()->loadDynamicProfile (bj->ii->getMetaData());
+                    }
+
+                    dynamicParams->applyTo (&currentParams);
+                    dynamicParams->deleteInstance();
+                    delete dynamicParams;
+                } else {
+                    (isRaw ? rawParams : imgParams)->applyTo (&currentParams);
                 }
 
-                std::cout << "  Merging default raw processing profile." << std::endl;
-                rawParams->applyTo (&currentParams);
-            } else {
-                if (options.defProfImg == DEFPROFILE_DYNAMIC) {
-                    imgParams->deleteInstance();
-                    delete imgParams;
-                    imgParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
+                out << (isRaw ? "  Merging default raw processing profile." : "  Merging default non-raw processing profile.") << std::endl;
+            }
+
+            bool sideCarFound = false;
+            unsigned int i = 0;
+
+            // Iterate the procparams file list in order to build the final ProcParams
+            do {
+                if (sideProcParams && i == sideCarFilePos) {
+                    // using the sidecar file
+                    Glib::ustring sideProcessingParams = inputFile + paramFileExtension;
+
+                    // the "load" method don't reset the procparams values anymore, so values found in the procparam file override the one of currentParams
+                    if ( !Glib::file_test ( sideProcessingParams, Glib::FILE_TEST_EXISTS ) || currentParams.load ( sideProcessingParams )) {
+                        err << "Warning: sidecar file requested but not found for: " << sideProcessingParams << std::endl;
+                    } else {
+                        sideCarFound = true;
+                        out << "  Merging sidecar procparams." << std::endl;
+                    }
+                }
+
+                if ( processingParams.size() > i  ) {
+                    out << "  Merging procparams #" << i << std::endl;
+                    processingParams[i]->applyTo (&currentParams);
                 }
 
-                std::cout << "  Merging default non-raw processing profile." << std::endl;
-                imgParams->applyTo (&currentParams);
+                i++;
+            } while (i < processingParams.size() + (sideProcParams ? 1 : 0));
+
+            if ( sideProcParams && !sideCarFound && skipIfNoSidecar ) {
+                failed = true;
+                err << "Error: no sidecar procparams found for: " << inputFile << std::endl;
+                return false;
             }
-        }
 
-        bool sideCarFound = false;
-        unsigned int i = 0;
+            bj->job = rtengine::ProcessingJob::create (bj->ii, currentParams, fast_export);
+
+            if ( !bj->job ) {
+                failed = true;
+                err << "Error creating processing for: " << inputFile << std::endl;
+                return false;
+            }
 
-        // Iterate the procparams file list in order to build the final ProcParams
-        do {
-            if (sideProcParams && i == sideCarFilePos) {
-                // using the sidecar file
-                Glib::ustring sideProcessingParams = inputFile + paramFileExtension;
+            return true;
+        };
+
+    const auto decodeStage =
+        [&]()
+        {
+            for (size_t iFile = nextFile++; iFile < inputFiles.size(); iFile = nextFile++) {
+                BatchJob* const bj = new BatchJob (inputFiles[iFile]);
+                bool failed = false;
+                bool prepared;
+
+                {
+                    // the raw decoders run parallel loops too
+                    const ThreadShare share (threadBudget, threadsPerImage);
+                    prepared = prepareJob (bj, failed);
+                }
 
-                // the "load" method don't reset the procparams values anymore, so values found in the procparam file override the one of currentParams
-                if ( !Glib::file_test ( sideProcessingParams, Glib::FILE_TEST_EXISTS ) || currentParams.load ( sideProcessingParams )) {
-                    std::cerr << "Warning: sidecar file requested but not found for: " << sideProcessingParams << std::endl;
+                if (!prepared) {
+                    finishJob (bj, failed);
                 } else {
-                    sideCarFound = true;
-                    std::cout << "  Merging sidecar procparams." << std::endl;
+                    decodedQueue.push (bj);
                 }
             }
+        };
+
+    const auto developStage =
+        [&]()
+        {
+            BatchJob* bj;
+
+            while (decodedQueue.pop (bj)) {
+                int errorCode;
+
+                // Process image; the job is consumed by the processing
+                {
+                    const ThreadShare share (threadBudget, threadsPerImage);
+                    bj->resultImage = rtengine::processImage (bj->job, errorCode, nullptr);
+                }
 
-            if ( processingParams.size() > i  ) {
-                std::cout << "  Merging procparams #" << i << std::endl;
-                processingParams[i]->applyTo (&currentParams);
+                bj->job = nullptr;
+
+                if ( !bj->resultImage ) {
+                    bj->err << "Error processing: " << bj->inputFile << std::endl;
+                    finishJob (bj, true);
+                } else {
+                    developedQueue.push (bj);
+                }
             }
+        };
+
+    const auto saveStage =
+        [&]()
+        {
+            BatchJob* bj;
+
+            while (developedQueue.pop (bj)) {
+                int errorCode;
+                rtengine::IImagefloat* const resultImage = bj->resultImage;
+                const Glib::ustring& outputFile = bj->outputFile;
+
+                // save image to disk, the encoders run parallel loops too
+                const ThreadShare share (threadBudget, threadsPerImage);
+
+                if ( outputType == "jpg" ) {
+                    errorCode = resultImage->saveAsJPEG ( outputFile, compression, subsampling );
+                } else if ( outputType == "tif" ) {
+                    errorCode = resultImage->saveAsTIFF ( outputFile, bits, isFloat, compression == 0  );
+                } else if ( outputType == "png" ) {
+                    errorCode = resultImage->saveAsPNG ( outputFile, bits );
+                } else {
+                    errorCode = resultImage->saveToFile (outputFile);
+                }
 
-            i++;
-        } while (i < processingParams.size() + (sideProcParams ? 1 : 0));
+                if (errorCode) {
+                    bj->err << "Error saving to: " << outputFile << std::endl;
+                } else {
+                    if ( copyParamsFile ) {
+                        Glib::ustring outputProcessingParams = outputFile + paramFileExtension;
+                        bj->params.save ( outputProcessingParams );
+                    }
+                }
 
-        if ( sideProcParams && !sideCarFound && skipIfNoSidecar ) {
-            delete ii;
-            errors++;
-            std::cerr << "Error: no sidecar procparams found for: " << inputFile << std::endl;
-            continue;
-        }
+                finishJob (bj, errorCode != 0);
+            }
+        };
 
-        job = rtengine::ProcessingJob::create (ii, currentParams, fast_export);
+    std::vector<Glib::Threads::Thread*> decoders;
+    std::vector<Glib::Threads::Thread*> developers;
+    std::vector<Glib::Threads::Thread*> savers;
 
-        if ( !job ) {
-            errors++;
-            std::cerr << "Error creating processing for: " << inputFile << std::endl;
-            ii->decreaseRef();
-            continue;
-        }
+    for (int i = 0; i < concurrentImages; ++i) {
+        decoders.push_back (Glib::Threads::Thread::create (decodeStage));
+        developers.push_back (Glib::Threads::Thread::create (developStage));
+        savers.push_back (Glib::Threads::Thread::create (saveStage));
+    }
 
-        // Process image
-        rtengine::IImagefloat* resultImage = rtengine::processImage (job, errorCode, nullptr);
+    for (auto thread : decoders) {
+        thread->join();
+    }
 
-        if ( !resultImage ) {
-            errors++;
-            std::cerr << "Error processing: " << inputFile << std::endl;
-            rtengine::ProcessingJob::destroy ( job );
-            continue;
-        }
+    decodedQueue.close();
 
-        // save image to disk
-        if ( outputType == "jpg" ) {
-            errorCode = resultImage->saveAsJPEG ( outputFile, compression, subsampling );
-        } else if ( outputType == "tif" ) {
-            errorCode = resultImage->saveAsTIFF ( outputFile, bits, isFloat, compression == 0  );
-        } else if ( outputType == "png" ) {
-            errorCode = resultImage->saveAsPNG ( outputFile, bits );
-        } else {
-            errorCode = resultImage->saveToFile (outputFile);
-        }
+    for (auto thread : developers) {
+        thread->join();
+    }
 
-        if (errorCode) {
-            errors++;
-            std::cerr << "Error saving to: " << outputFile << std::endl;
-        } else {
-            if ( copyParamsFile ) {
-                Glib::ustring outputProcessingParams = outputFile + paramFileExtension;
-                currentParams.save ( outputProcessingParams );
-            }
-        }
+    developedQueue.close();
 
-        ii->decreaseRef();
-        delete resultImage;
+    for (auto thread : savers) {
+        thread->join();
     }
 
+    errors += pipelineErrors;
+
     if (imgParams) {
         imgParams->deleteInstance();
         delete imgParams;
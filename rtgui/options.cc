@@ -401,6 +401,7 @@ void Options::setDefaults()
     theme = "RawTherapee";
     maxThumbnailHeight = 250;
     maxCacheEntries = 20000;
+    packedCache = false;
     thumbInterp = 1;
     autoSuffix = true;
     forceFormatOpts = true;
@@ -471,6 +472,13 @@ void Options::setDefaults()
     chunkSizeRCD = 2;
     chunkSizeRGB = 2;
     chunkSizeXT = 2;
+    exportTileHeight = 0;
+    fftwWisdom = true;
+    thumbnailIOThreads = 0;
+    thumbnailCPUThreads = 0;
+    dcpBakedLut = false;
+    masterFrameCache = true;
+    masterFrameCacheSize = 2048;
     FileBrowserToolbarSingleRow = false;
     hideTPVScrollbar = false;
     whiteBalanceSpotSize = 8;
@@ -593,6 +601,7 @@ void Options::setDefaults()
     rtSettings.ACESp0 = "RTv2_ACES-AP0";
     rtSettings.ACESp1 = "RTv2_ACES-AP1";
     rtSettings.verbose = false;
+    rtSettings.traceFile = "";
     rtSettings.gamutICC = true;
     rtSettings.gamutLch = true;
     rtSettings.amchroma = 40;//between 20 and 140   low values increase effect..and also artifacts, high values reduces
@@ -1022,6 +1031,10 @@ void Options::readFromFile(Glib::ustring fname)
                     maxCacheEntries = keyFile.get_integer("File Browser", "MaxCacheEntries");
                 }
 
+                if (keyFile.has_key("File Browser", "PackedCache")) {
+                    packedCache = keyFile.get_boolean("File Browser", "PackedCache");
+                }
+
                 if (keyFile.has_key("File Browser", "ParseExtensions")) {
                     auto l = keyFile.get_string_list("File Browser", "ParseExtensions");
                     if (!l.empty()) {
@@ -1154,6 +1167,10 @@ void Options::readFromFile(Glib::ustring fname)
                     measure = keyFile.get_boolean("Performance", "Measure");
                 }
 
+                if (keyFile.has_key("Performance", "TraceFile")) {
+                    rtSettings.traceFile = keyFile.get_string("Performance", "TraceFile");
+                }
+
                 if (keyFile.has_key("Performance", "ChunkSizeAMAZE")) {
                     chunkSizeAMAZE = std::min(16, std::max(1, keyFile.get_integer("Performance", "ChunkSizeAMAZE")));
                 }
@@ -1174,6 +1191,34 @@ void Options::readFromFile(Glib::ustring fname)
                     chunkSizeXT = std::min(16, std::max(1, keyFile.get_integer("Performance", "ChunkSizeXT")));
                 }
 
+                if (keyFile.has_key("Performance", "ExportTileHeight")) {
+                    exportTileHeight = std::max(0, keyFile.get_integer("Performance", "ExportTileHeight"));
+                }
+
+                if (keyFile.has_key("Performance", "FFTWWisdom")) {
+                    fftwWisdom = keyFile.get_boolean("Performance", "FFTWWisdom");
+                }
+
+                if (keyFile.has_key("Performance", "ThumbnailIOThreads")) {
+                    thumbnailIOThreads = std::max(0, keyFile.get_integer("Performance", "ThumbnailIOThreads"));
+                }
+
+                if (keyFile.has_key("Performance", "ThumbnailCPUThreads")) {
+                    thumbnailCPUThreads = std::max(0, keyFile.get_integer("Performance", "ThumbnailCPUThreads"));
+                }
+
+                if (keyFile.has_key("Performance", "DCPBakedLUT")) {
+                    dcpBakedLut = keyFile.get_boolean("Performance", "DCPBakedLUT");
+                }
+
+                if (keyFile.has_key("Performance", "MasterFrameCache")) {
+                    masterFrameCache = keyFile.get_boolean("Performance", "MasterFrameCache");
+                }
+
+                if (keyFile.has_key("Performance", "MasterFrameCacheSize")) {
+                    masterFrameCacheSize = std::max(0, keyFile.get_integer("Performance", "MasterFrameCacheSize"));
+                }
+
                 if (keyFile.has_key("Performance", "ThumbnailInspectorMode")) {
                     rtSettings.thumbnail_inspector_mode = static_cast<rtengine::Settings::ThumbnailInspectorMode>(keyFile.get_integer("Performance", "ThumbnailInspectorMode"));
                 }
@@ -2102,6 +2147,7 @@ void Options::saveToFile(Glib::ustring fname)
         keyFile.set_integer("File Browser", "SameThumbSize", sameThumbSize);
         keyFile.set_integer("File Browser", "MaxPreviewHeight", maxThumbnailHeight);
         keyFile.set_integer("File Browser", "MaxCacheEntries", maxCacheEntries);
+        keyFile.set_boolean("File Browser", "PackedCache", packedCache);
         Glib::ArrayHandle<Glib::ustring> pext = parseExtensions;
         keyFile.set_string_list("File Browser", "ParseExtensions", pext);
         Glib::ArrayHandle<int> pextena = parseExtensionsEnabled;
@@ -2147,11 +2193,19 @@ void Options::saveToFile(Glib::ustring fname)
         keyFile.set_integer("Performance", "PreviewDemosaicFromSidecar", prevdemo);
         keyFile.set_boolean("Performance", "SerializeTiffRead", serializeTiffRead);
         keyFile.set_integer("Performance", "Measure", measure);
+        keyFile.set_string("Performance", "TraceFile", rtSettings.traceFile);
         keyFile.set_integer("Performance", "ChunkSizeAMAZE", chunkSizeAMAZE);
         keyFile.set_integer("Performance", "ChunkSizeRCD", chunkSizeRCD);
         keyFile.set_integer("Performance", "ChunkSizeRGB", chunkSizeRGB);
         keyFile.set_integer("Performance", "ChunkSizeXT", chunkSizeXT);
         keyFile.set_integer("Performance", "ChunkSizeCA", chunkSizeCA);
+        keyFile.set_integer("Performance", "ExportTileHeight", exportTileHeight);
+        keyFile.set_boolean("Performance", "FFTWWisdom", fftwWisdom);
+        keyFile.set_integer("Performance", "ThumbnailIOThreads", thumbnailIOThreads);
+        keyFile.set_integer("Performance", "ThumbnailCPUThreads", thumbnailCPUThreads);
+        keyFile.set_boolean("Performance", "DCPBakedLUT", dcpBakedLut);
+        keyFile.set_boolean("Performance", "MasterFrameCache", masterFrameCache);
+        keyFile.set_integer("Performance", "MasterFrameCacheSize", masterFrameCacheSize);
         keyFile.set_integer("Performance", "ThumbnailInspectorMode", int(rtSettings.thumbnail_inspector_mode));
 
 
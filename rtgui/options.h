@@ -272,6 +272,7 @@ public:
     int editorToSendTo;
     int maxThumbnailHeight;
     std::size_t maxCacheEntries;
+    bool packedCache; // store the cached thumbnails, embedded profiles and data in a single file
     int thumbInterp; // 0: nearest, 1: bilinear
     std::vector<Glib::ustring> parseExtensions;   // List containing all extensions type
     std::vector<int> parseExtensionsEnabled;      // List of bool to retain extension or not
@@ -341,6 +342,13 @@ public:
     size_t chunkSizeRCD;
     size_t chunkSizeRGB;
     size_t chunkSizeXT;
+    int exportTileHeight; // height of the bands processed at once by the export when its tools allow it ; 0 = whole image
+    bool fftwWisdom; // keep the wisdom of the measured FFTW plans in the cache directory
+    int thumbnailIOThreads;  // threads loading the previews of the file browser ; 0 = half the processors, at least 2
+    int thumbnailCPUThreads; // threads processing the thumbnails of the file browser ; 0 = number of processors
+    bool dcpBakedLut; // apply the DCP hue/sat map, look table and tone curve through precomputed 3D LUTs
+    bool masterFrameCache; // keep the dark frames and flat fields averaged from several files in the cache directory
+    int masterFrameCacheSize; // in MiB, the least recently used master frames are removed beyond
     bool menuGroupRank;
     bool menuGroupLabel;
     bool menuGroupFileOperations;
@@ -1409,6 +1409,9 @@ Gtk::Widget* Preferences::getFileBrowserPanel()
     maxCacheEntriesSB->set_increments (1, 10);
     maxCacheEntriesSB->set_range (10, 100000);
 
+    packedCacheCB = Gtk::manage (new Gtk::CheckButton(M("PREFERENCES_CACHEPACKED") + Glib::ustring (" (") + M ("PREFERENCES_APPLNEXTSTARTUP") + ")"));
+    setExpandAlignProperties(packedCacheCB, false, false, Gtk::ALIGN_START, Gtk::ALIGN_CENTER);
+
     // Separation is needed so that a button is not accidentally clicked when one wanted
     // to click a spinbox. Ideally, the separation wouldn't require attaching a widget, but how?
     Gtk::HSeparator *cacheSeparator = Gtk::manage (new  Gtk::HSeparator());
@@ -1430,14 +1433,15 @@ Gtk::Widget* Preferences::getFileBrowserPanel()
     cacheGrid->attach (*maxThumbHeightSB, 1, 0, 1, 1);
     cacheGrid->attach (*maxCacheEntriesLbl, 0, 1, 1, 1);
     cacheGrid->attach (*maxCacheEntriesSB, 1, 1, 1, 1);
-    cacheGrid->attach (*cacheSeparator, 0, 2, 2, 1);
-    cacheGrid->attach (*clearThumbsLbl, 0, 3, 1, 1);
-    cacheGrid->attach (*clearThumbsBtn, 1, 3, 1, 1);
+    cacheGrid->attach (*packedCacheCB, 0, 2, 2, 1);
+    cacheGrid->attach (*cacheSeparator, 0, 3, 2, 1);
+    cacheGrid->attach (*clearThumbsLbl, 0, 4, 1, 1);
+    cacheGrid->attach (*clearThumbsBtn, 1, 4, 1, 1);
     if (moptions.saveParamsCache) {
-        cacheGrid->attach (*clearProfilesLbl, 0, 4, 1, 1);
-        cacheGrid->attach (*clearProfilesBtn, 1, 4, 1, 1);
-        cacheGrid->attach (*clearAllLbl, 0, 5, 1, 1);
-        cacheGrid->attach (*clearAllBtn, 1, 5, 1, 1);
+        cacheGrid->attach (*clearProfilesLbl, 0, 5, 1, 1);
+        cacheGrid->attach (*clearProfilesBtn, 1, 5, 1, 1);
+        cacheGrid->attach (*clearAllLbl, 0, 6, 1, 1);
+        cacheGrid->attach (*clearAllBtn, 1, 6, 1, 1);
     }
 
     vbc->pack_start (*cacheGrid, Gtk::PACK_SHRINK, 4);
@@ -1785,6 +1789,7 @@ void Preferences::storePreferences()
     moptions.maxRecentFolders = (int)maxRecentFolders->get_value();
     moptions.maxThumbnailHeight = (int)maxThumbHeightSB->get_value ();
     moptions.maxCacheEntries = (int)maxCacheEntriesSB->get_value ();
+    moptions.packedCache = packedCacheCB->get_active ();
     moptions.overlayedFileNames = overlayedFileNames->get_active();
     moptions.filmStripOverlayedFileNames = filmStripOverlayedFileNames->get_active();
     moptions.sameThumbSize = sameThumbSize->get_active();
@@ -2011,6 +2016,7 @@ void Preferences::fillPreferences()
     maxRecentFolders->set_value(moptions.maxRecentFolders);
     maxThumbHeightSB->set_value (moptions.maxThumbnailHeight);
     maxCacheEntriesSB->set_value (moptions.maxCacheEntries);
+    packedCacheCB->set_active (moptions.packedCache);
     overlayedFileNames->set_active(moptions.overlayedFileNames);
     filmStripOverlayedFileNames->set_active(moptions.filmStripOverlayedFileNames);
     sameThumbSize->set_active(moptions.sameThumbSize);
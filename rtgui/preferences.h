@@ -159,6 +159,7 @@ class Preferences final :
     Gtk::SpinButton*   maxRecentFolders;
     Gtk::SpinButton*   maxThumbHeightSB;
     Gtk::SpinButton*   maxCacheEntriesSB;
+    Gtk::CheckButton*  packedCacheCB;
     Gtk::Entry*     extension;
     Gtk::TreeView*  extensions;
     Gtk::Button*    addExt;
@@ -24,6 +24,7 @@
 #include "rtscalable.h"
 #include "thumbbrowserbase.h"
 #include "thumbbrowserentrybase.h"
+#include "thumbimageupdater.h"
 
 #include "../rtengine/rt_math.h"
 
@@ -1003,12 +1004,21 @@ bool ThumbBrowserBase::Internal::on_draw(const ::Cairo::RefPtr< Cairo::Context>
         MYWRITERLOCK(l, parent->entryRW);
 
         for (size_t i = 0; i < parent->fd.size() && !dirty; i++) { // if dirty meanwhile, cancel and wait for next redraw
-            if (!parent->fd[i]->drawable || !parent->fd[i]->insideWindow (0, 0, w, h)) {
-                parent->fd[i]->updatepriority = false;
+            ThumbnailExecutor::Lane lane;
+
+            if (!parent->fd[i]->drawable) {
+                lane = ThumbnailExecutor::Lane::BACKGROUND;
+            } else if (!parent->fd[i]->insideWindow (0, 0, w, h)) {
+                // one page above or below is likely to be shown next
+                lane = parent->fd[i]->insideWindow (0, -h, w, 3 * h) ? ThumbnailExecutor::Lane::NEAR_VISIBLE : ThumbnailExecutor::Lane::BACKGROUND;
             } else {
-                parent->fd[i]->updatepriority = true;
+                lane = ThumbnailExecutor::Lane::VISIBLE;
                 parent->fd[i]->draw (cr);
             }
+
+            if (parent->fd[i]->updatelane.exchange(lane) != lane) {
+                thumbImageUpdater->setLane (parent->fd[i], lane);
+            }
         }
     }
     style->render_frame(cr, 0., 0., w, h);
@@ -164,7 +164,7 @@ ThumbBrowserEntryBase::ThumbBrowserEntryBase (const Glib::ustring& fname) :
     italicstyle(false),
     edited(false),
     recentlysaved(false),
-    updatepriority(false),
+    updatelane(ThumbnailExecutor::Lane::BACKGROUND),
     withFilename(WFNAME_NONE)
 {
 }
@@ -26,6 +26,7 @@
 #include "guiutils.h"
 #include "lwbuttonset.h"
 #include "threadutils.h"
+#include "thumbnailexecutor.h"
 
 #include "../rtengine/coord2d.h"
 
@@ -114,7 +115,7 @@ public:
     bool italicstyle;
     bool edited;
     bool recentlysaved;
-    bool updatepriority;
+    std::atomic<ThumbnailExecutor::Lane> updatelane; // where the entry is relative to the visible area, for the thumbnail jobs
     eWithFilename withFilename;
 
     explicit ThumbBrowserEntryBase (const Glib::ustring& fname);
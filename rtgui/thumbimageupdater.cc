@@ -19,6 +19,7 @@
 
 #include <atomic>
 #include <set>
+#include <utility>
 
 #include <gtkmm.h>
 
@@ -31,10 +32,6 @@
 
 #include "../rtengine/procparams.h"
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif
-
 #define DEBUG(format,args...)
 //#define DEBUG(format,args...) printf("ThumbImageUpdate::%s: " format "\n", __FUNCTION__, ## args)
 
@@ -43,53 +40,20 @@ class ThumbImageUpdater::Impl :
 {
 public:
 
-    struct Job {
-        Job(ThumbBrowserEntryBase* tbe, bool* priority, bool upgrade,
-            ThumbImageUpdateListener* listener):
-            tbe_(tbe),
-    /*pparams_(pparams),
-    height_(height), */
-            priority_(priority),
-            upgrade_(upgrade),
-            listener_(listener)
-        {}
-
-        Job():
-            tbe_(nullptr),
-            priority_(nullptr),
-            upgrade_(false),
-            listener_(nullptr)
-        {}
-
-        ThumbBrowserEntryBase* tbe_;
-        /*rtengine::procparams::ProcParams pparams_;
-        int height_;*/
-        bool* priority_;
-        bool upgrade_;
-        ThumbImageUpdateListener* listener_;
-    };
-
-    typedef std::list<Job> JobList;
+    // thumbnail and upgrade flag of the queued jobs
+    typedef std::set<std::pair<ThumbBrowserEntryBase*, bool>> JobSet;
 
     Impl():
         active_(0),
         inactive_waiting_(false)
     {
-        int threadCount = 1;
-#ifdef _OPENMP
-        threadCount = omp_get_num_procs();
-#endif
-
-        threadPool_ = new Glib::ThreadPool(threadCount, 0);
     }
 
-    Glib::ThreadPool* threadPool_;
-
     // Need to be a Glib::Threads::Mutex because used in a Glib::Threads::Cond object...
     // This is the only exceptions along with GThreadMutex (guiutils.cc), MyMutex is used everywhere else
     Glib::Threads::Mutex mutex_;
 
-    JobList jobs_;
+    JobSet jobs_;
 
     std::atomic<unsigned int> active_;
 
@@ -98,50 +62,18 @@ public:
     Glib::Threads::Cond inactive_;
 
     void
-    processNextJob()
+    processJob(ThumbBrowserEntryBase* tbe, bool upgrade, ThumbImageUpdateListener* listener)
     {
-        Job j;
-
         {
             Glib::Threads::Mutex::Lock lock(mutex_);
 
-            // nothing to do; could be jobs have been removed
-            if ( jobs_.empty() ) {
-                DEBUG("processing: nothing to do (%d)", jobs_.empty());
+            // remove so a new request for the same thumbnail gets queued again
+            if ( jobs_.erase(std::make_pair(tbe, upgrade)) == 0 ) {
+                // removed meanwhile
                 return;
             }
 
-            JobList::iterator i;
-
-            // see if any priority jobs exist
-            for ( i = jobs_.begin(); i != jobs_.end(); ++i) {
-                if ( *(i->priority_) ) {
-                    DEBUG("processing(priority) %s", i->tbe_->thumbnail->getFileName().c_str());
-                    break;
-                }
-            }
-
-            // see if any none upgrade jobs exist
-            if ( i == jobs_.end() ) {
-                for ( i = jobs_.begin(); i != jobs_.end(); ++i) {
-                    if ( !i->upgrade_ ) {
-                        DEBUG("processing(not-upgrade) %s", i->tbe_->thumbnail->getFileName().c_str());
-                        break;
-                    }
-                }
-            }
-
-            // if none, then use first
-            if ( i == jobs_.end() ) {
-                i = jobs_.begin();
-                DEBUG("processing(first) %s", i->tbe_->thumbnail->getFileName().c_str());
-            }
-
-            // copy found job
-            j = *i;
-
-            // remove so not run again
-            jobs_.erase(i);
+            DEBUG("processing %s", tbe->thumbnail->getFileName().c_str());
             DEBUG("%d job(s) remaining", int(jobs_.size()) );
 
             ++active_;
@@ -150,19 +82,19 @@ public:
         // unlock and do processing; will relock on block exit, then call listener
         double scale = 1.0;
         rtengine::IImage8* img = nullptr;
-        Thumbnail* thm = j.tbe_->thumbnail;
+        Thumbnail* thm = tbe->thumbnail;
 
-        if ( j.upgrade_ ) {
+        if ( upgrade ) {
             if ( thm->isQuick() ) {
-                img = thm->upgradeThumbImage(thm->getProcParams(), j.tbe_->getPreviewHeight(), scale);
+                img = thm->upgradeThumbImage(thm->getProcParams(), tbe->getPreviewHeight(), scale);
             }
         } else {
-            img = thm->processThumbImage(thm->getProcParams(), j.tbe_->getPreviewHeight(), scale);
+            img = thm->processThumbImage(thm->getProcParams(), tbe->getPreviewHeight(), scale);
         }
 
         if (img) {
             DEBUG("pushing image %s", thm->getFileName().c_str());
-            j.listener_->updateImage(img, scale, thm->getProcParams().crop);
+            listener->updateImage(img, scale, thm->getProcParams().crop);
         }
 
         if ( --active_ == 0 ) {
@@ -191,7 +123,7 @@ ThumbImageUpdater::~ThumbImageUpdater() {
     delete impl_;
 }
 
-void ThumbImageUpdater::add(ThumbBrowserEntryBase* tbe, bool* priority, bool upgrade, ThumbImageUpdateListener* l)
+void ThumbImageUpdater::add(ThumbBrowserEntryBase* tbe, ThumbnailExecutor::Lane lane, bool upgrade, ThumbImageUpdateListener* l)
 {
     // nobody listening?
     if ( l == nullptr ) {
@@ -201,56 +133,39 @@ void ThumbImageUpdater::add(ThumbBrowserEntryBase* tbe, bool* priority, bool upg
     Glib::Threads::Mutex::Lock lock(impl_->mutex_);
 
     // look up if an older version is in the queue
-    Impl::JobList::iterator i(impl_->jobs_.begin());
-
-    for ( ; i != impl_->jobs_.end(); ++i ) {
-        if ( i->tbe_ == tbe &&
-                i->listener_ == l &&
-                i->upgrade_ == upgrade ) {
-            DEBUG("updating job %s", tbe->shortname.c_str());
-            // we have one, update queue entry, will be picked up by thread when processed
-            /*i->pparams_ = params;
-            i->height_ = height; */
-            i->priority_ = priority;
-            return;
-        }
+    if ( !impl_->jobs_.insert(std::make_pair(tbe, upgrade)).second ) {
+        DEBUG("updating job %s", tbe->shortname.c_str());
+        // we have one, it will be picked up by a thread in its new lane
+        ThumbnailExecutor::getInstance()->setLane(tbe, lane);
+        return;
     }
 
-    // create a new job and append to queue
     DEBUG("queueing job %s", tbe->shortname.c_str());
-    impl_->jobs_.push_back(Impl::Job(tbe, priority, upgrade, l));
-
-    DEBUG("adding run request %s", tbe->shortname.c_str());
-    impl_->threadPool_->push(sigc::mem_fun(*impl_, &ThumbImageUpdater::Impl::processNextJob));
+    Impl* const impl = impl_;
+    ThumbnailExecutor::getInstance()->submit(tbe, ThumbnailExecutor::Kind::CPU, lane, [impl, tbe, upgrade, l]() {
+        impl->processJob(tbe, upgrade, l);
+    });
 }
 
+void ThumbImageUpdater::setLane(ThumbBrowserEntryBase* tbe, ThumbnailExecutor::Lane lane)
+{
+    ThumbnailExecutor::getInstance()->setLane(tbe, lane);
+}
 
-void ThumbImageUpdater::removeJobs(ThumbImageUpdateListener* listener)
+void ThumbImageUpdater::removeJobs(ThumbBrowserEntryBase* tbe)
 {
-    DEBUG("removeJobs(%p)", listener);
+    DEBUG("removeJobs(%p)", tbe);
 
     {
         Glib::Threads::Mutex::Lock lock(impl_->mutex_);
 
-        for( Impl::JobList::iterator i(impl_->jobs_.begin()); i != impl_->jobs_.end(); ) {
-            if (i->listener_ == listener) {
-                DEBUG("erasing specific job");
-                Impl::JobList::iterator e(i++);
-                impl_->jobs_.erase(e);
-            } else {
-                ++i;
-            }
-        }
+        impl_->jobs_.erase(std::make_pair(tbe, false));
+        impl_->jobs_.erase(std::make_pair(tbe, true));
+        ThumbnailExecutor::getInstance()->cancel(tbe);
     }
 
-    while ( impl_->active_ != 0 ) {
-        DEBUG("waiting for running jobs1");
-        {
-            Glib::Threads::Mutex::Lock lock(impl_->mutex_);
-            impl_->inactive_waiting_ = true;
-            impl_->inactive_.wait(impl_->mutex_);
-        }
-    }
+    DEBUG("waiting for running jobs1");
+    ThumbnailExecutor::getInstance()->wait(tbe);
 }
 
 void ThumbImageUpdater::removeAllJobs()
@@ -260,6 +175,10 @@ void ThumbImageUpdater::removeAllJobs()
     {
         Glib::Threads::Mutex::Lock lock(impl_->mutex_);
 
+        for (const auto& job : impl_->jobs_) {
+            ThumbnailExecutor::getInstance()->cancel(job.first);
+        }
+
         impl_->jobs_.clear();
     }
 
@@ -272,4 +191,3 @@ void ThumbImageUpdater::removeAllJobs()
         }
     }
 }
-
@@ -20,6 +20,7 @@
 
 #include <glib.h>
 
+#include "thumbnailexecutor.h"
 
 #include "../rtengine/noncopyable.h"
 
@@ -69,26 +70,30 @@ public:
     /**
      * @brief Add an thumbnail image update request.
      *
-     * Code will add the request to the queue and, if needed, start a pool
-     * thread to process it.
+     * Code will add the request to the shared thumbnail executor, or move
+     * it to \c lane if it is already queued.
      *
-     * @param t thumbnail
-     * @param params processing params (?)
-     * @param height how big
-     * @param priority if \c true then run as soon as possible
+     * @param tbe thumbnail
+     * @param lane where the thumbnail is relative to the visible area
+     * @param upgrade whether to replace a quick thumbnail by a processed one
      * @param l listener waiting on update
      */
-    void add(ThumbBrowserEntryBase* tbe, bool* priority, bool upgrade, ThumbImageUpdateListener* l);
+    void add(ThumbBrowserEntryBase* tbe, ThumbnailExecutor::Lane lane, bool upgrade, ThumbImageUpdateListener* l);
 
     /**
-     * @brief Remove jobs associated with listener \c l.
+     * @brief Move the queued requests of \c tbe to \c lane, e.g. after a scroll.
+     */
+    void setLane(ThumbBrowserEntryBase* tbe, ThumbnailExecutor::Lane lane);
+
+    /**
+     * @brief Remove jobs associated with thumbnail \c tbe.
      *
      * Jobs being processed will be finished. Will not return till all jobs for
-     * \c l have been completed.
+     * \c tbe have been completed.
      *
-     * @param listener jobs associated with this will be stopped
+     * @param tbe jobs associated with this will be stopped
      */
-    void removeJobs(ThumbImageUpdateListener* listener);
+    void removeJobs(ThumbBrowserEntryBase* tbe);
 
     /**
      * @brief Stop processing and remove all jobs.
@@ -0,0 +1,279 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <glibmm/threads.h>
+
+#include "thumbnailexecutor.h"
+
+#include "options.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define DEBUG(format,args...)
+//#define DEBUG(format,args...) printf("ThumbnailExecutor::%s: " format "\n", __FUNCTION__, ## args)
+
+class ThumbnailExecutor::Impl :
+    public rtengine::NonCopyable
+{
+public:
+    static constexpr int laneCount = 3;
+    static constexpr int kindCount = 2;
+
+    struct Job {
+        const void* owner;
+        Kind kind;
+        Lane lane;   // a job moved to another lane stays in the queue of the previous one, where it is skipped
+        bool queued; // false once taken or cancelled, the copies left in the queues are skipped
+        std::function<void ()> run;
+    };
+
+    typedef std::shared_ptr<Job> JobPtr;
+
+    Impl() :
+        stopping(false)
+    {
+#ifdef _OPENMP
+        const int procs = omp_get_num_procs();
+#else
+        const int procs = 2;
+#endif
+        const int ioThreads = options.thumbnailIOThreads > 0 ? options.thumbnailIOThreads : std::max(2, procs / 2);
+        const int cpuThreads = options.thumbnailCPUThreads > 0 ? options.thumbnailCPUThreads : procs;
+
+        for (int i = 0; i < ioThreads + cpuThreads; ++i) {
+            const Kind kind = i < ioThreads ? Kind::IO : Kind::CPU;
+            threads.push_back(Glib::Threads::Thread::create(sigc::bind(sigc::mem_fun(*this, &Impl::work), kind)));
+        }
+    }
+
+    ~Impl()
+    {
+        {
+            Glib::Threads::Mutex::Lock lock(mutex);
+            clear();
+            stopping = true;
+            workAvailable.broadcast();
+        }
+
+        for (auto thread : threads) {
+            thread->join();
+        }
+    }
+
+    std::deque<JobPtr>& queue(Kind kind, Lane lane)
+    {
+        return queues[static_cast<int>(kind)][static_cast<int>(lane)];
+    }
+
+    // Called with the mutex locked
+    JobPtr next(Kind own)
+    {
+        const Kind other = own == Kind::IO ? Kind::CPU : Kind::IO;
+
+        for (const Kind kind : {own, other}) {
+            for (int lane = 0; lane < laneCount; ++lane) {
+                std::deque<JobPtr>& jobs = queue(kind, static_cast<Lane>(lane));
+
+                while (!jobs.empty()) {
+                    JobPtr job = std::move(jobs.front());
+                    jobs.pop_front();
+
+                    if (job->queued && job->lane == static_cast<Lane>(lane)) {
+                        if (kind != own) {
+                            DEBUG("stealing a job of the other kind");
+                        }
+
+                        return job;
+                    }
+                }
+            }
+        }
+
+        return JobPtr();
+    }
+
+    // Called with the mutex locked
+    void take(const JobPtr& job)
+    {
+        job->queued = false;
+
+        const auto range = pending.equal_range(job->owner);
+
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == job) {
+                pending.erase(it);
+                break;
+            }
+        }
+
+        running.insert(job->owner);
+    }
+
+    // Called with the mutex locked
+    unsigned int clear()
+    {
+        const unsigned int count = pending.size();
+
+        for (const auto& entry : pending) {
+            entry.second->queued = false;
+        }
+
+        pending.clear();
+
+        for (auto& kindQueues : queues) {
+            for (auto& jobs : kindQueues) {
+                jobs.clear();
+            }
+        }
+
+        return count;
+    }
+
+    void work(Kind kind)
+    {
+        Glib::Threads::Mutex::Lock lock(mutex);
+
+        while (true) {
+            const JobPtr job = next(kind);
+
+            if (!job) {
+                if (stopping) {
+                    return;
+                }
+
+                workAvailable.wait(mutex);
+                continue;
+            }
+
+            take(job);
+
+            lock.release();
+            job->run();
+            lock.acquire();
+
+            running.erase(running.find(job->owner));
+            jobDone.broadcast();
+        }
+    }
+
+    // Need to be a Glib::Threads::Mutex because used in a Glib::Threads::Cond object
+    Glib::Threads::Mutex mutex;
+    Glib::Threads::Cond workAvailable;
+    Glib::Threads::Cond jobDone;
+
+    std::deque<JobPtr> queues[kindCount][laneCount];
+    std::unordered_multimap<const void*, JobPtr> pending;
+    std::unordered_multiset<const void*> running;
+
+    std::vector<Glib::Threads::Thread*> threads;
+    bool stopping;
+};
+
+ThumbnailExecutor* ThumbnailExecutor::getInstance()
+{
+    static ThumbnailExecutor instance_;
+    return &instance_;
+}
+
+ThumbnailExecutor::ThumbnailExecutor() :
+    impl(new Impl())
+{
+}
+
+ThumbnailExecutor::~ThumbnailExecutor()
+{
+    delete impl;
+}
+
+void ThumbnailExecutor::submit(const void* owner, Kind kind, Lane lane, const std::function<void ()>& job)
+{
+    const Impl::JobPtr entry(new Impl::Job{owner, kind, lane, true, job});
+
+    Glib::Threads::Mutex::Lock lock(impl->mutex);
+
+    impl->queue(kind, lane).push_back(entry);
+    impl->pending.emplace(owner, entry);
+    impl->workAvailable.signal();
+}
+
+void ThumbnailExecutor::setLane(const void* owner, Lane lane)
+{
+    Glib::Threads::Mutex::Lock lock(impl->mutex);
+
+    const auto range = impl->pending.equal_range(owner);
+
+    for (auto it = range.first; it != range.second; ++it) {
+        const Impl::JobPtr& job = it->second;
+
+        if (job->lane != lane) {
+            job->lane = lane;
+            impl->queue(job->kind, lane).push_back(job);
+        }
+    }
+}
+
+unsigned int ThumbnailExecutor::cancel(const void* owner)
+{
+    Glib::Threads::Mutex::Lock lock(impl->mutex);
+
+    const auto range = impl->pending.equal_range(owner);
+    unsigned int count = 0;
+
+    for (auto it = range.first; it != range.second; ++it) {
+        it->second->queued = false;
+        ++count;
+    }
+
+    impl->pending.erase(range.first, range.second);
+
+    return count;
+}
+
+unsigned int ThumbnailExecutor::cancelAll()
+{
+    Glib::Threads::Mutex::Lock lock(impl->mutex);
+
+    return impl->clear();
+}
+
+void ThumbnailExecutor::wait(const void* owner)
+{
+    Glib::Threads::Mutex::Lock lock(impl->mutex);
+
+    while (impl->running.count(owner)) {
+        DEBUG("waiting for running jobs");
+        impl->jobDone.wait(impl->mutex);
+    }
+}
+
+void ThumbnailExecutor::waitAll()
+{
+    Glib::Threads::Mutex::Lock lock(impl->mutex);
+
+    while (!impl->running.empty()) {
+        DEBUG("waiting for running jobs");
+        impl->jobDone.wait(impl->mutex);
+    }
+}
@@ -0,0 +1,98 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <functional>
+
+#include "../rtengine/noncopyable.h"
+
+/**
+ * @brief Worker threads shared by the file browser to load the previews and to process the thumbnails
+ *
+ * Jobs are queued in three lanes, taken in order: the thumbnails currently visible, the ones close to the
+ * visible area and everything else. The workers are split between I/O jobs (loading the cache entries of a
+ * directory) and CPU jobs (processing the thumbnails): each worker takes the jobs of its own kind first and
+ * steals the jobs of the other kind when it has nothing left, so a directory with nothing to process gets
+ * all the threads for loading and vice versa.
+ *
+ * Jobs are grouped by an owner (any pointer) which allows to move them to another lane when the view is
+ * scrolled, and to cancel them when they are not needed anymore.
+ */
+class ThumbnailExecutor :
+    public rtengine::NonCopyable
+{
+public:
+    enum class Lane {
+        VISIBLE,
+        NEAR_VISIBLE,
+        BACKGROUND
+    };
+
+    enum class Kind {
+        IO,
+        CPU
+    };
+
+    static ThumbnailExecutor* getInstance();
+
+    /**
+     * @brief Queue a job
+     *
+     * @param owner identifies the job for setLane(), cancel() and wait()
+     */
+    void submit(const void* owner, Kind kind, Lane lane, const std::function<void ()>& job);
+
+    /**
+     * @brief Move the queued jobs of \c owner to \c lane
+     */
+    void setLane(const void* owner, Lane lane);
+
+    /**
+     * @brief Remove the queued jobs of \c owner
+     *
+     * @return the number of jobs removed
+     */
+    unsigned int cancel(const void* owner);
+
+    /**
+     * @brief Remove the queued jobs of all owners
+     *
+     * @return the number of jobs removed
+     */
+    unsigned int cancelAll();
+
+    /**
+     * @brief Wait until no job of \c owner is running anymore
+     *
+     * @note must not be called from a job
+     */
+    void wait(const void* owner);
+
+    /**
+     * @brief Wait until no job is running anymore
+     *
+     * @note must not be called from a job
+     */
+    void waitAll();
+
+private:
+    ThumbnailExecutor();
+    ~ThumbnailExecutor();
+
+    class Impl;
+    Impl* const impl;
+};